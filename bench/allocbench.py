@@ -54,6 +54,8 @@ benchmarks = [
     {'name': 'allocbench/huge.R', 'warmup_rep': 0, 'bench_rep': 1},
     {'name': 'allocbench/huge-recursive.R', 'warmup_rep': 0, 'bench_rep': 1},
     {'name': 'allocbench/huge-reuse.R', 'warmup_rep': 0, 'bench_rep': 1},
+    {'name': 'allocbench/small-threaded.R', 'warmup_rep': 0, 'bench_rep': 1},
+    {'name': 'allocbench/medium-threaded.R', 'warmup_rep': 0, 'bench_rep': 1},
     ]
 
 
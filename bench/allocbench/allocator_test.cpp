@@ -22,6 +22,10 @@
  */
 
 #define COMPILING_RHO
+#include <thread>
+#include <vector>
+
+#include "rho/GCNodeAllocator.hpp"
 #include "rho/IntVector.hpp"
 #include "rho/GCStackRoot.hpp"
 #include "rho/MemoryBank.hpp"
@@ -180,3 +184,32 @@ SEXP alloc_lookup_intvec(int* num, int* lookups, int* size) {
     return nullptr;
 }
 
+// Allocate and free num blocks of the given size in batches of each, from
+// each of num_threads threads at once.
+// This measures the throughput of the allocator when it is used from several
+// threads.  Raw blocks are used since nodes may not be created while the
+// allocator is multithreaded.
+extern "C"
+SEXP alloc_threaded(int* num_threads, int* num, int* each, int* size) {
+    alloc_various_intvec();
+    GCNodeAllocator::setMultiThreaded(true);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < *num_threads; ++t) {
+        threads.emplace_back([=]() {
+            std::vector<void*> allocations(*each);
+            for (int i = 0; i < ((*num + *each - 1) / *each); ++i) {
+                for (int k = 0; k < *each; ++k) {
+                    allocations[k] = GCNodeAllocator::allocate(*size);
+                }
+                for (int k = 0; k < *each; ++k) {
+                    GCNodeAllocator::free(allocations[k]);
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    GCNodeAllocator::setMultiThreaded(false);
+    return nullptr;
+}
@@ -212,6 +212,15 @@ public:
    */
   void applyToAllAllocations(std::function<void(void*)> fun) const;
 
+  /** @brief Iterates over all current superblocks and large allocations.
+   *
+   * The first function is called once for each medium-object superblock
+   * and the second function is called once for each large allocation.
+   */
+  void applyToAllSuperblocks(
+      std::function<void(AllocatorSuperblock*)> superblock_fun,
+      std::function<void(void*)> allocation_fun) const;
+
   /** @breif Erases all hashtable entries for an allocation.
    *
    * @param size_log2 the 2-log of the allocation size. Determines how many
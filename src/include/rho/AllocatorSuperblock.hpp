@@ -48,6 +48,12 @@ namespace rho {
  * of blocks that fit in the superblock, then the superblock is taken out of
  * the pool of superblocks with available nodes. Superblock nodes that are
  * freed are linked up in freelists according to size class.
+ *
+ * When the generational collector is enabled, a second bitset (m_young)
+ * records which of the allocated blocks were allocated since the last
+ * garbage collection.  Superblocks containing young blocks are linked
+ * into the allocator nursery so that a minor collection only needs to
+ * visit the young part of the heap.
  */
 class AllocatorSuperblock {
 public:
@@ -60,12 +66,15 @@ public:
    */
   AllocatorSuperblock(unsigned size_class, unsigned bitset_entries):
       m_size_class(size_class),
-      m_next_untouched(0) {
+      m_next_untouched(0),
+      m_in_nursery(false),
+      m_released(false) {
     // Here we mark all bitset entries as free so that we don't have to do
     // precise range checking while iterating over currently allocated blocks
     // when the number of blocks is not evenly divisible by 64.
     for (int i = 0; i < bitset_entries; ++i) {
       m_free[i] = ~0ull;
+      m_young[i] = 0;
     }
   }
 
@@ -74,6 +83,13 @@ public:
    */
   static void allocateArena();
 
+  /** @brief Back the small object arena with transparent huge pages.
+   *
+   * Applies to the part of the arena already in use as well as to any
+   * later growth.  Has no effect where huge pages are not supported.
+   */
+  static void setHugePages(bool enable);
+
   /**
    * Allocate a small block (bytes >= 32 && bytes <= 256).
    * Returns nullptr if there is no more space left for this object
@@ -93,15 +109,54 @@ public:
   /** @brief Apply function to all current allocations. */
   static void applyToArenaAllocations(std::function<void(void*)> fun);
 
+  /** @brief Apply function to all small-object superblocks. */
+  static void applyToArenaSuperblocks(
+      std::function<void(AllocatorSuperblock*)> fun);
+
   /** @brief Apply function to all current blocks in this superblock. */
   void applyToBlocks(std::function<void(void*)> fun) const;
 
+  /** @brief Apply function to all allocations overlapping a dirty card.
+   *
+   * Only small-object arena allocations are covered by the card table.
+   */
+  static void applyToDirtyCards(std::function<void(void*)> fun);
+
+  /** @brief Apply function to all young blocks in this superblock. */
+  void applyToYoungBlocks(std::function<void(void*)> fun) const;
+
+  /** @brief Reset all cards in the card table to clean. */
+  static void clearCards();
+
+  /** @brief Forget the age of all blocks in this superblock.
+   *
+   * All currently allocated blocks are considered old after this call.
+   */
+  void clearYoungBlocks();
+
   /**
    * Free a pointer inside a given superblock. The block MUST be in the given
    * superblock.
    */
   void freeBlock(void* pointer);
 
+  /**
+   * Returns true if this arena superblock has no allocated blocks and is
+   * not in use for allocating untouched blocks.
+   */
+  bool isEmpty() const;
+
+  /** @brief Number of currently allocated blocks in this superblock. */
+  unsigned numAllocatedBlocks() const;
+
+  /**
+   * Return the memory of the blocks of an empty arena superblock to the
+   * operating system, and keep the superblock for reuse by
+   * newSuperblockFromArena().  The header stays valid, so pointer lookups
+   * in the superblock still work.  No freelist may refer to its blocks.
+   */
+  void release();
+
   /**
    * Tests the bitset if a block index is allocated.
    * Returns true if the given block is currently allocated.
@@ -128,6 +183,19 @@ public:
         && pointer < endPointer();
   }
 
+  /** @brief Record a write to the card containing a given address.
+   *
+   * @return false if the address is outside the small object arena, in
+   * which case the write has not been recorded.
+   */
+  static bool markCard(uintptr_t address) {
+    if (address - s_arena_start >= s_arena_size) {
+      return false;
+    }
+    s_cards[(address - s_arena_start) >> s_card_size_log2] = 1;
+    return true;
+  }
+
   /** Print debug info about this superblock. */
   void printSummary() const;
 
@@ -155,12 +223,13 @@ private:
    * This leaves some unused bitset entries for larger block sizes.
    * Superblocks are either 2^18 or 2^19 bytes.
    *
-   * The fixed header size is 1168 bytes. This is the breakdown:
+   * The fixed header size is 2176 bytes. This is the breakdown:
    *    size_class     =   32 bytes
    *    next_untouched =   32 bytes
    *    free_list      =   64 bytes
    *    free bitset    = 1024 bytes
-   *    total          = 1152 bytes
+   *    young bitset   = 1024 bytes
+   *    total          = 2176 bytes
    *
    * The bitset can map 1024 * 8 = 8192 blocks.  We use these two combinations
    * of superblock size and minimum block size:
@@ -173,28 +242,57 @@ private:
    * without accounting for the header size, so there is actually a little
    * bit of slack, i.e. wasted bits in the bitset.
    *
-   * The required header size can be calculated with the following equation:
+   * The required header size can be calculated with the following equation
+   * (there are two bitsets of equal size):
    *
    * header_size =
-   *   128 + 8 * ( ( (sb_size + block_size - 1) / block_size ) + 63 ) / 64 )
+   *   128 + 16 * ( ( (sb_size + block_size - 1) / block_size ) + 63 ) / 64 )
    */
   static constexpr unsigned s_superblock_header_size =
-      128 + 8 * ((((1 << 18) + 31) / 32 + 63) / 64);
+      128 + 16 * ((((1 << 18) + 31) / 32 + 63) / 64);
 
   /**
-   * The number of 64-bit bitset entries needed to store the free bitset.
-   * Must be declared here so it comes
+   * The number of 64-bit bitset entries needed to store each of the free
+   * and young bitsets.
    */
   static constexpr unsigned s_max_bitset_entries =
-      (s_superblock_header_size - 128) / 8;
+      (s_superblock_header_size - 128) / 16;
 
-  // These are the superblock header members (1152 bytes total):
+  // These are the superblock header members (2176 bytes total):
   std::uint32_t m_size_class;
   std::uint32_t m_next_untouched;
+  bool m_in_nursery;  // Set if this superblock is linked into the nursery.
+  bool m_released;  // Set if the block memory was returned to the OS.
   std::uint64_t m_free[s_max_bitset_entries];  // Bit map of free blocks.
+  std::uint64_t m_young[s_max_bitset_entries];  // Bit map of young blocks.
+
+  /**
+   * Address space reserved for the small object arena.  Where possible
+   * this is s_max_arena_size, but only the part in use is committed.
+   */
+  static size_t s_arena_size;
+
+  /** The arena is committed in steps of 1Gb = 30 bits. */
+  static constexpr size_t s_arena_growth = size_t{1} << 30;
+
+  /** The arena reserves up to 64Gb on 64-bit platforms. */
+  static constexpr size_t s_max_arena_size =
+      sizeof(void*) >= 8 ? 64 * s_arena_growth : s_arena_growth;
+
+  /** The arena is aligned for 2Mb huge pages. */
+  static constexpr size_t s_huge_page_size = size_t{1} << 21;
+
+  /** Start of the small object arena. */
+  static uintptr_t s_arena_start;
+
+  /**
+   * The card table used by the generational write barrier.  Each byte
+   * covers 2^s_card_size_log2 bytes of the small object arena, and is
+   * set when an edge within that range is made to point to a young node.
+   */
+  static unsigned char* s_cards;
 
-  /** Samll object arena is 1Gb = 30 bits. */
-  static constexpr unsigned s_arenasize = 1 << 30;
+  static constexpr unsigned s_card_size_log2 = 9;
 
   /**
    * A small object superblock has size 2^18.
@@ -271,6 +369,12 @@ private:
    */
   static AllocatorSuperblock* newSuperblockFromArena(unsigned block_size);
 
+  /**
+   * Commits the next part of the reserved arena address space.
+   * Returns false if the whole reservation is already in use.
+   */
+  static bool growArena();
+
   /** @brief Allocates a new large superblock for medium-sized allocations.
    *
    * Large superblocks are allocated outside the small block arena.
@@ -287,6 +391,22 @@ private:
   /** Print debug info about all small-object superblocks. */
   static void debugPrintSmallSuperblocks();
 
+  /** @brief Tag an allocated block as young.
+   *
+   * Links the superblock into the nursery if it is not already there.
+   */
+  void tagBlockYoung(unsigned block);
+
+  /** @brief Returns a pointer to the block with the given index. */
+  void* blockPointer(unsigned block) const {
+    return reinterpret_cast<void*>(firstBlockPointer() + block * blockSize());
+  }
+
+  /** @brief Number of blocks that fit in this superblock. */
+  unsigned numBlocks() const {
+    return (superblockSize() - s_superblock_header_size) / blockSize();
+  }
+
   /**
    * Get the size class index for a small allocation using the allocation
    * size in bytes.
@@ -30,6 +30,7 @@
 #define ARGLIST_HPP 1
 
 #include <boost/range.hpp>
+#include <vector>
 #include "rho/GCStackRoot.hpp"
 #include "rho/PairList.hpp"
 #include "rho/Symbol.hpp"
@@ -464,6 +465,16 @@ namespace rho {
 	 * @param call The call that the arguments came from.  Ignored unless
 	 *          the ArgList has status EVALUATED.
 	 *
+	 * @param strict_args If non-null, the function being called
+	 *          is unable to tell a Promise from its value, and
+	 *          element i is true if the function is certain to
+	 *          evaluate its i'th argument.  Constant arguments
+	 *          are then passed by value, as are the values of
+	 *          variables passed positionally to strict
+	 *          arguments, provided no argument of the call needs
+	 *          evaluating.  This saves allocating Promises where
+	 *          the difference can't be observed.
+	 *
 	 * @note It would be desirable to avoid producing a new
 	 * PairList, and to absorb this functionality directly into
 	 * the ArgMatcher::match() function.  But at present the
@@ -471,7 +482,8 @@ namespace rho {
 	 * Closure::apply(), and used for other purposes.
 	 */
 	void wrapInPromises(Environment* env,
-			    const Expression* call = nullptr);
+			    const Expression* call = nullptr,
+			    const std::vector<bool>* strict_args = nullptr);
 
     private:
 	const PairList* const m_orig_list;  // Pointer to the argument
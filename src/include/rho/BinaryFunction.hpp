@@ -169,6 +169,41 @@ namespace rho {
 	};
 
 
+	/** @brief Operand that can hold the result of a binary function.
+	 *
+	 * Arithmetic on unshared temporaries, as in <tt>(x + 1) *
+	 * 2</tt>, needn't allocate a new vector for each result: the
+	 * result can overwrite an operand that is of the right type
+	 * and size and that nothing else refers to (i.e. has NAMED
+	 * zero).  As in CR's R_allocOrReuseVector(), the second
+	 * operand is preferred.  As for the unary reusableOperand(),
+	 * operands are only reused if neither has attributes.
+	 *
+	 * @tparam OutputType Class of vector returned by the function.
+	 *
+	 * @param lhs Non-null pointer to the first operand.
+	 *
+	 * @param rhs Non-null pointer to the second operand.
+	 *
+	 * @return Pointer to the operand that may be overwritten with
+	 * the result, or a null pointer if neither can be.
+	 */
+	template<typename OutputType, typename LhsType, typename RhsType>
+	OutputType* reusableOperand(const LhsType* lhs, const RhsType* rhs)
+	{
+	    if (lhs->hasAttributes() || rhs->hasAttributes())
+		return nullptr;
+	    size_t size = std::max(lhs->size(), rhs->size());
+	    if (lhs->size() == 0 || rhs->size() == 0)
+		size = 0;
+	    OutputType* result = internal::reusable<OutputType>(
+		rhs, size, std::is_same<OutputType, RhsType>());
+	    if (!result)
+		result = internal::reusable<OutputType>(
+		    lhs, size, std::is_same<OutputType, LhsType>());
+	    return result;
+	}
+
 	/** @brief Apply a binary function to a pair of vectors.
 	 *
 	 * If either operand has size zero then the result will have
@@ -205,6 +240,11 @@ namespace rho {
 	 * @tparam OutputType Class of vector returned by the function.  It
 	 *           must be possible implicitly to convert the return value
 	 *           of \a op to this type's element data type.
+	 *
+	 * @param result If not null, the vector in which to store the
+	 *          result, for example one obtained from
+	 *          reusableOperand().  Otherwise a new vector is
+	 *          created.
 	 */
 	template<typename Op, typename AttributeCopier,
 		 typename LhsType, typename RhsType,
@@ -212,7 +252,8 @@ namespace rho {
 	OutputType* applyBinaryOperator(const Op& op,
 					AttributeCopier attribute_copier,
 					const LhsType* lhs,
-					const RhsType* rhs)
+					const RhsType* rhs,
+					OutputType* result = nullptr)
 	{
 	    size_t lhs_size = lhs->size();
 	    size_t rhs_size = rhs->size();
@@ -225,7 +266,8 @@ namespace rho {
 	    if (size == 1 && !lhs->hasAttributes() && !rhs->hasAttributes()) {
 		return OutputType::createScalar(op((*lhs)[0], (*rhs)[0]));
 	    }
-	    OutputType* result = OutputType::create(size);
+	    if (!result)
+		result = OutputType::create(size);
 	    if (size == 1) {
 		(*result)[0] = op((*lhs)[0], (*rhs)[0]);
 	    } else if (lhs_size == 1) {
@@ -265,6 +307,109 @@ namespace rho {
 	    return result;
 	}
 
+	namespace internal {
+	    // Applies kernel to a longer operand and a shorter one that is
+	    // recycled, passing it runs of the longer operand that line up
+	    // with the start of the shorter one.  A very short operand is
+	    // first replicated so that each run is long enough to vectorize.
+	    template<typename Kernel, typename Value, typename Output>
+	    void applyKernelRecycling(Kernel kernel, bool long_is_lhs,
+				      const Value* long_data,
+				      const Value* short_data,
+				      size_t short_size,
+				      Output* out, size_t size)
+	    {
+		const size_t min_run = 256;
+		Value buffer[min_run];
+		if (short_size < min_run / 2) {
+		    size_t run = (min_run / short_size) * short_size;
+		    for (size_t i = 0; i < run; ++i)
+			buffer[i] = short_data[i % short_size];
+		    short_data = buffer;
+		    short_size = run;
+		}
+		for (size_t start = 0; start < size; start += short_size) {
+		    size_t n = std::min(short_size, size - start);
+		    if (long_is_lhs)
+			kernel(long_data + start, 1, short_data, 1,
+			       out + start, n);
+		    else
+			kernel(short_data, 1, long_data + start, 1,
+			       out + start, n);
+		}
+	    }
+	}
+
+	/** @brief Apply a vectorized kernel to a pair of vectors.
+	 *
+	 * This behaves exactly like applyBinaryOperator(), but
+	 * instead of calling a function for each element it passes
+	 * runs of elements to \a kernel, which is called as
+	 * <tt>kernel(lhs, lhs_stride, rhs, rhs_stride, out, n)</tt>
+	 * and must set <tt>out[i]</tt> from <tt>lhs[i *
+	 * lhs_stride]</tt> and <tt>rhs[i * rhs_stride]</tt> for each
+	 * \a i less than \a n.  The strides are 0 when an operand
+	 * has a single element, and 1 otherwise.  See
+	 * rho::VectorKernels for suitable kernels.
+	 *
+	 * @tparam OutputType Class of vector returned by the function.
+	 *           Its elements must have the same representation
+	 *           as the type written by \a kernel.
+	 *
+	 * @tparam Kernel Type of the function object \a kernel.
+	 *
+	 * @tparam AttributeCopier As for applyBinaryOperator().
+	 *
+	 * @tparam VectorType Class of vector forming both operands.
+	 *
+	 * @param result As for applyBinaryOperator().  The kernels in
+	 *          rho::VectorKernels allow \a out to be the same as
+	 *          \a lhs or \a rhs.
+	 */
+	template<typename OutputType, typename Kernel,
+		 typename AttributeCopier, typename VectorType>
+	OutputType* applyBinaryKernel(Kernel kernel,
+				      AttributeCopier attribute_copier,
+				      const VectorType* lhs,
+				      const VectorType* rhs,
+				      OutputType* result = nullptr)
+	{
+	    typedef typename VectorType::value_type Value;
+	    typedef typename OutputType::value_type OutputValue;
+	    size_t lhs_size = lhs->size();
+	    size_t rhs_size = rhs->size();
+	    size_t size = std::max(lhs_size, rhs_size);
+	    if (lhs_size == 0 || rhs_size == 0)
+		size = 0;
+	    if (!result)
+		result = OutputType::create(size);
+	    if (size > 0) {
+		const Value* l = lhs->begin();
+		const Value* r = rhs->begin();
+		OutputValue* out = result->begin();
+		if (lhs_size == rhs_size)
+		    kernel(l, 1, r, 1, out, size);
+		else if (lhs_size == 1)
+		    kernel(l, 0, r, 1, out, size);
+		else if (rhs_size == 1)
+		    kernel(l, 1, r, 0, out, size);
+		else {
+		    if (lhs_size > rhs_size)
+			internal::applyKernelRecycling(kernel, true, l, r,
+						       rhs_size, out, size);
+		    else
+			internal::applyKernelRecycling(kernel, false, r, l,
+						       lhs_size, out, size);
+		    if (size % lhs_size != 0 || size % rhs_size != 0) {
+			Rf_warning(_("longer object length is not"
+				     " a multiple of shorter object length"));
+		    }
+		}
+	    }
+	    attribute_copier.copyAttributes(result, lhs, rhs);
+	    return result;
+	}
+
     }  // namespace VectorOps
 }  // namespace rho
 	
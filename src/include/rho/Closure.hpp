@@ -31,6 +31,7 @@
 #ifndef RCLOSURE_H
 #define RCLOSURE_H
 
+#include <vector>
 #include "rho/FunctionBase.hpp"
 #include "rho/ArgMatcher.hpp"
 #include "rho/Environment.hpp"
@@ -74,7 +75,8 @@ namespace rho {
 	 */
 	Closure(const Closure& pattern)
 	    : FunctionBase(pattern), m_debug(false),
-              m_num_invokes(0),
+	      m_compilation_failed(false),
+              m_num_invokes(0), m_num_back_edges(0),
 	      m_matcher(pattern.m_matcher), m_body(pattern.m_body),
 	      m_environment(pattern.m_environment)
 	{}
@@ -154,9 +156,48 @@ namespace rho {
 	}
 
 	/** @brief Create an environment suitable for evaluating this closure.
+	 *
+	 * If an earlier call left an environment for reuse (see
+	 * releaseExecutionEnv()), that is returned instead.
 	 */
         Environment* createExecutionEnv() const;
 
+	/** @brief Finish with an environment from createExecutionEnv().
+	 *
+	 * Called just before a call of this Closure returns
+	 * normally.  If the compiled body can't have captured \a
+	 * env, and no other Closure was executed during the call,
+	 * \a env is emptied and kept for the next call.  Otherwise
+	 * its Frame is detached if possible (see
+	 * Environment::maybeDetachFrame()).
+	 *
+	 * @param env The local environment of the call.
+	 *
+	 * @param executions_before The value of executionCount()
+	 *          before the call started.
+	 */
+	void releaseExecutionEnv(Environment* env,
+				 unsigned int executions_before) const;
+
+	/** @brief Arguments that can be passed by value.
+	 *
+	 * @return null unless the compiled body is known to be
+	 * unable to tell a Promise from its value.  Otherwise
+	 * element i of the vector is true if the body is certain to
+	 * evaluate its i'th formal argument.  Suitable for passing to
+	 * ArgList::wrapInPromises().
+	 */
+	const std::vector<bool>* strictArguments() const;
+
+	/** @brief Number of Closure executions so far.
+	 *
+	 * The count wraps around on overflow.
+	 */
+	static unsigned int executionCount()
+	{
+	    return s_execution_count;
+	}
+
 	/** @brief Set debugging status.
 	 *
 	 * @param on The required new debugging status (true =
@@ -220,6 +261,80 @@ namespace rho {
 	void visitReferents(const_visitor* v) const override;
 
         void compile() const;
+
+#ifdef ENABLE_LLVM_JIT
+	/** @brief Statistics on the JIT compilation of this Closure.
+	 *
+	 * @return The Closure's statistics, which are created on
+	 * first use.
+	 */
+	std::shared_ptr<JIT::ClosureStatistics> jitStatistics() const;
+
+	/** @brief Compiled code for a loop in the body.
+	 *
+	 * Used for on-stack replacement of long-running interpreted
+	 * loops (see JIT::CompiledExpression::enterLoop()).  The loop
+	 * is queued for compilation the first time this is called,
+	 * and the code is kept for later calls of the Closure.
+	 *
+	 * @param loop Pointer to a loop in the body.
+	 *
+	 * @param env Working environment of a call of this Closure
+	 *          that is running the loop.
+	 *
+	 * @param replace_frame true if the code is to use a
+	 *          CompiledFrame in place of env's frame.  Otherwise
+	 *          it looks up all variables through the interpreter.
+	 *
+	 * @return The code, which may not be ready yet, or null if it
+	 * hasn't been queued yet or the loop can't be compiled.
+	 */
+	JIT::CompiledExpression* compiledLoop(const Expression* loop,
+					      Environment* env,
+					      bool replace_frame) const;
+#endif
+
+	/** @brief Not for general use.
+	 *
+	 * Credit loop back edges taken by the interpreter to the
+	 * innermost Closure being executed, if any.  The count is
+	 * used in deciding when a Closure is worth compiling.
+	 *
+	 * @param count Number of back edges taken.
+	 */
+	static void countBackEdges(unsigned int count);
+
+	/** @brief Count the iterations of an interpreted loop.
+	 *
+	 * The interpreter's loop primitives declare one of these on
+	 * the stack and call increment() on each iteration.  The
+	 * total is passed to countBackEdges() when the loop exits.
+	 */
+	class BackEdgeCounter {
+	public:
+	    BackEdgeCounter()
+		: m_count(0)
+	    {}
+
+	    ~BackEdgeCounter()
+	    {
+		if (m_count)
+		    countBackEdges(m_count);
+	    }
+
+	    void increment()
+	    {
+		++m_count;
+	    }
+
+	    /** @brief Iterations counted so far. */
+	    unsigned int count() const
+	    {
+		return m_count;
+	    }
+	private:
+	    unsigned int m_count;
+	};
     protected:
 	// Virtual function of GCNode:
 	void detachReferents() override;
@@ -268,20 +383,43 @@ namespace rho {
 	};
 
 	bool m_debug;
+	mutable bool m_compilation_failed;
         mutable int m_num_invokes;
+	mutable unsigned int m_num_back_edges;
 #ifdef ENABLE_LLVM_JIT
         mutable GCEdge<JIT::CompiledExpression> m_compiled_body;
+	// Code being generated by the background compilation thread.
+        mutable GCEdge<JIT::CompiledExpression> m_pending_body;
+	mutable std::shared_ptr<JIT::ClosureStatistics> m_jit_statistics;
+	// Code for loops in the body (see compiledLoop()).  Null code
+	// records a loop that can't be compiled.
+	struct CompiledLoop {
+	    GCEdge<const Expression> m_loop;
+	    bool m_replaces_frame;
+	    GCEdge<JIT::CompiledExpression> m_code;
+	};
+	mutable std::vector<CompiledLoop> m_compiled_loops;
 #else
         GCEdge<> m_compiled_body;  // unused.
+        GCEdge<> m_pending_body;  // unused.
 #endif
 	GCEdge<const ArgMatcher> m_matcher;
 	GCEdge<> m_body;
 	GCEdge<Environment> m_environment;
         static bool s_debugging_enabled;
+	static unsigned int s_execution_count;
 
 	// If a JIT compiled version of this closure exists, invalidate it.
 	void invalidateCompiledCode();
 
+	// Queue the closure for compilation (or recompilation with
+	// optimization) once it is hot enough.
+	void maybeCompile() const;
+
+	// Switch to the code from the background compilation thread,
+	// if it is ready.
+	void installPendingCode() const;
+
 	// Declared private to ensure that Closure objects are
 	// created only using 'new':
 	~Closure();
@@ -309,6 +309,22 @@ namespace rho {
 	    return m_frame;
 	}
 
+	/** @brief Replace the Environment's Frame.
+	 *
+	 * The bindings of the current Frame are copied into \a
+	 * frame, which then takes its place.  This allows compiled
+	 * code to take over an Environment that was set up by the
+	 * interpreter.
+	 *
+	 * @param frame Pointer to an empty Frame.  As with
+	 *          Frame::clone(), it will not have a read or write
+	 *          monitor.
+	 *
+	 * @note The Environment must not be on the search path
+	 * (checked).
+	 */
+	void replaceFrame(Frame* frame);
+
 	/** @brief Global environment.
 	 *
 	 * @return Pointer to the global environment.
@@ -379,6 +395,23 @@ namespace rho {
 #endif
 	}
 
+	/** @brief Empty the Environment for reuse, if safe.
+	 *
+	 * An alternative to maybeDetachFrame() for the local
+	 * Environment of a Closure whose body is known not to
+	 * capture it.  If the Environment does not appear to have
+	 * leaked, and has not been locked or debugged, all bindings
+	 * are removed from its Frame so that the Environment can
+	 * serve another call of the same Closure.
+	 *
+	 * @return true iff the Environment has been emptied.
+	 *
+	 * @note This function always returns false unless the
+	 * preprocessor variable DETACH_LOCAL_FRAMES is defined in
+	 * Environment.h.
+	 */
+	bool clearForReuse();
+
 	/** @brief Get namespace spec (if applicable).
 	 *
 	 * @return If this Environment is a namespace environment,
@@ -447,6 +480,26 @@ namespace rho {
 	 */
 	static Environment* detachFromSearchPath(int pos);
 	    
+	/** @brief Counts of search path cache lookups and
+	 * invalidations.
+	 */
+	struct SearchPathCacheStatistics {
+	    std::size_t hits;  ///< Found a cached Binding.
+	    std::size_t negative_hits;  ///< Found the Symbol cached as unbound.
+	    std::size_t misses;  ///< Searched the search path.
+	    std::size_t flushes;  ///< Entries invalidated for one Symbol.
+	    std::size_t generations;  ///< Times every entry was invalidated.
+	};
+
+	/** @brief Search path cache statistics since the last reset. */
+	static const SearchPathCacheStatistics& searchPathCacheStatistics()
+	{
+	    return s_cache_statistics;
+	}
+
+	/** @brief Reset the search path cache statistics to zero. */
+	static void resetSearchPathCacheStatistics();
+
 	/** @brief The name by which this type is known in R.
 	 *
 	 * @return The name by which this type is known in R.
@@ -489,10 +542,16 @@ namespace rho {
 	};
 
 	// The class maintains a cache of Symbol Bindings found along
-	// the search path:
+	// the search path.  Symbols found to be unbound throughout the
+	// search path are cached too, with a null Binding.  Each entry
+	// is stamped with the generation current when it was made, and
+	// entries from earlier generations are ignored, so that the
+	// whole cache can be invalidated without clearing it.
         class Cache;
 	static Cache* searchPathCache();
         static Cache* createSearchPathCache();
+	static unsigned int s_cache_generation;
+	static SearchPathCacheStatistics s_cache_statistics;
 
 	// Predefined environments:
 	static Environment* createBaseEnvironment();
@@ -528,7 +587,7 @@ namespace rho {
 	void detachFrame();
 
 	// Remove any mapping of 'sym' from the search path cache.  If called
-        // with a null pointer, clear the cache entirely.
+        // with a null pointer, invalidate the cache entirely.
 	static void flushFromSearchPathCache(const Symbol* sym);
 
 	static void initialize();
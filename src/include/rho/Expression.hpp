@@ -32,9 +32,14 @@
 #define EXPRESSION_H
 
 #include "rho/ArgList.hpp"
+#include "rho/Environment.hpp"
 #include "rho/FunctionBase.hpp"
 #include "rho/PairList.hpp"
 
+#ifdef ENABLE_LLVM_JIT
+#include "rho/jit/CompiledExpression.hpp"
+#endif
+
 namespace rho {
     class ArgList;
     class ArgMatchInfo;
@@ -159,7 +164,7 @@ namespace rho {
 	// allocated only using 'new':
 	~Expression() {}
 
-        FunctionBase* getFunction(Environment* env) const;
+        virtual FunctionBase* getFunction(Environment* env) const;
 
         RObject* evaluateClosureCall(const Closure* func,
 				     Environment* env,
@@ -207,6 +212,8 @@ namespace rho {
 					      Environment* execution_env) const;
 
 	Expression& operator=(const Expression&) = delete;
+
+	friend class VectorFusion;
     };
 
     /** @brief Singly linked list representing an R expression.
@@ -220,6 +227,23 @@ namespace rho {
      *
      * Unlike the regular Expression class, this class caches the results of
      * parameter matching to closure calls for improved performance.
+     *
+     * The cache is polymorphic: it holds the matchings for up to
+     * s_cache_size different combinations of closure and argument tags,
+     * so that call sites that see several closures (such as S3 generics,
+     * or the FUN argument of lapply) don't thrash it.  The tags are those
+     * of the supplied arguments after any '...' has been expanded, so
+     * calls passing '...' on are cacheable too.  Once the cache is full
+     * the call site is considered megamorphic, and calls that miss the
+     * cache use full argument matching.
+     *
+     * When the function is named by a Symbol, the class also caches the
+     * function found.  For calls evaluated other than in the global
+     * environment, the local Frame is searched directly and the cached
+     * lookup starts from the enclosing Environment, so calls from the
+     * body of a closure share a cache entry from one invocation to the
+     * next.  The entry is valid until Frame::functionBindingVersion()
+     * changes.
      */
     class CachingExpression : public Expression {
     public:
@@ -235,12 +259,13 @@ namespace rho {
 	explicit CachingExpression(RObject* cr = nullptr,
 				   PairList* tl = nullptr,
 				   const RObject* tg = nullptr)
-	    : Expression(cr, tl, tg)
+	    : Expression(cr, tl, tg), m_cache(), m_function_cache()
 	{}
 
 	CachingExpression(RObject* function,
 			  std::initializer_list<RObject*> unnamed_args)
-	    : Expression(function, unnamed_args)
+	    : Expression(function, unnamed_args), m_cache(),
+	      m_function_cache()
 	{}
 
 	/** @brief Copy constructor.
@@ -248,16 +273,59 @@ namespace rho {
 	 * @param pattern CachingExpression to be copied.
 	 */
 	CachingExpression(const CachingExpression& pattern)
-	    : Expression(pattern) {
+	    : Expression(pattern), m_cache(), m_function_cache() {
 	    // Don't copy the cache, as the new expression may be about to get
 	    // modified.
 	    // TODO: is there a way we can automatically detect modifications
 	    //   of *this and invalidate the cache?
 	}
 
-	CachingExpression(const Expression& pattern) : Expression(pattern)
+	CachingExpression(const Expression& pattern)
+	    : Expression(pattern), m_cache(), m_function_cache()
 	{}
 
+	/** @brief Maximum number of matchings cached by each call site. */
+	static constexpr unsigned s_cache_size = 4;
+
+	/** @brief Counts of argument matching cache lookups, over all
+	 * CachingExpression objects.
+	 */
+	struct CacheStatistics {
+	    std::size_t hits;  ///< Matched using a cached matching.
+	    std::size_t misses;  ///< Matched and added to the cache.
+	    std::size_t megamorphic;  ///< Missed a full cache.
+	    std::size_t uncacheable;  ///< Matching couldn't be cached.
+	};
+
+	/** @brief Argument matching cache statistics since the last
+	 * reset.
+	 */
+	static const CacheStatistics& cacheStatistics()
+	{
+	    return s_cache_statistics;
+	}
+
+	/** @brief Reset the argument matching cache statistics to zero. */
+	static void resetCacheStatistics();
+
+#ifdef ENABLE_LLVM_JIT
+	/** @brief Compiled code for this loop, when run outside a
+	 * closure.
+	 *
+	 * Used for on-stack replacement of long-running interpreted
+	 * loops (see JIT::CompiledExpression::enterLoop()).  The loop
+	 * is queued for compilation the first time this is called, and
+	 * the code is kept for later runs of the loop.  The code looks
+	 * up all variables through the interpreter.
+	 *
+	 * @param env Environment in which the loop is being run.
+	 *
+	 * @return The code, which may not be ready yet, or null if it
+	 * hasn't been queued yet or the loop can't be compiled.
+	 */
+	JIT::CompiledExpression* compiledLoop(Environment* env) const;
+#endif
+
 	// Virtual functions of RObject:
 	CachingExpression* clone() const override;
 
@@ -266,14 +334,60 @@ namespace rho {
     protected:
 	void detachReferents() override;
     private:
+	static CacheStatistics s_cache_statistics;
+
+	struct CacheEntry {
+	    GCEdge<const FunctionBase> m_function;
+	    const ArgMatchInfo* m_arg_match_info;
+	};
+
 	// Object used for recording details from previous evaluations of
 	// this expression, for the purpose of optimizing future evaluations.
 	// In the future, this will likely include type recording as well.
+	// Most call sites only ever see one closure, so the first entry is
+	// held inline and the others are allocated once needed.
         mutable struct {
-	    GCEdge<const FunctionBase> m_function;
-            const ArgMatchInfo* m_arg_match_info;
+	    CacheEntry m_first;
+	    CacheEntry* m_others;  // s_cache_size - 1 entries, or null.
+	    unsigned char m_num_others;
+	    bool m_megamorphic;
 	} m_cache;
 
+	// The function found by the last cacheable lookup of m_symbol.
+	// The lookup started from m_environment, and the entry is valid
+	// while m_version is Frame::functionBindingVersion().
+	mutable struct {
+	    GCEdge<Environment> m_environment;
+	    const Symbol* m_symbol;
+	    GCEdge<FunctionBase> m_function;
+	    std::size_t m_version;
+	} m_function_cache;
+
+#ifdef ENABLE_LLVM_JIT
+	// The code from compiledLoop().  A null code with
+	// m_loop_compilation_failed set records that the loop can't be
+	// compiled.
+	mutable GCEdge<JIT::CompiledExpression> m_compiled_loop;
+	mutable bool m_loop_compilation_failed = false;
+#endif
+
+	// Looks up the function named by symbol, starting from env, and
+	// caches the result if that is safe.
+	FunctionBase* lookupFunction(const Symbol* symbol,
+				     Environment* env) const;
+
+	// Returns the cached matching for a call of func with the given
+	// arguments, or null.
+	const ArgMatchInfo* lookupMatchInfo(const Closure* func,
+					    const ArgList* arglist) const;
+
+	// Adds a matching to the cache, or marks the call site as
+	// megamorphic if the cache is full.
+	void addMatchInfo(const Closure* func,
+			  const ArgMatchInfo* arg_match_info) const;
+
+	FunctionBase* getFunction(Environment* env) const override;
+
 	void matchArgsIntoEnvironment(const Closure* func,
 				      Environment* calling_env,
 				      ArgList* arglist,
@@ -282,7 +396,10 @@ namespace rho {
 
 	// Declared private to ensure that CachingExpression objects are
 	// allocated only using 'new':
-	~CachingExpression() {}
+	~CachingExpression()
+	{
+	    delete[] m_cache.m_others;
+	}
 
 	CachingExpression& operator=(const CachingExpression&) = delete;
     };
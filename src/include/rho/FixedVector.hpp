@@ -30,6 +30,7 @@
 #ifndef FIXEDVECTOR_HPP
 #define FIXEDVECTOR_HPP 1
 
+#include <type_traits>
 #include "rho/VectorBase.hpp"
 #include "rho/MemoryBank.hpp"
 
@@ -47,6 +48,17 @@ namespace rho {
      * rho implements all of CR's built-in vector types using this
      * template.
      *
+     * Vectors of arithmetic types can also be created in a compact
+     * form by createSequence(), which records only the first element
+     * and the difference between successive elements.  A compact
+     * vector is expanded into a separately allocated data block the
+     * first time begin() or operator[] is used, for example by
+     * INTEGER() or REAL().  Code that only reads the vector can use
+     * element() and isCompact() to avoid the expansion.
+     *
+     * Likewise createMapped() creates a vector whose data block is a
+     * region of a file mapped into memory.
+     *
      * @tparam T The type of the elements of the vector.
      *
      * @tparam ST The required ::SEXPTYPE of the vector.
@@ -97,6 +109,39 @@ namespace rho {
 	    return create(items.begin(), items.end());
 	}
 
+	/** @brief Create a compact arithmetic sequence.
+	 *
+	 * Element \a i of the vector is <tt>first + i * step</tt>,
+	 * computed in type \a T.  The elements are not stored until
+	 * the vector is expanded.
+	 *
+	 * @param first The value of the first element.
+	 *
+	 * @param step The difference between successive elements.
+	 *          If zero, every element is \a first.
+	 *
+	 * @param sz Number of elements required.
+	 */
+	static FixedVector* createSequence(T first, T step, size_type sz);
+
+	/** @brief Create a vector backed by part of a file.
+	 *
+	 * The file is mapped into memory privately, so it is never
+	 * modified: pages are copied when first written to.  The
+	 * mapping is removed when the vector is garbage collected.
+	 *
+	 * @param path Name of the file, which holds the elements in
+	 *          native binary format.
+	 *
+	 * @param offset Position in the file of the first element, in
+	 *          bytes.  Must be a multiple of <tt>sizeof(T)</tt>.
+	 *
+	 * @param sz Number of elements required.  An error is raised
+	 *          if the file is too short.
+	 */
+	static FixedVector* createMapped(const char* path,
+					 std::size_t offset, size_type sz);
+
 	/** @brief Create a vector containing a single value.
 	 *
 	 * @param value The value to store in the vector.
@@ -117,7 +162,7 @@ namespace rho {
 	 */
 	T& operator[](size_type index)
 	{
-	    return m_data[index];
+	    return begin()[index];
 	}
 
 	/** @brief Read-only element access.
@@ -129,26 +174,90 @@ namespace rho {
 	 */
 	const T& operator[](size_type index) const
 	{
+	    return begin()[index];
+	}
+
+	/** @brief Read an element without expanding the vector.
+	 *
+	 * @param index Index of required element (counting from
+	 *          zero).  No bounds checking is applied.
+	 *
+	 * @return The value of the specified element.
+	 */
+	T element(size_type index) const
+	{
+	    if (isCompact())
+		return externalData().value(index);
 	    return m_data[index];
 	}
 
+	/** @brief Is this a compact vector that hasn't been expanded?
+	 *
+	 * @return true iff the vector was created by createSequence()
+	 * and its elements have not yet been stored.
+	 */
+	bool isCompact() const
+	{
+	    return std::is_arithmetic<T>::value && !m_data;
+	}
+
+	/** @brief Is the data block part of the object?
+	 *
+	 * @return false if the vector was created by createSequence(),
+	 * even once it has been expanded, or by createMapped().  A
+	 * mapped data block may be read-only, so code that reuses an
+	 * unshared vector to hold a result should check this first.
+	 */
+	bool hasInlineData() const
+	{
+	    return !hasExternalData();
+	}
+
+	/** @brief First element of a compact vector.
+	 *
+	 * @return The value of element 0.  Only meaningful if
+	 * isCompact() is true.
+	 */
+	T sequenceStart() const
+	{
+	    return externalData().first;
+	}
+
+	/** @brief Step of a compact vector.
+	 *
+	 * @return The difference between successive elements.  Only
+	 * meaningful if isCompact() is true.
+	 */
+	T sequenceStep() const
+	{
+	    return externalData().step;
+	}
+
 	/** @brief Iterator designating first element.
+	 *
+	 * Expands the vector if it is compact.
 	 *
 	 * @return An iterator designating the first element of the
 	 * vector.  Returns end() if the vector is empty.
 	 */
 	iterator begin()
 	{
+	    if (isCompact())
+		expand();
 	    return m_data;
 	}
 
 	/** @brief Const iterator designating first element.
+	 *
+	 * Expands the vector if it is compact.
 	 *
 	 * @return A const_iterator designating the first element of
 	 * the vector.  Returns end() if the vector is empty.
 	 */
 	const_iterator begin() const
 	{
+	    if (isCompact())
+		expand();
 	    return m_data;
 	}
 
@@ -199,6 +308,16 @@ namespace rho {
 	 */
 	~FixedVector()
 	{
+	    if (hasExternalData()) {
+		ExternalData& external = externalData();
+		if (m_data) {
+		    GCNode::unregisterExternalBlock(m_data);
+		    external.release(external.block, external.block_bytes);
+		}
+		MemoryBank::adjustFreedSize(sizeof(FixedVector),
+					    externalObjectSize());
+		return;
+	    }
 	    destructElementsIfNeeded();
 
 	    // GCNode::~GCNode doesn't know about the string storage space in
@@ -212,9 +331,43 @@ namespace rho {
 	// Virtual function of GCNode:
 	void detachReferents() override;
     private:
-	T* m_data;  // pointer to the vector's data block.
+	// Description of a vector whose data block is outside the object,
+	// stored immediately after the object, in space allocated by
+	// externalObjectSize().  first and step describe
+	// a vector created by createSequence().  Once there is a data
+	// block, release(block, block_bytes) frees it.
+	struct ExternalData {
+	    T first;
+	    T step;
+	    void* block;
+	    std::size_t block_bytes;
+	    void (*release)(void*, std::size_t);
+
+	    T value(size_type index) const
+	    {
+		return value(index, std::is_arithmetic<T>());
+	    }
+
+	    T value(size_type index, std::true_type) const
+	    {
+		// Avoid turning -0 into +0 in constant vectors.
+		return step ? T(first + T(index) * step) : first;
+	    }
 
-	alignas(T) char m_first_element_storage[sizeof(T)];
+	    // Compact vectors of other types are never created.
+	    T value(size_type, std::false_type) const
+	    {
+		return first;
+	    }
+	};
+
+	// Pointer to the vector's data block.  Null if the vector is
+	// compact; points outside the object once a compact vector has
+	// been expanded, or if the data block is a mapped file.
+	mutable T* m_data;
+
+	alignas(T) alignas(void*)
+	char m_first_element_storage[sizeof(T)];
 
 	/** @brief Create a vector, leaving its contents
 	 *         uninitialized (for POD types) or default
@@ -230,6 +383,13 @@ namespace rho {
 	    constructElementsIfNeeded();
 	}
 
+	// Create a compact vector.
+	FixedVector(size_type sz, T first, T step);
+
+	// Copy a compact vector without expanding it.
+	FixedVector(const FixedVector<T, ST>& pattern,
+		    const ExternalData& description);
+
 	/** @brief Copy constructor.
 	 *
 	 * @param pattern FixedVector to be copied.
@@ -240,6 +400,34 @@ namespace rho {
 
 	static void* allocate(size_type size);
 
+	// True for compact vectors, whether or not they have been expanded,
+	// and for mapped vectors.
+	bool hasExternalData() const
+	{
+	    return std::is_arithmetic<T>::value
+		&& m_data != reinterpret_cast<const T*>(m_first_element_storage);
+	}
+
+	void* externalDataStorage() const
+	{
+	    static_assert(alignof(ExternalData) <= alignof(FixedVector),
+			  "ExternalData must be aligned like FixedVector.");
+	    return const_cast<FixedVector*>(this) + 1;
+	}
+
+	ExternalData& externalData() const
+	{
+	    return *static_cast<ExternalData*>(externalDataStorage());
+	}
+
+	static size_t externalObjectSize()
+	{
+	    return sizeof(FixedVector) + sizeof(ExternalData);
+	}
+
+	// Store the elements of a compact vector.
+	void expand() const;
+
 	static void constructElements(iterator from, iterator to);
 	static void constructElementsIfNeeded(iterator from, iterator to)
 	{
@@ -249,7 +437,8 @@ namespace rho {
 		constructElements(from, to);
 	}
 	void constructElementsIfNeeded() {
-	    constructElementsIfNeeded(begin(), end());
+	    if (ElementTraits::MustConstruct<T>::value)
+		constructElements(begin(), end());
 	}
 
 	void destructElementsIfNeeded(iterator from, iterator to)
@@ -258,7 +447,8 @@ namespace rho {
 		destructElements(from, to);
 	}
 	void destructElementsIfNeeded() {
-	    destructElementsIfNeeded(begin(), end());
+	    if (ElementTraits::MustDestruct<T>::value)
+		destructElements(begin(), end());
 	}
 	void destructElements(iterator from, iterator to);
 
@@ -303,6 +493,26 @@ rho::FixedVector<T, ST>::FixedVector(
     }
 }
 
+template <typename T, SEXPTYPE ST>
+rho::FixedVector<T, ST>::FixedVector(size_type sz, T first, T step)
+    : VectorBase(ST, sz), m_data(nullptr)
+{
+    static_assert(std::is_arithmetic<T>::value,
+		  "Only vectors of arithmetic types can be compact.");
+    new (externalDataStorage()) ExternalData{first, step, nullptr, 0,
+					     nullptr};
+}
+
+template <typename T, SEXPTYPE ST>
+rho::FixedVector<T, ST>::FixedVector(const FixedVector<T, ST>& pattern,
+				     const ExternalData& description)
+    : VectorBase(pattern), m_data(nullptr)
+{
+    new (externalDataStorage()) ExternalData{description.first,
+					     description.step, nullptr, 0,
+					     nullptr};
+}
+
 template <typename T, SEXPTYPE ST>
 void* rho::FixedVector<T, ST>::allocate(size_type sz)
 {
@@ -331,9 +541,80 @@ rho::FixedVector<T, ST>::create(size_type sz)
     return new(storage) FixedVector(sz);
 }
 
+template <typename T, SEXPTYPE ST>
+rho::FixedVector<T, ST>*
+rho::FixedVector<T, ST>::createSequence(T first, T step, size_type sz)
+{
+    void* storage = GCNode::operator new(externalObjectSize());
+    return new(storage) FixedVector(sz, first, step);
+}
+
+template <typename T, SEXPTYPE ST>
+rho::FixedVector<T, ST>*
+rho::FixedVector<T, ST>::createMapped(const char* path, std::size_t offset,
+				      size_type sz)
+{
+    if (offset % sizeof(T) != 0)
+	Rf_error(_("offset must be a multiple of the element size"));
+    if (sz == 0)
+	return create(0);
+    size_t bytes = sz * sizeof(T);
+    if (bytes / sizeof(T) != sz)
+	Rf_error(_("request to create impossibly large vector."));
+    void* block;
+    std::size_t block_bytes;
+    T* data = static_cast<T*>(mapFile(path, offset, bytes,
+				      &block, &block_bytes));
+    FixedVector* result;
+    try {
+	void* storage = GCNode::operator new(externalObjectSize());
+	result = new(storage) FixedVector(sz, T(), T());
+    } catch (...) {
+	unmapFile(block, block_bytes);
+	throw;
+    }
+    ExternalData& external = result->externalData();
+    external.block = block;
+    external.block_bytes = block_bytes;
+    external.release = unmapFile;
+    GCNode::registerExternalBlock(data, bytes, result);
+    result->m_data = data;
+    return result;
+}
+
+template <typename T, SEXPTYPE ST>
+void rho::FixedVector<T, ST>::expand() const
+{
+    ExternalData& description = externalData();
+    size_type sz = size();
+    size_t bytes = sz * sizeof(T);
+    if (bytes / sizeof(T) != sz)
+	Rf_error(_("request to create impossibly large vector."));
+    T* data;
+    try {
+	data = static_cast<T*>(MemoryBank::allocate(bytes));
+    } catch (std::bad_alloc) {
+	tooBig(bytes);
+	return;
+    }
+    for (size_type i = 0; i < sz; ++i)
+	data[i] = description.value(i);
+    description.block = data;
+    description.block_bytes = bytes;
+    description.release = MemoryBank::deallocate;
+    // Pointers into the data obtained via REAL() etc. must keep
+    // this vector alive when found on the stack.
+    GCNode::registerExternalBlock(data, bytes, this);
+    m_data = data;
+}
+
 template <typename T, SEXPTYPE ST>
 rho::FixedVector<T, ST>* rho::FixedVector<T, ST>::clone() const
 {
+    if (isCompact()) {
+	void* storage = GCNode::operator new(externalObjectSize());
+	return new(storage) FixedVector(*this, externalData());
+    }
     void* storage = allocate(size());
     return new(storage) FixedVector(*this);
 }
@@ -373,10 +654,16 @@ void rho::FixedVector<T, ST>::decreaseSizeInPlace(size_type new_size)
     if (new_size > size()) {
 	Rf_error("Increasing vector length in place not allowed.");
     }
+    if (hasExternalData()) {
+	// The external data block, if any, is released at destruction.
+	adjustSize(new_size);
+	return;
+    }
     size_t bytes = (size() - new_size) * sizeof(T);
     MemoryBank::adjustBytesAllocated(-bytes);
 
-    destructElementsIfNeeded(begin() + new_size, end());
+    if (ElementTraits::MustDestruct<T>::value)
+	destructElements(begin() + new_size, end());
     adjustSize(new_size);
 }
 
@@ -404,7 +404,9 @@ namespace rho {
 
 	Frame()
 	    : m_cache_count(0), m_locked(false), m_no_special_symbols(true),
-	      m_read_monitored(false), m_write_monitored(false)
+	      m_read_monitored(false), m_write_monitored(false),
+	      m_function_lookups_cached(false),
+	      m_variable_lookups_cached(false)
 	{}
 
 	/** @brief Copy constructor.
@@ -419,7 +421,9 @@ namespace rho {
 	Frame(const Frame& source)
 	    : m_cache_count(0), m_locked(source.m_locked),
 	      m_no_special_symbols(source.m_no_special_symbols),
-	      m_read_monitored(false), m_write_monitored(false)
+	      m_read_monitored(false), m_write_monitored(false),
+	      m_function_lookups_cached(false),
+	      m_variable_lookups_cached(false)
 	{}
 
 	/** @brief Get contents as a PairList.
@@ -587,6 +591,89 @@ namespace rho {
 	 */
 	bool erase(const Symbol* symbol);
 
+	/** @brief Version number of the bindings of functions.
+	 *
+	 * This is incremented whenever a binding that may affect the
+	 * result of findFunction() is modified or removed in a Frame
+	 * that is on the search path, or for which
+	 * noteFunctionLookup() has been called.  Bindings whose value
+	 * is neither a function nor a Promise don't count.
+	 *
+	 * CachingExpression uses this to validate its cached function
+	 * lookups.
+	 */
+	static std::size_t functionBindingVersion()
+	{
+	    return s_function_binding_version;
+	}
+
+	/** @brief Invalidate all cached function lookups.
+	 *
+	 * Called when an Environment's enclosing Environment changes,
+	 * and whenever a binding that may affect function lookup
+	 * changes in a Frame on which a cached lookup depends.
+	 */
+	static void invalidateFunctionLookups()
+	{
+	    ++s_function_binding_version;
+	}
+
+	/** @brief Note that a cached function lookup depends on this
+	 * Frame.
+	 *
+	 * From now on, changes to this Frame's bindings that may
+	 * affect the result of findFunction() will invalidate cached
+	 * function lookups.  There is no need to call this for Frames
+	 * on the search path.
+	 *
+	 * @note Whether or not lookups are noted is not considered to
+	 * be part of the state of a Frame object, and hence this
+	 * function is const.
+	 */
+	void noteFunctionLookup() const
+	{
+	    m_function_lookups_cached = true;
+	}
+
+	/** @brief Version number of the sets of bindings.
+	 *
+	 * This is incremented whenever a Binding is added to or
+	 * removed from a Frame that is on the search path, or for
+	 * which noteVariableLookup() has been called, and whenever
+	 * the Environments that enclose one another change.  Changes
+	 * to the values of existing bindings don't count.
+	 *
+	 * Compiled code uses this to validate the Bindings that it
+	 * has cached for the free variables of a closure.
+	 */
+	static std::size_t bindingSetVersion()
+	{
+	    return s_binding_set_version;
+	}
+
+	/** @brief Invalidate all cached variable lookups.
+	 */
+	static void invalidateVariableLookups()
+	{
+	    ++s_binding_set_version;
+	}
+
+	/** @brief Note that a cached variable lookup depends on this
+	 * Frame.
+	 *
+	 * From now on, adding or removing bindings in this Frame will
+	 * invalidate cached variable lookups.  There is no need to
+	 * call this for Frames on the search path.
+	 *
+	 * @note Whether or not lookups are noted is not considered to
+	 * be part of the state of a Frame object, and hence this
+	 * function is const.
+	 */
+	void noteVariableLookup() const
+	{
+	    m_variable_lookups_cached = true;
+	}
+
 	/** @brief Is the Frame locked?
 	 *
 	 * @return true iff the Frame is locked.
@@ -766,6 +853,8 @@ namespace rho {
 	friend class Environment;
 
 	static monitor s_read_monitor, s_write_monitor;
+	static std::size_t s_function_binding_version;
+	static std::size_t s_binding_set_version;
 
 	unsigned char m_cache_count;  // Number of cached Environments
 			// of which this is the Frame.  Normally
@@ -774,6 +863,8 @@ namespace rho {
 	bool m_no_special_symbols      : 1;
 	mutable bool m_read_monitored  : 1;
 	mutable bool m_write_monitored : 1;
+	mutable bool m_function_lookups_cached : 1;
+	mutable bool m_variable_lookups_cached : 1;
 
 	// Not (yet) implemented.  Declared to prevent
 	// compiler-generated versions:
@@ -787,6 +878,43 @@ namespace rho {
 	    --m_cache_count;
 	}
 
+	// Can cached function lookups depend on this Frame's bindings?
+	bool affectsFunctionLookups() const
+	{
+	    return m_cache_count > 0 || m_function_lookups_cached;
+	}
+
+	// Can cached variable lookups depend on the set of bindings in
+	// this Frame?
+	bool affectsVariableLookups() const
+	{
+	    return m_cache_count > 0 || m_variable_lookups_cached;
+	}
+
+	// Invalidate cached function and variable lookups, if they may
+	// depend on this Frame, because a binding has been removed or
+	// altogether replaced.
+	void bindingChanged()
+	{
+	    if (affectsFunctionLookups())
+		invalidateFunctionLookups();
+	    if (affectsVariableLookups())
+		invalidateVariableLookups();
+	}
+
+	// Likewise, because the value of a binding is about to change
+	// from old_value to new_value.
+	void valueChanging(const RObject* old_value, const RObject* new_value)
+	{
+	    if (affectsFunctionLookups()
+		&& (mayYieldFunction(old_value) || mayYieldFunction(new_value)
+		    || new_value == Symbol::missingArgument()))
+		invalidateFunctionLookups();
+	}
+
+	// Might findFunction() find a function in a binding to value?
+	static bool mayYieldFunction(const RObject* value);
+
 	// Flush symbol(s) from search list cache:
 	void flush(const Symbol* sym);
 
@@ -84,6 +84,7 @@ namespace rho {
 	{
 	    static_assert(sizeof(T) >= 0, "T must be a complete type");
 	    GCNode::incRefCount(m_target);
+	    GCNode::recordEdge(this, m_target);
 	}
 
 	~GCEdge() {
@@ -144,6 +145,7 @@ namespace rho {
 	{
 	    check_complete_type();
 	    GCNode::incRefCount(newtarget);
+	    GCNode::recordEdge(this, newtarget);
 	    T* oldtarget = m_target;
 	    m_target = newtarget;
 	    GCNode::decRefCount(oldtarget);
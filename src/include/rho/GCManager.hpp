@@ -164,6 +164,26 @@ namespace rho {
 	 */
 	static void setGCThreshold(size_t initial_threshold);
 
+	/** @brief Number of nodes with saturated reference counts.
+	 *
+	 * @return the number of live nodes whose reference counts
+	 * have saturated, as found by recent garbage collections.
+	 * Such nodes can only be freed by mark-sweep collection.
+	 *
+	 * @see GCNode::numSaturatedNodes()
+	 */
+	static size_t saturatedNodes();
+
+	/** @brief Number of superblocks left to be swept.
+	 *
+	 * @return the number of superblocks that a lazy sweep has
+	 * still to reclaim unreachable nodes from.  This is zero
+	 * unless lazy sweeping is enabled.
+	 *
+	 * @see GCNode::setLazySweep()
+	 */
+	static size_t sweepBacklog();
+
 	/** @brief Set/unset monitors on mark-sweep garbage collection.
 	 *
 	 * @param pre_gc If not a null pointer, this function will be
@@ -221,6 +241,9 @@ namespace rho {
 	// maybeGC() calls  gc() when the number of bytes still allocated after running
 	// gclite() reaches this level.
 	static size_t s_threshold;
+	// Set if s_threshold is to be recomputed once the lazy sweep
+	// following a mark-sweep collection is complete.
+	static bool s_threshold_update_pending;
 
 	static bool s_gc_is_running;
 	static bool s_gc_pending;
@@ -238,6 +261,9 @@ namespace rho {
 	static void (*s_pre_gc)();
 	static void (*s_post_gc)();
 
+	// Recompute s_threshold from the number of bytes allocated.
+	static void updateThreshold();
+
 	GCManager() = delete;
     };
 }  // namespace rho
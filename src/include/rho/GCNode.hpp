@@ -32,8 +32,12 @@
 #define GCNODE_HPP
 
 #include <assert.h>
+#include <cstdint>
 #include <functional>
+#include <map>
 #include <sstream>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "rho/config.hpp"
@@ -125,7 +129,8 @@ namespace rho {
 	};
 
 	GCNode()
-            : m_refcount_flags(s_mark | s_moribund_mask)
+            : m_refcount_flags(s_mark | s_moribund_mask),
+	      m_young(s_generational)
 	{
 	    ++s_num_nodes;
 	    s_moribund->push_back(this);
@@ -206,6 +211,130 @@ namespace rho {
 	 */
 	static void gc(bool markSweep);
 
+	/** @brief Initiate a minor garbage collection.
+	 *
+	 * Runs a mark-sweep collection restricted to the nodes created
+	 * since the previous collection, treating all older nodes as
+	 * live.  Nodes that survive are promoted, so that subsequent
+	 * minor collections do not examine them.  Has the same effect
+	 * as gc(false) unless generational collection is enabled.
+	 *
+	 * If too many references to young nodes from outside the small
+	 * object arena have been made since the previous collection, a
+	 * full mark-sweep collection is carried out instead.
+	 *
+	 * @return false if a full collection was carried out, otherwise
+	 *    true.
+	 */
+	static bool minorGC();
+
+	/** @brief Enable or disable generational garbage collection.
+	 *
+	 * When enabled, newly created nodes are tracked as young
+	 * until they survive a garbage collection, and writes to
+	 * GCEdge objects are recorded so that minorGC() can find
+	 * references from older nodes to young ones.  Disabling
+	 * generational collection promotes all existing nodes.
+	 */
+	static void setGenerational(bool enable);
+
+	/** @brief Is generational garbage collection enabled?
+	 */
+	static bool isGenerational()
+	{
+	    return s_generational;
+	}
+
+	/** @brief Set the number of threads used by mark-sweep
+	 * collections.
+	 *
+	 * With more than one thread, the mark phase traces the node
+	 * graph in parallel, and the sweep phase scans superblocks for
+	 * unmarked nodes in parallel.  Detaching and deleting the
+	 * unmarked nodes is always done on the calling thread.
+	 *
+	 * @param num_threads Number of threads to use, including the
+	 *    calling thread.  Zero is treated as one.
+	 */
+	static void setNumGCThreads(unsigned num_threads)
+	{
+	    s_num_gc_threads = num_threads ? num_threads : 1;
+	}
+
+	/** @brief Number of threads used by mark-sweep collections.
+	 */
+	static unsigned numGCThreads()
+	{
+	    return s_num_gc_threads;
+	}
+
+	/** @brief Enable or disable lazy sweeping.
+	 *
+	 * When enabled, the sweep phase of a mark-sweep collection
+	 * only deals with allocations outside superblocks.  The
+	 * unmarked nodes in superblocks are reclaimed afterwards, a
+	 * superblock at a time, whenever the allocator runs out of
+	 * free blocks of a given size.  Any sweeping still
+	 * outstanding is completed by the next collection.
+	 */
+	static void setLazySweep(bool enable)
+	{
+	    s_lazy_sweep = enable;
+	}
+
+	/** @brief Is lazy sweeping enabled?
+	 */
+	static bool isLazySweep()
+	{
+	    return s_lazy_sweep;
+	}
+
+	/** @brief Number of superblocks left to be swept.
+	 *
+	 * @return the number of superblocks that have not yet been
+	 * swept since the last mark-sweep collection.  This is always
+	 * zero unless lazy sweeping is enabled.
+	 */
+	static size_t sweepBacklog();
+
+	/** @brief Keep exact reference counts for heavily shared nodes.
+	 *
+	 * By default, a reference count that reaches the maximum
+	 * value that fits in a node sticks there, so the node can
+	 * then only be freed by a mark-sweep collection.  Once this
+	 * function has been called, references beyond that maximum
+	 * are instead counted in a side table keyed by node, so that
+	 * such nodes are freed as soon as they become unreferenced.
+	 *
+	 * This must be called before any GCNode objects are created,
+	 * as the true reference counts of nodes that have already
+	 * saturated are unknown.
+	 */
+	static void enableRefCountOverflow();
+
+	/** @brief Number of nodes with saturated reference counts.
+	 *
+	 * @return the number of nodes found to have saturated
+	 * reference counts by the most recent mark-sweep collection,
+	 * plus those that have survived minor collections since.
+	 * This is always zero if enableRefCountOverflow() has been
+	 * called.
+	 */
+	static size_t numSaturatedNodes()
+	{
+	    return s_num_saturated;
+	}
+
+	/** @brief Number of nodes whose reference counts are held
+	 * partly in the overflow table.
+	 *
+	 * @see enableRefCountOverflow()
+	 */
+	static size_t numOverflowedRefCounts()
+	{
+	    return s_refcount_overflow ? s_refcount_overflow->size() : 0;
+	}
+
 	/** @brief Number of GCNode objects in existence.
 	 *
 	 * @return the number of GCNode objects currently in
@@ -234,10 +363,39 @@ namespace rho {
 	virtual void visitReferents(const_visitor* v) const {}
 
 	// If candidate_pointer is a (possibly internal) pointer to a GCNode,
-	// returns the pointer to that node.
+	// or points into a block registered by registerExternalBlock(),
+	// returns the pointer to the node that owns it.
 	// Otherwise returns nullptr.
 	static GCNode* asGCNode(void* candidate_pointer);
 
+	/** @brief Associate a block of memory with the node that owns it.
+	 *
+	 * Nodes whose payload is held outside the node itself (for
+	 * example in a MemoryBank block or a mapped file) use this so
+	 * that pointers into the payload found on the C++ stack keep
+	 * the owning node alive, just as pointers into the node
+	 * itself do.
+	 *
+	 * @param start Start of the block.
+	 *
+	 * @param bytes Size of the block in bytes.  Pointers up to
+	 *          and including  start +  bytes are taken to
+	 *          refer to  owner, so that end() pointers are
+	 *          covered.
+	 *
+	 * @param owner Node owning the block.  The block must be
+	 *          unregistered before  owner is destroyed.
+	 */
+	static void registerExternalBlock(const void* start, std::size_t bytes,
+					  const GCNode* owner);
+
+	/** @brief Remove a block registered by registerExternalBlock().
+	 *
+	 * @param start Start of the block, as passed to
+	 *          registerExternalBlock().
+	 */
+	static void unregisterExternalBlock(const void* start);
+
     protected:
 	/**
 	 * @note The destructor is protected to ensure that GCNode
@@ -249,6 +407,8 @@ namespace rho {
 	{
 	    if (m_refcount_flags & s_moribund_mask)
 		destruct_aux();
+	    if (s_refcount_overflow && isRefCountFieldFull())
+		s_refcount_overflow->erase(this);
 	    --s_num_nodes;
 	}
     private:
@@ -270,6 +430,13 @@ namespace rho {
 	    void operator()(const GCNode* node) override;
 	};
 
+	/** Marker used by the parallel mark phase.
+	 *
+	 * Marks nodes atomically, and pushes newly marked nodes onto a
+	 * stack rather than visiting their referents recursively.
+	 */
+	class ParallelMarker;
+
 	/** Marker that counts the number of nodes marked.
 	 */
 	class CountingMarker : public Marker {
@@ -323,6 +490,54 @@ namespace rho {
 	  // bit is then toggled in the mark phase of a mark-sweep
 	  // garbage collection to identify reachable nodes.
 
+	mutable bool m_young;
+	  // Set if the node was created while generational collection
+	  // was enabled and has not yet survived a garbage collection.
+	  // This occupies padding that would otherwise be unused, so
+	  // doesn't increase the size of RObject.
+
+	static bool s_generational;  // Set if generational collection
+	  // is enabled.
+
+	static unsigned s_num_gc_threads;  // Number of threads used by
+	  // mark-sweep collections.
+
+	static bool s_lazy_sweep;  // Set if lazy sweeping is enabled.
+
+	// References to nodes beyond those that fit in their reference
+	// count fields, or null if enableRefCountOverflow() hasn't been
+	// called.
+	static std::unordered_map<const GCNode*, size_t>* s_refcount_overflow;
+
+	static size_t s_num_saturated;  // Number of saturated nodes found
+	  // by marking.
+
+	// Unreachable nodes with saturated reference counts found by the
+	// current lazy sweep.  These can only be deleted once the sweep
+	// is complete, as unswept nodes may still refer to them.
+	static std::vector<GCNode*>* s_lazy_sweep_to_delete;
+
+	// Blocks registered by registerExternalBlock(), keyed by start
+	// address, with their end addresses and owners.  s_external_min
+	// and s_external_max bound all registered blocks, so that most
+	// stack words can be rejected without a lookup.
+	struct ExternalBlock {
+	    std::uintptr_t end;
+	    const GCNode* owner;
+	};
+	static std::map<std::uintptr_t, ExternalBlock>* s_external_blocks;
+	static std::uintptr_t s_external_min;
+	static std::uintptr_t s_external_max;
+
+	// Writes of young nodes into GCEdges that lie outside the small
+	// object arena, as (edge address, target) pairs.
+	typedef std::pair<const void*, const GCNode*> RememberedEdge;
+	static std::vector<RememberedEdge>* s_remembered_edges;
+	static const size_t s_max_remembered_edges = 1 << 16;
+	static bool s_remembered_edges_overflowed;  // Set if more than
+	  // s_max_remembered_edges writes have been made since the last
+	  // collection, in which case a minor collection isn't possible.
+
 	static void gcliteImpl();
 
 	struct CreateAMinimallyInitializedGCNode;
@@ -332,6 +547,26 @@ namespace rho {
 
 	static void markSweepGC();
 
+	static void minorMarkSweepGC();
+
+	// Common setup for gc() and minorGC().
+	static void runCollector(void (*collector)());
+
+	// Called from GCEdge whenever an edge is made to point to
+	// target, so that references from old nodes to young ones can
+	// be found by minorGC().
+	static void recordEdge(const void* edge, const GCNode* target)
+	{
+	    if (target && target->m_young)
+		rememberEdge(edge, target);
+	}
+
+	static void rememberEdge(const void* edge, const GCNode* target);
+
+	// Clear the young flag of all nodes in the nursery, and empty
+	// the nursery.
+	static void promoteYoungNodes();
+
 	/** @brief Lightweight garbage collection.
 	 *
 	 * This function deletes nodes whose reference counts are
@@ -357,6 +592,23 @@ namespace rho {
 	    return (m_refcount_flags & s_refcount_mask) >> 1;
 	}
 
+	// Is the reference count field at its maximum value?
+	bool isRefCountFieldFull() const
+	{
+	    return (m_refcount_flags & s_refcount_mask) == s_refcount_mask;
+	}
+
+	// Has the reference count saturated, i.e. is it no longer known?
+	bool isRefCountSaturated() const
+	{
+	    return !s_refcount_overflow && isRefCountFieldFull();
+	}
+
+	// Used by incRefCount() and decRefCount() when the reference
+	// count field is full and the overflow table is in use.
+	static void incOverflowedRefCount(const GCNode* node);
+	static void decOverflowedRefCount(const GCNode* node);
+
 	// Decrement the reference count (subject to the stickiness of
 	// its MSB).  If as a result the reference count falls to
 	// zero, mark the node as moribund.
@@ -364,6 +616,11 @@ namespace rho {
 	{
 	    if (node) {
 		unsigned char& refcount_flags = node->m_refcount_flags;
+		if (s_refcount_overflow && node->isRefCountFieldFull()) {
+		    // The count doesn't fall to zero here.
+		    decOverflowedRefCount(node);
+		    return;
+		}
 		refcount_flags ^= s_decinc_refcount[refcount_flags & s_refcount_mask];
 		if ((refcount_flags &
 		     (s_refcount_mask | s_on_stack_mask| s_moribund_mask)) == 0)
@@ -405,6 +662,10 @@ namespace rho {
 	{
 	    if (node) {
 		unsigned char& refcount_flags = node->m_refcount_flags;
+		if (s_refcount_overflow && node->isRefCountFieldFull()) {
+		    incOverflowedRefCount(node);
+		    return;
+		}
 		refcount_flags ^= s_decinc_refcount[(refcount_flags & s_refcount_mask) + 1];
 	    }
 	}
@@ -423,6 +684,25 @@ namespace rho {
 	    return (m_refcount_flags & s_mark_mask) == s_mark;
 	}
 
+	// Atomically mark this node, returning false if it was already
+	// marked.  Safe to call concurrently from several threads during
+	// the mark phase.
+	bool tryMark() const;
+
+	// Mark all nodes reachable from the nodes in grey (which must
+	// already be marked) using s_num_gc_threads threads.
+	static void markInParallel(std::vector<const GCNode*>* grey);
+
+	// Sweep phase used when s_num_gc_threads > 1.
+	static void parallelSweep();
+
+	// Sweep function applied lazily by GCNodeAllocator.
+	static void lazySweepNode(void* pointer);
+
+	// Complete any lazy sweep still in progress.  Must be called
+	// before nodes are next marked.
+	static void finishLazySweep();
+
 	/** @brief Mark this node as moribund or delete if the stack bit is correct.
          */
 	void makeMoribund() const HOT_FUNCTION;
@@ -437,12 +717,21 @@ namespace rho {
 	 */
 	static void sweep();
 
+	// Detach the referents of a node found to be unreachable during
+	// a sweep.  If the node's reference count has saturated, it can't
+	// be freed by reference counting, so it is added to to_delete.
+	static void sweepNode(GCNode* node, std::vector<GCNode*>* to_delete);
+
 	template<typename T> friend class GCEdge;
 	friend class GCTestHelper;
 
     protected:
 	// Used by methods implementing SET_TYPEOF.
-	typedef unsigned InternalData;
+	struct InternalData {
+	    unsigned char refcount_flags;
+	    bool young;
+	    size_t refcount_overflow;
+	};
 	InternalData storeInternalData() const;
 	void restoreInternalData(InternalData data);
     };
@@ -29,8 +29,12 @@
 
 #include <assert.h>
 
+#include <atomic>
 #include <cstdint>
 #include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "rho/AddressSanitizer.hpp"
 
@@ -99,6 +103,77 @@ public:
   /** @brief Apply function to all current allocations. */
   static void applyToAllAllocations(std::function<void(void*)> f);
 
+  /** @brief Apply function to all current allocations using several
+   * threads.
+   *
+   * The function is called concurrently from up to num_threads threads,
+   * and is passed the index (in the range [0, num_threads)) of the thread
+   * calling it.  Work is divided between the threads a superblock at a
+   * time.  The function must not allocate or free any objects.
+   */
+  static void applyToAllAllocationsInParallel(
+      std::function<void(void*, unsigned)> f, unsigned num_threads);
+
+  /** @brief Start a lazy sweep of all current allocations.
+   *
+   * The function is applied immediately to each allocation that is not
+   * in a superblock.  Superblocks are instead queued, and the function is
+   * applied to the blocks of a queued superblock when allocate() finds the
+   * freelist for its size class empty, or when finishLazySweep() is
+   * called.  The function may free the allocation it is passed, and may
+   * also be applied to allocations made after this call.
+   *
+   * Any previous lazy sweep must have been finished.
+   */
+  static void beginLazySweep(std::function<void(void*)> f);
+
+  /** @brief Apply the lazy sweep function to all queued superblocks. */
+  static void finishLazySweep();
+
+  /** @brief Number of superblocks still queued for lazy sweeping. */
+  static std::size_t lazySweepBacklog() {
+    return s_unswept_count;
+  }
+
+  /** @brief Apply function to all allocations made since the nursery was
+   * last cleared.
+   *
+   * It is okay to free allocations during the iteration, but allocations
+   * made during the iteration may not be visited.
+   */
+  static void applyToYoungAllocations(std::function<void(void*)> f);
+
+  /** @brief Apply function to all small-object allocations overlapping a
+   * card marked by rememberEdge().
+   */
+  static void applyToDirtyCards(std::function<void(void*)> f);
+
+  /** @brief Forget the age of all current allocations.
+   *
+   * After this call every current allocation is considered old, and all
+   * cards are clean.
+   */
+  static void clearNursery();
+
+  /** @brief Enable or disable tracking of young allocations.
+   *
+   * Disabling the nursery also clears it.
+   */
+  static void enableNursery(bool enable);
+
+  /** @brief Is tracking of young allocations currently enabled? */
+  static bool nurseryEnabled() {
+    return s_nursery_enabled;
+  }
+
+  /** @brief Record a write to an edge located at the given address.
+   *
+   * @return true if the address lies in the small object arena, in which
+   * case the write has been recorded in the card table.  Otherwise the
+   * caller is responsible for remembering the write.
+   */
+  static bool rememberEdge(const void* edge);
+
   /** @brief Free a previously allocated object. */
   static void free(void* p);
 
@@ -121,10 +196,136 @@ public:
   /** @brief Print allocator state summary for debugging. */
   static void printSummary();
 
+  /** @brief Occupancy of a superblock, as reported by
+   * applyToSuperblocks().
+   */
+  struct SuperblockOccupancy {
+    std::size_t block_size;
+    unsigned num_blocks;
+    unsigned num_allocated;
+    bool in_arena;  // Set for small-object arena superblocks.
+  };
+
+  /** @brief Apply function to the occupancy of every superblock in use.
+   *
+   * Released superblocks are not visited.
+   */
+  static void applyToSuperblocks(
+      std::function<void(const SuperblockOccupancy&)> f);
+
+  /** @brief The usable size of an allocation.
+   *
+   * @param allocation A pointer returned by allocate() and not yet freed.
+   *
+   * @return the size in bytes, which may be more than was requested.
+   */
+  static std::size_t allocationSize(void* allocation);
+
+  /** @brief Back the small object arena with transparent huge pages.
+   *
+   * This reduces TLB misses on large heaps.  It may be enabled or disabled
+   * at any time, and has no effect where huge pages are not supported.
+   */
+  static void setHugePages(bool enable);
+
+  /** @brief Enable or disable returning free memory to the operating
+   * system after full garbage collections.
+   */
+  static void setReleaseFreeMemory(bool enable) {
+    s_release_free_memory = enable;
+  }
+
+  /** @brief Is free memory returned to the operating system after full
+   * garbage collections?
+   */
+  static bool releasesFreeMemory() {
+    return s_release_free_memory;
+  }
+
+  /** @brief Return the memory of empty small-object superblocks to the
+   * operating system.
+   *
+   * The superblocks are kept for reuse, so the arena does not shrink, but
+   * their pages are no longer resident.  Does nothing while a lazy sweep
+   * is in progress.  Aborts if the allocator is multithreaded.
+   *
+   * @return the number of bytes released.
+   */
+  static std::size_t releaseFreeMemory();
+
+  /** @brief Enable or disable use of the allocator from several threads.
+   *
+   * While enabled, allocate() and free() may be called concurrently from
+   * any thread to obtain and release raw blocks.  Each thread then
+   * allocates and frees small objects through its own cache of blocks for
+   * each size class.  A cache is refilled from, and flushed to, the shared
+   * freelists and superblocks in batches, so that the lock protecting the
+   * shared state is seldom taken.  Other allocations take the lock every
+   * time.
+   *
+   * Only raw blocks are supported: no thread, including the main one, may
+   * create GCNode objects while enabled, since GCNode::operator new() may
+   * trigger a garbage collection and updates unsynchronised statistics.
+   * Nothing may walk the heap while enabled either, as blocks held by other
+   * threads are tagged as allocated but aren't nodes, so garbage
+   * collection, heap profiling and releaseFreeMemory() abort.  Lazy
+   * sweeping is suspended meanwhile.  Every block obtained while enabled
+   * must be freed before the heap is next walked.
+   *
+   * Must be called while no other thread is using the allocator.  Aborts
+   * if asked to disable multithreading while any other thread that has
+   * allocated in the meantime is still running, as its cache can't then
+   * be flushed safely.
+   */
+  static void setMultiThreaded(bool enable);
+
+  /** @brief Is the allocator currently usable from several threads? */
+  static bool isMultiThreaded() {
+    return s_multithreaded;
+  }
+
 private:
   friend class AllocatorSuperblock;
   friend class AllocationTable;
 
+  class ThreadCache;
+
+  /** Set if releaseFreeMemory() is called after full collections. */
+  static bool s_release_free_memory;
+
+  /** Set if allocate() and free() may be called from several threads. */
+  static std::atomic<bool> s_multithreaded;
+
+  /**
+   * Protects the shared allocator state while s_multithreaded is set.
+   * Recursive, since freeing an object may free other objects.
+   */
+  static std::recursive_mutex* s_mutex;
+
+  /** The caches of all threads that have allocated while multithreaded. */
+  static std::vector<ThreadCache*>* s_thread_caches;
+
+  /** Single threaded implementation of allocate(). */
+  static void* allocateUnlocked(std::size_t bytes);
+
+  /** Single threaded implementation of free(). */
+  static void freeUnlocked(void* p);
+
+  /** Implementation of allocate() used while multithreaded. */
+  static void* allocateMultiThreaded(std::size_t bytes);
+
+  /** Implementation of free() used while multithreaded. */
+  static void freeMultiThreaded(void* p);
+
+  /** Returns the cache for the calling thread, creating it if needed. */
+  static ThreadCache* threadCache();
+
+  /**
+   * Aborts if the allocator is multithreaded.  Called before anything that
+   * walks the heap.
+   */
+  static void checkSingleThreaded();
+
   /** Allocation table for medium and large allocations. */
   static AllocationTable* s_alloctable;
 
@@ -166,6 +367,38 @@ private:
   /** Largest known heap address. */
   static uintptr_t s_heap_end;
 
+  /** Set if allocations are currently being tagged as young. */
+  static bool s_nursery_enabled;
+
+  /** Superblocks that contain at least one young block. */
+  static std::vector<AllocatorSuperblock*>* s_young_superblocks;
+
+  /**
+   * Young allocations that are not in a superblock.  Entries are set to
+   * nullptr when the allocation is freed.
+   */
+  static std::vector<void*>* s_young_large;
+
+  /** Index in s_young_large of each young allocation still live there. */
+  static std::unordered_map<void*, std::size_t>* s_young_large_index;
+
+  /**
+   * Superblocks queued for lazy sweeping, indexed by size class.
+   */
+  static std::vector<AllocatorSuperblock*>* s_unswept;
+
+  /** Total number of superblocks queued for lazy sweeping. */
+  static std::size_t s_unswept_count;
+
+  /** The function applied to each block of a lazily swept superblock. */
+  static std::function<void(void*)>* s_sweep_function;
+
+  /**
+   * Sweep queued superblocks of a size class until the freelist for that
+   * size class is not empty.  Returns true if a free block was found.
+   */
+  static bool lazySweepSizeClass(unsigned size_class);
+
   /**
    * Create a (in place) freelist node for an alloacation and insert in a
    * freelist by size class.
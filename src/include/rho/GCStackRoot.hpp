@@ -85,6 +85,15 @@ namespace rho {
 	 */
 	static void withAllStackNodesProtected(std::function<void()> function);
 
+	/** @brief Is the given address in the active part of the stack?
+	 *
+	 * @param p Address to test.
+	 *
+	 * @return true if \a p lies between the base of the stack and the
+	 *    caller's stack frame.
+	 */
+	static bool isOnStack(const void* p);
+
 	/** @brief Informs the memory manager that the object at this address
 	 *    must not be deleted prior to this call.
 	 */
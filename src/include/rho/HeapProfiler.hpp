@@ -0,0 +1,152 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file HeapProfiler.hpp
+ * @brief Class rho::HeapProfiler.
+ */
+
+#ifndef HEAPPROFILER_HPP
+#define HEAPPROFILER_HPP
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+namespace rho {
+    class Expression;
+
+    /** @brief Profiling of the garbage-collected heap.
+     *
+     * A snapshot describes the heap as it currently stands, broken
+     * down by node type and by allocation size, together with the
+     * occupancy of the superblocks holding each size.  Snapshots
+     * walk the whole heap, so they cost nothing until taken.
+     *
+     * In addition, allocation sites can be sampled.  While sampling
+     * is enabled, one allocation in every sampleInterval() bytes
+     * allocated is attributed to the call of the innermost
+     * FunctionContext.
+     *
+     * This class only has static members.
+     */
+    class HeapProfiler {
+    public:
+	/** @brief Live nodes of one type or size. */
+	struct Usage {
+	    std::size_t count;
+	    std::size_t bytes;
+	};
+
+	/** @brief Live nodes and superblock capacity for one
+	 * allocation size.
+	 */
+	struct SizeUsage : Usage {
+	    std::size_t superblocks;  ///< Superblocks of this block size.
+	    std::size_t capacity;  ///< Blocks in those superblocks.
+	};
+
+	/** @brief A summary of the heap. */
+	struct Snapshot {
+	    /** Usage by SEXPTYPE.  Nodes that are not RObjects are
+	     * recorded under -1.
+	     */
+	    std::map<int, Usage> by_type;
+
+	    /** Usage by allocation size in bytes. */
+	    std::map<std::size_t, SizeUsage> by_size;
+	};
+
+	/** @brief Allocations sampled at one call site. */
+	struct Site {
+	    const Expression* call;  ///< Null at top level.
+	    std::size_t samples;
+	    std::size_t bytes;  ///< Estimated bytes allocated.
+	};
+
+	HeapProfiler() = delete;
+
+	/** @brief Summarise the heap.
+	 *
+	 * Garbage not yet collected (including nodes still awaiting a
+	 * lazy sweep) is counted as live, so a garbage collection
+	 * should normally precede this.  Must not be called while
+	 * other threads are using the allocator.
+	 */
+	static Snapshot takeSnapshot();
+
+	/** @brief Start sampling allocation sites.
+	 *
+	 * @param interval Number of bytes allocated between
+	 *          samples.  Must be nonzero.
+	 */
+	static void startSampling(std::size_t interval);
+
+	/** @brief Stop sampling allocation sites.
+	 *
+	 * The samples taken so far are kept.
+	 */
+	static void stopSampling();
+
+	/** @brief Discard all samples taken so far. */
+	static void clearSamples();
+
+	/** @brief Is sampling currently enabled? */
+	static bool isSampling()
+	{
+	    return s_sampling;
+	}
+
+	/** @brief Bytes allocated between samples. */
+	static std::size_t sampleInterval()
+	{
+	    return s_sample_interval;
+	}
+
+	/** @brief The sampled allocation sites, most bytes first. */
+	static std::vector<Site> sampledSites();
+
+	/** @brief Not for general use.
+	 *
+	 * Called by GCNode::operator new() for each allocation.
+	 *
+	 * @param bytes Size of the allocation.
+	 */
+	static void notifyAllocation(std::size_t bytes)
+	{
+	    if (s_sampling) {
+		s_bytes_until_sample -= bytes;
+		if (s_bytes_until_sample <= 0)
+		    takeSample();
+	    }
+	}
+    private:
+	static bool s_sampling;
+	static std::size_t s_sample_interval;
+	static std::ptrdiff_t s_bytes_until_sample;
+
+	// Attribute a sample to the innermost call.
+	static void takeSample();
+    };
+}  // namespace rho
+
+#endif  // HEAPPROFILER_HPP
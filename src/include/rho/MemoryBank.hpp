@@ -73,6 +73,14 @@ namespace rho {
 	 */
 	static size_t bytesAllocated() {return s_bytes_allocated;}
 
+	/** @brief Number of bytes of files currently mapped into memory.
+	 *
+	 * @return the total size of the file mappings used as the data
+	 * of vectors.  These are not included in bytesAllocated(), as
+	 * they don't use memory from the heap.
+	 */
+	static size_t bytesMapped() {return s_bytes_mapped;}
+
 	/** @brief Integrity check.
 	 *
 	 * Aborts the program with an error message if the class is
@@ -136,6 +144,7 @@ namespace rho {
 	static const size_t s_new_threshold;
 	static size_t s_blocks_allocated;
 	static size_t s_bytes_allocated;
+	static size_t s_bytes_mapped;
 	static Pool* s_pools;
 	static const unsigned char s_pooltab[];
 #ifdef R_MEMORY_PROFILING
@@ -151,6 +160,7 @@ namespace rho {
 	friend class String;
 	template<typename, SEXPTYPE>
 	friend class FixedVector;
+	friend class VectorBase;
 
         /** @brief Adjust the freed block statistics.
          *
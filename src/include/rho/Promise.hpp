@@ -133,6 +133,17 @@ namespace rho {
 	 */
 	bool isMissingSymbol() const;
 
+	/** @brief Number of Promises forced so far.
+	 *
+	 * Incremented each time a Promise starts evaluating its
+	 * value generator.  Compiled code uses this to tell whether
+	 * looking up a symbol could have run R code.
+	 */
+	static unsigned int forcedCount()
+	{
+	    return s_forced_count;
+	}
+
 	/** @brief The name by which this type is known in R.
 	 *
 	 * @return The name by which this type is known in R.
@@ -177,6 +188,8 @@ namespace rho {
 	mutable bool m_under_evaluation;
 	mutable bool m_interrupted;
 
+	static unsigned int s_forced_count;
+
 	// Declared private to ensure that Promise objects are
 	// created only using 'new':
 	~Promise() {}
@@ -175,7 +175,7 @@ namespace rho {
 	static void initialize();
 
 	// Put all entries into the protecting state:
-        friend void GCNode::gc(bool);
+        friend class GCNode;
 	static void protectAll()
 	{
 	    s_stack->protectAll();
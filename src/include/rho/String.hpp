@@ -344,6 +344,7 @@ namespace rho {
 	m_target = nullptr;  // In case String::blank() causes GC.
 	m_target = String::blank();
 	GCNode::incRefCount(m_target);
+	GCNode::recordEdge(this, m_target);
     }
 }  // namespace rho
 
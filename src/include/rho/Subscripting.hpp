@@ -830,6 +830,20 @@ namespace rho {
 	    out = ElementTraits::duplicate_element(in);
 	}
 
+	// Helper functions for vectorSubset, reading elements of vectors
+	// of arithmetic types without expanding compact vectors.
+	template <class V>
+	static typename V::value_type
+	sourceElement(const V* v, std::size_t index, std::true_type) {
+	    return v->element(index);
+	}
+
+	template <class V>
+	static typename V::value_type&
+	sourceElement(V* v, std::size_t index, std::false_type) {
+	    return (*v)[index];
+	}
+
     };  // class Subscripting
 
     template <class VL, class VR>
@@ -1053,7 +1067,8 @@ namespace rho {
 		    NA<typename V::value_type>());
 	    } else {
 		(*ans)[i] = ElementTraits::duplicate_element(
-		    (*vnc)[index - 1]);
+		    sourceElement(vnc, index - 1, std::is_arithmetic<
+				  typename V::value_type>()));
 	    }
 	}
 	setVectorAttributes(ans, v, indices);
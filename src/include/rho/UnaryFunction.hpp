@@ -118,18 +118,72 @@ namespace rho {
 	using VectorOpReturnType =
 	    typename VectorTypeFor<OpReturnType<Op, InputType...>>::type;
 
+	namespace internal {
+	    template<typename OutputType>
+	    OutputType* reusable(const OutputType* operand, size_t size,
+				 std::true_type)
+	    {
+		if (operand->size() == size
+		    && NAMED(const_cast<OutputType*>(operand)) == 0
+		    && operand->hasInlineData())
+		    return const_cast<OutputType*>(operand);
+		return nullptr;
+	    }
+
+	    template<typename OutputType, typename VectorType>
+	    OutputType* reusable(const VectorType*, size_t, std::false_type)
+	    {
+		return nullptr;
+	    }
+	}
+
+	/** @brief Operand that can hold the result of a unary function.
+	 *
+	 * A function applied to an unshared temporary, as in
+	 * <tt>sqrt(x + 1)</tt>, can overwrite its operand instead of
+	 * allocating a new vector, if the operand is of the right type
+	 * and nothing else refers to it (i.e. it has NAMED zero).
+	 * Operands with attributes aren't reused, so that the
+	 * attribute copier doesn't need to allow for the result being
+	 * the operand.
+	 *
+	 * @tparam OutputType Class of vector returned by the function.
+	 *
+	 * @param input Non-null pointer to the operand.
+	 *
+	 * @return \a input, if it may be overwritten with the result,
+	 * otherwise a null pointer.
+	 */
+	template<typename OutputType, typename InputType>
+	OutputType* reusableOperand(const InputType* input)
+	{
+	    if (input->hasAttributes())
+		return nullptr;
+	    return internal::reusable<OutputType>(
+		input, input->size(), std::is_same<OutputType, InputType>());
+	}
+
+	/** @brief Apply a unary function to a vector.
+	 *
+	 * @param result If not null, the vector in which to store the
+	 *          result, for example one obtained from
+	 *          reusableOperand().  Otherwise a new vector is
+	 *          created.
+	 */
 	template<typename Op, typename AttributeCopier,
 		 typename InputType,
 		 typename OutputType = VectorOpReturnType<Op, InputType>>
 	OutputType* applyUnaryOperator(Op op,
 				       AttributeCopier attribute_copier,
-				       const InputType* input)
+				       const InputType* input,
+				       OutputType* result = nullptr)
 	{
 	    size_t size = input->size();
 	    if (size == 1 && !input->hasAttributes()) {
 		return OutputType::createScalar(op((*input)[0]));
 	    }
-	    OutputType* result = OutputType::create(input->size());
+	    if (!result)
+		result = OutputType::create(input->size());
 	    std::transform(input->begin(), input->end(), result->begin(),
 			   op);
 	    attribute_copier.copyAttributes(result, input);
@@ -298,6 +298,39 @@ namespace rho {
 	 * @param bytes Size of data block for which allocation failed.
 	 */
 	static void tooBig(std::size_t bytes);
+
+	/** @brief Map part of a file into memory.
+	 *
+	 * The mapping is private, so pages are copied when first
+	 * written to and changes are never written to the file.  An error is raised if the file can't be
+	 * mapped or has fewer than <tt>offset + bytes</tt> bytes.
+	 *
+	 * @param path Name of the file.
+	 *
+	 * @param offset Position in the file of the first byte required.
+	 *
+	 * @param bytes Number of bytes required.  Must be non-zero.
+	 *
+	 * @param block Set to the start of the mapping, which must be
+	 *          passed to unmapFile() when the memory is no longer
+	 *          required.
+	 *
+	 * @param block_bytes Set to the size of the mapping.
+	 *
+	 * @return Pointer to the memory holding byte \a offset of the
+	 * file.
+	 */
+	static void* mapFile(const char* path, std::size_t offset,
+			     std::size_t bytes,
+			     void** block, std::size_t* block_bytes);
+
+	/** @brief Remove a mapping created by mapFile().
+	 *
+	 * @param block The start of the mapping.
+	 *
+	 * @param block_bytes The size of the mapping.
+	 */
+	static void unmapFile(void* block, std::size_t block_bytes);
     private:
 	size_type m_size;
     };
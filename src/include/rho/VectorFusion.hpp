@@ -0,0 +1,115 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file VectorFusion.hpp
+ *
+ * @brief Class rho::VectorFusion.
+ */
+
+#ifndef RHO_VECTORFUSION_HPP
+#define RHO_VECTORFUSION_HPP
+
+#include <cstddef>
+
+namespace rho {
+    class ArgList;
+    class BuiltInFunction;
+    class Environment;
+    class Expression;
+    class FunctionBase;
+    class RObject;
+
+    /** @brief Evaluation of chains of elementwise operations in one pass.
+     *
+     * Evaluating an expression such as <tt>sqrt(a * b + c) > d</tt>
+     * one call at a time allocates a full-length vector for each
+     * intermediate result, and streams each of them through memory
+     * twice.  When the operands are plain numeric or logical vectors
+     * this class instead evaluates the whole chain a block of
+     * elements at a time, so that the intermediate results only ever
+     * occupy a cache-sized buffer, and the only full-length vector
+     * allocated is the result.
+     *
+     * The operations that can be fused are the binary arithmetic
+     * operators +, -, * and / (where the result is real), the
+     * comparison operators, and the functions of one argument in the
+     * Math group that do_math1() implements, such as sqrt() and exp().
+     * The call must name the primitive itself, so that a user
+     * redefinition of, say, <tt>+</tt> is respected.
+     *
+     * The operands are evaluated in the same order as the interpreter
+     * would evaluate them.  Any operation that can't be fused,
+     * because an operand has attributes or isn't numeric, because it
+     * would need integer arithmetic, or because the lengths of its
+     * operands differ, is applied in the usual way, so the results are
+     * always those the interpreter would give.  The only observable
+     * difference is that "NaNs produced" warnings are issued once the
+     * whole chain has been evaluated.
+     */
+    class VectorFusion {
+    public:
+	/** @brief Evaluate a call, fusing it with its arguments.
+	 *
+	 * @param call The call to be evaluated.
+	 *
+	 * @param function The BuiltInFunction that \a call invokes.
+	 *
+	 * @param env The Environment in which \a call is to be
+	 *          evaluated.
+	 *
+	 * @return The value of \a call, or a null pointer if \a call
+	 * is not an operation that can be fused with at least one of
+	 * its arguments.  If null is returned, nothing has been
+	 * evaluated.
+	 */
+	static RObject* evaluate(const Expression* call,
+				 const BuiltInFunction* function,
+				 Environment* env);
+
+	/** @brief Length below which results are not fused.
+	 *
+	 * For shorter vectors there is nothing to be gained from
+	 * fusion, so the operations are applied in the usual way.
+	 */
+	static const std::size_t s_min_length = 64;
+
+	/** @brief Number of elements computed at a time.
+	 */
+	static const std::size_t s_block_size = 512;
+    private:
+	class Evaluation;
+	struct Node;
+
+	VectorFusion() = delete;
+
+	// Access to protected members of Expression.
+	static FunctionBase* functionOf(const Expression* call,
+					Environment* env);
+	static RObject* evaluateBuiltInCall(const Expression* call,
+					    const BuiltInFunction* function,
+					    Environment* env,
+					    ArgList* arglist);
+    };
+}  // namespace rho
+
+#endif  // RHO_VECTORFUSION_HPP
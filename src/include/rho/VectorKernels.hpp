@@ -0,0 +1,134 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file VectorKernels.hpp
+ *
+ * @brief Explicitly vectorized loops for elementwise arithmetic and
+ * comparisons.
+ */
+
+#ifndef RHO_VECTORKERNELS_HPP
+#define RHO_VECTORKERNELS_HPP
+
+#include <cstddef>
+
+namespace rho {
+    /** @brief SIMD implementations of common elementwise operations.
+     *
+     * Each kernel computes <tt>out[i] = lhs[i * lhs_stride] op
+     * rhs[i * rhs_stride]</tt> for \a i in <tt>[0, n)</tt>, where
+     * each stride is either 0 (a scalar operand) or 1.  Results
+     * follow R's semantics exactly, including the treatment of NA
+     * and NaN, so the kernels can be substituted for the scalar
+     * functors in arithmetic.cpp and relop.cpp.
+     *
+     * The instruction set is chosen when the kernels are first
+     * used, from those supported by the processor.  Where no
+     * vector instructions are available the kernels fall back to
+     * plain loops.
+     */
+    namespace VectorKernels {
+	/** @brief Arithmetic operations with a vectorized kernel.
+	 */
+	enum class Arithmetic { PLUS, MINUS, TIMES, DIVIDE };
+
+	/** @brief Comparison operations with a vectorized kernel.
+	 */
+	enum class Comparison {
+	    EQUAL, NOT_EQUAL, LESS, GREATER, LESS_EQUAL, GREATER_EQUAL
+	};
+
+	/** @brief Is a vector long enough to be worth using a kernel?
+	 *
+	 * Below this size the cost of dispatching to a kernel
+	 * outweighs the gain.
+	 *
+	 * @param size Length of the result of an operation.
+	 */
+	inline bool worthwhile(std::size_t size)
+	{
+	    return size >= 16;
+	}
+
+	/** @brief Elementwise arithmetic on doubles.
+	 */
+	void realArithmetic(Arithmetic op,
+			    const double* lhs, std::size_t lhs_stride,
+			    const double* rhs, std::size_t rhs_stride,
+			    double* out, std::size_t n);
+
+	/** @brief Elementwise arithmetic on R integers.
+	 *
+	 * NA operands give NA, as do results that are outside the
+	 * range of an R integer.
+	 *
+	 * @param op Must not be Arithmetic::DIVIDE, which yields a
+	 *          real result.
+	 *
+	 * @return true iff any of the results overflowed.
+	 */
+	bool intArithmetic(Arithmetic op,
+			   const int* lhs, std::size_t lhs_stride,
+			   const int* rhs, std::size_t rhs_stride,
+			   int* out, std::size_t n);
+
+	/** @brief Elementwise comparison of doubles.
+	 *
+	 * The results are R logicals; if either operand is NA or NaN
+	 * the result is NA.
+	 */
+	void realComparison(Comparison op,
+			    const double* lhs, std::size_t lhs_stride,
+			    const double* rhs, std::size_t rhs_stride,
+			    int* out, std::size_t n);
+
+	/** @brief Elementwise comparison of R integers.
+	 *
+	 * The results are R logicals; if either operand is NA the
+	 * result is NA.
+	 */
+	void intComparison(Comparison op,
+			   const int* lhs, std::size_t lhs_stride,
+			   const int* rhs, std::size_t rhs_stride,
+			   int* out, std::size_t n);
+
+	/** @brief Name of the instruction set in use.
+	 *
+	 * @return One of "generic", "avx2" or "avx512f".
+	 */
+	const char* instructionSet();
+
+	/** @brief Select the instruction set to use.
+	 *
+	 * Intended for testing.
+	 *
+	 * @param name One of the names returned by instructionSet().
+	 *
+	 * @return false, leaving the selection unchanged, if \a name
+	 * is not known or the processor does not support it.
+	 */
+	bool setInstructionSet(const char* name);
+    }  // namespace VectorKernels
+}  // namespace rho
+
+#endif  // RHO_VECTORKERNELS_HPP
@@ -0,0 +1,94 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+
+#ifndef RHO_JIT_CLOSURE_STATISTICS_HPP
+#define RHO_JIT_CLOSURE_STATISTICS_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace rho {
+class Closure;
+
+namespace JIT {
+
+/*
+ * Counters that show what the JIT has done for a closure, and how well the
+ * compiled code is working out.  A closure gets one of these the first time
+ * its body is compiled.  The compiled code holds on to it too, as it
+ * increments guard_failures directly.
+ *
+ * All the fields are only accessed from the interpreter thread.
+ */
+class ClosureStatistics {
+public:
+    explicit ClosureStatistics(const Closure* closure);
+    ~ClosureStatistics();
+
+    // The closure, or null once it has been destroyed.
+    const Closure* closure() const {
+	return m_closure;
+    }
+
+    // Called by the closure's destructor.
+    void closureDestroyed() {
+	m_closure = nullptr;
+    }
+
+    // Compilations that produced code, how many of those were optimized,
+    // and how many failed in code generation.
+    unsigned int compilations;
+    unsigned int optimized_compilations;
+    unsigned int failed_compilations;
+
+    // Time spent generating IR and machine code, including for failed
+    // compilations.  Machine code is generated in batches, whose time is
+    // shared equally between the closures in the batch.
+    double compile_seconds;
+
+    // Calls that ran the compiled code.
+    std::uint64_t compiled_calls;
+
+    // Calls that had to be interpreted, although compiled code existed,
+    // because the frame had been set up before the code was installed.
+    std::uint64_t frame_layout_mismatches;
+
+    // Calls to a builtin inlined by the compiled code that went through
+    // the interpreter, because the function wasn't the predicted one.
+    std::uint32_t guard_failures;
+
+    // The statistics of all the closures that still exist.
+    static std::vector<const ClosureStatistics*> all();
+
+private:
+    const Closure* m_closure;
+
+    ClosureStatistics(const ClosureStatistics&) = delete;
+    ClosureStatistics& operator=(const ClosureStatistics&) = delete;
+};
+
+} // namespace JIT
+} // namespace rho
+
+#endif // RHO_JIT_CLOSURE_STATISTICS_HPP
@@ -0,0 +1,102 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#ifndef RHO_JIT_CODE_CACHE_HPP
+#define RHO_JIT_CODE_CACHE_HPP
+
+#include "rho/jit/llvm.hpp"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include <memory>
+#include <string>
+
+namespace rho {
+namespace JIT {
+
+struct OptimizationOptions;
+
+/*
+ * A cache of generated object code on disk, so that later processes can
+ * skip code generation for code that has been compiled before.  It is
+ * enabled by setting the environment variable R_JIT_CACHE_DIR to an
+ * existing, writable directory.
+ *
+ * Modules are identified by a hash of their IR, which includes the
+ * closure's body and formals as compiled, and of the compilation options.
+ * Generated code refers to R objects only through names that
+ * MCJITMemoryManager::getSymbolAddress() resolves in the current process,
+ * so the same object code can be loaded by any process that generates the
+ * same IR.
+ */
+class CodeCache : public llvm::ObjectCache {
+public:
+    // Returns the cache, or null if caching is not enabled.
+    static CodeCache* get();
+
+    // Caches code in the given directory from now on, or disables caching
+    // if it is empty, overriding R_JIT_CACHE_DIR.  Must not be called
+    // while anything is being compiled.
+    static void setDirectory(const std::string& directory);
+
+    // Number of modules loaded from, and written to, the cache.
+    std::size_t hits() const { return m_hits; }
+    std::size_t stores() const { return m_stores; }
+
+    // Returns a name for the module, derived from its IR and the options it
+    // is to be compiled with.  The module's identifier must be set to this
+    // for it to be cached.
+    static std::string moduleKey(const llvm::Module* module,
+				 const OptimizationOptions& options,
+				 unsigned optimization_level);
+
+#if (LLVM_VERSION < 306)
+    void notifyObjectCompiled(const llvm::Module* module,
+			      const llvm::MemoryBuffer* object) override;
+    llvm::MemoryBuffer* getObject(const llvm::Module* module) override;
+#else
+    void notifyObjectCompiled(const llvm::Module* module,
+			      llvm::MemoryBufferRef object) override;
+    std::unique_ptr<llvm::MemoryBuffer>
+    getObject(const llvm::Module* module) override;
+#endif
+
+private:
+    explicit CodeCache(const std::string& directory);
+
+    std::string m_directory;
+    std::size_t m_hits;
+    std::size_t m_stores;
+
+    static CodeCache*& instance();
+
+    std::string getFilename(const llvm::Module* module) const;
+    void writeObject(const llvm::Module* module,
+		     const char* data, std::size_t size);
+
+    CodeCache(const CodeCache&) = delete;
+    CodeCache& operator=(const CodeCache&) = delete;
+};
+
+} // namespace JIT
+} // namespace rho
+
+#endif // RHO_JIT_CODE_CACHE_HPP
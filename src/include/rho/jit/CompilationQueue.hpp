@@ -0,0 +1,174 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#ifndef RHO_JIT_COMPILATION_QUEUE_HPP
+#define RHO_JIT_COMPILATION_QUEUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class ExecutionEngine;
+class Module;
+}
+
+namespace rho {
+
+class RObject;
+class Environment;
+
+namespace JIT {
+
+class CodeBatch;
+class MCJITMemoryManager;
+
+/*
+ * Machine code generation for a module whose IR is complete.
+ *
+ * Code generation may happen on the background compilation thread, so a job
+ * must not refer to any garbage-collected objects other than through the
+ * addresses already recorded in its memory manager.
+ *
+ * Jobs are compiled in batches that share a single ExecutionEngine.  The
+ * generated code is freed by the background thread once every job in the
+ * batch has been destroyed.
+ */
+class CompilationJob {
+public:
+    typedef RObject* (*FunctionPointer)(Environment* env);
+
+    CompilationJob(std::unique_ptr<llvm::Module> module,
+		   std::unique_ptr<MCJITMemoryManager> memory_manager,
+		   const std::string& function_name,
+		   unsigned optimization_level);
+    ~CompilationJob();
+
+    // Generates the machine code for the jobs, which must all have the same
+    // optimization level, in a single ExecutionEngine.  The caller must hold
+    // the LLVM lock.
+    static void runBatch(
+	const std::vector<std::shared_ptr<CompilationJob>>& jobs);
+
+    // The LLVM optimization level, from 0 to 3.
+    unsigned optimizationLevel() const {
+	return m_optimization_level;
+    }
+
+    const std::string& functionName() const {
+	return m_function_name;
+    }
+
+    // True once run() has completed, on any thread.
+    bool isFinished() const {
+	return m_finished.load(std::memory_order_acquire);
+    }
+
+    // The compiled function, or null if code generation failed.  Only valid
+    // once isFinished() is true.
+    FunctionPointer function() const {
+	return m_function;
+    }
+
+    // Seconds spent generating machine code for this job, which is an
+    // equal share of its batch's time.  Only valid once isFinished() is
+    // true.
+    double seconds() const {
+	return m_seconds;
+    }
+
+private:
+    std::unique_ptr<llvm::Module> m_module;
+    std::unique_ptr<MCJITMemoryManager> m_memory_manager;
+    std::shared_ptr<CodeBatch> m_code;
+    std::string m_function_name;
+    unsigned m_optimization_level;
+    FunctionPointer m_function;
+    double m_seconds;
+    std::atomic<bool> m_finished;
+
+    CompilationJob(const CompilationJob&) = delete;
+    CompilationJob& operator=(const CompilationJob&) = delete;
+};
+
+/*
+ * The memory held by generated code.
+ */
+struct JITMemoryStatistics {
+    std::size_t engines;  // ExecutionEngines that hold code.
+    std::size_t functions;  // Compiled functions in those engines.
+    std::size_t code_bytes;
+    std::size_t data_bytes;
+};
+
+/*
+ * A queue of compilation jobs, serviced by a single background thread.
+ * Jobs that are waiting at the same time are compiled as a batch.
+ *
+ * All use of LLVM (which shares a single LLVMContext) must hold the lock
+ * returned by llvmMutex().  The interpreter thread holds it while it
+ * generates IR, and the background thread while it generates code.
+ */
+class CompilationQueue {
+public:
+    static std::recursive_mutex& llvmMutex();
+
+    // Adds a job to the queue, starting the background thread if needed.
+    static void enqueue(std::shared_ptr<CompilationJob> job);
+
+    // Number of jobs waiting or in progress.
+    static std::size_t pendingJobs();
+
+    // Blocks until all queued jobs have finished and the code of destroyed
+    // jobs has been freed.
+    static void waitUntilIdle();
+
+    // The largest number of jobs compiled in one batch.
+    static const std::size_t max_batch_size = 16;
+
+    // The memory held by all the code generated so far that hasn't been
+    // freed.
+    static JITMemoryStatistics memoryStatistics();
+
+    CompilationQueue() = delete;
+private:
+    // Hands the LLVM objects of a destroyed job to the background thread to
+    // free.  Never blocks on the LLVM lock.
+    static void retire(std::unique_ptr<llvm::Module> module,
+		       std::unique_ptr<MCJITMemoryManager> memory_manager,
+		       std::shared_ptr<CodeBatch> code);
+
+    // The caller must hold the queue's lock.
+    static void startWorker();
+
+    static void serviceQueue();
+
+    friend class CompilationJob;
+};
+
+} // namespace JIT
+} // namespace rho
+
+#endif // RHO_JIT_COMPILATION_QUEUE_HPP
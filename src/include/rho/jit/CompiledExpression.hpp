@@ -24,63 +24,167 @@
 #ifndef RHO_JIT_COMPILED_EXPRESSION_HPP
 #define RHO_JIT_COMPILED_EXPRESSION_HPP
 
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <vector>
 
 #include "rho/GCEdge.hpp"
 #include "rho/GCNode.hpp"
 #include "rho/GCStackRoot.hpp"
 #include "rho/jit/FrameDescriptor.hpp"
-
-namespace llvm {
-
-class ExecutionEngine;
-}
+#include "rho/jit/SymbolLookupCache.hpp"
 
 namespace rho {
 
 class Closure;
 class CompilerContext;
 class Environment;
+class Expression;
 class Frame;
 class RObject;
 
 namespace JIT {
 
+class ClosureStatistics;
+class CompilationJob;
 class FrameDescriptor;
 
 class CompiledExpression : public GCNode {
 public:
     ~CompiledExpression();
 
+    // Only valid once isReady() is true.
     RObject* evalInEnvironment(Environment* env) const
     {
 	GCStackRoot<const GCNode> protect(this);
 	return m_function(env);
     }
 
+    // Runs the code for a for loop from enterLoop(), starting at iteration
+    // start of sequence, which the interpreter has already evaluated.  Only
+    // valid once isReady() is true.
+    RObject* resumeForLoop(Environment* env, RObject* sequence,
+			   int start) const;
+
+    // Called by the compiled code of a for loop to collect the sequence and
+    // the first iteration passed to resumeForLoop().
+    static RObject* takeResumedForLoop(int* start);
+
     Frame* createFrame() const;
 
     bool hasMatchingFrameLayout(const Environment* env) const;
 
+    // Returns the emptied local environment of an earlier call, or null.
+    Environment* takeSpareEnvironment() const;
+
+    // Called when a call of the closure returns normally.  If the body
+    // can't have captured env, empties it and keeps it for the next call.
+    // Returns false if env should be disposed of as usual.
+    bool recycleEnvironment(Environment* env) const;
+
+    // If the body can't tell a promise from its value, returns the formal
+    // arguments it is certain to evaluate (see EscapeAnalysis).  Otherwise
+    // returns null.
+    const std::vector<bool>* strictArguments() const {
+	return m_environment_reusable ? &m_strict_arguments : nullptr;
+    }
+
+    // True once the machine code has been generated successfully.
+    bool isReady() const;
+
+    // True if machine code generation has finished but failed.
+    bool hasFailed() const;
+
+    // True if the machine code was generated with optimization.
+    bool isOptimized() const {
+	return m_optimized;
+    }
+
+    // The number of loop back edges taken by the compiled code.
+    std::uint32_t backEdgeCount() const {
+	return m_back_edge_count;
+    }
+
+    // Compile the function body to unoptimized code.  The code is ready by
+    // the time this returns.
     static CompiledExpression* compileFunctionBody(const Closure* function);
 
+    // Generate IR for the function body, and queue it for code generation
+    // on the background compilation thread.  Returns null (and does
+    // nothing) if LLVM is currently busy.
+    static CompiledExpression* compileFunctionBodyInBackground(
+	const Closure* function, bool optimize);
+
+    // Returns the code for a loop that the interpreter is part way through,
+    // so that the remaining iterations can run as compiled code (on-stack
+    // replacement), or null if the code isn't ready.  The loop is queued
+    // for compilation the first time it gets here.  If env is the working
+    // environment of the innermost closure, the closure keeps the code,
+    // and a plain frame is replaced by a CompiledFrame.  Otherwise the
+    // loop's call site keeps the code, which looks up all variables
+    // through the interpreter.  Loops that can't be compiled are
+    // remembered, and always return null.
+    static CompiledExpression* enterLoop(const Expression* loop,
+					 Environment* env);
+
+    // Generate IR for a loop, as used by enterLoop(), and queue it for code
+    // generation.  If closure is non-null, env is a working environment of
+    // the closure, and the code uses a CompiledFrame laid out for it.
+    // Returns null (and does nothing) if LLVM is currently busy.  Throws if
+    // the loop can't be compiled.
+    static CompiledExpression* compileLoopInBackground(const Expression* loop,
+						       const Closure* closure,
+						       Environment* env);
+
     void detachReferents() override;
     void visitReferents(const_visitor* v) const override;
 
 private:
-    CompiledExpression(const Closure* closure);
-
-    // The compiled function itself.
+    // Generates the IR for body.  If descriptor is null, the frame layout
+    // is worked out from the closure.  If loop is set, body is a loop that
+    // the interpreter is part way through.  The caller must hold the LLVM
+    // lock.
+    CompiledExpression(const Closure* closure, const RObject* body,
+		       FrameDescriptor* descriptor, bool optimize,
+		       bool loop = false);
+
+    // Adds the compilation to the closure's statistics, once the job has
+    // finished.
+    void recordOutcome() const;
+
+    // The compiled function itself, set once the job has finished.
     typedef RObject* (*CompiledExpressionPointer)(Environment* env);
-    CompiledExpressionPointer m_function;
+    mutable CompiledExpressionPointer m_function;
 
     // The interpreter requires the frame descriptor to work with the frames
     // that the compiled code generates.
     GCEdge<FrameDescriptor> m_frame_descriptor;
 
-    // TODO(kmillar): we ought to have a single engine that is shared by many
-    //   functions.
-    std::unique_ptr<llvm::ExecutionEngine> m_engine;
+    // Machine code generation.  The generated code is shared with the
+    // other jobs of its batch, and freed once they have all been destroyed.
+    std::shared_ptr<CompilationJob> m_job;
+
+    // The statistics of the closure being compiled, or null if the code
+    // doesn't belong to a closure.  Updated by recordOutcome().
+    std::shared_ptr<ClosureStatistics> m_statistics;
+    double m_ir_seconds;
+    mutable bool m_outcome_recorded;
+
+    bool m_optimized;
+
+    // Incremented by the compiled code on each loop back edge.
+    std::uint32_t m_back_edge_count;
+
+    // The caches used by the compiled code's lookups of variables outside
+    // the local frame.
+    std::deque<SymbolLookupCache> m_lookup_caches;
+
+    // Set if the body can't capture its environment, so that calls can
+    // reuse it and pass strict arguments by value.
+    bool m_environment_reusable;
+    std::vector<bool> m_strict_arguments;
+    mutable GCEdge<Environment> m_spare_environment;
 
     CompiledExpression(const CompiledExpression&) = delete;
     CompiledExpression& operator=(const CompiledExpression&) = delete;
@@ -77,6 +77,9 @@ private:
     llvm::Value* emitEvalInternal(const RObject* object);
     llvm::Value* emitSymbolEval(const Symbol* symbol);
     llvm::Value* emitExpressionEval(const Expression* object);
+    llvm::Value* emitCall(const Expression* expression,
+			  llvm::Value* resolved_function,
+			  FunctionBase* likely_function);
     llvm::Value* emitDotsEval(const DottedArgs* object);
 
     // Code to generate inlined functions.
@@ -90,11 +93,37 @@ private:
     llvm::Value* emitInlinedBegin(const Expression* expression);
     llvm::Value* emitInlinedReturn(const Expression* expression);
     llvm::Value* emitInlinedIf(const Expression* expression);
+    llvm::Value* emitInlinedFor(const Expression* expression);
     llvm::Value* emitInlinedWhile(const Expression* expression);
     llvm::Value* emitInlinedRepeat(const Expression* expression);
     llvm::Value* emitInlinedBreak(const Expression* expression);
     llvm::Value* emitInlinedNext(const Expression* expression);
 
+    // Unboxed scalar arithmetic and comparisons.
+    // A value which may be held unboxed.  If 'boxed' is null, the value
+    // exists only in 'value', a double holding a scalar of type 'kind'.
+    // Otherwise 'boxed' is the value and if 'kind' isn't NOT_SCALAR,
+    // 'value' is its unboxed equivalent.
+    struct ScalarValue {
+	llvm::Value* kind;  // i32 Runtime::ScalarKind
+	llvm::Value* value;
+	llvm::Value* boxed;
+    };
+    static bool isScalarOperator(const BuiltInFunction* builtin);
+    static bool isScalarOperatorCall(const Expression* expression);
+    ScalarValue emitUnboxedEval(const RObject* object);
+    ScalarValue emitScalarOperatorCall(const Expression* expression,
+				       llvm::Value* resolved_function,
+				       const BuiltInFunction* op);
+    ScalarValue emitScalarOperator(const Expression* expression,
+				   const BuiltInFunction* op);
+    ScalarValue emitUnbox(llvm::Value* boxed);
+    llvm::Value* emitBox(const ScalarValue& value);
+    ScalarValue mergeScalarValues(
+	llvm::ArrayRef<std::pair<ScalarValue, llvm::BasicBlock*>> values);
+    llvm::Value* emitCondition(const RObject* condition,
+			       const Expression* call);
+
     typedef llvm::Value* (Compiler::*EmitBuiltinFn)(const Expression*);
     static const std::vector<std::pair<FunctionBase*, EmitBuiltinFn>>&
 	getInlineableBuiltins();
@@ -120,6 +149,12 @@ private:
     llvm::Constant* emitConstantPointer(const void* value, llvm::Type* type);
 
     void emitSetVisibility(bool visible);
+    void emitCheckFunctionFound(const Expression* expression,
+				llvm::Value* resolved_function);
+    llvm::Value* emitIsExpectedBuiltin(llvm::Value* resolved_function,
+				       const BuiltInFunction* builtin);
+    llvm::AllocaInst* createEntryBlockAlloca(llvm::Type* type,
+					     const char* name);
 
     void emitErrorUnless(llvm::Value* condition,
 			 const char* error_msg,
@@ -130,6 +165,7 @@ private:
 				   llvm::PHINode* merge_point,
 				   llvm::BasicBlock* insert_before = nullptr);
     llvm::Value* createBackEdge(llvm::BasicBlock* destination);
+    void emitIncrementCounter(std::uint32_t* counter, const char* name);
 };
 
 template <class T>
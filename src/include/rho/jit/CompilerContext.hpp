@@ -24,11 +24,14 @@
 #ifndef RHO_JIT_COMPILER_CONTEXT_HPP
 #define RHO_JIT_COMPILER_CONTEXT_HPP
 
+#include <cstdint>
+#include <deque>
 #include <stack>
 #include <typeinfo>
 
 #include "rho/Frame.hpp"
 #include "rho/GCRoot.hpp"
+#include "rho/jit/OptimizationOptions.hpp"
 
 namespace llvm {
     class BasicBlock;
@@ -43,6 +46,7 @@ namespace rho {
 
     class Closure;
     class Environment;
+    class Expression;
     class Symbol;
 
 namespace JIT {
@@ -50,7 +54,7 @@ namespace JIT {
 class Compiler;
 class FrameDescriptor;
 class MCJITMemoryManager;
-struct OptimizationOptions;
+class SymbolLookupCache;
 
 class CompilerContext {
 public:
@@ -91,8 +95,17 @@ public:
     // Otherwise returns nullptr.
     FunctionBase* staticallyResolveFunction(const Symbol* symbol);
 
-    // Optimization options.
-    const OptimizationOptions& getOptimizationOptions();
+    // If the symbol currently refers to the primitive of that name in base,
+    // returns the primitive.  Otherwise returns nullptr.  Unlike
+    // staticallyResolveFunction(), this makes no assumption that the
+    // binding won't change later.
+    FunctionBase* resolvePrimitive(const Symbol* symbol);
+
+    // Optimization options, as set by R's options() when the context was
+    // created.
+    const OptimizationOptions& getOptimizationOptions() {
+	return m_optimization_options;
+    }
 
     // Returns true if all control flow operations can be statically resolved,
     // so that they can be inlined without requiring guards.
@@ -117,11 +130,30 @@ public:
     // compiler.
     GCRoot<FrameDescriptor> m_frame_descriptor;
 
+    // If non-null, the compiled code increments this on each loop back edge.
+    std::uint32_t* m_back_edge_counter;
+
+    // If non-null, the compiled code increments this whenever an inlined
+    // builtin's guard fails.
+    std::uint32_t* m_guard_failure_counter;
+
+    // If non-null, lookups of variables outside the local frame each get a
+    // cache here, which must outlive the compiled code.
+    std::deque<SymbolLookupCache>* m_lookup_caches;
+
+    // If non-null, a loop that the interpreter hands over part way through
+    // (on-stack replacement).  If it is a for loop, the compiled loop takes
+    // its sequence and first iteration from the interpreter (see
+    // CompiledExpression::resumeForLoop()) rather than evaluating the
+    // sequence itself.
+    const Expression* m_resumed_loop;
+
 private:
     const Closure* m_closure;
     llvm::Value* m_environment;
     llvm::Function* m_function;
     MCJITMemoryManager* m_memory_manager;
+    OptimizationOptions m_optimization_options;
 
     std::stack<llvm::BasicBlock*> m_break_destinations;
     std::stack<llvm::BasicBlock*> m_next_destinations;
@@ -0,0 +1,84 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#ifndef RHO_JIT_ESCAPE_ANALYSIS_HPP
+#define RHO_JIT_ESCAPE_ANALYSIS_HPP
+
+#include <vector>
+
+namespace rho {
+class Closure;
+class RObject;
+class Symbol;
+
+namespace JIT {
+
+class CompilerContext;
+
+/*
+ * Works out what a closure's body can do with its local environment and
+ * its arguments, so that calls to the closure can avoid allocating.
+ *
+ * The analysis is conservative.  The environment is considered captured
+ * unless every function called by the body or by the default arguments is
+ * a primitive in base that can neither create closures nor inspect the
+ * call stack.  The primitives can still dispatch to R methods at run time,
+ * so the interpreter has to check that no other closure ran during a call
+ * before reusing its environment.
+ */
+class EscapeAnalysis {
+public:
+    EscapeAnalysis(const Closure* closure, CompilerContext* context);
+
+    // True if the local environment might still be reachable once the
+    // closure returns, or if the body can tell whether its arguments were
+    // passed as promises.
+    bool environmentMayEscape() const {
+	return m_may_escape;
+    }
+
+    // Element i is true if the i'th formal argument is certain to be
+    // evaluated before the body has any side effects, or calls anything
+    // that might.  Arguments at and after '...' are never strict.
+    const std::vector<bool>& strictArguments() const {
+	return m_strict_arguments;
+    }
+
+private:
+    CompilerContext* m_context;
+    const Closure* m_closure;
+    bool m_may_escape;
+    std::vector<bool> m_strict_arguments;
+
+    bool mayCapture(const RObject* expression);
+
+    // Returns false once evaluation reaches something that might have a
+    // side effect.
+    bool markStrictArguments(const RObject* expression);
+    bool markStrictArgument(const Symbol* symbol);
+};
+
+} // namespace JIT
+} // namespace rho
+
+#endif // RHO_JIT_ESCAPE_ANALYSIS_HPP
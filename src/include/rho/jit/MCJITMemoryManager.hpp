@@ -25,6 +25,7 @@
 #define RHO_JIT_MCJIT_MEMORY_MANAGER_HPP
 
 #include "rho/jit/llvm.hpp"
+#include <atomic>
 #include <string>
 #include <unordered_map>
 
@@ -40,13 +41,38 @@ namespace JIT {
  * - All Symbol objects.
  * - All builtin function objects.
  * - Any objects that have been added with 'addGlobal()'.
+ *
+ * It also keeps count of the memory allocated for generated code and data,
+ * across all memory managers.
  */
 class MCJITMemoryManager : public llvm::SectionMemoryManager {
 public:
     explicit MCJITMemoryManager(llvm::Module* module);
+    ~MCJITMemoryManager();
 
     uint64_t getSymbolAddress(const std::string& name) override;
 
+    uint8_t* allocateCodeSection(uintptr_t size, unsigned alignment,
+				 unsigned section_id,
+				 llvm::StringRef section_name) override;
+    uint8_t* allocateDataSection(uintptr_t size, unsigned alignment,
+				 unsigned section_id,
+				 llvm::StringRef section_name,
+				 bool is_read_only) override;
+
+    // Makes the objects known to 'other' known to this memory manager too,
+    // so that several modules can be loaded through it.
+    void addMappings(const MCJITMemoryManager& other);
+
+    // Bytes of generated code and data currently allocated by all memory
+    // managers.
+    static std::size_t totalCodeBytes() {
+	return s_code_bytes.load(std::memory_order_relaxed);
+    }
+    static std::size_t totalDataBytes() {
+	return s_data_bytes.load(std::memory_order_relaxed);
+    }
+
     template<class T>
     llvm::GlobalVariable* addGlobal(T* object,
 				    bool isConstant,
@@ -59,13 +85,33 @@ public:
 
     llvm::GlobalVariable* getSymbol(const Symbol* symbol);
     llvm::GlobalVariable* getBuiltIn(const BuiltInFunction* function);
+
+    // A global whose address is 'address'.  Compiled code refers to objects
+    // through these rather than embedding their addresses, so that the code
+    // doesn't depend on where things are in the current process.
+    llvm::GlobalVariable* getConstant(const void* address);
+
+    // Adds 'tag' to the names of the globals that are specific to this
+    // module (i.e. all but symbols and builtins), so that modules can
+    // share an ExecutionEngine.  The names are otherwise numbered in the
+    // order they were created, so that compiling the same code always gives
+    // the same names.
+    void qualifyNames(const std::string& tag);
 private:
     llvm::Module* m_module;
     std::unordered_map<std::string,
 		       std::pair<void*, llvm::GlobalVariable*>> m_mappings;
+    std::unordered_map<const void*, llvm::GlobalVariable*> m_constants;
+    int m_global_count;
+    std::size_t m_code_bytes;
+    std::size_t m_data_bytes;
+
+    static std::atomic<std::size_t> s_code_bytes;
+    static std::atomic<std::size_t> s_data_bytes;
 
     llvm::GlobalVariable* addGlobal(llvm::Type* type, void* address,
 				    bool is_constant, std::string name);
+    std::string addCounter(const std::string& prefix);
 
     MCJITMemoryManager(const MCJITMemoryManager&) = delete;
     MCJITMemoryManager& operator=(const MCJITMemoryManager&) = delete;
@@ -25,19 +25,18 @@
 #define RHO_JIT_OPTIMIZATION_HPP
 
 #include "rho/jit/llvm.hpp"
+#include "rho/jit/OptimizationOptions.hpp"
 
 namespace rho {
 namespace JIT {
 
-// Performs some basic passes over a function.
-//
-// TODO(ArunChauhan): Currently, it only performs one pass that removes
-// redundant calls to the function "rho_runtime_setVisibility", from each basic
-// block.
-//
+// Performs the R-specific passes enabled in the optimization options over a
+// function.
 class BasicFunctionPass : public llvm::FunctionPass {
  public:
-  BasicFunctionPass() : llvm::FunctionPass(pass_id) {}
+  explicit BasicFunctionPass(
+      const OptimizationOptions& options = OptimizationOptions())
+      : llvm::FunctionPass(pass_id), options_(options) {}
 
   BasicFunctionPass(BasicFunctionPass& other) = delete;
   BasicFunctionPass& operator=(const BasicFunctionPass& other) = delete;
@@ -45,14 +44,19 @@ class BasicFunctionPass : public llvm::FunctionPass {
   BasicFunctionPass& operator=(BasicFunctionPass&& other) = default;
   ~BasicFunctionPass() = default;
 
-  // Runs RemoveRedundantCallsToSetVisibility.
-  // TODO(arunchauhan): Add more intra-procedural optimizations.
+  // Runs RemoveRedundantCallsToSetVisibility, CacheSymbolLookups and
+  // RemoveRedundantInterruptChecks, as enabled.
   bool runOnFunction(llvm::Function& function) override;
 
  private:
+  OptimizationOptions options_;
   static char pass_id;  // LLVM uses the address of this variable as the ID.
 };
 
+// Runs LLVM's standard optimization pipeline for the given level (0 to 3)
+// over the module.  Level 0 does nothing.
+void runStandardPasses(llvm::Module* module, unsigned level);
+
 class RemoveRedundantCallsToSetVisibility : public llvm::BasicBlockPass {
  public:
   RemoveRedundantCallsToSetVisibility() : llvm::BasicBlockPass(pass_id) {}
@@ -75,6 +79,52 @@ class RemoveRedundantCallsToSetVisibility : public llvm::BasicBlockPass {
   static char pass_id;  // LLVM uses the address of this variable as the ID.
 };
 
+// Replaces calls to rho_runtime_lookupSymbol and
+// rho_runtime_lookupSymbolWithCache in the function's own environment with
+// calls to rho_runtime_lookupSymbolCached, which share a
+// cache of the values found.  The cache is reset after any call that might
+// change a binding without running R code; the runtime notices when R code
+// runs.  This both removes redundant lookups from straight-line code and
+// avoids repeating loop-invariant lookups on every iteration of a loop.
+class CacheSymbolLookups : public llvm::FunctionPass {
+ public:
+  CacheSymbolLookups() : llvm::FunctionPass(pass_id) {}
+
+  CacheSymbolLookups(CacheSymbolLookups& other) = delete;
+  CacheSymbolLookups& operator=(const CacheSymbolLookups& other) = delete;
+  CacheSymbolLookups(CacheSymbolLookups&& other) = default;
+  CacheSymbolLookups& operator=(CacheSymbolLookups&& other) = default;
+  ~CacheSymbolLookups() = default;
+
+  bool runOnFunction(llvm::Function& function) override;
+
+ private:
+  static char pass_id;  // LLVM uses the address of this variable as the ID.
+};
+
+// Removes calls to rho_runtime_maybeCheckForUserInterrupts that are
+// dominated by another check in the same loops, so that every cycle in the
+// control flow graph still polls at least once.
+class RemoveRedundantInterruptChecks : public llvm::FunctionPass {
+ public:
+  RemoveRedundantInterruptChecks() : llvm::FunctionPass(pass_id) {}
+
+  RemoveRedundantInterruptChecks(
+      RemoveRedundantInterruptChecks& other) = delete;
+  RemoveRedundantInterruptChecks& operator=(
+      const RemoveRedundantInterruptChecks& other) = delete;
+  RemoveRedundantInterruptChecks(
+      RemoveRedundantInterruptChecks&& other) = default;
+  RemoveRedundantInterruptChecks& operator=(
+      RemoveRedundantInterruptChecks&& other) = default;
+  ~RemoveRedundantInterruptChecks() = default;
+
+  bool runOnFunction(llvm::Function& function) override;
+
+ private:
+  static char pass_id;  // LLVM uses the address of this variable as the ID.
+};
+
 }  // namespace JIT
 }  // namespace rho
 
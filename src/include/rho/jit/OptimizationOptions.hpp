@@ -30,7 +30,11 @@ namespace JIT {
 struct OptimizationOptions {
     OptimizationOptions()
 	: AssumeSaneControlFlowOperators(true),
-	  AssumeSaneAssignmentOperators(true) { }
+	  AssumeSaneAssignmentOperators(true),
+	  OptimizationLevel(2),
+	  RemoveRedundantVisibilityCalls(false),
+	  CacheSymbolLookups(false),
+	  RemoveRedundantInterruptChecks(false) { }
     
     /*
      * These options affect the semantics of R.
@@ -50,9 +54,27 @@ struct OptimizationOptions {
      * aggressively.
      */
 
-    // TODO(kmillar): add optimization options here.
+    // The LLVM optimization level (0 to 3) used for functions that have
+    // proven to be hot.  Baseline code is always compiled at level 0.
+    // Set from the R option 'rho.jit.optimize'.
+    unsigned OptimizationLevel;
 
-    // TODO(kmillar): add LLVM optimization options.
+    // The R-specific passes to run over each function.  The R option
+    // 'rho.jit.passes' names the ones to enable: "visibility", "lookups"
+    // and "interrupts".  If it isn't set, they are all enabled at
+    // OptimizationLevel 3 and none are otherwise.
+
+    // Only the last call to rho_runtime_setVisibility in a basic block has
+    // any effect.
+    bool RemoveRedundantVisibilityCalls;
+
+    // Reuse the results of rho_runtime_lookupSymbol calls, both within
+    // straight-line code and across loop iterations, until something that
+    // could change a binding happens.
+    bool CacheSymbolLookups;
+
+    // Skip polling for interrupts on paths that have just polled.
+    bool RemoveRedundantInterruptChecks;
 };
 
 }  // namespace JIT
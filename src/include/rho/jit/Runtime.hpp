@@ -38,6 +38,7 @@ class Value;
 
 namespace rho {
 
+class BuiltInFunction;
 class Environment;
 class RObject;
 class Symbol;
@@ -60,6 +61,7 @@ enum FunctionId {
     LOOKUP_SYMBOL,
     LOOKUP_SYMBOL_IN_COMPILED_FRAME,
     ASSIGN_SYMBOL_IN_COMPILED_FRAME,
+    ASSIGN_SYMBOL,
     LOOKUP_FUNCTION,
     CALL_FUNCTION,
     DO_BREAK,
@@ -71,9 +73,19 @@ enum FunctionId {
     // Runtime.cpp.
 };
 
+// The kinds of scalar that compiled code can hold unboxed.  The values
+// match those returned by rho_runtime_unboxScalar().
+enum ScalarKind {
+    NOT_SCALAR = 0,
+    LOGICAL_SCALAR,
+    INTEGER_SCALAR,
+    REAL_SCALAR,
+};
+
 std::string getName(FunctionId function);
 
 llvm::Function* getDeclaration(FunctionId id, llvm::Module* module);
+llvm::Function* getDeclaration(const std::string& name, llvm::Module* module);
 llvm::Function* getDeclaration(const std::string& name, Compiler* compiler);
 
 
@@ -111,6 +123,11 @@ llvm::Value* emitAssignSymbolInCompiledFrame(llvm::Value* symbol,
 					     llvm::Value* value,
 					     Compiler* compiler);
 
+// Assigns to the symbol in the environment's frame, whatever kind of frame
+// it is.
+llvm::Value* emitAssignSymbol(llvm::Value* symbol, llvm::Value* environment,
+			      llvm::Value* value, Compiler* compiler);
+
 llvm::Value* emitLookupFunction(llvm::Value* symbol, llvm::Value* environment,
 				Compiler* compiler);
 
@@ -147,9 +164,40 @@ void emitRethrow(Compiler* compiler);
 
 llvm::Value* emitLoopExceptionIsNext(llvm::Value* loop_exception,
 				     Compiler* compiler);
+// For loops.
+// Evaluates the loop sequence.  Returns null if the sequence is the range of
+// integers starting at *range_start, otherwise the sequence to iterate over.
+// range_start and length must point to i32s; *length is set in both cases.
+llvm::Value* emitForLoopSequence(const Expression* call,
+				 llvm::Value* environment,
+				 llvm::Value* range_start, llvm::Value* length,
+				 Compiler* compiler);
+// As emitForLoopSequence(), but for a loop that the interpreter has handed
+// over part way through.  start must point to an i32, which is set to the
+// index of the next iteration.
+llvm::Value* emitResumeForLoop(llvm::Value* range_start, llvm::Value* length,
+			       llvm::Value* start, Compiler* compiler);
+llvm::Value* emitForLoopElement(llvm::Value* sequence, llvm::Value* index,
+				Compiler* compiler);
+llvm::Value* emitForLoopIndex(llvm::Value* value, Compiler* compiler);
+
 llvm::Value* emitGetReturnExceptionValue(llvm::Value* return_exception,
 					 Compiler* compiler);
 
+// Unboxed scalars.
+// Returns the ScalarKind of value, storing the value in *result (a double*)
+// if it isn't NOT_SCALAR.
+llvm::Value* emitUnboxScalar(llvm::Value* value, llvm::Value* result,
+			     Compiler* compiler);
+// Returns boxed if it is non-null, otherwise a new scalar of the given kind.
+llvm::Value* emitBoxScalar(llvm::Value* boxed, llvm::Value* kind,
+			   llvm::Value* value, Compiler* compiler);
+llvm::Value* emitApplyBinaryOperator(const Expression* call,
+				     const BuiltInFunction* op,
+				     llvm::Value* lhs, llvm::Value* rhs,
+				     llvm::Value* environment,
+				     Compiler* compiler);
+
 // Utility functions.
 llvm::Value* emitIsAFunction(llvm::Value* robject, Compiler* compiler);
 
@@ -0,0 +1,77 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+
+#ifndef RHO_JIT_SYMBOL_LOOKUP_CACHE_HPP
+#define RHO_JIT_SYMBOL_LOOKUP_CACHE_HPP
+
+#include <cstddef>
+
+#include "rho/Frame.hpp"
+#include "rho/GCEdge.hpp"
+
+namespace rho {
+class Environment;
+class Symbol;
+
+namespace JIT {
+
+/*
+ * Inline cache for a lookup of a free variable in compiled code.
+ *
+ * Each lookup site that isn't resolved to the local frame gets one of these.
+ * It remembers the Binding that the lookup found, together with the
+ * environment the search started from and Frame::bindingSetVersion() at the
+ * time.  The Binding stays valid until a binding is added to or removed from
+ * one of the frames that were searched, or the environments are
+ * rearranged, all of which change the version.  Assigning a new value to
+ * the binding doesn't, so the cached Binding always gives the current value.
+ */
+class SymbolLookupCache {
+public:
+    SymbolLookupCache() : m_binding(nullptr), m_version(0) { }
+
+    // Returns the binding of symbol that a lookup in env would find, or null
+    // if there is none.
+    Frame::Binding* find(const Symbol* symbol, Environment* env);
+
+    // Empties the cache.
+    void clear() {
+	m_environment = nullptr;
+	m_binding = nullptr;
+    }
+
+    GCEdge<Environment> m_environment;
+
+private:
+    Frame::Binding* m_binding;
+    std::size_t m_version;
+
+    SymbolLookupCache(const SymbolLookupCache&) = delete;
+    SymbolLookupCache& operator=(const SymbolLookupCache&) = delete;
+};
+
+} // namespace JIT
+} // namespace rho
+
+#endif // RHO_JIT_SYMBOL_LOOKUP_CACHE_HPP
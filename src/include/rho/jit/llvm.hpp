@@ -26,6 +26,7 @@
 #include "llvm/ExecutionEngine/MCJIT.h"
 
 #include "llvm/Pass.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
 
 #include "llvm/Transforms/Utils/Cloning.h"
 
@@ -56,6 +57,22 @@
 #include "llvm/Analysis/Verifier.h"
 #endif
 
+#if (LLVM_VERSION >= 305)
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/LegacyPassManager.h"
+#else
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/PassManager.h"
+#include "llvm/Support/CFG.h"
+namespace llvm {
+namespace legacy {
+using llvm::FunctionPassManager;
+using llvm::PassManager;
+}
+}
+#endif
+
 #if (LLVM_VERSION < 306)
 namespace llvm {
 inline
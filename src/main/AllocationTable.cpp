@@ -177,14 +177,21 @@ void rho::AllocationTable::resize(unsigned new_alloctable_bits) {
 
 void rho::AllocationTable::applyToAllAllocations(
     std::function<void(void*)> fun) const {
+  applyToAllSuperblocks([&](AllocatorSuperblock* superblock) {
+      superblock->applyToBlocks(fun);
+    }, fun);
+}
+
+void rho::AllocationTable::applyToAllSuperblocks(
+    std::function<void(AllocatorSuperblock*)> superblock_fun,
+    std::function<void(void*)> allocation_fun) const {
   for (int i = 0; i < m_num_buckets; ++i) {
     Allocation& bucket = m_buckets[i];
     if (!bucket.isEmpty() && !bucket.isDeleted()) {
       if (bucket.isFirst()) {
         if (bucket.isSuperblock()) {
           // This is a large superblock.
-          AllocatorSuperblock* superblock = bucket.asSuperblock();
-          superblock->applyToBlocks(fun);
+          superblock_fun(bucket.asSuperblock());
         } else {
 #ifdef ALLOCATION_CHECK
           // Extra consistency check.
@@ -192,7 +199,7 @@ void rho::AllocationTable::applyToAllAllocations(
             allocerr("apply to all blocks iterating over non-alloc'd pointer");
           }
 #endif
-          fun(bucket.asPointer());
+          allocation_fun(bucket.asPointer());
         }
       }
     }
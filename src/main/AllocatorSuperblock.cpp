@@ -24,49 +24,163 @@
  *  https://www.R-project.org/Licenses/
  */
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
+#include <algorithm>
+#include <bitset>
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <limits>
 #include <memory>
+#include <vector>
 
 #include "rho/AddressSanitizer.hpp"
 #include "rho/AllocationTable.hpp"
 #include "rho/AllocatorSuperblock.hpp"
 
+#if defined(HAVE_MMAP) && !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#if defined(HAVE_MMAP) && !defined(MAP_NORESERVE)
+#define MAP_NORESERVE 0
+#endif
+
 namespace {
   // Arena for small-object superblocks:
-  uintptr_t arena_superblock_start = 0;
-  uintptr_t arena_superblock_end = 0;
+  uintptr_t arena_superblock_end = 0;  // End of the committed part.
   uintptr_t arena_superblock_next = 0;
+
+  // Set if the arena is to be backed by transparent huge pages.
+  bool arena_huge_pages = false;
+
+  // Released superblocks, available for reuse.
+  std::vector<rho::AllocatorSuperblock*> released_superblocks;
+
+#ifdef HAVE_MMAP
+  // Ask for transparent huge pages (or not) in part of the arena.
+  void adviseHugePages(uintptr_t start, size_t size, bool enable) {
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+    madvise(reinterpret_cast<void*>(start), size,
+            enable ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#endif
+  }
+#endif
 }
 
+uintptr_t rho::AllocatorSuperblock::s_arena_start = 0;
+size_t rho::AllocatorSuperblock::s_arena_size = 0;
+unsigned char* rho::AllocatorSuperblock::s_cards = nullptr;
+
 void rho::AllocatorSuperblock::allocateArena() {
+#ifdef HAVE_MMAP
+  // Reserve address space for the largest arena we may need, halving the
+  // request if the address space is limited.  Only the part in use is made
+  // accessible, by growArena().
+  void* arena = MAP_FAILED;
+  for (s_arena_size = s_max_arena_size; ; s_arena_size /= 2) {
+    arena = mmap(nullptr, s_arena_size + s_huge_page_size, PROT_NONE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (arena != MAP_FAILED || s_arena_size <= s_arena_growth) {
+      break;
+    }
+  }
+  if (arena == MAP_FAILED) {
+    allocerr("failed to reserve small-object arena");
+  }
+  // Align to a huge page, which also aligns the superblocks.
+  s_arena_start = (reinterpret_cast<uintptr_t>(arena) + s_huge_page_size - 1)
+      & ~uintptr_t{s_huge_page_size - 1};
+  arena_superblock_end = s_arena_start;
+  arena_superblock_next = s_arena_start;
+  if (!growArena()) {
+    allocerr("failed to allocate small-object arena");
+  }
+#else
   void* arena = nullptr;
-  size_t space = s_arenasize; // Total acquired arena space.
-  if (posix_memalign(&arena, s_small_superblock_size, space) != 0) {
+  s_arena_size = s_arena_growth;
+  if (posix_memalign(&arena, s_small_superblock_size, s_arena_size) != 0) {
     allocerr("failed to allocate small-object arena");
   }
-  size_t num_superblock = space / s_small_superblock_size;
-  arena_superblock_start = reinterpret_cast<uintptr_t>(arena);
-  arena_superblock_end = arena_superblock_start
+  size_t num_superblock = s_arena_size / s_small_superblock_size;
+  s_arena_start = reinterpret_cast<uintptr_t>(arena);
+  arena_superblock_end = s_arena_start
       + num_superblock * s_small_superblock_size;
-  arena_superblock_next = arena_superblock_start;
+  arena_superblock_next = s_arena_start;
 
   // Poison the whole small object arena.
-  ASAN_POISON_MEMORY_REGION(reinterpret_cast<void*>(arena), space);
+  ASAN_POISON_MEMORY_REGION(reinterpret_cast<void*>(arena), s_arena_size);
+#endif
+
+  // The card table covers the whole reservation, but is only written to
+  // when the generational collector is enabled, so its pages are not
+  // touched otherwise.
+  s_cards = static_cast<unsigned char*>(
+      calloc(s_arena_size >> s_card_size_log2, 1));
+  if (!s_cards) {
+    allocerr("failed to allocate card table");
+  }
+}
+
+bool rho::AllocatorSuperblock::growArena() {
+#ifdef HAVE_MMAP
+  uintptr_t arena_limit = s_arena_start + s_arena_size;
+  if (arena_superblock_end >= arena_limit) {
+    return false;
+  }
+  size_t size = std::min(s_arena_growth,
+                         static_cast<size_t>(arena_limit
+                                             - arena_superblock_end));
+  void* memory = reinterpret_cast<void*>(arena_superblock_end);
+  if (mprotect(memory, size, PROT_READ | PROT_WRITE) != 0) {
+    return false;
+  }
+  if (arena_huge_pages) {
+    adviseHugePages(arena_superblock_end, size, true);
+  }
+  // Poison the new part of the small object arena.
+  ASAN_POISON_MEMORY_REGION(memory, size);
+  arena_superblock_end += size;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void rho::AllocatorSuperblock::setHugePages(bool enable) {
+  arena_huge_pages = enable;
+#ifdef HAVE_MMAP
+  if (arena_superblock_end > s_arena_start) {
+    adviseHugePages(s_arena_start, arena_superblock_end - s_arena_start,
+                    enable);
+  }
+#endif
 }
 
 rho::AllocatorSuperblock* rho::AllocatorSuperblock::newSuperblockFromArena(
     unsigned block_size) {
-  if (arena_superblock_next >= arena_superblock_end) {
-    return nullptr;
+  void* pointer;
+  if (!released_superblocks.empty()) {
+    pointer = released_superblocks.back();
+    released_superblocks.pop_back();
+  } else {
+    if (arena_superblock_next >= arena_superblock_end && !growArena()) {
+      return nullptr;
+    }
+    pointer = reinterpret_cast<void*>(arena_superblock_next);
+    arena_superblock_next += s_small_superblock_size;
   }
-  void* pointer = reinterpret_cast<void*>(arena_superblock_next);
   // The whole arena is poisoned on allocation, now we just unpoison this
   // superblock header.
   ASAN_UNPOISON_MEMORY_REGION(pointer, s_superblock_header_size);
@@ -76,7 +190,6 @@ rho::AllocatorSuperblock* rho::AllocatorSuperblock::newSuperblockFromArena(
   AllocatorSuperblock* superblock =
       new (pointer)AllocatorSuperblock(
           sizeClassFromBlockSize(block_size), bitset_entries);
-  arena_superblock_next += s_small_superblock_size;
   return superblock;
 }
 
@@ -99,7 +212,7 @@ rho::AllocatorSuperblock* rho::AllocatorSuperblock::newLargeSuperblock(
 
 rho::AllocatorSuperblock* rho::AllocatorSuperblock::arenaSuperblockFromPointer(
     uintptr_t candidate) {
-  if (candidate >= arena_superblock_start && candidate < arena_superblock_next) {
+  if (candidate >= s_arena_start && candidate < arena_superblock_next) {
     if ((candidate & (s_small_superblock_size - 1)) < s_superblock_header_size) {
       // The pointer points inside the superblock header.
       return nullptr;
@@ -182,6 +295,43 @@ void rho::AllocatorSuperblock::freeBlock(void* pointer) {
   GCNodeAllocator::addToFreelist(free_node, m_size_class);
 }
 
+bool rho::AllocatorSuperblock::isEmpty() const {
+  if (m_released || m_in_nursery
+      || GCNodeAllocator::s_superblocks[m_size_class] == this) {
+    return false;
+  }
+  unsigned bitset_entries = (numBlocks() + 63) / 64;
+  for (int i = 0; i < bitset_entries; ++i) {
+    if (m_free[i] != ~0ull) {
+      return false;
+    }
+  }
+  return true;
+}
+
+unsigned rho::AllocatorSuperblock::numAllocatedBlocks() const {
+  // Bits past the last block are always set, so counting the free bits of
+  // whole entries is exact.
+  unsigned bitset_entries = (numBlocks() + 63) / 64;
+  unsigned num_free = 0;
+  for (int i = 0; i < bitset_entries; ++i) {
+    num_free += std::bitset<64>(m_free[i]).count();
+  }
+  return bitset_entries * 64 - num_free;
+}
+
+void rho::AllocatorSuperblock::release() {
+  m_released = true;
+#ifdef HAVE_MMAP
+  // The page holding the header is kept.
+  static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  uintptr_t start = (firstBlockPointer() + page_size - 1) & ~(page_size - 1);
+  madvise(reinterpret_cast<void*>(start), endPointer() - start,
+          MADV_DONTNEED);
+#endif
+  released_superblocks.push_back(this);
+}
+
 void* rho::AllocatorSuperblock::allocateLarge(unsigned size_log2) {
   assert(size_log2 >= 6 && size_log2 < GCNodeAllocator::s_num_medium_pools
       && "Can not allocate objects smaller than "
@@ -203,20 +353,48 @@ void* rho::AllocatorSuperblock::allocateLarge(unsigned size_log2) {
 void rho::AllocatorSuperblock::tagBlockAllocated(unsigned block) {
   unsigned bitset = block / 64;
   m_free[bitset] &= ~(uint64_t{1} << (block & 63));
+  if (GCNodeAllocator::s_nursery_enabled) {
+    // Every block allocated while the nursery is enabled is young until
+    // the next garbage collection.
+    tagBlockYoung(block);
+  }
 }
 
 void rho::AllocatorSuperblock::tagBlockUnallocated(unsigned block) {
   unsigned bitset = block / 64;
   m_free[bitset] |= uint64_t{1} << (block & 63);
+  m_young[bitset] &= ~(uint64_t{1} << (block & 63));
+}
+
+void rho::AllocatorSuperblock::tagBlockYoung(unsigned block) {
+  unsigned bitset = block / 64;
+  m_young[bitset] |= uint64_t{1} << (block & 63);
+  if (!m_in_nursery) {
+    m_in_nursery = true;
+    GCNodeAllocator::s_young_superblocks->push_back(this);
+  }
+}
+
+void rho::AllocatorSuperblock::clearYoungBlocks() {
+  unsigned bitset_entries = (numBlocks() + 63) / 64;
+  for (int i = 0; i < bitset_entries; ++i) {
+    m_young[i] = 0;
+  }
+  m_in_nursery = false;
 }
 
 void rho::AllocatorSuperblock::applyToArenaAllocations(
     std::function<void(void*)> fun) {
-  uintptr_t next_superblock = arena_superblock_start;
+  applyToArenaSuperblocks([&](AllocatorSuperblock* superblock) {
+      superblock->applyToBlocks(fun);
+    });
+}
+
+void rho::AllocatorSuperblock::applyToArenaSuperblocks(
+    std::function<void(AllocatorSuperblock*)> fun) {
+  uintptr_t next_superblock = s_arena_start;
   while (next_superblock < arena_superblock_next) {
-    AllocatorSuperblock* superblock =
-      reinterpret_cast<AllocatorSuperblock*>(next_superblock);
-    superblock->applyToBlocks(fun);
+    fun(reinterpret_cast<AllocatorSuperblock*>(next_superblock));
     next_superblock += s_small_superblock_size;
   }
 }
@@ -248,8 +426,57 @@ void rho::AllocatorSuperblock::applyToBlocks(std::function<void(void*)> fun)
   }
 }
 
+void rho::AllocatorSuperblock::applyToYoungBlocks(
+    std::function<void(void*)> fun) const {
+  unsigned bitset_entries = (numBlocks() + 63) / 64;
+  for (int i = 0; i < bitset_entries; ++i) {
+    // The bitset is re-read for each block because applying the function
+    // may free other young blocks in this superblock.
+    for (int index = 0; index < 64 && (m_young[i] >> index); ++index) {
+      if (m_young[i] & (uint64_t{1} << index)) {
+        fun(blockPointer(i * 64 + index));
+      }
+    }
+  }
+}
+
+void rho::AllocatorSuperblock::applyToDirtyCards(
+    std::function<void(void*)> fun) {
+  size_t num_cards = (arena_superblock_next - s_arena_start)
+      >> s_card_size_log2;
+  for (size_t card = 0; card < num_cards; ++card) {
+    if (!s_cards[card]) {
+      continue;
+    }
+    uintptr_t card_start = s_arena_start + (card << s_card_size_log2);
+    uintptr_t card_end = card_start + (uintptr_t{1} << s_card_size_log2);
+    AllocatorSuperblock* superblock = reinterpret_cast<AllocatorSuperblock*>(
+        card_start & ~uintptr_t{s_small_superblock_size - 1});
+    uintptr_t first_block = superblock->firstBlockPointer();
+    if (card_end <= first_block) {
+      // The card only covers the superblock header.
+      continue;
+    }
+    unsigned block_size = superblock->blockSize();
+    unsigned first = card_start > first_block
+        ? (card_start - first_block) / block_size : 0;
+    unsigned last = std::min((card_end - 1 - first_block) / block_size,
+                             uintptr_t{superblock->numBlocks() - 1});
+    for (unsigned block = first; block <= last; ++block) {
+      if (superblock->isBlockAllocated(block)) {
+        fun(superblock->blockPointer(block));
+      }
+    }
+  }
+}
+
+void rho::AllocatorSuperblock::clearCards() {
+  memset(s_cards, 0,
+         (arena_superblock_next - s_arena_start) >> s_card_size_log2);
+}
+
 void rho::AllocatorSuperblock::debugPrintSmallSuperblocks() {
-  uintptr_t next_superblock = arena_superblock_start;
+  uintptr_t next_superblock = s_arena_start;
   while (next_superblock < arena_superblock_next) {
     reinterpret_cast<AllocatorSuperblock*>(next_superblock)->printSummary();
     next_superblock += s_small_superblock_size;
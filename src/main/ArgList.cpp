@@ -222,8 +222,46 @@ const Symbol* ArgList::tag2Symbol(const RObject* tag)
 	    : coerceTag(tag));
 }
 
+// Arguments that evaluate to themselves.
+static bool isConstantArgument(const RObject* arg)
+{
+    if (!arg)
+	return false;
+    switch (arg->sexptype()) {
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+    case CPLXSXP:
+    case STRSXP:
+	return true;
+    default:
+	return false;
+    }
+}
+
+// The value of a variable, if it can be found without evaluating anything.
+static RObject* plainValue(const Symbol* symbol, Environment* env)
+{
+    if (symbol == DotsSymbol || symbol->isDotDotSymbol()
+	|| symbol == Symbol::missingArgument())
+	return nullptr;
+    const Frame::Binding* binding = env->findBinding(symbol);
+    if (!binding || binding->isActive())
+	return nullptr;
+    RObject* value = binding->rawValue();
+    if (value && value->sexptype() == PROMSXP) {
+	value = static_cast<Promise*>(value)->value();
+	if (value == Symbol::unboundValue())
+	    return nullptr;
+    }
+    if (value == Symbol::missingArgument() || value == Symbol::unboundValue())
+	return nullptr;
+    return value;
+}
+
 void ArgList::wrapInPromises(Environment* env,
-			     const Expression* call)
+			     const Expression* call,
+			     const std::vector<bool>* strict_args)
 {
     if (m_status == PROMISED)
 	return;
@@ -241,6 +279,28 @@ void ArgList::wrapInPromises(Environment* env,
     setList(nullptr);
     PairList* lastout = nullptr;
 
+    // Looking up a variable early is only safe if nothing can change it
+    // before the callee would have looked it up.  So no argument may need
+    // evaluating, and positions must determine which formal each argument
+    // is matched to.  Forcing a promise or reading an active binding can
+    // run arbitrary code, so every variable must already have a plain
+    // value.
+    bool pass_variables = strict_args && !m_first_arg_env;
+    if (pass_variables) {
+	for (const ConsCell& arg : expanded_args) {
+	    const RObject* rawvalue = arg.car();
+	    if (arg.tag() || !rawvalue
+		|| !(isConstantArgument(rawvalue)
+		     || (rawvalue->sexptype() == SYMSXP
+			 && plainValue(static_cast<const Symbol*>(rawvalue),
+				       env)))) {
+		pass_variables = false;
+		break;
+	    }
+	}
+    }
+
+    unsigned int position = 0;
     for (const ConsCell& arg : expanded_args) {
 	RObject* rawvalue = arg.car();
 	const Symbol* tag = tag2Symbol(arg.tag());
@@ -249,9 +309,20 @@ void ArgList::wrapInPromises(Environment* env,
 	    value = Promise::createEvaluatedPromise(rawvalue, m_first_arg);
 	    m_first_arg = nullptr;
 	    m_first_arg_env = nullptr;
-	} else if (rawvalue != Symbol::missingArgument())
-	    value = new Promise(rawvalue, env);
+	} else if (strict_args && isConstantArgument(rawvalue)) {
+	    value = rawvalue;
+	    SET_NAMED(value, 2);
+	} else if (rawvalue != Symbol::missingArgument()) {
+	    if (pass_variables && position < strict_args->size()
+		&& (*strict_args)[position])
+		value = plainValue(static_cast<Symbol*>(rawvalue), env);
+	    if (value && value != Symbol::missingArgument())
+		SET_NAMED(value, 2);
+	    else
+		value = new Promise(rawvalue, env);
+	}
 	lastout = append(value, tag, lastout);
+	++position;
     }
 
     m_status = PROMISED;
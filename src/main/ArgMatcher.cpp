@@ -326,7 +326,7 @@ bool ArgMatchInfo::arglistTagsMatch(const PairList* args) const {
     size_t index;
     for (index = 0; index < m_tags.size() && arg != nullptr;
 	 ++index, arg = arg->tail()) {
-	if (m_tags[index] != args->tag())
+	if (m_tags[index] != arg->tag())
 	    return false;
     }
     if (index != m_tags.size() || arg != nullptr) {
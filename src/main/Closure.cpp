@@ -43,6 +43,7 @@
 #include "rho/ReturnBailout.hpp"
 #include "rho/ReturnException.hpp"
 #include "rho/errors.hpp"
+#include "rho/jit/ClosureStatistics.hpp"
 #include "rho/jit/CompiledExpression.hpp"
 
 using namespace std;
@@ -64,10 +65,27 @@ namespace rho {
 }
 
 bool Closure::s_debugging_enabled = true;
+unsigned int Closure::s_execution_count = 0;
+
+#ifdef ENABLE_LLVM_JIT
+namespace {
+    // A closure is compiled to unoptimized code once it has been called
+    // this many times, or its interpreted loops have taken this many back
+    // edges.
+    const int baseline_invocations = 100;
+    const unsigned int baseline_back_edges = 10000;
+
+    // Compiled code is recompiled with optimization once the closure has
+    // been called this many times, or the compiled loops have taken this
+    // many back edges.
+    const int optimize_invocations = 1000;
+    const unsigned int optimize_back_edges = 100000;
+}
+#endif
 
 Closure::Closure(const PairList* formal_args, RObject* body, Environment* env)
-    : FunctionBase(CLOSXP), m_debug(false),
-      m_num_invokes(0)
+    : FunctionBase(CLOSXP), m_debug(false), m_compilation_failed(false),
+      m_num_invokes(0), m_num_back_edges(0)
 {
     m_matcher = new ArgMatcher(formal_args);
     m_body = body;
@@ -75,6 +93,11 @@ Closure::Closure(const PairList* formal_args, RObject* body, Environment* env)
 }
 
 Closure::~Closure() {
+#ifdef ENABLE_LLVM_JIT
+    // Compiled code may keep the statistics alive a little longer.
+    if (m_jit_statistics)
+	m_jit_statistics->closureDestroyed();
+#endif
 }
 
 Closure* Closure::clone() const
@@ -91,6 +114,10 @@ void Closure::detachReferents()
     m_body.detach();
     m_environment.detach();
     m_compiled_body.detach();
+    m_pending_body.detach();
+#ifdef ENABLE_LLVM_JIT
+    m_compiled_loops.clear();
+#endif
     FunctionBase::detachReferents();
 }
 
@@ -102,18 +129,19 @@ RObject* Closure::execute(Environment* env) const
     Closure::DebugScope debugscope(this);
     try {
 	++m_num_invokes;
+	++s_execution_count;
 #ifdef ENABLE_LLVM_JIT
+	maybeCompile();
 	if (m_compiled_body
 	    && m_compiled_body->hasMatchingFrameLayout(env)) {
+	    ++m_jit_statistics->compiled_calls;
 	    PlainContext boctxt;
 	    ans = m_compiled_body->evalInEnvironment(env);
 	} else {
-	    if (!m_compiled_body && m_num_invokes == 100) {
-		// Compile the body, but stay in the interpreter because the
-		// frame hasn't been setup for a compiled function.
-		// TODO(kmillar): recompile functions as needed.
-		compile();
-	    }
+	    // Either there is no compiled code yet, or the frame was set up
+	    // before it was installed.
+	    if (m_compiled_body)
+		++m_jit_statistics->frame_layout_mismatches;
 #endif
 	    BailoutContext boctxt;
 	    ans = Evaluator::evaluate(m_body, env);
@@ -140,13 +168,112 @@ void Closure::compile() const {
 #ifdef ENABLE_LLVM_JIT
     try {
 	m_compiled_body = JIT::CompiledExpression::compileFunctionBody(this);
+	m_pending_body = nullptr;
     } catch (...) {
 	// Compilation failed.  Continue on with the interpreter.
     }
 #endif
 }
 
+#ifdef ENABLE_LLVM_JIT
+std::shared_ptr<JIT::ClosureStatistics> Closure::jitStatistics() const
+{
+    if (!m_jit_statistics)
+	m_jit_statistics = std::make_shared<JIT::ClosureStatistics>(this);
+    return m_jit_statistics;
+}
+
+JIT::CompiledExpression* Closure::compiledLoop(const Expression* loop,
+					       Environment* env,
+					       bool replace_frame) const
+{
+    for (const CompiledLoop& entry : m_compiled_loops) {
+	if (entry.m_loop == loop && entry.m_replaces_frame == replace_frame)
+	    return entry.m_code;
+    }
+    GCStackRoot<JIT::CompiledExpression> code;
+    try {
+	code = JIT::CompiledExpression::compileLoopInBackground(
+	    loop, replace_frame ? this : nullptr, env);
+	// If LLVM is busy, try again next time.
+	if (!code)
+	    return nullptr;
+    } catch (...) {
+	// Remember the failure, and carry on with the interpreter.
+    }
+    m_compiled_loops.emplace_back();
+    CompiledLoop& entry = m_compiled_loops.back();
+    entry.m_loop = loop;
+    entry.m_replaces_frame = replace_frame;
+    entry.m_code = code;
+    return code;
+}
+#endif
+
+void Closure::maybeCompile() const {
+#ifdef ENABLE_LLVM_JIT
+    if (m_pending_body || m_compilation_failed)
+	return;
+    bool optimize;
+    if (!m_compiled_body) {
+	if (m_num_invokes < baseline_invocations
+	    && m_num_back_edges < baseline_back_edges)
+	    return;
+	optimize = false;
+    } else {
+	if (m_compiled_body->isOptimized()
+	    || (m_num_invokes < optimize_invocations
+		&& m_compiled_body->backEdgeCount() < optimize_back_edges))
+	    return;
+	optimize = true;
+    }
+    try {
+	// If LLVM is busy this returns null, and we try again on the next
+	// call.
+	m_pending_body = JIT::CompiledExpression::compileFunctionBodyInBackground(
+	    this, optimize);
+    } catch (...) {
+	// Compilation failed.  Continue on with the interpreter (or the
+	// existing compiled code).
+	m_compilation_failed = true;
+    }
+#endif
+}
+
+void Closure::installPendingCode() const {
+#ifdef ENABLE_LLVM_JIT
+    if (!m_pending_body)
+	return;
+    if (m_pending_body->isReady()) {
+	m_compiled_body = m_pending_body;
+	m_pending_body = nullptr;
+    } else if (m_pending_body->hasFailed()) {
+	m_pending_body = nullptr;
+	m_compilation_failed = true;
+    }
+#endif
+}
+
+void Closure::countBackEdges(unsigned int count)
+{
+    ClosureContext* context = ClosureContext::innermost();
+    if (!context)
+	return;
+    const Closure* closure = dynamic_cast<const Closure*>(context->function());
+    if (closure)
+	closure->m_num_back_edges += count;
+}
+
 Environment* Closure::createExecutionEnv() const {
+    // Installing the code now means that this call can use it.
+    installPendingCode();
+#ifdef ENABLE_LLVM_JIT
+    if (m_compiled_body) {
+	Environment* env = m_compiled_body->takeSpareEnvironment();
+	if (env && env->enclosingEnvironment() == environment())
+	    return env;
+    }
+#endif
     Frame* frame =
 #ifdef ENABLE_LLVM_JIT
         m_compiled_body ? m_compiled_body->createFrame():
@@ -155,6 +282,29 @@ Environment* Closure::createExecutionEnv() const {
     return new Environment(environment(), frame);
 }
 
+void Closure::releaseExecutionEnv(Environment* env,
+				  unsigned int executions_before) const
+{
+#ifdef ENABLE_LLVM_JIT
+    // Any other closure that ran during the call, for example an S3
+    // method dispatched to by a primitive, might have captured env.
+    if (m_compiled_body && !m_debug
+	&& s_execution_count == executions_before + 1
+	&& m_compiled_body->recycleEnvironment(env))
+	return;
+#endif
+    env->maybeDetachFrame();
+}
+
+const std::vector<bool>* Closure::strictArguments() const
+{
+#ifdef ENABLE_LLVM_JIT
+    if (m_compiled_body)
+	return m_compiled_body->strictArguments();
+#endif
+    return nullptr;
+}
+
 const char* Closure::typeName() const
 {
     return staticTypeName();
@@ -177,7 +327,13 @@ void Closure::setBody(RObject* body) {
 
 void Closure::invalidateCompiledCode() {
     m_num_invokes = 0;
+    m_num_back_edges = 0;
+    m_compilation_failed = false;
     m_compiled_body = nullptr;
+    m_pending_body = nullptr;
+#ifdef ENABLE_LLVM_JIT
+    m_compiled_loops.clear();
+#endif
 }
 
 void Closure::visitReferents(const_visitor* v) const
@@ -186,6 +342,7 @@ void Closure::visitReferents(const_visitor* v) const
     const GCNode* body = m_body;
     const GCNode* environment = m_environment;
     const GCNode* compiled_body = m_compiled_body;
+    const GCNode* pending_body = m_pending_body;
 
     FunctionBase::visitReferents(v);
     if (matcher)
@@ -196,6 +353,17 @@ void Closure::visitReferents(const_visitor* v) const
 	(*v)(environment);
     if (compiled_body)
 	(*v)(compiled_body);
+    if (pending_body)
+	(*v)(pending_body);
+#ifdef ENABLE_LLVM_JIT
+    for (const CompiledLoop& entry : m_compiled_loops) {
+	const GCNode* loop = entry.m_loop;
+	const GCNode* code = entry.m_code;
+	(*v)(loop);
+	if (code)
+	    (*v)(code);
+    }
+#endif
 }
 
 void SET_FORMALS(SEXP closure, SEXP formals) {
@@ -39,6 +39,7 @@
 #include "rho/BuiltInFunction.hpp"
 #include "rho/FunctionBase.hpp"
 #include "rho/ListFrame.hpp"
+#include "rho/RealVector.hpp"
 #include "rho/StringVector.hpp"
 #include "rho/Symbol.hpp"
 #include "sparsehash/dense_hash_map"
@@ -80,15 +81,24 @@ SEXP R_BaseEnv;
 SEXP R_GlobalEnv;
 SEXP R_BaseNamespace;
 
+namespace {
+    struct CacheEntry {
+	Frame::Binding* binding;  // Null if the Symbol is unbound.
+	unsigned int generation;
+    };
+}
+
 class Environment::Cache : public google::dense_hash_map<
-    const Symbol*, Frame::Binding*,
+    const Symbol*, CacheEntry,
     PointerHash,
     std::equal_to<const Symbol*>,
-    Allocator<std::pair<const Symbol* const,
-			      Frame::Binding*> >
+    Allocator<std::pair<const Symbol* const, CacheEntry> >
     >
 { };
 
+unsigned int Environment::s_cache_generation = 0;
+Environment::SearchPathCacheStatistics Environment::s_cache_statistics;
+
 // The implementation assumes that any loops in the node graph will
 // include at least one Environment.
 void Environment::LeakMonitor::operator()(const GCNode* node)
@@ -108,6 +118,33 @@ void Environment::detachFrame()
     m_frame = nullptr;
 }
 
+bool Environment::clearForReuse()
+{
+#ifdef DETACH_LOCAL_FRAMES
+    if (m_leaked || m_locked || m_single_stepping || m_on_search_path
+	|| m_frame->isLocked())
+	return false;
+    m_frame->clear();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Environment::replaceFrame(Frame* frame)
+{
+    if (m_on_search_path)
+	error(_("cannot replace the frame of an environment"
+		" on the search path"));
+    frame->importBindings(m_frame, true);
+    if (m_frame->isLocked())
+	frame->lock(false);
+    m_frame = frame;
+    // Cached lookups may have noted the old Frame.
+    Frame::invalidateFunctionLookups();
+    Frame::invalidateVariableLookups();
+}
+
 void Environment::detachReferents()
 {
     setOnSearchPath(false);
@@ -124,6 +161,7 @@ Frame::Binding* Environment::findBinding(const Symbol* symbol)
     bool cache_miss = false;
     Environment* env = this;
 #ifdef CHECK_CACHE
+    bool cache_hit = false;
     Frame::Binding* cache_binding = 0;
 #endif
     Cache* search_path_cache = searchPathCache();
@@ -131,26 +169,46 @@ Frame::Binding* Environment::findBinding(const Symbol* symbol)
 	if (env->isSearchPathCachePortal()) {
 	    // TODO: the cache isn't effective for S3 methods.
 	    Cache::iterator it = search_path_cache->find(symbol);
-	    if (it == search_path_cache->end())
+	    if (it == search_path_cache->end()
+		|| it->second.generation != s_cache_generation) {
 		cache_miss = true;
+		++s_cache_statistics.misses;
+	    }
 #ifdef CHECK_CACHE
-	    else cache_binding = it->second;
+	    else {
+		cache_hit = true;
+		cache_binding = it->second.binding;
+	    }
 #else
-	    else return it->second;
+	    else {
+		Frame::Binding* bdg = it->second.binding;
+		if (bdg)
+		    ++s_cache_statistics.hits;
+		else
+		    ++s_cache_statistics.negative_hits;
+		return bdg;
+	    }
 #endif
 	}
 	Frame::Binding* bdg = env->frame()->binding(symbol);
 	if (bdg) {
 #ifdef CHECK_CACHE
-	    if (cache_binding && cache_binding != bdg)
+	    if (cache_hit && cache_binding != bdg)
 		abort();
 #endif
 	    if (cache_miss)
-		(*search_path_cache)[symbol] = bdg;
+		(*search_path_cache)[symbol] = {bdg, s_cache_generation};
 	    return bdg;
 	}
 	env = env->enclosingEnvironment();
     }
+#ifdef CHECK_CACHE
+    if (cache_binding)
+	abort();
+#endif
+    // Remember that the Symbol is unbound on the search path.
+    if (cache_miss)
+	(*search_path_cache)[symbol] = {nullptr, s_cache_generation};
     return nullptr;
 }
 
@@ -162,16 +220,21 @@ void Environment::flushFromSearchPathCache(const Symbol* sym)
 {
     Cache* search_path_cache = searchPathCache();
 
-    if (sym)
-	search_path_cache->erase(sym);
-    else {
-	// Clear the cache, but retain the current number of buckets:
-	size_t buckets = search_path_cache->bucket_count();
-	search_path_cache->clear();
-	search_path_cache->rehash(buckets);
+    if (sym) {
+	if (search_path_cache->erase(sym))
+	    ++s_cache_statistics.flushes;
+    } else {
+	// Existing entries are overwritten as they are next looked up.
+	++s_cache_generation;
+	++s_cache_statistics.generations;
     }
 }
 
+void Environment::resetSearchPathCacheStatistics()
+{
+    s_cache_statistics = SearchPathCacheStatistics();
+}
+
 Environment::Cache* Environment::createSearchPathCache()
 {
     Cache* search_path_cache = new Cache();
@@ -268,6 +331,8 @@ unsigned int Environment::packGPBits() const
 void  Environment::setEnclosingEnvironment(Environment* new_enclos)
 {
     m_enclosing = new_enclos;
+    Frame::invalidateFunctionLookups();
+    Frame::invalidateVariableLookups();
     // Recursively propagate participation in search list cache:
     if (m_on_search_path) {
 	Environment* env = m_enclosing;
@@ -296,6 +361,8 @@ Environment* Environment::attachToSearchPath(int pos, StringVector* name)
     new_env->m_enclosing = where->m_enclosing;
     where->m_enclosing = new_env;
     new_env->setOnSearchPath(true);
+    Frame::invalidateFunctionLookups();
+    Frame::invalidateVariableLookups();
 
     return new_env;
 }
@@ -320,6 +387,8 @@ Environment* Environment::detachFromSearchPath(int pos) {
     where->m_enclosing = env_to_detach->m_enclosing;
     env_to_detach->m_enclosing = nullptr;
     env_to_detach->setOnSearchPath(false);
+    Frame::invalidateFunctionLookups();
+    Frame::invalidateVariableLookups();
 
     return env_to_detach;
 }
@@ -408,6 +477,31 @@ void SET_ENCLOS(SEXP x, SEXP v) {
 	SEXP_downcast<Environment*>(v));
 }
 
+// Returns the search path cache statistics as a named numeric vector,
+// and resets them if 'reset' is TRUE.
+extern "C"
+SEXP searchpathcachestats(SEXP reset)
+{
+    const Environment::SearchPathCacheStatistics& stats
+	= Environment::searchPathCacheStatistics();
+    GCStackRoot<RealVector> ans(RealVector::create(5));
+    GCStackRoot<StringVector> names(StringVector::create(5));
+    (*ans)[0] = stats.hits;
+    (*names)[0] = String::obtain("hits");
+    (*ans)[1] = stats.negative_hits;
+    (*names)[1] = String::obtain("negative_hits");
+    (*ans)[2] = stats.misses;
+    (*names)[2] = String::obtain("misses");
+    (*ans)[3] = stats.flushes;
+    (*names)[3] = String::obtain("flushes");
+    (*ans)[4] = stats.generations;
+    (*names)[4] = String::obtain("generations");
+    ans->setAttribute(NamesSymbol, names);
+    if (Rf_asLogical(reset) == TRUE)
+	Environment::resetSearchPathCacheStatistics();
+    return ans;
+}
+
 // Utility intended to be called from a debugger.  Prints out the
 // names of the Symbols in an Environment, together with the addresses
 // the Symbols are bound to.
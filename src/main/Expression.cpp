@@ -49,8 +49,11 @@
 #include "rho/PlainContext.hpp"
 #include "rho/ProtectStack.hpp"
 #include "rho/RAllocStack.hpp"
+#include "rho/RealVector.hpp"
 #include "rho/StackChecker.hpp"
+#include "rho/StringVector.hpp"
 #include "rho/Symbol.hpp"
+#include "rho/VectorFusion.hpp"
 
 #undef match
 
@@ -220,6 +223,11 @@ RObject* Expression::evaluateFixedArityBuiltIn(const BuiltInFunction* func,
 RObject* Expression::evaluateBuiltInCall(
     const BuiltInFunction* func, Environment* env, ArgList* arglist) const
 {
+    if (arglist->status() == ArgList::RAW) {
+	RObject* result = VectorFusion::evaluate(this, func, env);
+	if (result)
+	    return result;
+    }
     if (func->hasDirectCall() || func->hasFixedArityCall())
         return evaluateDirectBuiltInCall(func, env, arglist);
     else
@@ -309,8 +317,9 @@ RObject* Expression::invokeClosureImpl(const Closure* func,
     // We can't modify *parglist, as it's on the other side of a
     // GCStackFrameboundary, so make a copy instead.
     ArgList arglist(parglist->list(), parglist->status());
-    arglist.wrapInPromises(calling_env, this);
+    arglist.wrapInPromises(calling_env, this, func->strictArguments());
 
+    unsigned int executions = Closure::executionCount();
     Environment* execution_env = func->createExecutionEnv();
     matchArgsIntoEnvironment(func, calling_env, &arglist, execution_env);
 
@@ -330,7 +339,7 @@ RObject* Expression::invokeClosureImpl(const Closure* func,
     }
 
     Environment::monitorLeaks(result);
-    execution_env->maybeDetachFrame();
+    func->releaseExecutionEnv(execution_env, executions);
 
     return result;
 }
@@ -363,20 +372,181 @@ CachingExpression* CachingExpression::clone() const
     return new CachingExpression(*this);
 }
 
+CachingExpression::CacheStatistics CachingExpression::s_cache_statistics;
+
+void CachingExpression::resetCacheStatistics()
+{
+    s_cache_statistics = CacheStatistics();
+}
+
+#ifdef ENABLE_LLVM_JIT
+JIT::CompiledExpression*
+CachingExpression::compiledLoop(Environment* env) const
+{
+    if (m_compiled_loop || m_loop_compilation_failed)
+	return m_compiled_loop;
+    try {
+	// If LLVM is busy, this returns null and we try again next time.
+	m_compiled_loop = JIT::CompiledExpression::compileLoopInBackground(
+	    this, nullptr, env);
+    } catch (...) {
+	m_loop_compilation_failed = true;
+    }
+    return m_compiled_loop;
+}
+#endif
+
 void CachingExpression::visitReferents(const_visitor* v) const
 {
-    const GCNode* function = m_cache.m_function.get();
+    const GCNode* function = m_cache.m_first.m_function.get();
+    const GCNode* environment = m_function_cache.m_environment.get();
+    const GCNode* found = m_function_cache.m_function.get();
+#ifdef ENABLE_LLVM_JIT
+    const GCNode* compiled_loop = m_compiled_loop.get();
+#endif
     Expression::visitReferents(v);
     if (function)
 	(*v)(function);
+    if (environment)
+	(*v)(environment);
+    if (found)
+	(*v)(found);
+#ifdef ENABLE_LLVM_JIT
+    if (compiled_loop)
+	(*v)(compiled_loop);
+#endif
+    for (unsigned i = 0; i < m_cache.m_num_others; ++i) {
+	const GCNode* other = m_cache.m_others[i].m_function.get();
+	if (other)
+	    (*v)(other);
+    }
 }
 
 void CachingExpression::detachReferents()
 {
-    m_cache.m_function = nullptr;
+    m_cache.m_first.m_function = nullptr;
+    for (unsigned i = 0; i < m_cache.m_num_others; ++i)
+	m_cache.m_others[i].m_function = nullptr;
+    m_cache.m_num_others = 0;
+    m_function_cache.m_environment = nullptr;
+    m_function_cache.m_function = nullptr;
+#ifdef ENABLE_LLVM_JIT
+    m_compiled_loop = nullptr;
+#endif
     Expression::detachReferents();
 }
 
+FunctionBase* CachingExpression::getFunction(Environment* env) const
+{
+    RObject* head = car();
+    if (head->sexptype() != SYMSXP)
+	return Expression::getFunction(env);
+    Symbol* symbol = static_cast<Symbol*>(head);
+    Environment* start = env;
+    if (env != Environment::global()) {
+	// A binding in the local Frame takes precedence, and local
+	// Frames are too short-lived to be worth tracking, so look
+	// there directly and start the cached lookup from the enclosing
+	// Environment.
+	start = env->enclosingEnvironment();
+	if (!start || env->frame()->binding(symbol))
+	    return Expression::getFunction(env);
+    }
+    // car() may have been modified since it was cached.
+    if (m_function_cache.m_environment == start
+	&& m_function_cache.m_symbol == symbol
+	&& m_function_cache.m_version == Frame::functionBindingVersion())
+	return m_function_cache.m_function;
+
+    FunctionBase* func = lookupFunction(symbol, start);
+    if (!func)
+	Rf_error(_("could not find function \"%s\""),
+		 symbol->name()->c_str());
+    return func;
+}
+
+FunctionBase* CachingExpression::lookupFunction(const Symbol* symbol,
+						Environment* env) const
+{
+    // Frames beyond the global environment are on the search path,
+    // and so are tracked anyway.
+    for (Environment* e = env; e && e != Environment::global();
+	 e = e->enclosingEnvironment())
+	e->frame()->noteFunctionLookup();
+    // Forcing a Promise may change bindings, so take the version first.
+    size_t version = Frame::functionBindingVersion();
+
+    // As findFunction(), except that active bindings aren't cached.
+    bool cacheable = true;
+    Environment* e = env;
+    do {
+	Frame::Binding* bdg;
+	if (e == Environment::global())
+	    bdg = e->findBinding(symbol);
+	else
+	    bdg = e->frame()->binding(symbol);
+	if (bdg) {
+	    if (bdg->isActive())
+		cacheable = false;
+	    pair<RObject*, bool> fpr = bdg->forcedValue2();
+	    RObject* val = fpr.first;
+	    if (val == Symbol::missingArgument())
+		Rf_error(_("argument \"%s\" is missing, with no default"),
+			 symbol->name()->c_str());
+	    if (FunctionBase::isA(val)) {
+		// See findTestedValue().
+		if (!fpr.second)
+		    bdg->rawValue();
+		FunctionBase* func = static_cast<FunctionBase*>(val);
+		if (cacheable) {
+		    m_function_cache.m_environment = env;
+		    m_function_cache.m_symbol = symbol;
+		    m_function_cache.m_function = func;
+		    m_function_cache.m_version = version;
+		}
+		return func;
+	    }
+	}
+	e = e->enclosingEnvironment();
+    } while (e);
+    return nullptr;
+}
+
+const ArgMatchInfo*
+CachingExpression::lookupMatchInfo(const Closure* func,
+				   const ArgList* arglist) const
+{
+    const CacheEntry& first = m_cache.m_first;
+    if (first.m_function == func
+	&& first.m_arg_match_info->arglistTagsMatch(arglist->tags()))
+	return first.m_arg_match_info;
+    for (unsigned i = 0; i < m_cache.m_num_others; ++i) {
+	const CacheEntry& entry = m_cache.m_others[i];
+	if (entry.m_function == func
+	    && entry.m_arg_match_info->arglistTagsMatch(arglist->tags()))
+	    return entry.m_arg_match_info;
+    }
+    return nullptr;
+}
+
+void CachingExpression::addMatchInfo(const Closure* func,
+				     const ArgMatchInfo* arg_match_info) const
+{
+    CacheEntry* entry;
+    if (!m_cache.m_first.m_function) {
+	entry = &m_cache.m_first;
+    } else if (m_cache.m_num_others < s_cache_size - 1) {
+	if (!m_cache.m_others)
+	    m_cache.m_others = new CacheEntry[s_cache_size - 1]();
+	entry = &m_cache.m_others[m_cache.m_num_others++];
+    } else {
+	m_cache.m_megamorphic = true;
+	return;
+    }
+    entry->m_arg_match_info = arg_match_info;
+    entry->m_function = func;
+}
+
 void CachingExpression::matchArgsIntoEnvironment(const Closure* func,
                                           Environment* calling_env,
                                           ArgList* arglist,
@@ -384,27 +554,34 @@ void CachingExpression::matchArgsIntoEnvironment(const Closure* func,
 {
     const ArgMatcher* matcher = func->matcher();
 
-    if (!m_cache.m_function) {
-	// TODO: Don't cache the matching the first time that the function is
-	// called.  This eliminates additional work and storage for
-	// functions that are only called once.
-	ArgList args(getArgs(), ArgList::RAW);
-	m_cache.m_arg_match_info = matcher->createMatchInfo(&args);
-	m_cache.m_function = func;
-    }
-
-    if (m_cache.m_function == func
-	&& m_cache.m_arg_match_info
-	&& m_cache.m_arg_match_info->arglistTagsMatch(arglist->tags()))
-    {
-	matcher->match(execution_env, arglist, m_cache.m_arg_match_info);
+    const ArgMatchInfo* arg_match_info = lookupMatchInfo(func, arglist);
+    if (arg_match_info) {
+	++s_cache_statistics.hits;
+	matcher->match(execution_env, arglist, arg_match_info);
 	return;
     }
 
-    // We weren't able to cache a matching, probably because getArgs()
-    // contains '...'.  Run the full matching algorithm instead.
     ClosureContext context(this, calling_env, func, func->environment(),
 			   *arglist);
+    if (!m_cache.m_megamorphic) {
+	// The matching depends only on the tags of the supplied arguments,
+	// which by now include any expanded from '...'.
+	// TODO: Don't cache the matching the first time that the function is
+	// called.  This eliminates additional work and storage for
+	// functions that are only called once.
+	arg_match_info = matcher->createMatchInfo(arglist);
+	if (arg_match_info) {
+	    ++s_cache_statistics.misses;
+	    addMatchInfo(func, arg_match_info);
+	    matcher->match(execution_env, arglist, arg_match_info);
+	    return;
+	}
+	++s_cache_statistics.uncacheable;
+    } else {
+	++s_cache_statistics.megamorphic;
+    }
+
+    // Run the full matching algorithm.
     matcher->match(execution_env, arglist);
 }
 
@@ -416,6 +593,29 @@ SEXP Rf_currentExpression()
     return R_CurrentExpr;
 }
 
+// Returns the argument matching cache statistics as a named numeric
+// vector, and resets them if 'reset' is TRUE.
+extern "C"
+SEXP argmatchcachestats(SEXP reset)
+{
+    const CachingExpression::CacheStatistics& stats
+	= CachingExpression::cacheStatistics();
+    GCStackRoot<RealVector> ans(RealVector::create(4));
+    GCStackRoot<StringVector> names(StringVector::create(4));
+    (*ans)[0] = stats.hits;
+    (*names)[0] = String::obtain("hits");
+    (*ans)[1] = stats.misses;
+    (*names)[1] = String::obtain("misses");
+    (*ans)[2] = stats.megamorphic;
+    (*names)[2] = String::obtain("megamorphic");
+    (*ans)[3] = stats.uncacheable;
+    (*names)[3] = String::obtain("uncacheable");
+    ans->setAttribute(NamesSymbol, names);
+    if (Rf_asLogical(reset) == TRUE)
+	CachingExpression::resetCacheStatistics();
+    return ans;
+}
+
 SEXP Rf_lcons(SEXP cr, SEXP tl)
 {
     GCStackRoot<> crr(cr);
@@ -42,6 +42,8 @@ using namespace rho;
 
 Frame::monitor Frame::s_read_monitor = nullptr;
 Frame::monitor Frame::s_write_monitor = nullptr;
+size_t Frame::s_function_binding_version = 0;
+size_t Frame::s_binding_set_version = 0;
 
 // ***** Class Frame::Binding *****
 
@@ -113,6 +115,7 @@ void Frame::Binding::setFunction(FunctionBase* function, Origin origin)
 	if (isLocked())
 	    Rf_error(_("cannot change active binding if binding is locked"));
     }
+    m_frame->bindingChanged();
     m_value = function;
     m_active = true;
     m_frame->monitorWrite(*this);
@@ -126,6 +129,7 @@ void Frame::Binding::setValue(RObject* new_value, Origin origin, bool quiet)
     if (isActive())
 	Rf_error(_("internal error: use %s for active bindings"),
 		 "setFunction()");
+    m_frame->valueChanging(m_value, new_value);
     m_value = new_value;
     m_origin = origin;
     if (!quiet)
@@ -176,6 +180,7 @@ PairList* Frame::asPairList() const
 void Frame::clear()
 {
     statusChanged(nullptr);
+    bindingChanged();
     v_clear();
     m_no_special_symbols = true;
 }
@@ -190,8 +195,10 @@ bool Frame::erase(const Symbol* symbol)
     if (isLocked())
 	Rf_error(_("cannot remove bindings from a locked frame"));
     bool ans = v_erase(symbol);
-    if (ans)
+    if (ans) {
 	statusChanged(symbol);
+	bindingChanged();
+    }
     return ans;
 }
 
@@ -214,6 +221,11 @@ void Frame::flush(const Symbol* sym)
     Environment::flushFromSearchPathCache(sym);
 }
 
+bool Frame::mayYieldFunction(const RObject* value)
+{
+    return value && (FunctionBase::isA(value) || value->sexptype() == PROMSXP);
+}
+
 void Frame::initializeBinding(Frame::Binding* binding,
 			      const Symbol* symbol)
 {
@@ -223,6 +235,8 @@ void Frame::initializeBinding(Frame::Binding* binding,
     }
     binding->initialize(this, symbol);
     statusChanged(symbol);
+    if (affectsVariableLookups())
+	invalidateVariableLookups();
     if (symbol->isSpecialSymbol()) {
 	m_no_special_symbols = false;
     }
@@ -241,6 +255,7 @@ void Frame::importBinding(const Binding* binding_to_import, bool quiet) {
     if (!binding_to_import)
 	return;
     Binding *new_binding = obtainBinding(binding_to_import->symbol());
+    bindingChanged();
     *new_binding = *binding_to_import;
     new_binding->m_frame = this;
     if (!quiet)
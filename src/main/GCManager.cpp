@@ -47,6 +47,7 @@ unsigned int GCManager::s_inhibitor_count = 0;
 size_t GCManager::s_threshold = R_VSIZE;
 size_t GCManager::s_min_threshold = s_threshold;
 size_t GCManager::s_gclite_threshold = s_threshold;
+bool GCManager::s_threshold_update_pending = false;
 bool GCManager::s_gc_is_running = false;
 bool GCManager::s_gc_pending = false;
 size_t GCManager::s_max_bytes = 0;
@@ -98,22 +99,69 @@ void GCManager::gc(bool force_full_collection)
 
     GCNode::gc(false);
 
+    // This has completed any lazy sweep left by the last mark-sweep
+    // collection, so the bytes allocated now reflect the live data.
+    if (s_threshold_update_pending) {
+	updateThreshold();
+	s_threshold_update_pending = false;
+    }
+
+    // With generational collection, try collecting just the nodes created
+    // since the last collection before resorting to a full collection.
+    bool full_collection_done = false;
+    if (!force_full_collection && GCNode::isGenerational()
+	&& MemoryBank::bytesAllocated() > s_threshold) {
+	full_collection_done = !GCNode::minorGC();
+    }
+
     if (force_full_collection || MemoryBank::bytesAllocated() > s_threshold) {
-	GCNode::gc(true);
-	s_threshold = std::max(size_t(0.8*double(s_threshold)),
-			       std::max(s_min_threshold,
-					size_t(1.2*MemoryBank::bytesAllocated())));
+	if (!full_collection_done)
+	    GCNode::gc(true);
+	// An explicitly requested collection completes the sweep, so
+	// that the memory usage reported afterwards is accurate.
+	if (force_full_collection)
+	    GCNode::gc(false);
+	if (GCNode::sweepBacklog() == 0)
+	    updateThreshold();
+	else
+	    s_threshold_update_pending = true;
     }
 
     s_gclite_threshold = std::max(size_t(0.8*double(s_gclite_threshold)),
 			       std::max(s_min_threshold,
 					size_t(1.2*MemoryBank::bytesAllocated())));
 
+    if (s_os && GCNode::numSaturatedNodes() > 0)
+	*s_os << "Garbage collection " << gc_count << ": "
+	      << GCNode::numSaturatedNodes()
+	      << " nodes with saturated reference counts\n";
+
+    if (s_os && GCNode::sweepBacklog() > 0)
+	*s_os << "Garbage collection " << gc_count << ": "
+	      << GCNode::sweepBacklog() << " superblocks left to sweep\n";
+
     if (s_post_gc) (*s_post_gc)();
 
     s_gc_is_running = false;
 }
 
+size_t GCManager::saturatedNodes()
+{
+    return GCNode::numSaturatedNodes();
+}
+
+size_t GCManager::sweepBacklog()
+{
+    return GCNode::sweepBacklog();
+}
+
+void GCManager::updateThreshold()
+{
+    s_threshold = std::max(size_t(0.8*double(s_threshold)),
+			   std::max(s_min_threshold,
+				    size_t(1.2*MemoryBank::bytesAllocated())));
+}
+
 void GCManager::resetMaxTallies()
 {
     s_max_bytes = MemoryBank::bytesAllocated();
@@ -32,11 +32,15 @@
 #include "rho/GCNode.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <iostream>
 #include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <thread>
 #include <utility>
 
 #include "rho/GCManager.hpp"
@@ -47,6 +51,7 @@
 #include "rho/WeakRef.hpp"
 
 #include "rho/GCNodeAllocator.hpp"
+#include "rho/HeapProfiler.hpp"
 
 using namespace std;
 using namespace rho;
@@ -54,6 +59,17 @@ using namespace rho;
 vector<const GCNode*>* GCNode::s_moribund = 0;
 unsigned int GCNode::s_num_nodes = 0;
 bool GCNode::s_on_stack_bits_correct = false;
+bool GCNode::s_generational = false;
+vector<GCNode::RememberedEdge>* GCNode::s_remembered_edges = 0;
+bool GCNode::s_remembered_edges_overflowed = false;
+unsigned GCNode::s_num_gc_threads = 1;
+bool GCNode::s_lazy_sweep = false;
+vector<GCNode*>* GCNode::s_lazy_sweep_to_delete = 0;
+std::unordered_map<const GCNode*, size_t>* GCNode::s_refcount_overflow = 0;
+size_t GCNode::s_num_saturated = 0;
+map<uintptr_t, GCNode::ExternalBlock>* GCNode::s_external_blocks = 0;
+uintptr_t GCNode::s_external_min = numeric_limits<uintptr_t>::max();
+uintptr_t GCNode::s_external_max = 0;
 
 // Used to update reference count bits of a GCNode. The array element at index
 // 2N + 1 is XORed with the current refcount bits to compute the updated reference
@@ -72,6 +88,7 @@ unsigned char GCNode::s_mark = 0;
 HOT_FUNCTION void* GCNode::operator new(size_t bytes) {
     GCManager::maybeGC();
     MemoryBank::notifyAllocation(bytes);
+    HeapProfiler::notifyAllocation(bytes);
     void *result;
 
     result = GCNodeAllocator::allocate(bytes);
@@ -88,7 +105,7 @@ HOT_FUNCTION void* GCNode::operator new(size_t bytes) {
 }
 
 GCNode::GCNode(CreateAMinimallyInitializedGCNode*)
-    : m_refcount_flags(s_decinc_refcount[1]) {
+    : m_refcount_flags(s_decinc_refcount[1]), m_young(s_generational) {
 }
 
 void GCNode::operator delete(void* pointer, size_t bytes) {
@@ -110,6 +127,34 @@ bool GCNode::check() {
     return true;
 }
 
+void GCNode::enableRefCountOverflow() {
+    if (s_num_nodes != 0) {
+        cerr << "GCNode::enableRefCountOverflow() : "
+            "GCNode objects already exist.\n";
+        abort();
+    }
+    if (!s_refcount_overflow) {
+        s_refcount_overflow = new std::unordered_map<const GCNode*, size_t>();
+    }
+}
+
+void GCNode::incOverflowedRefCount(const GCNode* node) {
+    ++(*s_refcount_overflow)[node];
+}
+
+void GCNode::decOverflowedRefCount(const GCNode* node) {
+    auto overflow = s_refcount_overflow->find(node);
+    if (overflow != s_refcount_overflow->end()) {
+        if (--overflow->second == 0) {
+            s_refcount_overflow->erase(overflow);
+        }
+    } else {
+        // s_decinc_refcount makes the maximum count sticky, so clear the
+        // lowest count bit directly.
+        node->m_refcount_flags &= static_cast<unsigned char>(~0x2);
+    }
+}
+
 void GCNode::destruct_aux() {
     // Erase this node from the moribund list:
     typedef std::vector<const GCNode*>::iterator Iter;
@@ -123,6 +168,23 @@ void GCNode::destruct_aux() {
 extern RObject* R_Srcref;
 
 void GCNode::gc(bool markSweep) {
+    runCollector(markSweep ? markSweepGC : gclite);
+}
+
+bool GCNode::minorGC() {
+    if (!s_generational) {
+        runCollector(gclite);
+        return true;
+    }
+    if (s_remembered_edges_overflowed) {
+        runCollector(markSweepGC);
+        return false;
+    }
+    runCollector(minorMarkSweepGC);
+    return true;
+}
+
+void GCNode::runCollector(void (*collector)()) {
     if (GCManager::GCInhibitor::active()) {
         return;
     }
@@ -131,11 +193,7 @@ void GCNode::gc(bool markSweep) {
     ProtectStack::protectAll();
     incRefCount(R_Srcref);
 
-    if (markSweep) {
-        GCStackRootBase::withAllStackNodesProtected(markSweepGC);
-    } else {
-        GCStackRootBase::withAllStackNodesProtected(gclite);
-    }
+    GCStackRootBase::withAllStackNodesProtected(collector);
 
     decRefCount(R_Srcref);
 }
@@ -146,15 +204,122 @@ void GCNode::markSweepGC() {
     // any code that depends on normal operation of the garbage collector.
     s_on_stack_bits_correct = true;
 
+    finishLazySweep();
     mark();
     sweep();
+    if (s_generational) {
+        promoteYoungNodes();
+    }
+    if (GCNodeAllocator::releasesFreeMemory()) {
+        GCNodeAllocator::releaseFreeMemory();
+    }
+
+    s_on_stack_bits_correct = false;
+}
+
+void GCNode::minorMarkSweepGC() {
+    s_on_stack_bits_correct = true;
+
+    finishLazySweep();
+
+    // Outside of garbage collection every live node is marked, so the
+    // Marker stops as soon as it reaches an old node.  Unmarking the young
+    // nodes restricts the mark phase to them.
+    GCNodeAllocator::applyToYoungAllocations([](void* pointer) {
+        GCNode* node = static_cast<GCNode*>(pointer);
+        // Beware ~ promotes to unsigned int.
+        node->m_refcount_flags &= static_cast<unsigned char>(~s_mark_mask);
+        node->m_refcount_flags |= s_mark ^ s_mark_mask;
+    });
+
+    GCNode::Marker marker;
+    GCRootBase::visitRoots(&marker);
+    GCStackRootBase::visitRoots(&marker);
+    ProtectStack::visitRoots(&marker);
+
+    // Old nodes are treated as live, so anything they refer to is too.
+    GCNodeAllocator::applyToDirtyCards([&](void* pointer) {
+        GCNode* node = static_cast<GCNode*>(pointer);
+        if (!node->m_young) {
+            node->visitReferents(&marker);
+        }
+    });
+    for (const RememberedEdge& edge : *s_remembered_edges) {
+        GCNode* owner = GCNodeAllocator::lookupPointer(
+            const_cast<void*>(edge.first));
+        if (owner) {
+            if (!owner->m_young) {
+                owner->visitReferents(&marker);
+            }
+        } else if (GCNodeAllocator::lookupPointer(
+                       const_cast<GCNode*>(edge.second)) == edge.second) {
+            // The edge isn't part of a GCNode, so it may still refer to the
+            // target.  If it has since been freed, this merely retains the
+            // target until the next collection.
+            marker(edge.second);
+        }
+    }
+
+    WeakRef::markThru();
+    if (R_Srcref) {
+        marker(R_Srcref);
+    }
+
+    vector<GCNode*> to_delete;
+    GCNodeAllocator::applyToYoungAllocations([&](void* pointer) {
+        GCNode* node = static_cast<GCNode*>(pointer);
+        if (!node->isMarked()) {
+            sweepNode(node, &to_delete);
+        }
+    });
+    for (GCNode* node : to_delete) {
+        delete node;
+    }
+
+    promoteYoungNodes();
 
     s_on_stack_bits_correct = false;
 }
 
+void GCNode::promoteYoungNodes() {
+    GCNodeAllocator::applyToYoungAllocations([](void* pointer) {
+        static_cast<GCNode*>(pointer)->m_young = false;
+    });
+    GCNodeAllocator::clearNursery();
+    s_remembered_edges->clear();
+    s_remembered_edges_overflowed = false;
+}
+
+void GCNode::rememberEdge(const void* edge, const GCNode* target) {
+    // Edges on the stack are found by the conservative stack scan.
+    if (GCNodeAllocator::rememberEdge(edge)
+        || s_remembered_edges_overflowed
+        || GCStackRootBase::isOnStack(edge)) {
+        return;
+    }
+    if (s_remembered_edges->size() >= s_max_remembered_edges) {
+        // Scanning this many edges would cost about as much as a full
+        // collection, so the next collection will be a full one.
+        s_remembered_edges_overflowed = true;
+        s_remembered_edges->clear();
+        return;
+    }
+    s_remembered_edges->push_back(RememberedEdge(edge, target));
+}
+
+void GCNode::setGenerational(bool enable) {
+    if (!enable) {
+        promoteYoungNodes();
+    }
+    s_generational = enable;
+    GCNodeAllocator::enableNursery(enable);
+}
+
 void GCNode::gclite() {
     s_on_stack_bits_correct = true;
 
+    finishLazySweep();
+
     while (!s_moribund->empty()) {
         // Last in, first out, for cache efficiency:
         const GCNode* node = s_moribund->back();
@@ -173,6 +338,9 @@ void GCNode::gclite() {
 void GCNode::initialize() {
     GCNodeAllocator::initialize();
     s_moribund = new vector<const GCNode*>();
+    s_remembered_edges = new vector<RememberedEdge>();
+    s_lazy_sweep_to_delete = new vector<GCNode*>();
+    s_external_blocks = new map<uintptr_t, ExternalBlock>();
 }
 
 void GCNode::makeMoribund() const {
@@ -189,6 +357,130 @@ void GCNode::addToMoribundList() const {
     s_moribund->push_back(this);
 }
 
+class GCNode::ParallelMarker : public const_visitor {
+public:
+    explicit ParallelMarker(vector<const GCNode*>* stack)
+        : m_stack(stack)
+    {}
+
+    void operator()(const GCNode* node) override {
+        if (node->tryMark()) {
+            m_stack->push_back(node);
+        }
+    }
+private:
+    vector<const GCNode*>* m_stack;
+};
+
+bool GCNode::tryMark() const {
+    unsigned char old_flags;
+    if (s_mark) {
+        old_flags = __atomic_fetch_or(&m_refcount_flags, s_mark_mask,
+                                      __ATOMIC_RELAXED);
+    } else {
+        // Beware ~ promotes to unsigned int.
+        old_flags = __atomic_fetch_and(
+            &m_refcount_flags, static_cast<unsigned char>(~s_mark_mask),
+            __ATOMIC_RELAXED);
+    }
+    return (old_flags & s_mark_mask) != s_mark;
+}
+
+namespace {
+    // Work that a marking thread has made available to other threads.
+    struct SharedMarkStack {
+        std::mutex mutex;
+        vector<const GCNode*> nodes;
+    };
+
+    // Each marking thread keeps its own stack of nodes whose referents
+    // are still to be visited.  When that grows beyond this size, half of
+    // it is moved to the thread's shared stack, from which idle threads
+    // can steal.
+    const size_t s_mark_stack_share_size = 256;
+
+    // Move up to half of source (but at least one node) onto the end of
+    // dest.
+    void takeHalf(vector<const GCNode*>* source,
+                  vector<const GCNode*>* dest) {
+        size_t count = std::max<size_t>(1, source->size() / 2);
+        dest->insert(dest->end(), source->end() - count, source->end());
+        source->resize(source->size() - count);
+    }
+}
+
+void GCNode::markInParallel(vector<const GCNode*>* grey) {
+    unsigned num_threads = s_num_gc_threads;
+    std::unique_ptr<SharedMarkStack[]> shared(
+        new SharedMarkStack[num_threads]);
+    for (size_t i = 0; i < grey->size(); ++i) {
+        shared[i % num_threads].nodes.push_back((*grey)[i]);
+    }
+    grey->clear();
+
+    // Number of threads that have run out of work.  A thread only goes
+    // idle once its own shared stack is empty, and idle threads don't
+    // produce work, so once all threads are idle the marking is complete.
+    std::atomic<unsigned> num_idle(0);
+
+    std::atomic<size_t> num_saturated(0);
+
+    // Try to move work from the shared stacks (our own first) into local.
+    auto steal = [&](unsigned self, vector<const GCNode*>* local) {
+        for (unsigned i = 0; i < num_threads; ++i) {
+            SharedMarkStack& victim = shared[(self + i) % num_threads];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.nodes.empty()) {
+                takeHalf(&victim.nodes, local);
+                return true;
+            }
+        }
+        return false;
+    };
+
+    auto worker = [&](unsigned self) {
+        vector<const GCNode*> local;
+        ParallelMarker marker(&local);
+        size_t local_saturated = 0;
+        while (true) {
+            if (local.empty() && !steal(self, &local)) {
+                ++num_idle;
+                while (!steal(self, &local)) {
+                    if (num_idle == num_threads) {
+                        num_saturated += local_saturated;
+                        return;
+                    }
+                    std::this_thread::yield();
+                }
+                --num_idle;
+            }
+            const GCNode* node = local.back();
+            local.pop_back();
+            if (node->isRefCountSaturated()) {
+                ++local_saturated;
+            }
+            node->visitReferents(&marker);
+            if (local.size() > s_mark_stack_share_size) {
+                SharedMarkStack& mine = shared[self];
+                std::lock_guard<std::mutex> lock(mine.mutex);
+                if (mine.nodes.empty()) {
+                    takeHalf(&local, &mine.nodes);
+                }
+            }
+        }
+    };
+
+    vector<std::thread> helpers;
+    for (unsigned thread = 1; thread < num_threads; ++thread) {
+        helpers.emplace_back(worker, thread);
+    }
+    worker(0);
+    for (std::thread& helper : helpers) {
+        helper.join();
+    }
+    s_num_saturated += num_saturated;
+}
+
 void GCNode::mark() {
     // In the first mark-sweep collection, the marking of a node is
     // indicated by the mark bit being set; in the second mark sweep,
@@ -196,10 +488,21 @@ void GCNode::mark() {
     // alternation.  This avoids the need for the sweep phase to
     // iterate through the surviving nodes simply to remove marks.
     s_mark ^= s_mark_mask;
+    s_num_saturated = 0;
     GCNode::Marker marker;
-    GCRootBase::visitRoots(&marker);
-    GCStackRootBase::visitRoots(&marker);
-    ProtectStack::visitRoots(&marker);
+    if (s_num_gc_threads > 1) {
+        // Mark the roots here, and trace from them in parallel.
+        vector<const GCNode*> grey;
+        ParallelMarker root_marker(&grey);
+        GCRootBase::visitRoots(&root_marker);
+        GCStackRootBase::visitRoots(&root_marker);
+        ProtectStack::visitRoots(&root_marker);
+        markInParallel(&grey);
+    } else {
+        GCRootBase::visitRoots(&marker);
+        GCStackRootBase::visitRoots(&marker);
+        ProtectStack::visitRoots(&marker);
+    }
     WeakRef::markThru();
     if (R_Srcref) {
         marker(R_Srcref);
@@ -207,6 +510,14 @@ void GCNode::mark() {
 }
 
 void GCNode::sweep() {
+    if (s_lazy_sweep) {
+        GCNodeAllocator::beginLazySweep(lazySweepNode);
+        return;
+    }
+    if (s_num_gc_threads > 1) {
+        parallelSweep();
+        return;
+    }
     // Detach the referents of nodes that haven't been marked.
     // Once this is done, all of the nodes in the cycle will be unreferenced
     // and they will have been deleted unless their reference count is
@@ -216,25 +527,118 @@ void GCNode::sweep() {
         // The pointer is still allocated, so detach referents.
         GCNode* node = static_cast<GCNode*>(pointer);
         if (!node->isMarked()) {
+            sweepNode(node, &to_delete);
+        }
+    });
+    // At this point, the only unmarked objects are GCNodes with saturated
+    // reference counts.  Delete them.
+    for (GCNode* node : to_delete) {
+        delete node;
+    }
+}
+
+void GCNode::parallelSweep() {
+    // Find the unmarked nodes in parallel.  Nothing is freed during this
+    // pass, so the threads only read the allocator's bitsets and the
+    // nodes' mark bits.
+    unsigned num_threads = s_num_gc_threads;
+    vector<vector<GCNode*>> unmarked(num_threads);
+    GCNodeAllocator::applyToAllAllocationsInParallel(
+        [&](void* pointer, unsigned thread) {
+            GCNode* node = static_cast<GCNode*>(pointer);
+            if (!node->isMarked()) {
+                unmarked[thread].push_back(node);
+            }
+        }, num_threads);
+
+    // Unlike in sweep(), detaching the referents of one unmarked node must
+    // not free another, as the pointers to them have already been
+    // collected.  So every unmarked node is pinned by incrementing its
+    // reference count before any referents are detached.
+    vector<GCNode*> to_release;
+    vector<GCNode*> to_delete;
+    for (const vector<GCNode*>& nodes : unmarked) {
+        for (GCNode* node : nodes) {
             int ref_count = node->getRefCount();
             incRefCount(node);
             if (node->getRefCount() == ref_count) {
                 // The reference count has saturated.
-                node->detachReferents();
                 to_delete.push_back(node);
             } else {
-                node->detachReferents();
-                decRefCount(node);
+                to_release.push_back(node);
             }
         }
-    });
-    // At this point, the only unmarked objects are GCNodes with saturated
-    // reference counts.  Delete them.
+    }
+    for (const vector<GCNode*>& nodes : unmarked) {
+        for (GCNode* node : nodes) {
+            node->detachReferents();
+        }
+    }
+    for (GCNode* node : to_release) {
+        decRefCount(node);
+    }
     for (GCNode* node : to_delete) {
         delete node;
     }
 }
 
+void GCNode::lazySweepNode(void* pointer) {
+    GCNode* node = static_cast<GCNode*>(pointer);
+    // Nodes created since the mark phase are always marked.
+    if (node->isMarked()) {
+        return;
+    }
+    int ref_count = node->getRefCount();
+    incRefCount(node);
+    if (node->getRefCount() == ref_count) {
+        // The reference count has saturated.
+        node->detachReferents();
+        s_lazy_sweep_to_delete->push_back(node);
+        return;
+    }
+    node->detachReferents();
+    if (node->getRefCount() == 1
+        && !(node->m_refcount_flags & s_moribund_mask)) {
+        // Nothing else refers to the node, and being unreachable it
+        // can't be on the stack, so it can be deleted even if the stack
+        // bits are not up to date.
+        delete node;
+    } else {
+        decRefCount(node);
+    }
+}
+
+void GCNode::finishLazySweep() {
+    bool was_sweeping = GCNodeAllocator::lazySweepBacklog() > 0;
+    GCNodeAllocator::finishLazySweep();
+    for (GCNode* node : *s_lazy_sweep_to_delete) {
+        delete node;
+    }
+    s_lazy_sweep_to_delete->clear();
+    // A lazy sweep leaves nothing to release when the collection ends, so
+    // release once it is complete.
+    if (was_sweeping && GCNodeAllocator::releasesFreeMemory()) {
+        GCNodeAllocator::releaseFreeMemory();
+    }
+}
+
+size_t GCNode::sweepBacklog() {
+    return GCNodeAllocator::lazySweepBacklog();
+}
+
+void GCNode::sweepNode(GCNode* node, vector<GCNode*>* to_delete) {
+    int ref_count = node->getRefCount();
+    incRefCount(node);
+    if (node->getRefCount() == ref_count) {
+        // The reference count has saturated.
+        node->detachReferents();
+        to_delete->push_back(node);
+    } else {
+        node->detachReferents();
+        decRefCount(node);
+    }
+}
+
 void GCNode::Marker::operator()(const GCNode* node) {
     if (node->isMarked()) {
         return;
@@ -242,6 +646,9 @@ void GCNode::Marker::operator()(const GCNode* node) {
     // Update mark  Beware ~ promotes to unsigned int.
     node->m_refcount_flags &= static_cast<unsigned char>(~s_mark_mask);
     node->m_refcount_flags |= s_mark;
+    if (node->isRefCountSaturated()) {
+        ++s_num_saturated;
+    }
     node->visitReferents(this);
 }
 
@@ -269,13 +676,57 @@ void rho::initializeMemorySubsystem() {
 // Returns nullptr if the candidate pointer is not inside a GCNode,
 // otherwise returns the pointer to the enclosign GCNode.
 GCNode* GCNode::asGCNode(void* candidate_pointer) {
-    return GCNodeAllocator::lookupPointer(candidate_pointer);
+    GCNode* node = GCNodeAllocator::lookupPointer(candidate_pointer);
+    if (node)
+	return node;
+    uintptr_t address = reinterpret_cast<uintptr_t>(candidate_pointer);
+    if (address < s_external_min || address > s_external_max)
+	return nullptr;
+    // Find the last block starting at or before address.
+    auto block = s_external_blocks->upper_bound(address);
+    if (block == s_external_blocks->begin())
+	return nullptr;
+    --block;
+    if (address > block->second.end)
+	return nullptr;
+    return const_cast<GCNode*>(block->second.owner);
+}
+
+void GCNode::registerExternalBlock(const void* start, size_t bytes,
+				   const GCNode* owner)
+{
+    uintptr_t begin = reinterpret_cast<uintptr_t>(start);
+    uintptr_t end = begin + bytes;
+    (*s_external_blocks)[begin] = ExternalBlock{end, owner};
+    s_external_min = std::min(s_external_min, begin);
+    s_external_max = std::max(s_external_max, end);
+}
+
+void GCNode::unregisterExternalBlock(const void* start)
+{
+    s_external_blocks->erase(reinterpret_cast<uintptr_t>(start));
+    if (s_external_blocks->empty()) {
+	s_external_min = numeric_limits<uintptr_t>::max();
+	s_external_max = 0;
+    }
 }
 
 GCNode::InternalData GCNode::storeInternalData() const {
-    return m_refcount_flags;
+    InternalData data = { m_refcount_flags, m_young, 0 };
+    if (s_refcount_overflow && isRefCountFieldFull()) {
+        // The destructor removes the node from the overflow table.
+        auto overflow = s_refcount_overflow->find(this);
+        if (overflow != s_refcount_overflow->end()) {
+            data.refcount_overflow = overflow->second;
+        }
+    }
+    return data;
 }
 
 void GCNode::restoreInternalData(InternalData data) {
-    m_refcount_flags = data;
+    m_refcount_flags = data.refcount_flags;
+    m_young = data.young;
+    if (data.refcount_overflow) {
+        (*s_refcount_overflow)[this] = data.refcount_overflow;
+    }
 }
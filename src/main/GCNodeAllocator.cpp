@@ -27,11 +27,18 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "rho/AddressSanitizer.hpp"
 #include "rho/AllocationTable.hpp"
@@ -60,6 +67,29 @@ uintptr_t rho::GCNodeAllocator::s_heap_end = 0;
 // Free lists head pointers.
 rho::FreeListNode* rho::GCNodeAllocator::s_freelists[s_num_freelists];
 
+// The nursery: allocations made since the last garbage collection, tracked
+// only when the generational collector is enabled.
+bool rho::GCNodeAllocator::s_nursery_enabled = false;
+std::vector<rho::AllocatorSuperblock*>*
+rho::GCNodeAllocator::s_young_superblocks = nullptr;
+std::vector<void*>* rho::GCNodeAllocator::s_young_large = nullptr;
+std::unordered_map<void*, std::size_t>*
+rho::GCNodeAllocator::s_young_large_index = nullptr;
+
+// Superblocks still to be visited by the current lazy sweep, if any.
+std::vector<rho::AllocatorSuperblock*>* rho::GCNodeAllocator::s_unswept
+    = nullptr;
+std::size_t rho::GCNodeAllocator::s_unswept_count = 0;
+std::function<void(void*)>* rho::GCNodeAllocator::s_sweep_function = nullptr;
+
+// Thread caches, used only while the allocator is multithreaded.
+std::atomic<bool> rho::GCNodeAllocator::s_multithreaded(false);
+std::recursive_mutex* rho::GCNodeAllocator::s_mutex = nullptr;
+std::vector<rho::GCNodeAllocator::ThreadCache*>*
+rho::GCNodeAllocator::s_thread_caches = nullptr;
+
+bool rho::GCNodeAllocator::s_release_free_memory = false;
+
 #ifdef ALLOCATION_CHECK
 // Helper function for allocator consistency checking.
 // An additional allocation map is added which shadows the state of the
@@ -177,9 +207,27 @@ void rho::GCNodeAllocator::initialize() {
 
   // Use a 16 bit hash initially.
   s_alloctable = new rho::AllocationTable(16);
+
+  s_young_superblocks = new std::vector<AllocatorSuperblock*>();
+  s_young_large = new std::vector<void*>();
+  s_young_large_index = new std::unordered_map<void*, std::size_t>();
+
+  s_unswept = new std::vector<AllocatorSuperblock*>[
+      s_num_small_pools + s_num_medium_pools];
+  s_sweep_function = new std::function<void(void*)>();
+
+  s_mutex = new std::recursive_mutex();
+  s_thread_caches = new std::vector<ThreadCache*>();
 }
 
 void* rho::GCNodeAllocator::allocate(size_t bytes) {
+  if (s_multithreaded) {
+    return allocateMultiThreaded(bytes);
+  }
+  return allocateUnlocked(bytes);
+}
+
+void* rho::GCNodeAllocator::allocateUnlocked(size_t bytes) {
   void* result = nullptr;
 #ifdef HAVE_ADDRESS_SANITIZER
   // Increase size to include redzones.
@@ -198,6 +246,9 @@ void* rho::GCNodeAllocator::allocate(size_t bytes) {
     }
     actual_bytes = size_class * 8;
     result = removeFromFreelist(size_class);
+    if (!result && lazySweepSizeClass(size_class)) {
+      result = removeFromFreelist(size_class);
+    }
     if (!result) {
       result = AllocatorSuperblock::allocateBlock(actual_bytes);
       // If allocating in the small object arena fails, we continue
@@ -217,6 +268,10 @@ void* rho::GCNodeAllocator::allocate(size_t bytes) {
     actual_bytes = 1 << size_log2;
     unsigned size_class = AllocatorSuperblock::sizeClassFromSizeLog2(size_log2);
     result = removeFromFreelist(size_class);
+    if (!result && size_log2 < s_num_medium_pools
+        && lazySweepSizeClass(size_class)) {
+      result = removeFromFreelist(size_class);
+    }
     if (!result) {
       if (size_log2 < s_num_medium_pools) {
         result = AllocatorSuperblock::allocateLarge(size_log2);
@@ -227,6 +282,12 @@ void* rho::GCNodeAllocator::allocate(size_t bytes) {
       // Only update heap bounds if allocating a new block.
       updateHeapBounds(result, actual_bytes);
     }
+    if (s_nursery_enabled && size_log2 >= s_num_medium_pools) {
+      // Allocations in superblocks are tagged as young by the superblock,
+      // but this allocation has to be tracked separately.
+      (*s_young_large_index)[result] = s_young_large->size();
+      s_young_large->push_back(result);
+    }
   }
   if (!result) {
     allocerr("failed to allocate object");
@@ -258,6 +319,14 @@ void* rho::GCNodeAllocator::allocate(size_t bytes) {
 }
 
 void rho::GCNodeAllocator::free(void* pointer) {
+  if (s_multithreaded) {
+    freeMultiThreaded(pointer);
+  } else {
+    freeUnlocked(pointer);
+  }
+}
+
+void rho::GCNodeAllocator::freeUnlocked(void* pointer) {
 #ifdef HAVE_ADDRESS_SANITIZER
   // Adjust for redzone to find the true start of the allocation.
   pointer = offsetPointer(pointer, -s_redzone_size);
@@ -295,6 +364,13 @@ void rho::GCNodeAllocator::free(void* pointer) {
     } else if (allocation->asPointer() == pointer) {
       // Erase all entries in hashtable for the allocation.
       s_alloctable->erase(pointer_uint, allocation->sizeLog2());
+      if (!s_young_large_index->empty()) {
+        auto young = s_young_large_index->find(pointer);
+        if (young != s_young_large_index->end()) {
+          (*s_young_large)[young->second] = nullptr;
+          s_young_large_index->erase(young);
+        }
+      }
       // Add allocation to free list.
       addLargeAllocationToFreelist(pointer, allocation->sizeClass());
     } else {
@@ -303,8 +379,162 @@ void rho::GCNodeAllocator::free(void* pointer) {
   }
 }
 
+/**
+ * A cache of free small-object blocks for each size class, owned by a single
+ * thread.
+ *
+ * Cached blocks stay tagged as allocated in their superblock, so that
+ * handing one out or taking one back touches no shared state.  The shared
+ * state is only locked to refill an empty cache, or to flush half of a full
+ * one.
+ */
+class rho::GCNodeAllocator::ThreadCache {
+public:
+  ThreadCache() : m_owner(std::this_thread::get_id()), m_count() {
+    std::lock_guard<std::recursive_mutex> lock(*s_mutex);
+    s_thread_caches->push_back(this);
+  }
+
+  ~ThreadCache() {
+    std::lock_guard<std::recursive_mutex> lock(*s_mutex);
+    flush();
+    s_thread_caches->erase(std::find(s_thread_caches->begin(),
+                                     s_thread_caches->end(), this));
+  }
+
+  bool isOwnedByCallingThread() const {
+    return m_owner == std::this_thread::get_id();
+  }
+
+  /** Returns a block, or nullptr if the small object arena is exhausted. */
+  void* allocate(unsigned size_class) {
+    if (m_count[size_class] == 0) {
+      refill(size_class);
+      if (m_count[size_class] == 0) {
+        return nullptr;
+      }
+    }
+    return m_blocks[size_class][--m_count[size_class]];
+  }
+
+  void free(void* block, unsigned size_class) {
+    if (m_count[size_class] == s_capacity) {
+      std::lock_guard<std::recursive_mutex> lock(*s_mutex);
+      release(size_class, s_batch_size);
+    }
+    m_blocks[size_class][m_count[size_class]++] = block;
+  }
+
+  /** Returns all cached blocks.  The caller must hold s_mutex. */
+  void flush() {
+    for (unsigned size_class = 0; size_class < s_num_small_pools;
+         ++size_class) {
+      release(size_class, m_count[size_class]);
+    }
+  }
+
+private:
+  static constexpr unsigned s_capacity = 64;
+  static constexpr unsigned s_batch_size = s_capacity / 2;
+
+  std::thread::id m_owner;
+  void* m_blocks[s_num_small_pools][s_capacity];
+  unsigned m_count[s_num_small_pools];
+
+  void refill(unsigned size_class) {
+    std::lock_guard<std::recursive_mutex> lock(*s_mutex);
+    unsigned& count = m_count[size_class];
+    while (count < s_batch_size) {
+      void* block = removeFromFreelist(size_class);
+      if (!block) {
+        block = AllocatorSuperblock::allocateBlock(
+            bytesFromSizeClass(size_class));
+      }
+      if (!block) {
+        break;
+      }
+      m_blocks[size_class][count++] = block;
+    }
+  }
+
+  /** Returns the most recently cached blocks to their superblocks. */
+  void release(unsigned size_class, unsigned num_blocks) {
+    unsigned& count = m_count[size_class];
+    for (; num_blocks > 0; --num_blocks) {
+      void* block = m_blocks[size_class][--count];
+      AllocatorSuperblock::arenaSuperblockFromPointer(
+          reinterpret_cast<uintptr_t>(block))->freeBlock(block);
+    }
+  }
+};
+
+rho::GCNodeAllocator::ThreadCache* rho::GCNodeAllocator::threadCache() {
+  // Held by pointer to keep the thread-local storage small.
+  static thread_local std::unique_ptr<ThreadCache> cache;
+  if (!cache) {
+    cache.reset(new ThreadCache());
+  }
+  return cache.get();
+}
+
+void* rho::GCNodeAllocator::allocateMultiThreaded(size_t bytes) {
+  ThreadCache* cache = threadCache();
+#if !defined(HAVE_ADDRESS_SANITIZER) && !defined(ALLOCATION_CHECK)
+  // Redzones and the allocation check map are maintained by
+  // allocateUnlocked(), so those builds always take the lock.
+  if (bytes <= s_maximum_small_block_size) {
+    unsigned size_class = std::max<unsigned>((bytes + 7) / 8, 4);
+    void* result = cache->allocate(size_class);
+    if (result) {
+      return result;
+    }
+  }
+#endif
+  std::lock_guard<std::recursive_mutex> lock(*s_mutex);
+  return allocateUnlocked(bytes);
+}
+
+void rho::GCNodeAllocator::freeMultiThreaded(void* pointer) {
+  ThreadCache* cache = threadCache();
+#if !defined(HAVE_ADDRESS_SANITIZER) && !defined(ALLOCATION_CHECK)
+  AllocatorSuperblock* superblock =
+      AllocatorSuperblock::arenaSuperblockFromPointer(
+          reinterpret_cast<uintptr_t>(pointer));
+  if (superblock) {
+    cache->free(pointer, superblock->m_size_class);
+    return;
+  }
+#endif
+  std::lock_guard<std::recursive_mutex> lock(*s_mutex);
+  freeUnlocked(pointer);
+}
+
+void rho::GCNodeAllocator::setMultiThreaded(bool enable) {
+  if (!enable && s_thread_caches) {
+    std::lock_guard<std::recursive_mutex> lock(*s_mutex);
+    for (ThreadCache* cache : *s_thread_caches) {
+      // Another thread could be using its cache at any moment.
+      if (!cache->isOwnedByCallingThread()) {
+        allocerr("multithreading disabled while other threads are running");
+      }
+      cache->flush();
+    }
+  }
+  s_multithreaded = enable;
+}
+
+void rho::GCNodeAllocator::checkSingleThreaded() {
+  // Blocks held by other threads, or in thread caches, are tagged as
+  // allocated but aren't nodes, and other threads may change the
+  // allocations while they are walked.
+  if (s_multithreaded) {
+    allocerr("heap walked while the allocator is multithreaded");
+  }
+}
+
 void rho::GCNodeAllocator::applyToAllAllocations(
     std::function<void(void*)> fun) {
+  checkSingleThreaded();
 #ifdef HAVE_ADDRESS_SANITIZER
   // Create an intermediate lambda which adds redzone offsets.
   std::function<void(void*)> original = fun;
@@ -317,6 +547,159 @@ void rho::GCNodeAllocator::applyToAllAllocations(
   s_alloctable->applyToAllAllocations(fun);
 }
 
+void rho::GCNodeAllocator::applyToAllAllocationsInParallel(
+    std::function<void(void*, unsigned)> fun, unsigned num_threads) {
+  checkSingleThreaded();
+#ifdef HAVE_ADDRESS_SANITIZER
+  std::function<void(void*, unsigned)> original = fun;
+  fun = [=](void* pointer, unsigned thread) {
+    original(offsetPointer(pointer, s_redzone_size), thread);
+  };
+#endif
+  // Collect the units of work up front, so that the threads only need to
+  // share an index into them.
+  std::vector<AllocatorSuperblock*> superblocks;
+  std::vector<void*> large_allocations;
+  AllocatorSuperblock::applyToArenaSuperblocks(
+      [&](AllocatorSuperblock* superblock) {
+        superblocks.push_back(superblock);
+      });
+  s_alloctable->applyToAllSuperblocks(
+      [&](AllocatorSuperblock* superblock) {
+        superblocks.push_back(superblock);
+      },
+      [&](void* allocation) {
+        large_allocations.push_back(allocation);
+      });
+
+  size_t num_units = superblocks.size() + large_allocations.size();
+  std::atomic<size_t> next_unit(0);
+  auto worker = [&](unsigned thread) {
+    for (size_t unit = next_unit++; unit < num_units; unit = next_unit++) {
+      if (unit < superblocks.size()) {
+        superblocks[unit]->applyToBlocks([&](void* pointer) {
+            fun(pointer, thread);
+          });
+      } else {
+        fun(large_allocations[unit - superblocks.size()], thread);
+      }
+    }
+  };
+
+  std::vector<std::thread> helpers;
+  for (unsigned thread = 1; thread < num_threads; ++thread) {
+    helpers.emplace_back(worker, thread);
+  }
+  worker(0);
+  for (std::thread& helper : helpers) {
+    helper.join();
+  }
+}
+
+void rho::GCNodeAllocator::beginLazySweep(std::function<void(void*)> fun) {
+  checkSingleThreaded();
+  assert(s_unswept_count == 0 && "A lazy sweep is already in progress");
+#ifdef HAVE_ADDRESS_SANITIZER
+  std::function<void(void*)> original = fun;
+  fun = [=](void* pointer) {
+    original(offsetPointer(pointer, s_redzone_size));
+  };
+#endif
+  *s_sweep_function = fun;
+  auto enqueue = [](AllocatorSuperblock* superblock) {
+    s_unswept[superblock->m_size_class].push_back(superblock);
+    ++s_unswept_count;
+  };
+  AllocatorSuperblock::applyToArenaSuperblocks(enqueue);
+  // Large allocations are few, so they are swept straight away.
+  s_alloctable->applyToAllSuperblocks(enqueue, fun);
+}
+
+void rho::GCNodeAllocator::finishLazySweep() {
+  for (unsigned size_class = 0;
+       size_class < s_num_small_pools + s_num_medium_pools; ++size_class) {
+    std::vector<AllocatorSuperblock*>& unswept = s_unswept[size_class];
+    while (!unswept.empty()) {
+      AllocatorSuperblock* superblock = unswept.back();
+      unswept.pop_back();
+      --s_unswept_count;
+      superblock->applyToBlocks(*s_sweep_function);
+    }
+  }
+}
+
+bool rho::GCNodeAllocator::lazySweepSizeClass(unsigned size_class) {
+  if (s_multithreaded) {
+    // Sweeping deletes objects, which only the main thread may do.
+    return false;
+  }
+  std::vector<AllocatorSuperblock*>& unswept = s_unswept[size_class];
+  while (!unswept.empty()) {
+    AllocatorSuperblock* superblock = unswept.back();
+    unswept.pop_back();
+    --s_unswept_count;
+    superblock->applyToBlocks(*s_sweep_function);
+    if (s_freelists[size_class]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void rho::GCNodeAllocator::applyToYoungAllocations(
+    std::function<void(void*)> fun) {
+  checkSingleThreaded();
+#ifdef HAVE_ADDRESS_SANITIZER
+  std::function<void(void*)> original = fun;
+  fun = [=](void* pointer) {
+    original(offsetPointer(pointer, s_redzone_size));
+  };
+#endif
+  for (AllocatorSuperblock* superblock : *s_young_superblocks) {
+    superblock->applyToYoungBlocks(fun);
+  }
+  // Indexing is used because entries may be nulled during the iteration.
+  for (size_t i = 0; i < s_young_large->size(); ++i) {
+    void* allocation = (*s_young_large)[i];
+    if (allocation) {
+      fun(allocation);
+    }
+  }
+}
+
+void rho::GCNodeAllocator::applyToDirtyCards(
+    std::function<void(void*)> fun) {
+  checkSingleThreaded();
+#ifdef HAVE_ADDRESS_SANITIZER
+  std::function<void(void*)> original = fun;
+  fun = [=](void* pointer) {
+    original(offsetPointer(pointer, s_redzone_size));
+  };
+#endif
+  AllocatorSuperblock::applyToDirtyCards(fun);
+}
+
+void rho::GCNodeAllocator::clearNursery() {
+  for (AllocatorSuperblock* superblock : *s_young_superblocks) {
+    superblock->clearYoungBlocks();
+  }
+  s_young_superblocks->clear();
+  s_young_large->clear();
+  s_young_large_index->clear();
+  AllocatorSuperblock::clearCards();
+}
+
+void rho::GCNodeAllocator::enableNursery(bool enable) {
+  if (!enable) {
+    clearNursery();
+  }
+  s_nursery_enabled = enable;
+}
+
+bool rho::GCNodeAllocator::rememberEdge(const void* edge) {
+  return AllocatorSuperblock::markCard(reinterpret_cast<uintptr_t>(edge));
+}
+
 rho::GCNode* rho::GCNodeAllocator::lookupPointer(void* candidate) {
   uintptr_t candidate_uint = reinterpret_cast<uintptr_t>(candidate);
   void* result = AllocatorSuperblock::lookupAllocation(candidate_uint);
@@ -409,6 +792,103 @@ void rho::GCNodeAllocator::updateHeapBounds(void* pointer, size_t size) {
   }
 }
 
+void rho::GCNodeAllocator::setHugePages(bool enable) {
+  AllocatorSuperblock::setHugePages(enable);
+}
+
+size_t rho::GCNodeAllocator::releaseFreeMemory() {
+#ifdef HAVE_ADDRESS_SANITIZER
+  // Quarantined blocks are still linked through their superblocks.
+  return 0;
+#else
+  if (s_unswept_count > 0) {
+    // Unswept superblocks may look empty once swept, but not before.
+    return 0;
+  }
+  checkSingleThreaded();
+  std::vector<AllocatorSuperblock*> empty;
+  AllocatorSuperblock::applyToArenaSuperblocks(
+      [&](AllocatorSuperblock* superblock) {
+        if (superblock->isEmpty()) {
+          superblock->m_released = true;
+          empty.push_back(superblock);
+        }
+      });
+  if (empty.empty()) {
+    return 0;
+  }
+  // Unlink the blocks of the empty superblocks from the freelists before
+  // their memory goes away.
+  for (unsigned size_class = 0; size_class < s_num_small_pools;
+       ++size_class) {
+    FreeListNode** link = &s_freelists[size_class];
+    while (*link) {
+      if ((*link)->m_superblock->m_released) {
+        *link = (*link)->m_next;
+      } else {
+        link = &(*link)->m_next;
+      }
+    }
+  }
+  for (AllocatorSuperblock* superblock : empty) {
+    superblock->release();
+  }
+  return empty.size() * AllocatorSuperblock::s_small_superblock_size;
+#endif
+}
+
+void rho::GCNodeAllocator::applyToSuperblocks(
+    std::function<void(const SuperblockOccupancy&)> fun) {
+  checkSingleThreaded();
+  auto report = [&](AllocatorSuperblock* superblock, bool in_arena) {
+    SuperblockOccupancy occupancy;
+    occupancy.block_size = superblock->blockSize();
+    occupancy.num_blocks = superblock->numBlocks();
+    occupancy.num_allocated = superblock->numAllocatedBlocks();
+    occupancy.in_arena = in_arena;
+    fun(occupancy);
+  };
+  AllocatorSuperblock::applyToArenaSuperblocks(
+      [&](AllocatorSuperblock* superblock) {
+        if (!superblock->m_released) {
+          report(superblock, true);
+        }
+      });
+  s_alloctable->applyToAllSuperblocks(
+      [&](AllocatorSuperblock* superblock) {
+        report(superblock, false);
+      },
+      [](void*) {});
+}
+
+size_t rho::GCNodeAllocator::allocationSize(void* pointer) {
+  size_t size;
+#ifdef HAVE_ADDRESS_SANITIZER
+  pointer = offsetPointer(pointer, -s_redzone_size);
+#endif
+  uintptr_t pointer_uint = reinterpret_cast<uintptr_t>(pointer);
+  AllocatorSuperblock* superblock =
+      AllocatorSuperblock::arenaSuperblockFromPointer(pointer_uint);
+  if (superblock) {
+    size = superblock->blockSize();
+  } else {
+    AllocationTable::Allocation* allocation =
+        s_alloctable->search(pointer_uint);
+    if (!allocation) {
+      allocerr("failed to find size of unallocated pointer");
+    }
+    if (allocation->isSuperblock()) {
+      size = allocation->asSuperblock()->blockSize();
+    } else {
+      size = size_t{1} << allocation->sizeLog2();
+    }
+  }
+#ifdef HAVE_ADDRESS_SANITIZER
+  size -= 2 * s_redzone_size;
+#endif
+  return size;
+}
+
 void rho::GCNodeAllocator::printSummary() {
   AllocatorSuperblock::debugPrintSmallSuperblocks();
   s_alloctable->printSummary();
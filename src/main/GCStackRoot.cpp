@@ -73,6 +73,18 @@ void* GCStackRootBase::getStackBase()
     return reinterpret_cast<void*>(R_CStackStart);
 }
 
+bool GCStackRootBase::isOnStack(const void* p)
+{
+    char top;  // Marks the current top of the stack.
+    uintptr_t address = reinterpret_cast<uintptr_t>(p);
+    uintptr_t base = reinterpret_cast<uintptr_t>(getStackBase());
+#ifdef STACK_GROWS_UP
+    return address >= base && address < reinterpret_cast<uintptr_t>(&top);
+#else
+    return address <= base && address > reinterpret_cast<uintptr_t>(&top);
+#endif
+}
+
 NO_SANITIZE_ADDRESS 
 void GCStackRootBase::visitRoots(GCNode::const_visitor* visitor,
 				 const void* start_ptr,
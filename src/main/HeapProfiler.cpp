@@ -0,0 +1,133 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file HeapProfiler.cpp
+ *
+ * Implementation of class HeapProfiler.
+ */
+
+#include "rho/HeapProfiler.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include "rho/Evaluator.hpp"
+#include "rho/Expression.hpp"
+#include "rho/FunctionContext.hpp"
+#include "rho/GCNodeAllocator.hpp"
+#include "rho/GCRoot.hpp"
+#include "rho/RObject.hpp"
+
+using namespace std;
+using namespace rho;
+
+bool HeapProfiler::s_sampling = false;
+size_t HeapProfiler::s_sample_interval = 512 * 1024;
+ptrdiff_t HeapProfiler::s_bytes_until_sample = 0;
+
+namespace {
+    struct SiteRecord {
+	GCRoot<const Expression> call;
+	size_t samples;
+	size_t bytes;
+    };
+
+    // Created on first use, and never destroyed, so that the GCRoots
+    // outlive the garbage collector.
+    unordered_map<const Expression*, SiteRecord>* sites = nullptr;
+}
+
+HeapProfiler::Snapshot HeapProfiler::takeSnapshot()
+{
+    Snapshot snapshot;
+    GCNodeAllocator::applyToAllAllocations([&](void* pointer) {
+	    const GCNode* node = static_cast<GCNode*>(pointer);
+	    const RObject* object = dynamic_cast<const RObject*>(node);
+	    int type = object ? int(object->sexptype()) : -1;
+	    size_t bytes = GCNodeAllocator::allocationSize(pointer);
+	    Usage& type_usage = snapshot.by_type[type];
+	    ++type_usage.count;
+	    type_usage.bytes += bytes;
+	    SizeUsage& size_usage = snapshot.by_size[bytes];
+	    ++size_usage.count;
+	    size_usage.bytes += bytes;
+	});
+    GCNodeAllocator::applyToSuperblocks(
+	[&](const GCNodeAllocator::SuperblockOccupancy& occupancy) {
+	    SizeUsage& usage = snapshot.by_size[occupancy.block_size];
+	    ++usage.superblocks;
+	    usage.capacity += occupancy.num_blocks;
+	});
+    return snapshot;
+}
+
+void HeapProfiler::startSampling(size_t interval)
+{
+    if (!sites)
+	sites = new unordered_map<const Expression*, SiteRecord>();
+    s_sample_interval = interval;
+    s_bytes_until_sample = interval;
+    s_sampling = true;
+}
+
+void HeapProfiler::stopSampling()
+{
+    s_sampling = false;
+}
+
+void HeapProfiler::clearSamples()
+{
+    if (sites)
+	sites->clear();
+}
+
+vector<HeapProfiler::Site> HeapProfiler::sampledSites()
+{
+    vector<Site> result;
+    if (sites) {
+	for (const auto& entry : *sites) {
+	    const SiteRecord& record = entry.second;
+	    result.push_back(Site{record.call, record.samples, record.bytes});
+	}
+    }
+    sort(result.begin(), result.end(),
+	 [](const Site& a, const Site& b) { return a.bytes > b.bytes; });
+    return result;
+}
+
+void HeapProfiler::takeSample()
+{
+    // A large allocation may account for several samples.
+    size_t samples = 1 + size_t(-s_bytes_until_sample) / s_sample_interval;
+    s_bytes_until_sample += samples * s_sample_interval;
+
+    const Expression* call = nullptr;
+    if (Evaluator::current()) {
+	FunctionContext* context = FunctionContext::innermost();
+	if (context)
+	    call = context->call();
+    }
+    SiteRecord& record = (*sites)[call];
+    record.call = call;
+    record.samples += samples;
+    record.bytes += samples * s_sample_interval;
+}
@@ -48,6 +48,7 @@ const size_t MemoryBank::s_new_threshold = 193;
 
 size_t MemoryBank::s_blocks_allocated = 0;
 size_t MemoryBank::s_bytes_allocated = 0;
+size_t MemoryBank::s_bytes_mapped = 0;
 #ifdef R_MEMORY_PROFILING
 void (*MemoryBank::s_monitor)(size_t) = 0;
 size_t MemoryBank::s_monitor_threshold = numeric_limits<size_t>::max();
@@ -49,6 +49,8 @@ namespace rho {
     }
 }
 
+unsigned int Promise::s_forced_count = 0;
+
 void Promise::detachReferents()
 {
     m_value.detach();
@@ -70,6 +72,7 @@ RObject* Promise::evaluate(Environment* /*env*/)
 		       "recursive default argument reference "
 		       "or earlier problems?"));
 	m_under_evaluation = true;
+	++s_forced_count;
 	try {
 	    IncrementStackDepthScope scope;
 	    PlainContext cntxt;
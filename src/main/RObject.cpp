@@ -322,8 +322,7 @@ public:
 protected:
     virtual ~PaddedPairList() {}
 
-    void* m_unused_padding_1;
-    void* m_unused_padding_2;
+    char m_unused_padding[sizeof(CachingExpression) - sizeof(PairList)];
 };
 
 }  // anonymous namespace
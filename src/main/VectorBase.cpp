@@ -27,11 +27,29 @@
  * @brief Implementation of class VectorBase and related functions.
  */
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include "rho/VectorBase.hpp"
 
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "rho/IntVector.hpp"
 #include "rho/ListVector.hpp"
+#include "rho/MemoryBank.hpp"
 #include "rho/PairList.hpp"
+#include "rho/RawVector.hpp"
+#include "rho/RealVector.hpp"
 #include "rho/StringVector.hpp"
 #include "rho/Symbol.hpp"
 #include "rho/errors.hpp"
@@ -146,6 +164,55 @@ void VectorBase::tooBig(std::size_t bytes)
 		     dsize/1024.0);
     Rf_errorcall(nullptr, _("cannot allocate vector of size %0.1f Kb"), dsize);
 }
+
+void* VectorBase::mapFile(const char* path, std::size_t offset,
+			  std::size_t bytes,
+			  void** block, std::size_t* block_bytes)
+{
+#ifdef HAVE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+	Rf_error(_("cannot open file '%s': %s"), path, strerror(errno));
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+	int err = errno;
+	close(fd);
+	Rf_error(_("cannot open file '%s': %s"), path, strerror(err));
+    }
+    std::size_t file_size = info.st_size;
+    if (file_size < offset || file_size - offset < bytes) {
+	close(fd);
+	Rf_error(_("file '%s' is too short"), path);
+    }
+    // The mapping has to start on a page boundary.
+    std::size_t start = offset - offset % sysconf(_SC_PAGESIZE);
+    std::size_t length = bytes + (offset - start);
+    // Pages stay backed by the file until they are written to, so making
+    // the mapping writable costs nothing, and C code that writes through
+    // REAL() etc. gets a private copy rather than a crash.
+    void* mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE, fd, off_t(start));
+    int err = errno;
+    close(fd);
+    if (mapping == MAP_FAILED)
+	Rf_error(_("cannot map file '%s': %s"), path, strerror(err));
+    MemoryBank::s_bytes_mapped += length;
+    *block = mapping;
+    *block_bytes = length;
+    return static_cast<char*>(mapping) + (offset - start);
+#else
+    Rf_error(_("memory-mapped vectors are not supported on this platform"));
+    return nullptr;
+#endif
+}
+
+void VectorBase::unmapFile(void* block, std::size_t block_bytes)
+{
+#ifdef HAVE_MMAP
+    munmap(block, block_bytes);
+    MemoryBank::s_bytes_mapped -= block_bytes;
+#endif
+}
 		     
 // Rf_allocVector is still in memory.cpp (for the time being).
 
@@ -176,3 +243,44 @@ void SETLENGTH(SEXP x, R_xlen_t v)
 	Rf_error("SETLENGTH invoked for a non-vector.");
     vb->decreaseSizeInPlace(VectorBase::size_type(v));
 }
+
+// Called from .mapvector() in R.
+extern "C"
+SEXP mapvector(SEXP file, SEXP what, SEXP length, SEXP offset,
+	       SEXP copy_on_write)
+{
+    if (!Rf_isString(file) || Rf_length(file) != 1
+	|| STRING_ELT(file, 0) == NA_STRING)
+	Rf_error(_("invalid '%s' argument"), "file");
+    const char* path = Rf_translateChar(STRING_ELT(file, 0));
+    double n = Rf_asReal(length);
+    if (!R_FINITE(n) || n < 0 || n != std::floor(n)
+	|| n > double(std::numeric_limits<VectorBase::size_type>::max()))
+	Rf_error(_("invalid '%s' argument"), "n");
+    double start = Rf_asReal(offset);
+    if (!R_FINITE(start) || start < 0 || start != std::floor(start))
+	Rf_error(_("invalid '%s' argument"), "offset");
+    int writable = Rf_asLogical(copy_on_write);
+    if (writable == NA_LOGICAL)
+	Rf_error(_("invalid '%s' argument"), "copy.on.write");
+
+    const char* type = CHAR(STRING_ELT(what, 0));
+    VectorBase* ans;
+    if (strcmp(type, "double") == 0)
+	ans = RealVector::createMapped(path, std::size_t(start),
+				       VectorBase::size_type(n));
+    else if (strcmp(type, "integer") == 0)
+	ans = IntVector::createMapped(path, std::size_t(start),
+				      VectorBase::size_type(n));
+    else if (strcmp(type, "raw") == 0)
+	ans = RawVector::createMapped(path, std::size_t(start),
+				      VectorBase::size_type(n));
+    else
+	Rf_error(_("invalid '%s' argument"), "what");
+
+    // Unless copy.on.write is set, make R code copy the vector before
+    // modifying it, so that changes aren't shared with other references.
+    if (!writable)
+	SET_NAMED(ans, NAMEDMAX);
+    return ans;
+}
@@ -0,0 +1,613 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file VectorFusion.cpp
+ *
+ * Implementation of class VectorFusion.
+ */
+
+#define R_NO_REMAP
+#include "rho/VectorFusion.hpp"
+
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "Defn.h"
+#include "arithmetic.h"
+#include "localization.h"
+#include "rho/ArgList.hpp"
+#include "rho/BuiltInFunction.hpp"
+#include "rho/Evaluator.hpp"
+#include "rho/Expression.hpp"
+#include "rho/IntVector.hpp"
+#include "rho/LogicalVector.hpp"
+#include "rho/ProtectStack.hpp"
+#include "rho/RealVector.hpp"
+#include "rho/Symbol.hpp"
+#include "rho/VectorKernels.hpp"
+
+using namespace std;
+using namespace rho;
+
+const size_t VectorFusion::s_min_length;
+const size_t VectorFusion::s_block_size;
+
+namespace {
+    enum class Kind { VALUE, ARITHMETIC, COMPARISON, MATH1 };
+
+    // The type of the vector that a node's results would form.
+    enum class Type { LOGICAL, INTEGER, REAL, OTHER };
+
+    struct Operation {
+	Kind kind;
+	int arity;
+	const BuiltInFunction* primitive;
+	VectorKernels::Arithmetic arithmetic;
+	VectorKernels::Comparison comparison;
+	double (*math)(double);
+    };
+
+    typedef unordered_map<const Symbol*, Operation> OperationTable;
+
+    OperationTable* makeOperationTable()
+    {
+	using VectorKernels::Arithmetic;
+	using VectorKernels::Comparison;
+	static const struct {
+	    const char* name;
+	    Arithmetic op;
+	} arithmetic[] = {
+	    { "+", Arithmetic::PLUS }, { "-", Arithmetic::MINUS },
+	    { "*", Arithmetic::TIMES }, { "/", Arithmetic::DIVIDE }
+	};
+	static const struct {
+	    const char* name;
+	    Comparison op;
+	} comparisons[] = {
+	    { "==", Comparison::EQUAL }, { "!=", Comparison::NOT_EQUAL },
+	    { "<", Comparison::LESS }, { ">", Comparison::GREATER },
+	    { "<=", Comparison::LESS_EQUAL },
+	    { ">=", Comparison::GREATER_EQUAL }
+	};
+	static const char* const math1[] = {
+	    "floor", "ceiling", "sqrt", "sign", "exp", "expm1", "log1p",
+	    "cos", "sin", "tan", "acos", "asin", "atan",
+	    "cosh", "sinh", "tanh", "acosh", "asinh", "atanh",
+	    "lgamma", "gamma", "digamma", "trigamma",
+	    "cospi", "sinpi", "tanpi"
+	};
+
+	OperationTable* table = new OperationTable;
+	for (const auto& entry : arithmetic) {
+	    (*table)[Symbol::obtain(entry.name)] = Operation{
+		Kind::ARITHMETIC, 2,
+		BuiltInFunction::obtainPrimitive(entry.name),
+		entry.op, Comparison::EQUAL, nullptr };
+	}
+	for (const auto& entry : comparisons) {
+	    (*table)[Symbol::obtain(entry.name)] = Operation{
+		Kind::COMPARISON, 2,
+		BuiltInFunction::obtainPrimitive(entry.name),
+		Arithmetic::PLUS, entry.op, nullptr };
+	}
+	for (const char* name : math1) {
+	    const BuiltInFunction* primitive
+		= BuiltInFunction::obtainPrimitive(name);
+	    (*table)[Symbol::obtain(name)] = Operation{
+		Kind::MATH1, 1, primitive,
+		Arithmetic::PLUS, Comparison::EQUAL,
+		math1_function(primitive->variant()) };
+	}
+	return table;
+    }
+
+    const OperationTable& operations()
+    {
+	static const OperationTable* table = makeOperationTable();
+	return *table;
+    }
+
+    bool isCall(const RObject* expression)
+    {
+	return expression && expression->sexptype() == LANGSXP;
+    }
+
+    // If expression is a call to one of the fusible operations, with the
+    // right number of arguments, none of them named, missing or '...',
+    // returns the operation.  Otherwise returns null.
+    const Operation* fusibleCall(const RObject* expression)
+    {
+	if (!isCall(expression))
+	    return nullptr;
+	const Expression* call = static_cast<const Expression*>(expression);
+	const RObject* head = call->car();
+	if (!head || head->sexptype() != SYMSXP)
+	    return nullptr;
+	const OperationTable& table = operations();
+	auto found = table.find(static_cast<const Symbol*>(head));
+	if (found == table.end())
+	    return nullptr;
+	int num_args = 0;
+	for (const PairList* args = call->tail(); args; args = args->tail()) {
+	    const RObject* arg = args->car();
+	    if (args->tag() || arg == Symbol::missingArgument()
+		|| arg == DotsSymbol
+		|| (arg && arg->sexptype() == SYMSXP
+		    && static_cast<const Symbol*>(arg)->isDotDotSymbol()))
+		return nullptr;
+	    ++num_args;
+	}
+	if (num_args != found->second.arity)
+	    return nullptr;
+	return &found->second;
+    }
+
+    Type typeOf(const RObject* value)
+    {
+	if (!value || value->attributes())
+	    return Type::OTHER;
+	switch (value->sexptype()) {
+	case LGLSXP:
+	    return Type::LOGICAL;
+	case INTSXP:
+	    return Type::INTEGER;
+	case REALSXP:
+	    return Type::REAL;
+	default:
+	    return Type::OTHER;
+	}
+    }
+
+    // Reads elements of a numeric or logical vector as doubles.
+    template <class V, class Convert>
+    void loadElements(const RObject* value, size_t start, size_t n,
+		      double* out, Convert convert)
+    {
+	const V* vector = static_cast<const V*>(value);
+	for (size_t i = 0; i < n; ++i)
+	    out[i] = convert(vector->element(start + i));
+    }
+
+    double intToReal(int value)
+    {
+	return value == NA_INTEGER ? NA_REAL : value;
+    }
+
+    double logicalToReal(Logical value)
+    {
+	return double(value);
+    }
+
+    double identity(double value)
+    {
+	return value;
+    }
+}  // anonymous namespace
+
+// An operation in the tree being fused, or an operand that has been
+// evaluated.
+struct VectorFusion::Node {
+    Kind kind;
+    Type type;
+    size_t size;
+    RObject* value;  // For VALUE nodes.
+    const Expression* call;  // For the others.
+    const Operation* operation;
+    Node* lhs;
+    Node* rhs;  // Null for MATH1 nodes.
+    bool nan_produced;
+
+    // Working storage, set up by Evaluation::prepare().  Nodes of size
+    // one are evaluated once, into 'constant'.
+    double constant;
+    vector<double> buffer;
+    vector<int> logicals;
+
+    bool isFusible() const {
+	return type != Type::OTHER;
+    }
+};
+
+class VectorFusion::Evaluation {
+public:
+    explicit Evaluation(Environment* env)
+	: m_env(env), m_num_nodes(0)
+    {}
+
+    RObject* evaluateRoot(const Expression* call,
+			  const BuiltInFunction* function,
+			  const Operation* operation);
+private:
+    static const size_t s_num_local_nodes = 16;
+
+    Environment* m_env;
+    ProtectStack::Scope m_protect_scope;
+    Node m_local_nodes[s_num_local_nodes];
+    size_t m_num_nodes;
+    list<Node> m_more_nodes;
+
+    Node* newNode();
+    Node* valueNode(RObject* value);
+    Node* build(const RObject* expression);
+    Node* buildCall(const Expression* call, const BuiltInFunction* function,
+		    const Operation* operation);
+    Node* combine(const Expression* call, const Operation* operation,
+		  Node* lhs, Node* rhs);
+    PairList* evaluatedArgs(Node* lhs, Node* rhs);
+    RObject* materialize(Node* node);
+    RObject* run(Node* root);
+    void prepare(Node* node, size_t block_size);
+    const double* compute(Node* node, size_t start, size_t n,
+			  size_t* stride, double* out);
+    const double* load(Node* node, size_t start, size_t n);
+    void apply(Node* node, size_t start, size_t n, double* out);
+    void issueWarnings(const Node* node);
+};
+
+VectorFusion::Node* VectorFusion::Evaluation::newNode()
+{
+    Node* node;
+    if (m_num_nodes < s_num_local_nodes) {
+	node = &m_local_nodes[m_num_nodes++];
+    } else {
+	m_more_nodes.emplace_back();
+	node = &m_more_nodes.back();
+    }
+    node->lhs = node->rhs = nullptr;
+    node->value = nullptr;
+    node->call = nullptr;
+    node->operation = nullptr;
+    node->nan_produced = false;
+    return node;
+}
+
+VectorFusion::Node* VectorFusion::Evaluation::valueNode(RObject* value)
+{
+    ProtectStack::protect(value);
+    Node* node = newNode();
+    node->kind = Kind::VALUE;
+    node->value = value;
+    node->type = typeOf(value);
+    node->size = node->isFusible()
+	? static_cast<const VectorBase*>(value)->size() : 0;
+    return node;
+}
+
+VectorFusion::Node* VectorFusion::Evaluation::build(const RObject* expression)
+{
+    const Operation* operation = fusibleCall(expression);
+    if (operation) {
+	const Expression* call = static_cast<const Expression*>(expression);
+	if (functionOf(call, m_env) == operation->primitive)
+	    return buildCall(call, operation->primitive, operation);
+    }
+    return valueNode(Evaluator::evaluate(const_cast<RObject*>(expression),
+					 m_env));
+}
+
+VectorFusion::Node*
+VectorFusion::Evaluation::buildCall(const Expression* call,
+				    const BuiltInFunction* function,
+				    const Operation* operation)
+{
+    function->maybeTrace(call);
+    const PairList* args = call->tail();
+    Node* lhs = build(args->car());
+    Node* rhs = operation->arity == 2 ? build(args->tail()->car()) : nullptr;
+    Node* node = combine(call, operation, lhs, rhs);
+    if (node)
+	return node;
+
+    ArgList arglist(evaluatedArgs(lhs, rhs), ArgList::EVALUATED);
+    return valueNode(call->applyBuiltIn(function, m_env, &arglist));
+}
+
+// Returns the node for applying operation to lhs and rhs, or null if the
+// operation can't be fused.
+VectorFusion::Node*
+VectorFusion::Evaluation::combine(const Expression* call,
+				  const Operation* operation,
+				  Node* lhs, Node* rhs)
+{
+    if (!lhs->isFusible() || (rhs && !rhs->isFusible()))
+	return nullptr;
+    size_t size = lhs->size;
+    Type type = Type::REAL;
+    if (rhs) {
+	if (lhs->size == 1 && rhs->size > 0)
+	    size = rhs->size;
+	else if (rhs->size != lhs->size && !(rhs->size == 1 && lhs->size > 0))
+	    return nullptr;
+    }
+    switch (operation->kind) {
+    case Kind::ARITHMETIC:
+	// Integer and logical operands give an integer result, except
+	// for division.
+	if (operation->arithmetic != VectorKernels::Arithmetic::DIVIDE
+	    && lhs->type != Type::REAL && rhs->type != Type::REAL)
+	    return nullptr;
+	break;
+    case Kind::COMPARISON:
+	type = Type::LOGICAL;
+	break;
+    default:
+	break;
+    }
+
+    Node* node = newNode();
+    node->kind = operation->kind;
+    node->type = type;
+    node->size = size;
+    node->call = call;
+    node->operation = operation;
+    node->lhs = lhs;
+    node->rhs = rhs;
+    return node;
+}
+
+// Returns the values of lhs and rhs, as the arguments of a call.
+PairList* VectorFusion::Evaluation::evaluatedArgs(Node* lhs, Node* rhs)
+{
+    RObject* values[] = { materialize(lhs), rhs ? materialize(rhs) : nullptr };
+    return PairList::make(rhs ? 2 : 1, values);
+}
+
+RObject* VectorFusion::Evaluation::materialize(Node* node)
+{
+    if (node->kind == Kind::VALUE)
+	return node->value;
+    node->value = run(node);
+    ProtectStack::protect(node->value);
+    return node->value;
+}
+
+RObject* VectorFusion::Evaluation::evaluateRoot(
+    const Expression* call, const BuiltInFunction* function,
+    const Operation* operation)
+{
+    const PairList* args = call->tail();
+    Node* lhs = build(args->car());
+    Node* rhs = operation->arity == 2 ? build(args->tail()->car()) : nullptr;
+    Node* root = combine(call, operation, lhs, rhs);
+    bool any_fused = lhs->kind != Kind::VALUE
+	|| (rhs && rhs->kind != Kind::VALUE);
+    if (root && any_fused && root->size >= s_min_length) {
+	if (function->printHandling() == BuiltInFunction::SOFT_ON)
+	    Evaluator::enableResultPrinting(true);
+	return run(root);
+    }
+
+    ArgList arglist(evaluatedArgs(lhs, rhs), ArgList::EVALUATED);
+    return evaluateBuiltInCall(call, function, m_env, &arglist);
+}
+
+RObject* VectorFusion::Evaluation::run(Node* root)
+{
+    size_t size = root->size;
+    size_t block_size = std::min(size, s_block_size);
+    prepare(root, block_size);
+
+    RObject* result;
+    if (root->type == Type::LOGICAL) {
+	LogicalVector* logicals = LogicalVector::create(size);
+	Logical* out = logicals->begin();
+	for (size_t start = 0; start < size; start += block_size) {
+	    size_t n = std::min(block_size, size - start);
+	    size_t stride;
+	    const double* values = compute(root, start, n, &stride, nullptr);
+	    for (size_t i = 0; i < n; ++i) {
+		double value = values[i * stride];
+		out[start + i] = ISNAN(value) ? Logical::NA()
+		    : Logical(value != 0);
+	    }
+	}
+	result = logicals;
+    } else {
+	RealVector* reals = RealVector::create(size);
+	double* out = reals->begin();
+	for (size_t start = 0; start < size; start += block_size) {
+	    size_t n = std::min(block_size, size - start);
+	    size_t stride;
+	    const double* values = compute(root, start, n, &stride,
+					   out + start);
+	    if (values != out + start) {
+		for (size_t i = 0; i < n; ++i)
+		    out[start + i] = values[i * stride];
+	    }
+	}
+	result = reals;
+    }
+
+    ProtectStack::protect(result);
+    issueWarnings(root);
+    return result;
+}
+
+void VectorFusion::Evaluation::prepare(Node* node, size_t block_size)
+{
+    if (node->kind == Kind::VALUE) {
+	if (node->size == 1) {
+	    node->buffer.resize(1);
+	    node->constant = *load(node, 0, 1);
+	} else if (node->type != Type::REAL
+		   || static_cast<RealVector*>(node->value)->isCompact()) {
+	    node->buffer.resize(block_size);
+	}
+	return;
+    }
+
+    prepare(node->lhs, block_size);
+    if (node->rhs)
+	prepare(node->rhs, block_size);
+    size_t buffer_size = node->size == 1 ? 1 : block_size;
+    node->buffer.resize(buffer_size);
+    if (node->kind == Kind::COMPARISON)
+	node->logicals.resize(buffer_size);
+    if (node->size == 1)
+	apply(node, 0, 1, &node->constant);
+}
+
+// Computes elements [start, start + n) of node's value, and returns a
+// pointer to them.  If node has size one, the value is at the returned
+// pointer and *stride is set to zero; otherwise the elements are
+// contiguous and *stride is one.  Operations write to out if it is
+// non-null.
+const double* VectorFusion::Evaluation::compute(Node* node,
+						size_t start, size_t n,
+						size_t* stride, double* out)
+{
+    if (node->size == 1) {
+	*stride = 0;
+	return &node->constant;
+    }
+    *stride = 1;
+    if (node->kind == Kind::VALUE)
+	return load(node, start, n);
+    if (!out)
+	out = node->buffer.data();
+    apply(node, start, n, out);
+    return out;
+}
+
+const double* VectorFusion::Evaluation::load(Node* node,
+					     size_t start, size_t n)
+{
+    double* buffer = node->buffer.data();
+    switch (node->type) {
+    case Type::REAL:
+	{
+	    const RealVector* reals
+		= static_cast<const RealVector*>(node->value);
+	    if (!reals->isCompact())
+		return reals->begin() + start;
+	    loadElements<RealVector>(reals, start, n, buffer, identity);
+	}
+	break;
+    case Type::INTEGER:
+	loadElements<IntVector>(node->value, start, n, buffer, intToReal);
+	break;
+    case Type::LOGICAL:
+	loadElements<LogicalVector>(node->value, start, n, buffer,
+				    logicalToReal);
+	break;
+    case Type::OTHER:
+	break;
+    }
+    return buffer;
+}
+
+void VectorFusion::Evaluation::apply(Node* node, size_t start, size_t n,
+				     double* out)
+{
+    size_t lhs_stride, rhs_stride;
+    const double* lhs = compute(node->lhs, start, n, &lhs_stride, nullptr);
+    const Operation* operation = node->operation;
+    switch (node->kind) {
+    case Kind::ARITHMETIC:
+	{
+	    const double* rhs = compute(node->rhs, start, n, &rhs_stride,
+					nullptr);
+	    VectorKernels::realArithmetic(operation->arithmetic,
+					  lhs, lhs_stride, rhs, rhs_stride,
+					  out, n);
+	}
+	break;
+    case Kind::COMPARISON:
+	{
+	    const double* rhs = compute(node->rhs, start, n, &rhs_stride,
+					nullptr);
+	    int* logicals = node->logicals.data();
+	    VectorKernels::realComparison(operation->comparison,
+					  lhs, lhs_stride, rhs, rhs_stride,
+					  logicals, n);
+	    for (size_t i = 0; i < n; ++i)
+		out[i] = logicals[i] == NA_LOGICAL ? NA_REAL : logicals[i];
+	}
+	break;
+    case Kind::MATH1:
+	// As in math1(), NaNs in the input are passed through unchanged,
+	// and new NaNs give a warning.
+	for (size_t i = 0; i < n; ++i) {
+	    double x = lhs[i * lhs_stride];
+	    double y = operation->math(x);
+	    if (ISNAN(y)) {
+		if (ISNAN(x))
+		    y = x;
+		else
+		    node->nan_produced = true;
+	    }
+	    out[i] = y;
+	}
+	break;
+    case Kind::VALUE:
+	break;
+    }
+}
+
+void VectorFusion::Evaluation::issueWarnings(const Node* node)
+{
+    if (node->kind == Kind::VALUE)
+	return;
+    issueWarnings(node->lhs);
+    if (node->rhs)
+	issueWarnings(node->rhs);
+    if (node->nan_produced)
+	Rf_warningcall(const_cast<Expression*>(node->call),
+		       _("NaNs produced"));
+}
+
+RObject* VectorFusion::evaluate(const Expression* call,
+				const BuiltInFunction* function,
+				Environment* env)
+{
+    // Most calls can be rejected without a table lookup.
+    const PairList* args = call->tail();
+    if (!args || !(isCall(args->car())
+		   || (args->tail() && isCall(args->tail()->car()))))
+	return nullptr;
+
+    const Operation* operation = fusibleCall(call);
+    if (!operation || operation->primitive != function
+	|| !(fusibleCall(args->car())
+	     || (args->tail() && fusibleCall(args->tail()->car()))))
+	return nullptr;
+
+    Evaluation evaluation(env);
+    return evaluation.evaluateRoot(call, function, operation);
+}
+
+FunctionBase* VectorFusion::functionOf(const Expression* call,
+				       Environment* env)
+{
+    return call->getFunction(env);
+}
+
+RObject* VectorFusion::evaluateBuiltInCall(const Expression* call,
+					   const BuiltInFunction* function,
+					   Environment* env,
+					   ArgList* arglist)
+{
+    return call->evaluateBuiltInCall(function, env, arglist);
+}
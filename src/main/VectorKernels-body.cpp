@@ -0,0 +1,119 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/* The loops driving the vectorized kernels.  VectorKernels.cpp includes
+ * this file once for each instruction set, inside a namespace that
+ * provides the primitives (lanes(), load(), broadcast(), store(),
+ * apply(), compareLanes() and the overflow accumulator) for that set, and
+ * with that set enabled by '#pragma GCC target'.  The elements left over
+ * once the last complete group of lanes is done are handled by the
+ * generic kernels.
+ */
+
+// Calls function(i, lhs_lanes, rhs_lanes) for each complete group of
+// lanes, and returns the number of elements handled.
+template <class T, class Function>
+inline std::size_t forEachGroup(const T* lhs, std::size_t lhs_stride,
+				const T* rhs, std::size_t rhs_stride,
+				std::size_t n, Function function)
+{
+    const std::size_t width = lanes(lhs);
+    std::size_t i = 0;
+    if (lhs_stride && rhs_stride) {
+	for (; i + width <= n; i += width)
+	    function(i, load(lhs + i), load(rhs + i));
+    } else if (rhs_stride) {
+	auto lhs_lanes = broadcast(*lhs);
+	for (; i + width <= n; i += width)
+	    function(i, lhs_lanes, load(rhs + i));
+    } else if (lhs_stride) {
+	auto rhs_lanes = broadcast(*rhs);
+	for (; i + width <= n; i += width)
+	    function(i, load(lhs + i), rhs_lanes);
+    }
+    return i;
+}
+
+template <class Op>
+void realArithmetic(const double* lhs, std::size_t lhs_stride,
+		    const double* rhs, std::size_t rhs_stride,
+		    double* out, std::size_t n)
+{
+    std::size_t done = forEachGroup(
+	lhs, lhs_stride, rhs, rhs_stride, n,
+	[=](std::size_t i, Reals l, Reals r) {
+	    store(out + i, apply(Op(), l, r));
+	});
+    generic::realArithmetic<Op>(lhs + done * lhs_stride, lhs_stride,
+				rhs + done * rhs_stride, rhs_stride,
+				out + done, n - done);
+}
+
+template <class Op>
+bool intArithmetic(const int* lhs, std::size_t lhs_stride,
+		   const int* rhs, std::size_t rhs_stride,
+		   int* out, std::size_t n)
+{
+    Overflow overflow = noOverflow();
+    std::size_t done = forEachGroup(
+	lhs, lhs_stride, rhs, rhs_stride, n,
+	[&](std::size_t i, Ints l, Ints r) {
+	    store(out + i, apply(Op(), l, r, &overflow));
+	});
+    bool vector_overflow = anyOverflow(overflow);
+    bool tail_overflow
+	= generic::intArithmetic<Op>(lhs + done * lhs_stride, lhs_stride,
+				     rhs + done * rhs_stride, rhs_stride,
+				     out + done, n - done);
+    return vector_overflow || tail_overflow;
+}
+
+template <class Cmp>
+void realComparison(const double* lhs, std::size_t lhs_stride,
+		    const double* rhs, std::size_t rhs_stride,
+		    int* out, std::size_t n)
+{
+    std::size_t done = forEachGroup(
+	lhs, lhs_stride, rhs, rhs_stride, n,
+	[=](std::size_t i, Reals l, Reals r) {
+	    compareLanes<Cmp>(l, r, out + i);
+	});
+    generic::realComparison<Cmp>(lhs + done * lhs_stride, lhs_stride,
+				 rhs + done * rhs_stride, rhs_stride,
+				 out + done, n - done);
+}
+
+template <class Cmp>
+void intComparison(const int* lhs, std::size_t lhs_stride,
+		   const int* rhs, std::size_t rhs_stride,
+		   int* out, std::size_t n)
+{
+    std::size_t done = forEachGroup(
+	lhs, lhs_stride, rhs, rhs_stride, n,
+	[=](std::size_t i, Ints l, Ints r) {
+	    compareLanes<Cmp>(l, r, out + i);
+	});
+    generic::intComparison<Cmp>(lhs + done * lhs_stride, lhs_stride,
+				rhs + done * rhs_stride, rhs_stride,
+				out + done, n - done);
+}
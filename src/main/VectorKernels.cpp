@@ -0,0 +1,619 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file VectorKernels.cpp
+ *
+ * Implementation of the functions in namespace rho::VectorKernels.
+ */
+
+#include "rho/VectorKernels.hpp"
+
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+// The vectorized kernels rely on GCC's support for compiling functions
+// for an instruction set that the rest of the program doesn't assume.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define RHO_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace rho {
+namespace VectorKernels {
+
+namespace {
+
+// NA_INTEGER and NA_LOGICAL.
+const int NA = INT_MIN;
+
+// Results of integer arithmetic are computed exactly as doubles, and are
+// NA if they don't fit in an R integer.
+inline int checkRange(double result, bool* overflow)
+{
+    if (std::abs(result) > INT_MAX) {
+	*overflow = true;
+	return NA;
+    }
+    return int(result);
+}
+
+struct Plus {
+    static double real(double lhs, double rhs) { return lhs + rhs; }
+
+    static int integer(int lhs, int rhs, bool* overflow) {
+	if (lhs == NA || rhs == NA)
+	    return NA;
+	return checkRange(double(lhs) + double(rhs), overflow);
+    }
+};
+
+struct Minus {
+    static double real(double lhs, double rhs) { return lhs - rhs; }
+
+    static int integer(int lhs, int rhs, bool* overflow) {
+	if (lhs == NA || rhs == NA)
+	    return NA;
+	return checkRange(double(lhs) - double(rhs), overflow);
+    }
+};
+
+struct Times {
+    static double real(double lhs, double rhs) { return lhs * rhs; }
+
+    static int integer(int lhs, int rhs, bool* overflow) {
+	if (lhs == NA || rhs == NA)
+	    return NA;
+	return checkRange(double(lhs) * double(rhs), overflow);
+    }
+};
+
+struct Divide {
+    static double real(double lhs, double rhs) { return lhs / rhs; }
+};
+
+struct Equal {
+    template <class T> static bool test(T lhs, T rhs) { return lhs == rhs; }
+};
+
+struct NotEqual {
+    template <class T> static bool test(T lhs, T rhs) { return lhs != rhs; }
+};
+
+struct Less {
+    template <class T> static bool test(T lhs, T rhs) { return lhs < rhs; }
+};
+
+struct Greater {
+    template <class T> static bool test(T lhs, T rhs) { return lhs > rhs; }
+};
+
+struct LessEqual {
+    template <class T> static bool test(T lhs, T rhs) { return lhs <= rhs; }
+};
+
+struct GreaterEqual {
+    template <class T> static bool test(T lhs, T rhs) { return lhs >= rhs; }
+};
+
+template <class Cmp>
+inline int compare(double lhs, double rhs)
+{
+    if (std::isnan(lhs) || std::isnan(rhs))
+	return NA;
+    return Cmp::test(lhs, rhs);
+}
+
+template <class Cmp>
+inline int compare(int lhs, int rhs)
+{
+    if (lhs == NA || rhs == NA)
+	return NA;
+    return Cmp::test(lhs, rhs);
+}
+
+// Plain loops, for processors without vector instructions and for the
+// tails of the vectorized loops.
+namespace generic {
+
+template <class Op>
+void realArithmetic(const double* lhs, size_t lhs_stride,
+		    const double* rhs, size_t rhs_stride,
+		    double* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+	out[i] = Op::real(lhs[i * lhs_stride], rhs[i * rhs_stride]);
+}
+
+template <class Op>
+bool intArithmetic(const int* lhs, size_t lhs_stride,
+		   const int* rhs, size_t rhs_stride,
+		   int* out, size_t n)
+{
+    bool overflow = false;
+    for (size_t i = 0; i < n; ++i)
+	out[i] = Op::integer(lhs[i * lhs_stride], rhs[i * rhs_stride],
+			     &overflow);
+    return overflow;
+}
+
+template <class Cmp>
+void realComparison(const double* lhs, size_t lhs_stride,
+		    const double* rhs, size_t rhs_stride,
+		    int* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+	out[i] = compare<Cmp>(lhs[i * lhs_stride], rhs[i * rhs_stride]);
+}
+
+template <class Cmp>
+void intComparison(const int* lhs, size_t lhs_stride,
+		   const int* rhs, size_t rhs_stride,
+		   int* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+	out[i] = compare<Cmp>(lhs[i * lhs_stride], rhs[i * rhs_stride]);
+}
+
+}  // namespace generic
+
+#ifdef RHO_X86_KERNELS
+
+// How each comparison maps onto the x86 comparison instructions.  AVX2
+// only has integer instructions for == and >, so the other comparisons are
+// made from those by swapping the operands and negating the result.
+template <class Cmp> struct Predicate;
+
+template <> struct Predicate<Equal> {
+    static const int real = _CMP_EQ_OQ, integer = _MM_CMPINT_EQ;
+    static const bool equality = true, swap = false, negate = false;
+};
+
+template <> struct Predicate<NotEqual> {
+    static const int real = _CMP_NEQ_UQ, integer = _MM_CMPINT_NE;
+    static const bool equality = true, swap = false, negate = true;
+};
+
+template <> struct Predicate<Less> {
+    static const int real = _CMP_LT_OQ, integer = _MM_CMPINT_LT;
+    static const bool equality = false, swap = true, negate = false;
+};
+
+template <> struct Predicate<Greater> {
+    static const int real = _CMP_GT_OQ, integer = _MM_CMPINT_NLE;
+    static const bool equality = false, swap = false, negate = false;
+};
+
+template <> struct Predicate<LessEqual> {
+    static const int real = _CMP_LE_OQ, integer = _MM_CMPINT_LE;
+    static const bool equality = false, swap = false, negate = true;
+};
+
+template <> struct Predicate<GreaterEqual> {
+    static const int real = _CMP_GE_OQ, integer = _MM_CMPINT_NLT;
+    static const bool equality = false, swap = true, negate = true;
+};
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+namespace avx2 {
+
+typedef __m256d Reals;
+typedef __m256i Ints;
+// All ones in the lanes where an integer operation overflowed.
+typedef __m256i Overflow;
+
+inline size_t lanes(const double*) { return 4; }
+inline size_t lanes(const int*) { return 8; }
+
+inline Reals load(const double* p) { return _mm256_loadu_pd(p); }
+inline Ints load(const int* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+inline Reals broadcast(double value) { return _mm256_set1_pd(value); }
+inline Ints broadcast(int value) { return _mm256_set1_epi32(value); }
+
+inline void store(double* p, Reals value) { _mm256_storeu_pd(p, value); }
+inline void store(int* p, Ints value) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), value);
+}
+
+inline Overflow noOverflow() { return _mm256_setzero_si256(); }
+inline bool anyOverflow(Overflow overflow) {
+    return !_mm256_testz_si256(overflow, overflow);
+}
+
+inline Reals apply(Plus, Reals l, Reals r) { return _mm256_add_pd(l, r); }
+inline Reals apply(Minus, Reals l, Reals r) { return _mm256_sub_pd(l, r); }
+inline Reals apply(Times, Reals l, Reals r) { return _mm256_mul_pd(l, r); }
+inline Reals apply(Divide, Reals l, Reals r) { return _mm256_div_pd(l, r); }
+
+// Narrows the four 64-bit lanes of a comparison mask to 32 bits each.
+inline __m128i narrow(__m256d mask)
+{
+    __m256 halves = _mm256_castpd_ps(mask);
+    __m128 low = _mm256_castps256_ps128(halves);
+    __m128 high = _mm256_extractf128_ps(halves, 1);
+    return _mm_castps_si128(_mm_shuffle_ps(low, high,
+					   _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+// Makes the lanes NA where either operand is NA or where out_of_range is
+// set, and records the lanes that overflowed.
+inline Ints checkLanes(Ints l, Ints r, Ints result, Ints out_of_range,
+		       Overflow* overflow)
+{
+    const Ints na = _mm256_set1_epi32(NA);
+    Ints na_operand = _mm256_or_si256(_mm256_cmpeq_epi32(l, na),
+				      _mm256_cmpeq_epi32(r, na));
+    *overflow = _mm256_or_si256(*overflow,
+				_mm256_andnot_si256(na_operand, out_of_range));
+    return _mm256_blendv_epi8(result, na,
+			      _mm256_or_si256(na_operand, out_of_range));
+}
+
+// The wrapped result of an addition is out of range if its sign bit is
+// wrong, or if it is INT_MIN, which R uses for NA.
+inline Ints apply(Plus, Ints l, Ints r, Overflow* overflow)
+{
+    Ints sum = _mm256_add_epi32(l, r);
+    Ints wrong_sign = _mm256_and_si256(_mm256_xor_si256(l, sum),
+				       _mm256_xor_si256(r, sum));
+    Ints out_of_range
+	= _mm256_or_si256(_mm256_srai_epi32(wrong_sign, 31),
+			  _mm256_cmpeq_epi32(sum, _mm256_set1_epi32(NA)));
+    return checkLanes(l, r, sum, out_of_range, overflow);
+}
+
+inline Ints apply(Minus, Ints l, Ints r, Overflow* overflow)
+{
+    Ints difference = _mm256_sub_epi32(l, r);
+    Ints wrong_sign = _mm256_and_si256(_mm256_xor_si256(l, r),
+				       _mm256_xor_si256(l, difference));
+    Ints out_of_range
+	= _mm256_or_si256(_mm256_srai_epi32(wrong_sign, 31),
+			  _mm256_cmpeq_epi32(difference,
+					     _mm256_set1_epi32(NA)));
+    return checkLanes(l, r, difference, out_of_range, overflow);
+}
+
+// Products are formed as doubles, four lanes at a time, as in the scalar
+// code.
+inline Ints apply(Times, Ints l, Ints r, Overflow* overflow)
+{
+    const __m256d limit = _mm256_set1_pd(INT_MAX);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d low = _mm256_mul_pd(
+	_mm256_cvtepi32_pd(_mm256_castsi256_si128(l)),
+	_mm256_cvtepi32_pd(_mm256_castsi256_si128(r)));
+    __m256d high = _mm256_mul_pd(
+	_mm256_cvtepi32_pd(_mm256_extracti128_si256(l, 1)),
+	_mm256_cvtepi32_pd(_mm256_extracti128_si256(r, 1)));
+    __m128i low_big = narrow(_mm256_cmp_pd(_mm256_andnot_pd(sign, low),
+					   limit, _CMP_GT_OQ));
+    __m128i high_big = narrow(_mm256_cmp_pd(_mm256_andnot_pd(sign, high),
+					    limit, _CMP_GT_OQ));
+    Ints product = _mm256_inserti128_si256(
+	_mm256_castsi128_si256(_mm256_cvttpd_epi32(low)),
+	_mm256_cvttpd_epi32(high), 1);
+    Ints out_of_range = _mm256_inserti128_si256(
+	_mm256_castsi128_si256(low_big), high_big, 1);
+    return checkLanes(l, r, product, out_of_range, overflow);
+}
+
+template <class Cmp>
+inline void compareLanes(Reals l, Reals r, int* out)
+{
+    __m128i is_true = narrow(_mm256_cmp_pd(l, r, Predicate<Cmp>::real));
+    __m128i is_na = narrow(_mm256_cmp_pd(l, r, _CMP_UNORD_Q));
+    __m128i result = _mm_and_si128(is_true, _mm_set1_epi32(1));
+    result = _mm_blendv_epi8(result, _mm_set1_epi32(NA), is_na);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), result);
+}
+
+template <class Cmp>
+inline void compareLanes(Ints l, Ints r, int* out)
+{
+    typedef Predicate<Cmp> P;
+    const Ints na = _mm256_set1_epi32(NA);
+    Ints is_true;
+    if (P::equality)
+	is_true = _mm256_cmpeq_epi32(l, r);
+    else if (P::swap)
+	is_true = _mm256_cmpgt_epi32(r, l);
+    else
+	is_true = _mm256_cmpgt_epi32(l, r);
+    if (P::negate)
+	is_true = _mm256_xor_si256(is_true, _mm256_set1_epi32(-1));
+    Ints na_operand = _mm256_or_si256(_mm256_cmpeq_epi32(l, na),
+				      _mm256_cmpeq_epi32(r, na));
+    Ints result = _mm256_and_si256(is_true, _mm256_set1_epi32(1));
+    store(out, _mm256_blendv_epi8(result, na, na_operand));
+}
+
+#include "VectorKernels-body.cpp"
+
+}  // namespace avx2
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+
+namespace avx512f {
+
+typedef __m512d Reals;
+typedef __m512i Ints;
+// One bit for each lane where an integer operation overflowed.
+typedef __mmask16 Overflow;
+
+inline size_t lanes(const double*) { return 8; }
+inline size_t lanes(const int*) { return 16; }
+
+inline Reals load(const double* p) { return _mm512_loadu_pd(p); }
+inline Ints load(const int* p) { return _mm512_loadu_si512(p); }
+
+inline Reals broadcast(double value) { return _mm512_set1_pd(value); }
+inline Ints broadcast(int value) { return _mm512_set1_epi32(value); }
+
+inline void store(double* p, Reals value) { _mm512_storeu_pd(p, value); }
+inline void store(int* p, Ints value) { _mm512_storeu_si512(p, value); }
+
+inline Overflow noOverflow() { return 0; }
+inline bool anyOverflow(Overflow overflow) { return overflow != 0; }
+
+inline Reals apply(Plus, Reals l, Reals r) { return _mm512_add_pd(l, r); }
+inline Reals apply(Minus, Reals l, Reals r) { return _mm512_sub_pd(l, r); }
+inline Reals apply(Times, Reals l, Reals r) { return _mm512_mul_pd(l, r); }
+inline Reals apply(Divide, Reals l, Reals r) { return _mm512_div_pd(l, r); }
+
+inline __mmask16 naOperand(Ints l, Ints r)
+{
+    const Ints na = _mm512_set1_epi32(NA);
+    return _mm512_cmpeq_epi32_mask(l, na) | _mm512_cmpeq_epi32_mask(r, na);
+}
+
+// Makes the lanes NA where either operand is NA or where out_of_range is
+// set, and records the lanes that overflowed.
+inline Ints checkLanes(Ints l, Ints r, Ints result, __mmask16 out_of_range,
+		       Overflow* overflow)
+{
+    __mmask16 na_operand = naOperand(l, r);
+    *overflow |= out_of_range & ~na_operand;
+    return _mm512_mask_mov_epi32(result, na_operand | out_of_range,
+				 _mm512_set1_epi32(NA));
+}
+
+// The wrapped result of an addition is out of range if its sign bit is
+// wrong, or if it is INT_MIN, which R uses for NA.
+inline Ints apply(Plus, Ints l, Ints r, Overflow* overflow)
+{
+    Ints sum = _mm512_add_epi32(l, r);
+    Ints wrong_sign = _mm512_and_si512(_mm512_xor_si512(l, sum),
+				       _mm512_xor_si512(r, sum));
+    __mmask16 out_of_range
+	= _mm512_cmplt_epi32_mask(wrong_sign, _mm512_setzero_si512())
+	| _mm512_cmpeq_epi32_mask(sum, _mm512_set1_epi32(NA));
+    return checkLanes(l, r, sum, out_of_range, overflow);
+}
+
+inline Ints apply(Minus, Ints l, Ints r, Overflow* overflow)
+{
+    Ints difference = _mm512_sub_epi32(l, r);
+    Ints wrong_sign = _mm512_and_si512(_mm512_xor_si512(l, r),
+				       _mm512_xor_si512(l, difference));
+    __mmask16 out_of_range
+	= _mm512_cmplt_epi32_mask(wrong_sign, _mm512_setzero_si512())
+	| _mm512_cmpeq_epi32_mask(difference, _mm512_set1_epi32(NA));
+    return checkLanes(l, r, difference, out_of_range, overflow);
+}
+
+// Products are formed as doubles, eight lanes at a time, as in the scalar
+// code.
+inline Ints apply(Times, Ints l, Ints r, Overflow* overflow)
+{
+    const __m512d limit = _mm512_set1_pd(INT_MAX);
+    __m512d low = _mm512_mul_pd(
+	_mm512_cvtepi32_pd(_mm512_castsi512_si256(l)),
+	_mm512_cvtepi32_pd(_mm512_castsi512_si256(r)));
+    __m512d high = _mm512_mul_pd(
+	_mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(l, 1)),
+	_mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(r, 1)));
+    __mmask8 low_big
+	= _mm512_cmp_pd_mask(_mm512_abs_pd(low), limit, _CMP_GT_OQ);
+    __mmask8 high_big
+	= _mm512_cmp_pd_mask(_mm512_abs_pd(high), limit, _CMP_GT_OQ);
+    Ints product = _mm512_inserti64x4(
+	_mm512_castsi256_si512(_mm512_cvttpd_epi32(low)),
+	_mm512_cvttpd_epi32(high), 1);
+    __mmask16 out_of_range = __mmask16(low_big | (high_big << 8));
+    return checkLanes(l, r, product, out_of_range, overflow);
+}
+
+template <class Cmp>
+inline void compareLanes(Reals l, Reals r, int* out)
+{
+    __mmask8 is_true = _mm512_cmp_pd_mask(l, r, Predicate<Cmp>::real);
+    __mmask8 is_na = _mm512_cmp_pd_mask(l, r, _CMP_UNORD_Q);
+    __m512i result = _mm512_maskz_mov_epi64(is_true, _mm512_set1_epi64(1));
+    result = _mm512_mask_mov_epi64(result, is_na, _mm512_set1_epi64(NA));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+			_mm512_cvtepi64_epi32(result));
+}
+
+template <class Cmp>
+inline void compareLanes(Ints l, Ints r, int* out)
+{
+    __mmask16 is_true = _mm512_cmp_epi32_mask(l, r, Predicate<Cmp>::integer);
+    Ints result = _mm512_maskz_mov_epi32(is_true, _mm512_set1_epi32(1));
+    store(out, _mm512_mask_mov_epi32(result, naOperand(l, r),
+				     _mm512_set1_epi32(NA)));
+}
+
+#include "VectorKernels-body.cpp"
+
+}  // namespace avx512f
+
+#pragma GCC pop_options
+
+#endif  // RHO_X86_KERNELS
+
+typedef void (*RealArithmeticKernel)(const double*, size_t,
+				     const double*, size_t, double*, size_t);
+typedef bool (*IntArithmeticKernel)(const int*, size_t,
+				    const int*, size_t, int*, size_t);
+typedef void (*RealComparisonKernel)(const double*, size_t,
+				     const double*, size_t, int*, size_t);
+typedef void (*IntComparisonKernel)(const int*, size_t,
+				    const int*, size_t, int*, size_t);
+
+// The kernels for one instruction set, indexed by operation.
+struct Kernels {
+    const char* name;
+    RealArithmeticKernel real_arithmetic[4];
+    IntArithmeticKernel int_arithmetic[3];
+    RealComparisonKernel real_comparison[6];
+    IntComparisonKernel int_comparison[6];
+};
+
+#define KERNELS(ISA)							\
+    { #ISA,								\
+      { ISA::realArithmetic<Plus>, ISA::realArithmetic<Minus>,		\
+	ISA::realArithmetic<Times>, ISA::realArithmetic<Divide> },	\
+      { ISA::intArithmetic<Plus>, ISA::intArithmetic<Minus>,		\
+	ISA::intArithmetic<Times> },					\
+      { ISA::realComparison<Equal>, ISA::realComparison<NotEqual>,	\
+	ISA::realComparison<Less>, ISA::realComparison<Greater>,	\
+	ISA::realComparison<LessEqual>,					\
+	ISA::realComparison<GreaterEqual> },				\
+      { ISA::intComparison<Equal>, ISA::intComparison<NotEqual>,	\
+	ISA::intComparison<Less>, ISA::intComparison<Greater>,		\
+	ISA::intComparison<LessEqual>,					\
+	ISA::intComparison<GreaterEqual> } }
+
+const Kernels generic_kernels = KERNELS(generic);
+#ifdef RHO_X86_KERNELS
+const Kernels avx2_kernels = KERNELS(avx2);
+const Kernels avx512f_kernels = KERNELS(avx512f);
+#endif
+
+#undef KERNELS
+
+// In order of preference.
+const Kernels* const all_kernels[] = {
+#ifdef RHO_X86_KERNELS
+    &avx512f_kernels,
+    &avx2_kernels,
+#endif
+    &generic_kernels
+};
+
+bool isSupported(const Kernels* kernels)
+{
+#ifdef RHO_X86_KERNELS
+    __builtin_cpu_init();
+    if (kernels == &avx512f_kernels)
+	return __builtin_cpu_supports("avx512f");
+    if (kernels == &avx2_kernels)
+	return __builtin_cpu_supports("avx2");
+#endif
+    return true;
+}
+
+const Kernels* preferredKernels()
+{
+    for (const Kernels* kernels : all_kernels) {
+	if (isSupported(kernels))
+	    return kernels;
+    }
+    return &generic_kernels;
+}
+
+const Kernels*& currentKernels()
+{
+    static const Kernels* s_kernels = preferredKernels();
+    return s_kernels;
+}
+
+}  // anonymous namespace
+
+void realArithmetic(Arithmetic op,
+		    const double* lhs, size_t lhs_stride,
+		    const double* rhs, size_t rhs_stride,
+		    double* out, size_t n)
+{
+    currentKernels()->real_arithmetic[int(op)](lhs, lhs_stride,
+					       rhs, rhs_stride, out, n);
+}
+
+bool intArithmetic(Arithmetic op,
+		   const int* lhs, size_t lhs_stride,
+		   const int* rhs, size_t rhs_stride,
+		   int* out, size_t n)
+{
+    assert(op != Arithmetic::DIVIDE);
+    return currentKernels()->int_arithmetic[int(op)](lhs, lhs_stride,
+						     rhs, rhs_stride, out, n);
+}
+
+void realComparison(Comparison op,
+		    const double* lhs, size_t lhs_stride,
+		    const double* rhs, size_t rhs_stride,
+		    int* out, size_t n)
+{
+    currentKernels()->real_comparison[int(op)](lhs, lhs_stride,
+					       rhs, rhs_stride, out, n);
+}
+
+void intComparison(Comparison op,
+		   const int* lhs, size_t lhs_stride,
+		   const int* rhs, size_t rhs_stride,
+		   int* out, size_t n)
+{
+    currentKernels()->int_comparison[int(op)](lhs, lhs_stride,
+					      rhs, rhs_stride, out, n);
+}
+
+const char* instructionSet()
+{
+    return currentKernels()->name;
+}
+
+bool setInstructionSet(const char* name)
+{
+    for (const Kernels* kernels : all_kernels) {
+	if (strcmp(kernels->name, name) == 0 && isSupported(kernels)) {
+	    currentKernels() = kernels;
+	    return true;
+	}
+    }
+    return false;
+}
+
+}  // namespace VectorKernels
+}  // namespace rho
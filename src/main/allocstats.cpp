@@ -21,9 +21,26 @@
  *  https://www.R-project.org/Licenses/
  */
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <cstring>
+#include "Defn.h"
+#include "rho/Expression.hpp"
 #include "rho/IntVector.hpp"
 #include "rho/GCStackRoot.hpp"
+#include "rho/HeapProfiler.hpp"
+#include "rho/ListVector.hpp"
 #include "rho/MemoryBank.hpp"
+#include "rho/RealVector.hpp"
+#include "rho/StringVector.hpp"
+#ifdef ENABLE_LLVM_JIT
+#include "rho/Closure.hpp"
+#include "rho/GCRoot.hpp"
+#include "rho/jit/ClosureStatistics.hpp"
+#include "rho/jit/CompilationQueue.hpp"
+#endif
 
 using namespace rho;
 
@@ -61,3 +78,163 @@ SEXP allocstats(void) {
     return nullptr;
 #endif // ALLOC_STATS
 }
+
+// Returns the columns of a heap profile table, selected by 'what':
+// "types": 'type', 'count', 'bytes' for live nodes by type.
+// "sizes": 'size', 'count', 'bytes', 'superblocks', 'capacity' for live
+//     nodes by allocation size, with the superblocks holding that size.
+// "sites": 'call', 'samples', 'bytes' for sampled allocation sites.
+extern "C"
+SEXP heapsnapshot(SEXP what) {
+    const char* table = CHAR(STRING_ELT(what, 0));
+    GCStackRoot<ListVector> ans;
+    if (strcmp(table, "sites") == 0) {
+        std::vector<HeapProfiler::Site> sites = HeapProfiler::sampledSites();
+        size_t n = sites.size();
+        ans = ListVector::create(3);
+        GCStackRoot<ListVector> call_column(ListVector::create(n));
+        GCStackRoot<RealVector> samples_column(RealVector::create(n));
+        GCStackRoot<RealVector> bytes_column(RealVector::create(n));
+        for (size_t i = 0; i < n; ++i) {
+            (*call_column)[i] = const_cast<Expression*>(sites[i].call);
+            (*samples_column)[i] = sites[i].samples;
+            (*bytes_column)[i] = sites[i].bytes;
+        }
+        (*ans)[0] = call_column.get();
+        (*ans)[1] = samples_column.get();
+        (*ans)[2] = bytes_column.get();
+        return ans;
+    }
+
+    HeapProfiler::Snapshot snapshot = HeapProfiler::takeSnapshot();
+    if (strcmp(table, "types") == 0) {
+        size_t n = snapshot.by_type.size();
+        ans = ListVector::create(3);
+        GCStackRoot<StringVector> type_column(StringVector::create(n));
+        GCStackRoot<RealVector> count_column(RealVector::create(n));
+        GCStackRoot<RealVector> bytes_column(RealVector::create(n));
+        size_t i = 0;
+        for (const auto& entry : snapshot.by_type) {
+            const char* name = entry.first < 0 ? "(internal)"
+                : type2char(SEXPTYPE(entry.first));
+            (*type_column)[i] = String::obtain(name);
+            (*count_column)[i] = entry.second.count;
+            (*bytes_column)[i] = entry.second.bytes;
+            ++i;
+        }
+        (*ans)[0] = type_column.get();
+        (*ans)[1] = count_column.get();
+        (*ans)[2] = bytes_column.get();
+    } else if (strcmp(table, "sizes") == 0) {
+        size_t n = snapshot.by_size.size();
+        ans = ListVector::create(5);
+        GCStackRoot<RealVector> size_column(RealVector::create(n));
+        GCStackRoot<RealVector> count_column(RealVector::create(n));
+        GCStackRoot<RealVector> bytes_column(RealVector::create(n));
+        GCStackRoot<RealVector> superblocks_column(RealVector::create(n));
+        GCStackRoot<RealVector> capacity_column(RealVector::create(n));
+        size_t i = 0;
+        for (const auto& entry : snapshot.by_size) {
+            (*size_column)[i] = entry.first;
+            (*count_column)[i] = entry.second.count;
+            (*bytes_column)[i] = entry.second.bytes;
+            (*superblocks_column)[i] = entry.second.superblocks;
+            (*capacity_column)[i] = entry.second.capacity;
+            ++i;
+        }
+        (*ans)[0] = size_column.get();
+        (*ans)[1] = count_column.get();
+        (*ans)[2] = bytes_column.get();
+        (*ans)[3] = superblocks_column.get();
+        (*ans)[4] = capacity_column.get();
+    } else {
+        Rf_error(_("unknown heap profile table '%s'"), table);
+    }
+    return ans;
+}
+
+// Starts or stops sampling of allocation sites, or discards the samples
+// taken so far if 'enable' is NA.  Returns the previous sampling state.
+extern "C"
+SEXP heapsampling(SEXP enable, SEXP interval) {
+    bool was_sampling = HeapProfiler::isSampling();
+    int on = asLogical(enable);
+    if (on == NA_LOGICAL) {
+        HeapProfiler::clearSamples();
+    } else if (on) {
+        double bytes = asReal(interval);
+        if (!R_FINITE(bytes) || bytes < 1) {
+            Rf_error(_("invalid '%s' argument"), "interval");
+        }
+        HeapProfiler::startSampling(size_t(bytes));
+    } else {
+        HeapProfiler::stopSampling();
+    }
+    return ScalarLogical(was_sampling);
+}
+
+// Returns the memory held by JIT-compiled code as a named numeric vector:
+// the number of execution engines and compiled functions, and the bytes of
+// code and data.  All are zero if the JIT is not enabled.
+extern "C"
+SEXP jitmemstats(void) {
+    GCStackRoot<RealVector> ans(RealVector::create(4));
+    GCStackRoot<StringVector> names(StringVector::create(4));
+#ifdef ENABLE_LLVM_JIT
+    JIT::JITMemoryStatistics stats = JIT::CompilationQueue::memoryStatistics();
+    (*ans)[0] = stats.engines;
+    (*ans)[1] = stats.functions;
+    (*ans)[2] = stats.code_bytes;
+    (*ans)[3] = stats.data_bytes;
+#else
+    std::fill(ans->begin(), ans->end(), 0);
+#endif
+    (*names)[0] = String::obtain("engines");
+    (*names)[1] = String::obtain("functions");
+    (*names)[2] = String::obtain("code_bytes");
+    (*names)[3] = String::obtain("data_bytes");
+    ans->setAttribute(NamesSymbol, names);
+    return ans;
+}
+
+// Returns the JIT statistics of each closure that has been compiled, as a
+// list of columns: the closures, their counts of successful, optimized and
+// failed compilations, the seconds spent compiling, and their counts of
+// compiled calls, frame layout mismatches and inlined builtin guard
+// failures.  There are no rows if the JIT is not enabled.
+extern "C"
+SEXP jitstats(void) {
+    GCStackRoot<ListVector> ans(ListVector::create(8));
+#ifdef ENABLE_LLVM_JIT
+    std::vector<const JIT::ClosureStatistics*> stats
+        = JIT::ClosureStatistics::all();
+    // Keep the closures, and so their statistics, alive while the columns
+    // are allocated.
+    std::vector<GCRoot<Closure>> closures;
+    for (const JIT::ClosureStatistics* closure_stats : stats)
+        closures.emplace_back(const_cast<Closure*>(closure_stats->closure()));
+    size_t n = stats.size();
+#else
+    size_t n = 0;
+#endif
+    GCStackRoot<ListVector> closure_column(ListVector::create(n));
+    (*ans)[0] = closure_column.get();
+    GCStackRoot<RealVector> columns[7];
+    for (int j = 0; j < 7; ++j) {
+        columns[j] = RealVector::create(n);
+        (*ans)[j + 1] = columns[j].get();
+    }
+#ifdef ENABLE_LLVM_JIT
+    for (size_t i = 0; i < n; ++i) {
+        (*closure_column)[i] = closures[i].get();
+        (*columns[0])[i] = stats[i]->compilations;
+        (*columns[1])[i] = stats[i]->optimized_compilations;
+        (*columns[2])[i] = stats[i]->failed_compilations;
+        (*columns[3])[i] = stats[i]->compile_seconds;
+        (*columns[4])[i] = stats[i]->compiled_calls;
+        (*columns[5])[i] = stats[i]->frame_layout_mismatches;
+        (*columns[6])[i] = stats[i]->guard_failures;
+    }
+#endif
+    return ans;
+}
@@ -68,6 +68,7 @@
 #include "rho/RAllocStack.hpp"
 #include "rho/RealVector.hpp"
 #include "rho/UnaryFunction.hpp"
+#include "rho/VectorKernels.hpp"
 
 using namespace rho;
 using namespace VectorOps;
@@ -536,10 +537,59 @@ namespace {
 	    rhs = coerceVector(rhs, INTSXP);
 	}
 
-	return applyBinaryOperator(op,
-				   BinaryArithmeticAttributeCopier(),
-				   SEXP_downcast<IntVector*>(lhs),
-				   SEXP_downcast<IntVector*>(rhs));
+	typedef VectorOpReturnType<Op, IntVector, IntVector> OutputType;
+	IntVector* l = SEXP_downcast<IntVector*>(lhs);
+	IntVector* r = SEXP_downcast<IntVector*>(rhs);
+	return applyBinaryOperator(op, BinaryArithmeticAttributeCopier(),
+				   l, r, reusableOperand<OutputType>(l, r));
+    }
+
+    // The vectorized kernel for an arithmetic operator, if there is one.
+    bool arithmetic_kernel(ARITHOP_TYPE code, VectorKernels::Arithmetic* op)
+    {
+	switch (code) {
+	case PLUSOP:
+	    *op = VectorKernels::Arithmetic::PLUS;
+	    return true;
+	case MINUSOP:
+	    *op = VectorKernels::Arithmetic::MINUS;
+	    return true;
+	case TIMESOP:
+	    *op = VectorKernels::Arithmetic::TIMES;
+	    return true;
+	case DIVOP:
+	    *op = VectorKernels::Arithmetic::DIVIDE;
+	    return true;
+	default:
+	    return false;
+	}
+    }
+
+    bool use_kernel(SEXP lhs, SEXP rhs)
+    {
+	return VectorKernels::worthwhile(std::max(XLENGTH(lhs), XLENGTH(rhs)));
+    }
+
+    // Returns nullptr if there is no suitable kernel.
+    VectorBase* integer_binary_kernel(ARITHOP_TYPE code, SEXP lhs, SEXP rhs,
+				      Rboolean* naflag)
+    {
+	VectorKernels::Arithmetic op;
+	if (TYPEOF(lhs) != INTSXP || TYPEOF(rhs) != INTSXP
+	    || !use_kernel(lhs, rhs) || !arithmetic_kernel(code, &op)
+	    || op == VectorKernels::Arithmetic::DIVIDE)
+	    return nullptr;
+	IntVector* x = SEXP_downcast<IntVector*>(lhs);
+	IntVector* y = SEXP_downcast<IntVector*>(rhs);
+	return applyBinaryKernel<IntVector>(
+	    [=](const int* l, size_t l_stride, const int* r, size_t r_stride,
+		int* out, size_t n) {
+		if (VectorKernels::intArithmetic(op, l, l_stride, r, r_stride,
+						 out, n))
+		    *naflag = TRUE;
+	    },
+	    BinaryArithmeticAttributeCopier(), x, y,
+	    reusableOperand<IntVector>(x, y));
     }
 }  // anonymous namespace
 
@@ -548,44 +598,52 @@ namespace {
 static SEXP integer_binary(ARITHOP_TYPE code, SEXP s1, SEXP s2, SEXP lcall)
 {
     Rboolean naflag = FALSE;
-    VectorBase* ans = nullptr;
-
-    switch (code) {
-    case PLUSOP:
-	ans = apply_integer_binary(
-	    [&](int lhs, int rhs) { return integer_plus(lhs, rhs, &naflag); },
-	    s1, s2);
-	break;
-    case MINUSOP:
-	ans = apply_integer_binary(
-	    [&](int lhs, int rhs) { return integer_minus(lhs, rhs, &naflag); },
-	    s1, s2);
-	break;
-    case TIMESOP:
-	ans = apply_integer_binary(
-	    [&](int lhs, int rhs) { return integer_times(lhs, rhs, &naflag); },
-	    s1, s2);
-	break;
-    case DIVOP:
-	ans = apply_integer_binary(
-	    [](int lhs, int rhs) { return integer_divide(lhs, rhs); },
-	    s1, s2);
-	break;
-    case POWOP:
-	ans = apply_integer_binary(
-	    [](int lhs, int rhs) { return integer_pow(lhs, rhs); },
-	    s1, s2);
-	break;
-    case MODOP:
-	ans = apply_integer_binary(
-	    [](int lhs, int rhs) { return integer_mod(lhs, rhs); },
-	    s1, s2);
-	break;
-    case IDIVOP:
-	ans = apply_integer_binary(
-	    [](int lhs, int rhs) { return integer_idiv(lhs, rhs); },
-	    s1, s2);
-	break;
+    VectorBase* ans = integer_binary_kernel(code, s1, s2, &naflag);
+
+    if (!ans) {
+	switch (code) {
+	case PLUSOP:
+	    ans = apply_integer_binary(
+		[&](int lhs, int rhs) {
+		    return integer_plus(lhs, rhs, &naflag);
+		},
+		s1, s2);
+	    break;
+	case MINUSOP:
+	    ans = apply_integer_binary(
+		[&](int lhs, int rhs) {
+		    return integer_minus(lhs, rhs, &naflag);
+		},
+		s1, s2);
+	    break;
+	case TIMESOP:
+	    ans = apply_integer_binary(
+		[&](int lhs, int rhs) {
+		    return integer_times(lhs, rhs, &naflag);
+		},
+		s1, s2);
+	    break;
+	case DIVOP:
+	    ans = apply_integer_binary(
+		[](int lhs, int rhs) { return integer_divide(lhs, rhs); },
+		s1, s2);
+	    break;
+	case POWOP:
+	    ans = apply_integer_binary(
+		[](int lhs, int rhs) { return integer_pow(lhs, rhs); },
+		s1, s2);
+	    break;
+	case MODOP:
+	    ans = apply_integer_binary(
+		[](int lhs, int rhs) { return integer_mod(lhs, rhs); },
+		s1, s2);
+	    break;
+	case IDIVOP:
+	    ans = apply_integer_binary(
+		[](int lhs, int rhs) { return integer_idiv(lhs, rhs); },
+		s1, s2);
+	    break;
+	}
     }
     if (naflag)
 	warningcall(lcall, INTEGER_OVERFLOW_WARNING);
@@ -608,29 +666,48 @@ static RealVector* apply_real_binary(Op op, SEXP lhs, SEXP rhs)
     SEXPTYPE rhs_type = TYPEOF(rhs);
 
     if(lhs_type == REALSXP && rhs_type == REALSXP) {
+	RealVector* l = SEXP_downcast<RealVector*>(lhs);
+	RealVector* r = SEXP_downcast<RealVector*>(rhs);
 	return applyBinaryOperator(
 	    op,
 	    BinaryArithmeticAttributeCopier(),
-	    SEXP_downcast<RealVector*>(lhs),
-	    SEXP_downcast<RealVector*>(rhs));
+	    l, r, reusableOperand<RealVector>(l, r));
     } else if(lhs_type == INTSXP) {
+	IntVector* l = SEXP_downcast<IntVector*>(lhs);
+	RealVector* r = SEXP_downcast<RealVector*>(rhs);
 	return applyBinaryOperator(
 	    [=](int lhs, double rhs) { return op(intToReal(lhs), rhs); },
 	    BinaryArithmeticAttributeCopier(),
-	    SEXP_downcast<IntVector*>(lhs),
-	    SEXP_downcast<RealVector*>(rhs));
+	    l, r, reusableOperand<RealVector>(l, r));
     } else {
 	assert(rhs_type == INTSXP);
+	RealVector* l = SEXP_downcast<RealVector*>(lhs);
+	IntVector* r = SEXP_downcast<IntVector*>(rhs);
 	return applyBinaryOperator(
 	    [=](double lhs, int rhs) { return op(lhs, intToReal(rhs)); },
 	    BinaryArithmeticAttributeCopier(),
-	    SEXP_downcast<RealVector*>(lhs),
-	    SEXP_downcast<IntVector*>(rhs));
+	    l, r, reusableOperand<RealVector>(l, r));
     }
 }
 
 static SEXP real_binary(ARITHOP_TYPE code, SEXP s1, SEXP s2)
 {
+    VectorKernels::Arithmetic op;
+    if (TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP
+	&& use_kernel(s1, s2) && arithmetic_kernel(code, &op)) {
+	RealVector* x = SEXP_downcast<RealVector*>(s1);
+	RealVector* y = SEXP_downcast<RealVector*>(s2);
+	return applyBinaryKernel<RealVector>(
+	    [=](const double* lhs, size_t lhs_stride,
+		const double* rhs, size_t rhs_stride,
+		double* out, size_t n) {
+		VectorKernels::realArithmetic(op, lhs, lhs_stride,
+					      rhs, rhs_stride, out, n);
+	    },
+	    BinaryArithmeticAttributeCopier(), x, y,
+	    reusableOperand<RealVector>(x, y));
+    }
+
     switch (code) {
     case PLUSOP:
 	return apply_real_binary(
@@ -708,70 +785,74 @@ static SEXP math1(SEXP sa, double (*f)(double), SEXP lcall)
     GCStackRoot<RealVector>
 	rv(static_cast<RealVector*>(coerceVector(sa, REALSXP)));
     NaNWarner op(f);
-    RealVector* result = applyUnaryOperator(std::ref(op),
-					    CopyAllAttributes(),
-					    rv.get());
+    RealVector* result
+	= applyUnaryOperator(std::ref(op), CopyAllAttributes(), rv.get(),
+			     reusableOperand<RealVector>(rv.get()));
     op.warnings();
     return result;
 }
 
-SEXP attribute_hidden do_math1(SEXP call, SEXP op, SEXP args, SEXP env)
+double (*math1_function(int variant))(double)
 {
-    SEXP s;
-
-    BuiltInFunction* builtin = SEXP_downcast<BuiltInFunction*>(op);
-
-    if (isComplex(CAR(args)))
-	return complex_math1(call, op, args, env);
-
-#define MATH1(x) math1(CAR(args), x, call);
-    switch (builtin->variant()) {
-    case 1: return MATH1(floor);
-    case 2: return MATH1(ceil);
-    case 3: return MATH1(sqrt);
-    case 4: return MATH1(sign);
-	/* case 5: return MATH1(trunc); separate from 2.6.0 */
-
-    case 10: return MATH1(exp);
-    case 11: return MATH1(expm1);
-    case 12: return MATH1(log1p);
-    case 20: return MATH1(cos);
-    case 21: return MATH1(sin);
-    case 22: return MATH1(tan);
-    case 23: return MATH1(acos);
-    case 24: return MATH1(asin);
-    case 25: return MATH1(atan);
-
-    case 30: return MATH1(cosh);
-    case 31: return MATH1(sinh);
-    case 32: return MATH1(tanh);
-    case 33: return MATH1(acosh);
-    case 34: return MATH1(asinh);
-    case 35: return MATH1(atanh);
-
-    case 40: return MATH1(lgammafn);
-    case 41: return MATH1(gammafn);
-
-    case 42: return MATH1(digamma);
-    case 43: return MATH1(trigamma);
-	/* case 44: return MATH1(tetragamma);
-	   case 45: return MATH1(pentagamma);
+    switch (variant) {
+    case 1: return floor;
+    case 2: return ceil;
+    case 3: return sqrt;
+    case 4: return sign;
+	/* case 5: return trunc; separate from 2.6.0 */
+
+    case 10: return exp;
+    case 11: return expm1;
+    case 12: return log1p;
+    case 20: return cos;
+    case 21: return sin;
+    case 22: return tan;
+    case 23: return acos;
+    case 24: return asin;
+    case 25: return atan;
+
+    case 30: return cosh;
+    case 31: return sinh;
+    case 32: return tanh;
+    case 33: return acosh;
+    case 34: return asinh;
+    case 35: return atanh;
+
+    case 40: return lgammafn;
+    case 41: return gammafn;
+
+    case 42: return digamma;
+    case 43: return trigamma;
+	/* case 44: return tetragamma;
+	   case 45: return pentagamma;
 	   removed in 2.0.0
 
-	   case 46: return MATH1(Rf_gamma_cody); removed in 2.8.0
+	   case 46: return Rf_gamma_cody; removed in 2.8.0
 	*/
-    case 47: return MATH1(cospi);
-    case 48: return MATH1(sinpi);
+    case 47: return cospi;
+    case 48: return sinpi;
 #if defined(HAVE_TANPI) || defined(HAVE___TANPI)
-    case 49: return MATH1(Rtanpi);
+    case 49: return Rtanpi;
 #else
-    case 49: return MATH1(tanpi);
+    case 49: return tanpi;
 #endif
 
     default:
-	errorcall(call, _("unimplemented real function of 1 argument"));
+	return nullptr;
     }
-    return s; /* never used; to keep -Wall happy */
+}
+
+SEXP attribute_hidden do_math1(SEXP call, SEXP op, SEXP args, SEXP env)
+{
+    BuiltInFunction* builtin = SEXP_downcast<BuiltInFunction*>(op);
+
+    if (isComplex(CAR(args)))
+	return complex_math1(call, op, args, env);
+
+    double (*f)(double) = math1_function(builtin->variant());
+    if (!f)
+	errorcall(call, _("unimplemented real function of 1 argument"));
+    return math1(CAR(args), f, call);
 }
 
 /* methods are allowed to have more than one arg */
@@ -43,6 +43,10 @@ SEXP complex_binary(ARITHOP_TYPE, SEXP, SEXP);
 SEXP R_binary(SEXP, SEXP, SEXP, SEXP);
 SEXP R_unary(SEXP, SEXP, SEXP);
 
+/* The function of one argument that do_math1() applies for the given
+   variant, or NULL if there is none. */
+double (*math1_function(int variant))(double);
+
 double R_pow(double x, double y);
 static R_INLINE double R_POW(double x, double y) /* handle x ^ 2 inline */
 {
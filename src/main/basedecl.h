@@ -38,6 +38,13 @@ SEXP R_getTaskCallbackNames(void);
 SEXP R_removeTaskCallback(SEXP);
 SEXP R_addTaskCallback(SEXP, SEXP, SEXP, SEXP);
 SEXP allocstats(void);
+SEXP heapsnapshot(SEXP);
+SEXP heapsampling(SEXP, SEXP);
+SEXP jitmemstats(void);
+SEXP jitstats(void);
+SEXP mapvector(SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP argmatchcachestats(SEXP);
+SEXP searchpathcachestats(SEXP);
 
 
 #ifdef __cplusplus
@@ -142,6 +142,7 @@ void Frame::Binding::assign(RObject* new_value, Origin origin)
 	setActiveValue(m_value, new_value);
 	m_frame->monitorRead(*this);
     } else {
+	m_frame->valueChanging(m_value, new_value);
 	m_value = new_value;
 	m_frame->monitorWrite(*this);
     }
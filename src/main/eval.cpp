@@ -54,14 +54,18 @@
 #include "rho/DottedArgs.hpp"
 #include "rho/ExpressionVector.hpp"
 #include "rho/GCStackFrameBoundary.hpp"
+#include "rho/IntVector.hpp"
 #include "rho/ListFrame.hpp"
 #include "rho/LoopBailout.hpp"
 #include "rho/LoopException.hpp"
+#include "rho/PlainContext.hpp"
 #include "rho/Promise.hpp"
 #include "rho/ProvenanceTracker.hpp"
+#include "rho/RealVector.hpp"
 #include "rho/ReturnBailout.hpp"
 #include "rho/ReturnException.hpp"
 #include "rho/S3Launcher.hpp"
+#include "rho/jit/CompiledExpression.hpp"
 
 using namespace std;
 using namespace rho;
@@ -840,6 +844,44 @@ namespace {
 	return v;
     }
 
+    /* Interpreted loops that run for this many iterations are
+       compiled in the background.  Once the code is ready, which is
+       checked every osr_poll_back_edges iterations, the remaining
+       iterations run as compiled code (on-stack replacement). */
+    const unsigned int osr_back_edges = 10000;
+    const unsigned int osr_poll_back_edges = 1000;
+
+    inline bool atOsrCheckpoint(const Closure::BackEdgeCounter& back_edges)
+    {
+	unsigned int count = back_edges.count();
+	return count >= osr_back_edges
+	    && (count - osr_back_edges) % osr_poll_back_edges == 0;
+    }
+
+    /* Run the compiled code for the loop to completion in rho, if it
+       is ready.  If sequence is non-null, the loop is a for loop over
+       it that the interpreter has run up to iteration start.  Returns
+       false, having done nothing, if there is no code to run. */
+    bool runCompiledLoop(Expression* loop, Environment* rho,
+			 RObject* sequence = nullptr, int start = 0)
+    {
+#ifdef ENABLE_LLVM_JIT
+	GCStackRoot<JIT::CompiledExpression> compiled(
+	    JIT::CompiledExpression::enterLoop(loop, rho));
+	if (!compiled)
+	    return false;
+	// As in Closure::execute(), compiled code can't handle bailouts.
+	PlainContext context;
+	if (sequence)
+	    compiled->resumeForLoop(rho, sequence, start);
+	else
+	    compiled->evalInEnvironment(rho);
+	return true;
+#else
+	return false;
+#endif
+    }
+
     RObject* propagateBailout(RObject* bailout)
     {
 	Evaluator::Context* callctxt
@@ -944,8 +986,15 @@ SEXP attribute_hidden do_for_impl(SEXP call, SEXP op, SEXP args, SEXP rho)
 
     Environment* env = SEXP_downcast<Environment*>(rho);
     Environment::LoopScope loopscope(env);
+    Closure::BackEdgeCounter back_edges;
     for (i = 0; i < n; i++) {
+	// The compiled loop carries on from element i.  Pairlists have
+	// been partly consumed by now.
+	if (atOsrCheckpoint(back_edges) && !dbg && val_type != LISTSXP
+	    && runCompiledLoop(SEXP_downcast<Expression*>(call), env, val, i))
+	    break;
 	Evaluator::maybeCheckForUserInterrupts();
+	back_edges.increment();
 	DO_LOOP_RDEBUG(call, op, args, rho, bgn);
 
 	switch (val_type) {
@@ -980,11 +1029,14 @@ SEXP attribute_hidden do_for_impl(SEXP call, SEXP op, SEXP args, SEXP rho)
                     break;
                 case INTSXP:
                     v = ALLOC_LOOP_VAR(v, val_type);
-                    INTEGER(v)[0] = INTEGER(val)[i];
+                    // element() doesn't expand compact sequences.
+                    INTEGER(v)[0]
+                        = static_cast<IntVector*>(val.get())->element(i);
                     break;
                 case REALSXP:
                     v = ALLOC_LOOP_VAR(v, val_type);
-                    REAL(v)[0] = REAL(val)[i];
+                    REAL(v)[0]
+                        = static_cast<RealVector*>(val.get())->element(i);
                     break;
                 case CPLXSXP:
                     v = ALLOC_LOOP_VAR(v, val_type);
@@ -1060,9 +1112,18 @@ static SEXP do_while_impl(SEXP call, SEXP op, SEXP args, SEXP rho)
 
     Environment* env = SEXP_downcast<Environment*>(rho);
     Environment::LoopScope loopscope(env);
+    Closure::BackEdgeCounter back_edges;
 
-    while (asLogicalNoNA(Rf_eval(CAR(args), rho), call)) {
+    for (;;) {
+	// The compiled loop starts by testing the condition, so the
+	// switch has to happen before the interpreter tests it.
+	if (atOsrCheckpoint(back_edges) && !dbg
+	    && runCompiledLoop(SEXP_downcast<Expression*>(call), env))
+	    break;
+	if (!asLogicalNoNA(Rf_eval(CAR(args), rho), call))
+	    break;
 	Evaluator::maybeCheckForUserInterrupts();
+	back_edges.increment();
 	RObject* ans;
 	DO_LOOP_RDEBUG(call, op, args, rho, bgn);
 	try {
@@ -1122,8 +1183,13 @@ static SEXP do_repeat_impl(SEXP call, SEXP op, SEXP args, SEXP rho)
 
     Environment* env = SEXP_downcast<Environment*>(rho);
     Environment::LoopScope loopscope(env);
+    Closure::BackEdgeCounter back_edges;
     for (;;) {
+	if (atOsrCheckpoint(back_edges) && !dbg
+	    && runCompiledLoop(SEXP_downcast<Expression*>(call), env))
+	    break;
 	Evaluator::maybeCheckForUserInterrupts();
+	back_edges.increment();
 	RObject* ans;
 	DO_LOOP_RDEBUG(call, op, args, rho, bgn);
 	try {
@@ -0,0 +1,67 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+
+#include "rho/jit/ClosureStatistics.hpp"
+
+#include <set>
+
+namespace rho {
+namespace JIT {
+
+namespace {
+    // Created on first use and never destroyed, as statistics may be
+    // destroyed during exit.
+    std::set<ClosureStatistics*>& registry()
+    {
+	static std::set<ClosureStatistics*>* statistics
+	    = new std::set<ClosureStatistics*>;
+	return *statistics;
+    }
+}  // anonymous namespace
+
+ClosureStatistics::ClosureStatistics(const Closure* closure)
+    : compilations(0), optimized_compilations(0), failed_compilations(0),
+      compile_seconds(0), compiled_calls(0), frame_layout_mismatches(0),
+      guard_failures(0), m_closure(closure)
+{
+    registry().insert(this);
+}
+
+ClosureStatistics::~ClosureStatistics()
+{
+    registry().erase(this);
+}
+
+std::vector<const ClosureStatistics*> ClosureStatistics::all()
+{
+    std::vector<const ClosureStatistics*> result;
+    for (const ClosureStatistics* statistics : registry()) {
+	if (statistics->closure())
+	    result.push_back(statistics);
+    }
+    return result;
+}
+
+} // namespace JIT
+} // namespace rho
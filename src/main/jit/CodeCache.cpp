@@ -0,0 +1,169 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+#include "rho/jit/llvm.hpp"
+
+#define R_NO_REMAP
+#include "rho/jit/CodeCache.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+
+#include "rho/jit/OptimizationOptions.hpp"
+#include "llvm/Support/raw_ostream.h"
+
+namespace rho {
+namespace JIT {
+
+static const std::string module_prefix = "rho.";
+
+CodeCache::CodeCache(const std::string& directory)
+    : m_directory(directory), m_hits(0), m_stores(0)
+{ }
+
+CodeCache*& CodeCache::instance()
+{
+    static CodeCache* cache = []() -> CodeCache* {
+	const char* directory = getenv("R_JIT_CACHE_DIR");
+	if (!directory || !*directory)
+	    return nullptr;
+	return new CodeCache(directory);
+    }();
+    return cache;
+}
+
+CodeCache* CodeCache::get()
+{
+    return instance();
+}
+
+void CodeCache::setDirectory(const std::string& directory)
+{
+    CodeCache*& cache = instance();
+    // Engines only use the cache while compiling, so the old one can go.
+    delete cache;
+    cache = directory.empty() ? nullptr : new CodeCache(directory);
+}
+
+// 64-bit FNV-1a, which (unlike std::hash) gives the same result in every
+// build.
+static std::uint64_t hashString(const std::string& text)
+{
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : text) {
+	hash ^= c;
+	hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string CodeCache::moduleKey(const llvm::Module* module,
+				 const OptimizationOptions& options,
+				 unsigned optimization_level)
+{
+    std::string text;
+    llvm::raw_string_ostream stream(text);
+    module->print(stream, nullptr);
+    stream << "\n; target " << llvm::sys::getProcessTriple()
+	   << "\n; llvm " << LLVM_VERSION
+	   << "\n; optimize " << optimization_level
+	   << "\n; options " << options.AssumeSaneControlFlowOperators
+	   << options.AssumeSaneAssignmentOperators << "\n";
+    stream.flush();
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx",
+	     static_cast<unsigned long long>(hashString(text)));
+    return module_prefix + key;
+}
+
+std::string CodeCache::getFilename(const llvm::Module* module) const
+{
+    const std::string& identifier = module->getModuleIdentifier();
+    if (identifier.compare(0, module_prefix.size(), module_prefix) != 0)
+	return "";
+    return m_directory + "/" + identifier + ".o";
+}
+
+void CodeCache::writeObject(const llvm::Module* module,
+			    const char* data, std::size_t size)
+{
+    std::string filename = getFilename(module);
+    if (filename.empty())
+	return;
+    // Many processes may share the cache, so write to a temporary file and
+    // rename it into place.  Failures just mean the code isn't cached.
+    std::string temporary = filename + "." + std::to_string(getpid());
+    {
+	std::ofstream file(temporary, std::ios::binary);
+	file.write(data, size);
+	if (!file)
+	    return;
+    }
+    if (std::rename(temporary.c_str(), filename.c_str()) != 0)
+	std::remove(temporary.c_str());
+    else
+	++m_stores;
+}
+
+#if (LLVM_VERSION < 306)
+void CodeCache::notifyObjectCompiled(const llvm::Module* module,
+				     const llvm::MemoryBuffer* object)
+{
+    writeObject(module, object->getBufferStart(), object->getBufferSize());
+}
+
+llvm::MemoryBuffer* CodeCache::getObject(const llvm::Module* module)
+#else
+void CodeCache::notifyObjectCompiled(const llvm::Module* module,
+				     llvm::MemoryBufferRef object)
+{
+    writeObject(module, object.getBufferStart(), object.getBufferSize());
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+CodeCache::getObject(const llvm::Module* module)
+#endif
+{
+    std::string filename = getFilename(module);
+    if (filename.empty())
+	return nullptr;
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+	return nullptr;
+    std::string contents((std::istreambuf_iterator<char>(file)),
+			 std::istreambuf_iterator<char>());
+    ++m_hits;
+#if (LLVM_VERSION < 306)
+    return llvm::MemoryBuffer::getMemBufferCopy(contents, filename);
+#else
+    return std::unique_ptr<llvm::MemoryBuffer>(
+	llvm::MemoryBuffer::getMemBufferCopy(contents, filename));
+#endif
+}
+
+} // namespace JIT
+} // namespace rho
@@ -0,0 +1,373 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+#include "rho/jit/llvm.hpp"
+
+#define R_NO_REMAP
+#include "rho/jit/CompilationQueue.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <set>
+#include <thread>
+
+#include "rho/jit/CodeCache.hpp"
+#include "rho/jit/MCJITMemoryManager.hpp"
+#include "rho/jit/Optimization.hpp"
+
+namespace rho {
+namespace JIT {
+
+namespace {
+    std::atomic<std::size_t> num_engines(0);
+    std::atomic<std::size_t> num_functions(0);
+}  // anonymous namespace
+
+/*
+ * An ExecutionEngine shared by the jobs of a batch.  It owns the modules
+ * and (through its memory manager) the generated code.
+ */
+class CodeBatch {
+public:
+    CodeBatch(std::unique_ptr<llvm::ExecutionEngine> engine,
+	      std::size_t functions)
+	: m_engine(std::move(engine)), m_functions(functions)
+    {
+	++num_engines;
+	num_functions += functions;
+    }
+
+    // The engine and modules belong to the shared LLVMContext, so the
+    // caller must hold the LLVM lock.  Batches are only released by the
+    // background thread or by runBatch().
+    ~CodeBatch()
+    {
+	m_engine.reset();
+	--num_engines;
+	num_functions -= m_functions;
+    }
+
+    llvm::ExecutionEngine* engine() {
+	return m_engine.get();
+    }
+private:
+    std::unique_ptr<llvm::ExecutionEngine> m_engine;
+    std::size_t m_functions;
+
+    CodeBatch(const CodeBatch&) = delete;
+    CodeBatch& operator=(const CodeBatch&) = delete;
+};
+
+CompilationJob::CompilationJob(
+    std::unique_ptr<llvm::Module> module,
+    std::unique_ptr<MCJITMemoryManager> memory_manager,
+    const std::string& function_name,
+    unsigned optimization_level)
+    : m_module(std::move(module)),
+      m_memory_manager(std::move(memory_manager)),
+      m_function_name(function_name),
+      m_optimization_level(optimization_level),
+      m_function(nullptr), m_seconds(0), m_finished(false)
+{ }
+
+CompilationJob::~CompilationJob()
+{
+    // Jobs are usually destroyed by the garbage collector.  Rather than
+    // waiting for the background thread to finish a batch, leave it to free
+    // the LLVM objects.
+    if (m_module || m_memory_manager || m_code)
+	CompilationQueue::retire(std::move(m_module),
+				 std::move(m_memory_manager),
+				 std::move(m_code));
+}
+
+void CompilationJob::runBatch(
+    const std::vector<std::shared_ptr<CompilationJob>>& jobs)
+{
+    CompilationJob* first = jobs.front().get();
+    auto start = std::chrono::steady_clock::now();
+    try {
+	// The first job's memory manager serves the whole batch, so it needs
+	// to know the objects that all the modules refer to.
+	unsigned level = first->m_optimization_level;
+	for (const auto& job : jobs) {
+	    assert(job->m_optimization_level == level);
+	    if (job.get() != first)
+		first->m_memory_manager->addMappings(*job->m_memory_manager);
+	    runStandardPasses(job->m_module.get(), level);
+	}
+
+	llvm::TargetOptions options;
+	// Baseline code is compiled quickly.  Optimized code is only
+	// generated for functions that have proven to be hot.
+	options.EnableFastISel = level == 0;
+	static const llvm::CodeGenOpt::Level codegen_levels[] = {
+	    llvm::CodeGenOpt::None, llvm::CodeGenOpt::Less,
+	    llvm::CodeGenOpt::Default, llvm::CodeGenOpt::Aggressive
+	};
+
+	std::unique_ptr<llvm::ExecutionEngine> engine(
+#if (LLVM_VERSION < 306)
+	    llvm::EngineBuilder(first->m_module.release())
+	    .setMCJITMemoryManager(first->m_memory_manager.release())
+	    .setUseMCJIT(true)
+#else
+	    llvm::EngineBuilder(std::move(first->m_module))
+	    .setMCJITMemoryManager(std::move(first->m_memory_manager))
+#endif
+	    .setOptLevel(codegen_levels[level])
+	    .setTargetOptions(options)
+	    .create());
+	if (engine) {
+	    if (CodeCache* cache = CodeCache::get())
+		engine->setObjectCache(cache);
+	    for (const auto& job : jobs) {
+		if (job.get() == first)
+		    continue;
+#if (LLVM_VERSION < 306)
+		engine->addModule(job->m_module.release());
+#else
+		engine->addModule(std::move(job->m_module));
+#endif
+	    }
+	    engine->finalizeObject();
+	    auto code = std::make_shared<CodeBatch>(std::move(engine),
+						    jobs.size());
+	    for (const auto& job : jobs) {
+		job->m_function = reinterpret_cast<FunctionPointer>(
+		    code->engine()->getFunctionAddress(job->m_function_name));
+		job->m_code = code;
+	    }
+	}
+    } catch (...) {
+	// Compilation failed.  The interpreter will carry on without it.
+	for (const auto& job : jobs) {
+	    job->m_function = nullptr;
+	    job->m_code.reset();
+	}
+    }
+    std::chrono::duration<double> elapsed
+	= std::chrono::steady_clock::now() - start;
+    for (const auto& job : jobs) {
+	job->m_seconds = elapsed.count() / jobs.size();
+	job->m_finished.store(true, std::memory_order_release);
+    }
+}
+
+namespace {
+    struct QueueState {
+	std::mutex mutex;
+	std::condition_variable work_available;
+	std::condition_variable idle;
+	std::deque<std::shared_ptr<CompilationJob>> jobs;
+	std::size_t jobs_in_progress = 0;
+	bool worker_started = false;
+    };
+
+    // Created on first use and never destroyed, as the (detached) worker
+    // thread may still be using it during exit.
+    QueueState& queueState()
+    {
+	static QueueState* state = new QueueState;
+	return *state;
+    }
+
+    // The LLVM objects of a destroyed job, waiting for the background
+    // thread to free them.
+    struct RetiredJob {
+	std::unique_ptr<llvm::Module> module;
+	std::unique_ptr<MCJITMemoryManager> memory_manager;
+	std::shared_ptr<CodeBatch> code;
+	RetiredJob* next;
+    };
+
+    // A lock-free stack, so that retiring a job never waits for the
+    // background thread.
+    std::atomic<RetiredJob*> retired_jobs(nullptr);
+    // Retired jobs that haven't been freed yet.
+    std::atomic<std::size_t> num_retired(0);
+
+    // Frees the retired jobs, returning how many there were.
+    std::size_t freeRetiredJobs()
+    {
+	RetiredJob* job = retired_jobs.exchange(nullptr,
+						std::memory_order_acquire);
+	if (!job)
+	    return 0;
+	std::size_t count = 0;
+	std::lock_guard<std::recursive_mutex> lock(
+	    CompilationQueue::llvmMutex());
+	while (job) {
+	    RetiredJob* next = job->next;
+	    delete job;
+	    job = next;
+	    ++count;
+	}
+	return count;
+    }
+
+    bool isIdle(const QueueState& state)
+    {
+	return state.jobs.empty() && state.jobs_in_progress == 0
+	    && num_retired == 0;
+    }
+}  // anonymous namespace
+
+std::recursive_mutex& CompilationQueue::llvmMutex()
+{
+    static std::recursive_mutex* mutex = new std::recursive_mutex;
+    return *mutex;
+}
+
+void CompilationQueue::enqueue(std::shared_ptr<CompilationJob> job)
+{
+    QueueState& state = queueState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.jobs.push_back(std::move(job));
+    startWorker();
+    state.work_available.notify_one();
+}
+
+void CompilationQueue::retire(
+    std::unique_ptr<llvm::Module> module,
+    std::unique_ptr<MCJITMemoryManager> memory_manager,
+    std::shared_ptr<CodeBatch> code)
+{
+    RetiredJob* job = new RetiredJob{std::move(module),
+				     std::move(memory_manager),
+				     std::move(code), nullptr};
+    ++num_retired;
+    RetiredJob* head = retired_jobs.load(std::memory_order_relaxed);
+    do {
+	job->next = head;
+    } while (!retired_jobs.compare_exchange_weak(head, job,
+						 std::memory_order_release,
+						 std::memory_order_relaxed));
+    if (head)
+	return;  // The background thread has already been woken.
+
+    // The queue's lock is never held for long, and taking it here means
+    // that the wakeup can't be missed.
+    QueueState& state = queueState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    startWorker();
+    state.work_available.notify_one();
+}
+
+void CompilationQueue::startWorker()
+{
+    QueueState& state = queueState();
+    if (!state.worker_started) {
+	std::thread(serviceQueue).detach();
+	state.worker_started = true;
+    }
+}
+
+std::size_t CompilationQueue::pendingJobs()
+{
+    QueueState& state = queueState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.jobs.size() + state.jobs_in_progress;
+}
+
+void CompilationQueue::waitUntilIdle()
+{
+    QueueState& state = queueState();
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.idle.wait(lock, [&]() {
+	    return isIdle(state);
+	});
+}
+
+JITMemoryStatistics CompilationQueue::memoryStatistics()
+{
+    JITMemoryStatistics statistics;
+    statistics.engines = num_engines;
+    statistics.functions = num_functions;
+    statistics.code_bytes = MCJITMemoryManager::totalCodeBytes();
+    statistics.data_bytes = MCJITMemoryManager::totalDataBytes();
+    return statistics;
+}
+
+void CompilationQueue::serviceQueue()
+{
+    QueueState& state = queueState();
+    while (true) {
+	{
+	    std::unique_lock<std::mutex> lock(state.mutex);
+	    state.work_available.wait(lock, [&]() {
+		    return !state.jobs.empty()
+			|| retired_jobs.load(std::memory_order_relaxed);
+		});
+	}
+	if (std::size_t freed = freeRetiredJobs()) {
+	    std::lock_guard<std::mutex> lock(state.mutex);
+	    num_retired -= freed;
+	    if (isIdle(state))
+		state.idle.notify_all();
+	}
+	{
+	    std::lock_guard<std::mutex> lock(state.mutex);
+	    if (state.jobs.empty())
+		continue;
+	}
+	// Jobs queued while the interpreter holds the LLVM lock join the
+	// batch.
+	std::vector<std::shared_ptr<CompilationJob>> batch;
+	{
+	    std::lock_guard<std::recursive_mutex> llvm_lock(llvmMutex());
+	    {
+		std::lock_guard<std::mutex> lock(state.mutex);
+		// Take the waiting jobs that can share an engine.  Cached
+		// code is named after its IR, so identical code has to be
+		// compiled separately.
+		unsigned level = state.jobs.front()->optimizationLevel();
+		std::set<std::string> names;
+		while (!state.jobs.empty() && batch.size() < max_batch_size
+		       && state.jobs.front()->optimizationLevel() == level
+		       && names.insert(state.jobs.front()->functionName())
+		       .second) {
+		    batch.push_back(std::move(state.jobs.front()));
+		    state.jobs.pop_front();
+		}
+		state.jobs_in_progress += batch.size();
+	    }
+	    CompilationJob::runBatch(batch);
+	}
+	// Drop the jobs outside the queue's lock: if the CompiledExpressions
+	// have been garbage collected, this retires them, to be freed on the
+	// next time round.
+	std::size_t batch_size = batch.size();
+	batch.clear();
+	{
+	    std::lock_guard<std::mutex> lock(state.mutex);
+	    state.jobs_in_progress -= batch_size;
+	    if (isIdle(state))
+		state.idle.notify_all();
+	}
+    }
+}
+
+} // namespace JIT
+} // namespace rho
@@ -22,12 +22,22 @@
  */
 #include "rho/jit/llvm.hpp"
 
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+
 #define R_NO_REMAP
 #include "rho/jit/CompiledExpression.hpp"
 
+#include "rho/jit/ClosureStatistics.hpp"
+#include "rho/jit/CodeCache.hpp"
+#include "rho/jit/CompilationQueue.hpp"
 #include "rho/jit/CompiledFrame.hpp"
 #include "rho/jit/Compiler.hpp"
 #include "rho/jit/CompilerContext.hpp"
+#include "rho/jit/EscapeAnalysis.hpp"
 #include "rho/jit/Globals.hpp"
 #include "rho/jit/MCJITMemoryManager.hpp"
 #include "rho/jit/Optimization.hpp"
@@ -35,8 +45,13 @@
 #include "rho/jit/TypeBuilder.hpp"
 
 #include "rho/Closure.hpp"
+#include "rho/ClosureContext.hpp"
 #include "rho/Environment.hpp"
+#include "rho/Expression.hpp"
+#include "rho/GCStackRoot.hpp"
+#include "rho/ListFrame.hpp"
 #include "rho/RObject.hpp"
+#include "rho/Symbol.hpp"
 
 using llvm::Module;
 using llvm::Value;
@@ -47,17 +62,137 @@ namespace JIT {
 CompiledExpression*
 CompiledExpression::compileFunctionBody(const Closure* closure)
 {
-    return new CompiledExpression(closure);
+    std::lock_guard<std::recursive_mutex> lock(
+	CompilationQueue::llvmMutex());
+    CompiledExpression* result = new CompiledExpression(
+	closure, closure->body(), nullptr, false);
+    CompilationJob::runBatch({result->m_job});
+    if (!result->isReady())
+	throw std::runtime_error("JIT compilation failed");
+    return result;
 }
 
-CompiledExpression::CompiledExpression(const Closure* closure)
+CompiledExpression*
+CompiledExpression::compileFunctionBodyInBackground(const Closure* closure,
+						    bool optimize)
+{
+    std::unique_lock<std::recursive_mutex> lock(
+	CompilationQueue::llvmMutex(), std::try_to_lock);
+    if (!lock.owns_lock()) {
+	// The background thread is busy.  Rather than waiting, try again
+	// later.
+	return nullptr;
+    }
+    CompiledExpression* result = new CompiledExpression(
+	closure, closure->body(), nullptr, optimize);
+    CompilationQueue::enqueue(result->m_job);
+    return result;
+}
+
+CompiledExpression*
+CompiledExpression::compileLoopInBackground(const Expression* loop,
+					    const Closure* closure,
+					    Environment* env)
 {
+    GCStackRoot<const Closure> owner(closure);
+    GCStackRoot<FrameDescriptor> descriptor;
+    if (!closure) {
+	// Compile the loop as the body of a closure whose environment is
+	// env.  This gets the function predictions right, and the empty
+	// frame descriptor sends all variable lookups to the interpreter.
+	owner = new Closure(nullptr, const_cast<Expression*>(loop), env);
+	descriptor = new FrameDescriptor({}, {});
+    }
+
+    // Unless the loop itself gets inlined, the compiled code would just
+    // call back into the interpreter.
+    CompilerContext prediction_context(owner, nullptr, nullptr, nullptr);
+    if (descriptor)
+	prediction_context.m_frame_descriptor = descriptor;
+    if (!dynamic_cast<const Symbol*>(loop->car())
+	|| !prediction_context.canInlineControlFlow())
+	throw std::runtime_error("loop can't be compiled");
+
+    std::unique_lock<std::recursive_mutex> lock(
+	CompilationQueue::llvmMutex(), std::try_to_lock);
+    if (!lock.owns_lock()) {
+	// The background thread is busy.  The interpreter carries on with
+	// the loop, and tries again later.
+	return nullptr;
+    }
+    CompiledExpression* result = new CompiledExpression(
+	owner, loop, descriptor, false, true);
+    CompilationQueue::enqueue(result->m_job);
+    return result;
+}
+
+CompiledExpression*
+CompiledExpression::enterLoop(const Expression* loop, Environment* env)
+{
+    const Closure* closure = nullptr;
+    ClosureContext* context = ClosureContext::innermost();
+    if (context && context->workingEnvironment() == env)
+	closure = dynamic_cast<const Closure*>(context->function());
+
+    CompiledExpression* code = nullptr;
+    bool replace_frame = false;
+    if (closure) {
+	// Only plain ListFrames are handed over.  Other kinds of frame may
+	// be relied on by other code.
+	replace_frame = typeid(*env->frame()) == typeid(ListFrame);
+	code = closure->compiledLoop(loop, env, replace_frame);
+    } else if (const CachingExpression* site
+	       = dynamic_cast<const CachingExpression*>(loop)) {
+	code = site->compiledLoop(env);
+    }
+    if (!code || !code->isReady())
+	return nullptr;
+    if (replace_frame)
+	env->replaceFrame(code->createFrame());
+    return code;
+}
+
+namespace {
+    // Passed from resumeForLoop() to the compiled code.
+    RObject* resumed_sequence = nullptr;
+    int resumed_start = 0;
+}
+
+RObject* CompiledExpression::resumeForLoop(Environment* env,
+					   RObject* sequence, int start) const
+{
+    resumed_sequence = sequence;
+    resumed_start = start;
+    return evalInEnvironment(env);
+}
+
+RObject* CompiledExpression::takeResumedForLoop(int* start)
+{
+    assert(resumed_sequence);
+    RObject* sequence = resumed_sequence;
+    resumed_sequence = nullptr;
+    *start = resumed_start;
+    return sequence;
+}
+
+CompiledExpression::CompiledExpression(const Closure* closure,
+				       const RObject* body,
+				       FrameDescriptor* descriptor,
+				       bool optimize, bool loop)
+    : m_function(nullptr), m_ir_seconds(0), m_outcome_recorded(false),
+      m_optimized(optimize), m_back_edge_count(0),
+      m_environment_reusable(false)
+{
+    auto start = std::chrono::steady_clock::now();
+    // Loops compiled on their own belong to a temporary closure (see
+    // compileLoopInBackground()), which isn't worth keeping statistics for.
+    if (!descriptor)
+	m_statistics = closure->jitStatistics();
+
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmPrinter();
     EnsureGlobalsInitialized();
 
-    const RObject* body = closure->body();
-
     // Create a module to compile the code in.  MCJIT requires that each
     // separate invocation of the JIT compiler uses its own module.
     llvm::LLVMContext& context = llvm::getGlobalContext();
@@ -78,6 +213,15 @@ CompiledExpression::CompiledExpression(const Closure* closure)
         new MCJITMemoryManager(module.get()));
     CompilerContext compiler_context(closure, environment, function,
 				     memory_manager.get());
+    if (descriptor)
+	compiler_context.m_frame_descriptor = descriptor;
+    if (loop)
+	compiler_context.m_resumed_loop = static_cast<const Expression*>(body);
+    compiler_context.m_back_edge_counter = &m_back_edge_count;
+    compiler_context.m_lookup_caches = &m_lookup_caches;
+    if (m_statistics)
+	compiler_context.m_guard_failure_counter
+	    = &m_statistics->guard_failures;
     Compiler compiler(&compiler_context);
 #if (LLVM_VERSION > 306)
     function->setPersonalityFn(
@@ -85,6 +229,12 @@ CompiledExpression::CompiledExpression(const Closure* closure)
 #endif
     Value* return_value = compiler.emitEval(body);
 
+    if (!descriptor && body == closure->body()) {
+	EscapeAnalysis escape_analysis(closure, &compiler_context);
+	m_environment_reusable = !escape_analysis.environmentMayEscape();
+	m_strict_arguments = escape_analysis.strictArguments();
+    }
+
     if (!llvm::isa<llvm::UndefValue>(return_value)) {
 	if (!return_value->hasName())
 	    return_value->setName("return_value");
@@ -103,49 +253,92 @@ CompiledExpression::CompiledExpression(const Closure* closure)
     llvm::verifyFunction(*function);
 
     // Perform some basic intra-procedural optimization.
-    BasicFunctionPass().runOnFunction(*function);
+    const OptimizationOptions& options
+	= compiler_context.getOptimizationOptions();
+    BasicFunctionPass(options).runOnFunction(*function);
     llvm::verifyFunction(*function);
+    unsigned optimization_level = optimize ? options.OptimizationLevel : 0;
 
-    // The IR is now complete.  Compile to native code.
-    llvm::TargetOptions options;
-    // TODO(kmillar): set options dynamically.
-    options.EnableFastISel = true;
-
-    m_engine.reset(
-#if (LLVM_VERSION < 306)
-                   llvm::EngineBuilder(module.release())
-		   .setMCJITMemoryManager(memory_manager.release())
-		   .setUseMCJIT(true)
-#else
-                   llvm::EngineBuilder(std::move(module))
-		   .setMCJITMemoryManager(std::move(memory_manager))
-#endif
-		   .setOptLevel(llvm::CodeGenOpt::None)
-                   .setTargetOptions(options)
-		   .create());
-    assert(m_engine);
-
-    m_engine->finalizeObject();
-    auto ptr = m_engine->getFunctionAddress(function->getName());
-    assert(ptr && "JIT compilation failed");
+    // Several modules may share an execution engine, so the names they
+    // define need to be made unique.  If the code is to be cached, the
+    // names come from a hash of the IR, so that the same code gets the same
+    // names in every process.  The LLVM lock protects the counter.
+    std::string tag;
+    if (CodeCache::get()) {
+	tag = CodeCache::moduleKey(module.get(), options, optimization_level);
+    } else {
+	static unsigned int module_count = 0;
+	tag = "module." + std::to_string(++module_count);
+    }
+    module->setModuleIdentifier(tag);
+    memory_manager->qualifyNames(tag);
+    function->setName(tag + ".function");
 
-    m_function = reinterpret_cast<CompiledExpressionPointer>(ptr);
+    // The IR is now complete.  Native code generation doesn't need to
+    // touch any R objects, so it can be done on another thread.
+    m_job = std::make_shared<CompilationJob>(std::move(module),
+					     std::move(memory_manager),
+					     function->getName(),
+					     optimization_level);
     m_frame_descriptor = compiler_context.m_frame_descriptor;
+    std::chrono::duration<double> elapsed
+	= std::chrono::steady_clock::now() - start;
+    m_ir_seconds = elapsed.count();
 }
 
 CompiledExpression::~CompiledExpression()
 {
-    // m_engine->freeMachineCodeForFunction(m_function);
+}
+
+bool CompiledExpression::isReady() const
+{
+    if (!m_function && m_job->isFinished()) {
+	m_function = m_job->function();
+	recordOutcome();
+    }
+    return m_function != nullptr;
+}
+
+bool CompiledExpression::hasFailed() const
+{
+    if (!m_job->isFinished())
+	return false;
+    recordOutcome();
+    return !m_job->function();
+}
+
+void CompiledExpression::recordOutcome() const
+{
+    if (m_outcome_recorded || !m_statistics)
+	return;
+    m_outcome_recorded = true;
+    m_statistics->compile_seconds += m_ir_seconds + m_job->seconds();
+    if (!m_job->function()) {
+	++m_statistics->failed_compilations;
+	return;
+    }
+    ++m_statistics->compilations;
+    if (m_optimized)
+	++m_statistics->optimized_compilations;
 }
 
 void CompiledExpression::detachReferents() {
     m_frame_descriptor = nullptr;
+    m_spare_environment = nullptr;
+    for (SymbolLookupCache& cache : m_lookup_caches)
+	cache.clear();
     GCNode::detachReferents();
 }
 
 void CompiledExpression::visitReferents(const_visitor* v) const {
     if (m_frame_descriptor)
 	(*v)(m_frame_descriptor);
+    if (m_spare_environment)
+	(*v)(m_spare_environment);
+    for (const SymbolLookupCache& cache : m_lookup_caches) {
+	if (cache.m_environment)
+	    (*v)(cache.m_environment);
+    }
     GCNode::visitReferents(v);
 }
 
@@ -161,5 +354,23 @@ bool CompiledExpression::hasMatchingFrameLayout(const Environment* env) const
   return frame->getDescriptor() == m_frame_descriptor.get();
 }
 
+Environment* CompiledExpression::takeSpareEnvironment() const
+{
+    Environment* env = m_spare_environment;
+    m_spare_environment = nullptr;
+    return env;
+}
+
+bool CompiledExpression::recycleEnvironment(Environment* env) const
+{
+    // Recursive calls find the spare environment already taken, and
+    // allocate their own.  Only one is kept.
+    if (!m_environment_reusable || m_spare_environment
+	|| !hasMatchingFrameLayout(env) || !env->clearForReuse())
+	return false;
+    m_spare_environment = env;
+    return true;
+}
+
 } // namespace JIT
 } // namespace rho
@@ -25,10 +25,12 @@
 #define R_NO_REMAP
 #include "rho/jit/Compiler.hpp"
 
+#include "rho/jit/CodeCache.hpp"
 #include "rho/jit/CompilationException.hpp"
 #include "rho/jit/FrameDescriptor.hpp"
 #include "rho/jit/MCJITMemoryManager.hpp"
 #include "rho/jit/Runtime.hpp"
+#include "rho/jit/SymbolLookupCache.hpp"
 #include "rho/jit/TypeBuilder.hpp"
 
 #include "rho/BuiltInFunction.hpp"
@@ -74,10 +76,21 @@ Compiler::Compiler(CompilerContext* context)
 llvm::Constant* Compiler::emitConstantPointer(const void* value,
 					      llvm::Type* type)
 {
-    llvm::Constant* pointer_as_integer = llvm::ConstantInt::get(
-	getType<intptr_t>(),
-	reinterpret_cast<intptr_t>(value));
-    return llvm::ConstantExpr::getIntToPtr(pointer_as_integer, type);
+    if (!value)
+	return llvm::ConstantPointerNull::get(
+	    llvm::cast<llvm::PointerType>(type));
+    if (!CodeCache::get()) {
+	// Embedding the address lets LLVM fold it.
+	llvm::Constant* pointer_as_integer = llvm::ConstantInt::get(
+	    getType<intptr_t>(),
+	    reinterpret_cast<intptr_t>(value));
+	return llvm::ConstantExpr::getIntToPtr(pointer_as_integer, type);
+    }
+    // The address is filled in when the code is loaded, so the code can be
+    // reused by other processes (see CodeCache).
+    llvm::GlobalVariable* global
+	= m_context->getMemoryManager()->getConstant(value);
+    return llvm::ConstantExpr::getBitCast(global, type);
 }
 
 llvm::Constant* Compiler::emitSymbol(const Symbol* symbol)
@@ -197,6 +210,9 @@ Value* Compiler::emitEvalInternal(const RObject* object)
 	assert(0 && "Unexpected eval of a promise in JIT compilation.");
 	return nullptr;
     default:
+	// As in RObject::evaluate(), the constant is shared with the
+	// AST, so it must never be modified in place.
+	SET_NAMED(const_cast<RObject*>(object), 2);
 	return emitConstantPointer(object);
     }
 }
@@ -216,6 +232,21 @@ Value* Compiler::emitSymbolEval(const Symbol* symbol)
 	    emitSymbol(symbol), m_context->getEnvironment(), location,
 	    this);
     }
+    if (m_context->m_lookup_caches
+	&& symbol != DotsSymbol
+	&& !symbol->isDotDotSymbol()
+	&& symbol != Symbol::missingArgument()) {
+	// Give the lookup its own cache of where the symbol is bound.
+	m_context->m_lookup_caches->emplace_back();
+	llvm::Function* lookup_with_cache = Runtime::getDeclaration(
+	    "rho_runtime_lookupSymbolWithCache", this);
+	Value* cache = emitConstantPointer(
+	    &m_context->m_lookup_caches->back(),
+	    lookup_with_cache->getFunctionType()->getParamType(2));
+	return emitCallOrInvoke(lookup_with_cache,
+				{ emitSymbol(symbol),
+				  m_context->getEnvironment(), cache });
+    }
     // Otherwise fallback to the interpreter for now.
     return Runtime::emitLookupSymbol(emitSymbol(symbol),
 				     m_context->getEnvironment(), this);
@@ -235,19 +266,30 @@ Value* Compiler::emitExpressionEval(const Expression* expression)
     } else if (Symbol* symbol = dynamic_cast<Symbol*>(function)) {
 	// The first element is a symbol.  Look it up.
 	resolved_function = emitFunctionLookup(symbol, &likely_function);
-	// Check that the lookup succeeded, unless the function was resolved
-	// at compile time.
-	if (!llvm::isa<llvm::Constant>(resolved_function)) {
-	    emitErrorUnless(resolved_function,
-			    _("could not find function \"%s\""),
-			    emitConstantPointer(symbol->name()->c_str()));
-	}
     } else {
 	// The first element is a (function-valued) expression.  Fallback
 	// to the interpreter for now.
 	return Runtime::emitEvaluate(emitConstantPointer(expression),
 				     m_context->getEnvironment(), this);
     }
+    return emitCall(expression, resolved_function, likely_function);
+}
+
+// Emits a call to the resolved function, inlining it if it is likely to be a
+// builtin that the compiler knows about.
+Value* Compiler::emitCall(const Expression* expression,
+			  Value* resolved_function,
+			  FunctionBase* likely_function)
+{
+    emitCheckFunctionFound(expression, resolved_function);
+
+    BuiltInFunction* builtin = dynamic_cast<BuiltInFunction*>(likely_function);
+    if (isScalarOperator(builtin) && isScalarOperatorCall(expression)) {
+	Value* result = emitBox(emitScalarOperatorCall(
+				    expression, resolved_function, builtin));
+	emitSetVisibility(true);
+	return result;
+    }
 
     if (likely_function) {
 	Value* result = emitInlineableBuiltinCall(
@@ -263,6 +305,19 @@ Value* Compiler::emitExpressionEval(const Expression* expression)
 	emitConstantPointer(expression), m_context->getEnvironment(), this);
 }
 
+void Compiler::emitCheckFunctionFound(const Expression* expression,
+				      Value* resolved_function)
+{
+    // Check that the lookup succeeded, unless the function was resolved
+    // at compile time.
+    if (!llvm::isa<llvm::Constant>(resolved_function)) {
+	const Symbol* symbol = SEXP_downcast<const Symbol*>(expression->car());
+	emitErrorUnless(resolved_function,
+			_("could not find function \"%s\""),
+			emitConstantPointer(symbol->name()->c_str()));
+    }
+}
+
 Value* Compiler::emitDotsEval(const DottedArgs* expression)
 {
     // Call the interpreter.
@@ -312,12 +367,44 @@ BasicBlock* Compiler::createBranch(const char* name,
     return block;
 }
 
+Value* Compiler::emitIsExpectedBuiltin(Value* resolved_function,
+				      const BuiltInFunction* builtin)
+{
+    Value* likely_fn_value = m_context->getMemoryManager()
+	->getBuiltIn(builtin);
+    likely_fn_value = CreateBitCast(likely_fn_value,
+				    llvm::TypeBuilder<FunctionBase*, false>::get(getContext()));
+    return CreateICmpEQ(resolved_function, likely_fn_value);
+}
+
+llvm::AllocaInst* Compiler::createEntryBlockAlloca(llvm::Type* type,
+						   const char* name)
+{
+    // Allocas in the entry block can be promoted to registers by LLVM.
+    InsertPointGuard preserve_insert_point(*this);
+    BasicBlock& entry_block = m_context->getFunction()->getEntryBlock();
+    SetInsertPoint(&entry_block, entry_block.begin());
+    return CreateAlloca(type, nullptr, name);
+}
+
 Value* Compiler::createBackEdge(llvm::BasicBlock* destination)
 {
+    if (m_context->m_back_edge_counter) {
+	// Count the back edge, for use in deciding when to optimize.
+	emitIncrementCounter(m_context->m_back_edge_counter,
+			     "rho.back_edge_count");
+    }
     Runtime::emitMaybeCheckForUserInterrupt(this);
     return CreateBr(destination);
 }
 
+void Compiler::emitIncrementCounter(std::uint32_t* counter, const char* name)
+{
+    Value* global = m_context->getMemoryManager()->addGlobal(counter, false,
+							     name);
+    CreateStore(CreateAdd(CreateLoad(global), getInt32(1)), global);
+}
+
 /*
  * The rest of this file contains the code to emit inlined versions of special
  * functions, primarily those that implement flow control.
@@ -337,8 +424,8 @@ Compiler::getInlineableBuiltins()
 		       &Compiler::emitInlinedReturn),
 	std::make_pair(BuiltInFunction::obtainPrimitive("if"),
 		       &Compiler::emitInlinedIf),
-	// std::make_pair(BuiltInFunction::obtainPrimitive("for"),
-	// 	       &Compiler::emitInlinedFor),
+	std::make_pair(BuiltInFunction::obtainPrimitive("for"),
+		       &Compiler::emitInlinedFor),
 	std::make_pair(BuiltInFunction::obtainPrimitive("while"),
 		       &Compiler::emitInlinedWhile),
 	std::make_pair(BuiltInFunction::obtainPrimitive("repeat"),
@@ -416,12 +503,8 @@ Value* Compiler::emitInlineableBuiltinCall(const Expression* expression,
 
     // Code to check if the function is the predicted one.
     restoreIP(incoming_block);
-    Value* likely_fn_value = m_context->getMemoryManager()
-	->getBuiltIn(builtin);
-    likely_fn_value = CreateBitCast(likely_fn_value,
-				    llvm::TypeBuilder<FunctionBase*, false>::get(getContext()));
-    Value* is_expected_builtin = CreateICmpEQ(resolved_function,
-					      likely_fn_value);
+    Value* is_expected_builtin = emitIsExpectedBuiltin(resolved_function,
+						       builtin);
     CreateCondBr(is_expected_builtin, inlined_builtin_block, fallback_block,
                  CreateBranchWeightsLikelyTaken(m_context->getLLVMContext()));
 
@@ -432,6 +515,9 @@ Value* Compiler::emitInlineableBuiltinCall(const Expression* expression,
     // TODO(kmillar): allow this check to be skipped at some optimization
     //   levels.
     SetInsertPoint(fallback_block);
+    if (m_context->m_guard_failure_counter)
+	emitIncrementCounter(m_context->m_guard_failure_counter,
+			     "rho.guard_failure_count");
     Value* fallback_value
 	=  Runtime::emitCallFunction(resolved_function,
 				     emitConstantPointer(expression->tail()),
@@ -565,10 +651,9 @@ Value* Compiler::emitInlinedIf(const Expression* expression)
     }
 
     // Evaluate the condition and branch.
-    Value* r_condition = emitEval(CADR(const_cast<Expression*>(expression)));
-    // TODO(kmillar): r_condition needs GC protection.
-    Value* boolean_condition = Runtime::emitCoerceToTrueOrFalse(
-	r_condition, expression, this);
+    // TODO(kmillar): the condition value needs GC protection.
+    Value* boolean_condition = emitCondition(expression->tail()->car(),
+					     expression);
     InsertPoint branch_point = saveIP();
 
     // Create the merge point.
@@ -637,6 +722,126 @@ Value* Compiler::emitInlinedRepeat(const Expression* expression)
     return emitInvisibleNullValue();
 }
 
+Value* Compiler::emitInlinedFor(const Expression* expression)
+{
+    if (listLength(expression) != 4) {
+	// This is probably a syntax error.  Let the interpreter handle it.
+	return nullptr;
+    }
+
+    const Symbol* symbol = dynamic_cast<const Symbol*>(
+	expression->tail()->car());
+    if (!symbol) {
+	// This is probably a syntax error.  Let the interpreter handle it.
+	return nullptr;
+    }
+    // The loop variable is normally in the frame descriptor.  It isn't when
+    // a loop is compiled part way through (on-stack replacement) in a frame
+    // that wasn't set up by compiled code.
+    int location = m_context->m_frame_descriptor->getLocation(symbol);
+    auto assign_loop_variable = [=](Value* value) {
+	if (location == -1)
+	    Runtime::emitAssignSymbol(emitSymbol(symbol),
+				      m_context->getEnvironment(), value, this);
+	else
+	    Runtime::emitAssignSymbolInCompiledFrame(
+		emitSymbol(symbol), m_context->getEnvironment(), location,
+		value, this);
+    };
+    const RObject* body = expression->tail()->tail()->tail()->car();
+
+    // The runtime returns the range start and the length through pointers.
+    llvm::Type* int_type = getType<int32_t>();
+    Value* range_start_ptr = createEntryBlockAlloca(int_type,
+						    "for_range_start");
+    Value* length_ptr = createEntryBlockAlloca(int_type, "for_length");
+
+    // Evaluate the sequence.  If it is an integer range, no vector gets
+    // created and the sequence is null.  A loop that the interpreter hands
+    // over part way through has already evaluated it.
+    bool resumed = expression == m_context->m_resumed_loop;
+    Value* sequence;
+    Value* start_index = getInt32(0);
+    if (resumed) {
+	Value* start_ptr = createEntryBlockAlloca(int_type, "for_start");
+	sequence = Runtime::emitResumeForLoop(range_start_ptr, length_ptr,
+					      start_ptr, this);
+	start_index = CreateLoad(start_ptr);
+    } else {
+	sequence = Runtime::emitForLoopSequence(
+	    expression, m_context->getEnvironment(),
+	    range_start_ptr, length_ptr, this);
+    }
+    // Nothing else refers to the sequence while the loop runs, and the
+    // conservative stack scan only finds pointers held in memory.  A
+    // volatile store to an entry block slot can't be optimized away, so
+    // the sequence stays visible to the scan until the function returns.
+    Value* sequence_slot = createEntryBlockAlloca(getType<RObject*>(),
+						  "for_sequence");
+    CreateStore(sequence, sequence_slot, true);
+    Value* range_start = CreateLoad(range_start_ptr);
+    Value* length = CreateLoad(length_ptr);
+    Value* is_range = CreateIsNull(sequence);
+
+    // As in the interpreter, the loop variable is NULL if the loop body is
+    // never run.
+    if (!resumed)
+	assign_loop_variable(emitNullValue());
+
+    BasicBlock* preheader = GetInsertBlock();
+    BasicBlock* loop_header = createBasicBlock("for_header");
+    BasicBlock* loop_body = createBasicBlock("for_body");
+    BasicBlock* range_element = createBasicBlock("for_range_element");
+    BasicBlock* sequence_element = createBasicBlock("for_sequence_element");
+    BasicBlock* loop_body_start = createBasicBlock("for_body_start");
+    BasicBlock* loop_latch = createBasicBlock("for_next");
+    BasicBlock* continue_block = createBasicBlock("continue");
+
+    CreateBr(loop_header);
+
+    SetInsertPoint(loop_header);
+    llvm::PHINode* index = CreatePHI(int_type, 2, "for_index");
+    index->addIncoming(start_index, preheader);
+    CreateCondBr(CreateICmpSLT(index, length), loop_body, continue_block);
+
+    SetInsertPoint(loop_body);
+    {
+	LoopScope loop(m_context,
+		       continue_block, loop_latch,
+		       this);
+	CreateCondBr(is_range, range_element, sequence_element);
+
+	// Work out the value of the loop variable.
+	SetInsertPoint(range_element);
+	Value* range_value = Runtime::emitForLoopIndex(
+	    CreateAdd(range_start, index), this);
+	BasicBlock* range_element_end = GetInsertBlock();
+	CreateBr(loop_body_start);
+
+	SetInsertPoint(sequence_element);
+	Value* sequence_value = Runtime::emitForLoopElement(sequence, index,
+							     this);
+	BasicBlock* sequence_element_end = GetInsertBlock();
+	CreateBr(loop_body_start);
+
+	SetInsertPoint(loop_body_start);
+	llvm::PHINode* value = CreatePHI(getType<RObject*>(), 2);
+	value->addIncoming(range_value, range_element_end);
+	value->addIncoming(sequence_value, sequence_element_end);
+	assign_loop_variable(value);
+	emitEval(body);
+    }
+    CreateBr(loop_latch);
+
+    SetInsertPoint(loop_latch);
+    Value* next_index = CreateAdd(index, getInt32(1));
+    createBackEdge(loop_header);
+    index->addIncoming(next_index, GetInsertBlock());
+
+    SetInsertPoint(continue_block);
+    return emitInvisibleNullValue();
+}
+
 Value* Compiler::emitInlinedWhile(const Expression* expression)
 {
     if (listLength(expression) != 3) {
@@ -654,9 +859,7 @@ Value* Compiler::emitInlinedWhile(const Expression* expression)
     CreateBr(loop_header);
 
     SetInsertPoint(loop_header);
-    llvm::Value* evaluated_condition = emitEval(condition);
-    llvm::Value* condition_as_bool = Runtime::emitCoerceToTrueOrFalse(
-	evaluated_condition, expression, this);
+    llvm::Value* condition_as_bool = emitCondition(condition, expression);
     CreateCondBr(condition_as_bool, loop_body, continue_block);
 
     SetInsertPoint(loop_body);
@@ -701,6 +904,334 @@ Value* Compiler::emitInlinedNext(const Expression* expression) {
     }
 }
 
+/*
+ * Unboxed scalar arithmetic and comparisons.
+ *
+ * Calls of the binary arithmetic and relational operators are compiled to
+ * code that works directly on doubles in registers when both operands are
+ * logical, integer or real scalars without attributes.  Nested operator calls
+ * pass their results along unboxed, so an expression like 'a * x + b < y'
+ * only allocates (at most) the final result.  When the operands aren't
+ * suitable, or an integer operation overflows, the code falls back to the
+ * interpreter's implementation, applied to the already-evaluated operands.
+ */
+namespace {
+enum class ScalarOp { ADD, SUBTRACT, MULTIPLY, DIVIDE,
+		      LT, GT, LE, GE, EQ, NE };
+
+const std::vector<std::pair<BuiltInFunction*, ScalarOp>>& getScalarOperators()
+{
+    static std::vector<std::pair<BuiltInFunction*, ScalarOp>> operators = {
+	{ BuiltInFunction::obtainPrimitive("+"), ScalarOp::ADD },
+	{ BuiltInFunction::obtainPrimitive("-"), ScalarOp::SUBTRACT },
+	{ BuiltInFunction::obtainPrimitive("*"), ScalarOp::MULTIPLY },
+	{ BuiltInFunction::obtainPrimitive("/"), ScalarOp::DIVIDE },
+	{ BuiltInFunction::obtainPrimitive("<"), ScalarOp::LT },
+	{ BuiltInFunction::obtainPrimitive(">"), ScalarOp::GT },
+	{ BuiltInFunction::obtainPrimitive("<="), ScalarOp::LE },
+	{ BuiltInFunction::obtainPrimitive(">="), ScalarOp::GE },
+	{ BuiltInFunction::obtainPrimitive("=="), ScalarOp::EQ },
+	{ BuiltInFunction::obtainPrimitive("!="), ScalarOp::NE },
+    };
+    return operators;
+}
+
+ScalarOp getScalarOp(const BuiltInFunction* builtin)
+{
+    for (const auto& op : getScalarOperators()) {
+	if (op.first == builtin)
+	    return op.second;
+    }
+    assert(0 && "Not a scalar operator.");
+    return ScalarOp::ADD;
+}
+}  // anonymous namespace
+
+bool Compiler::isScalarOperator(const BuiltInFunction* builtin)
+{
+    if (!builtin)
+	return false;
+    for (const auto& op : getScalarOperators()) {
+	if (op.first == builtin)
+	    return true;
+    }
+    return false;
+}
+
+bool Compiler::isScalarOperatorCall(const Expression* expression)
+{
+    // Only binary calls are handled.  Unary minus, '...' and missing
+    // arguments are left to the interpreter.
+    if (listLength(expression) != 3)
+	return false;
+    for (const ConsCell& arg : *expression->tail()) {
+	if (arg.car() == DotsSymbol || arg.car() == Symbol::missingArgument())
+	    return false;
+    }
+    return true;
+}
+
+Compiler::ScalarValue Compiler::emitUnboxedEval(const RObject* object)
+{
+    const Expression* expression = dynamic_cast<const Expression*>(object);
+    Symbol* symbol = expression ? dynamic_cast<Symbol*>(expression->car())
+	: nullptr;
+    if (!symbol || !isScalarOperatorCall(expression)) {
+	return emitUnbox(emitEval(object));
+    }
+
+    FunctionBase* likely_function;
+    Value* resolved_function = emitFunctionLookup(symbol, &likely_function);
+    BuiltInFunction* builtin = dynamic_cast<BuiltInFunction*>(likely_function);
+    if (!isScalarOperator(builtin)) {
+	return emitUnbox(emitCall(expression, resolved_function,
+				  likely_function));
+    }
+    emitCheckFunctionFound(expression, resolved_function);
+    return emitScalarOperatorCall(expression, resolved_function, builtin);
+}
+
+Compiler::ScalarValue Compiler::emitScalarOperatorCall(
+    const Expression* expression,
+    Value* resolved_function,
+    const BuiltInFunction* op)
+{
+    if (llvm::isa<llvm::Constant>(resolved_function)) {
+	return emitScalarOperator(expression, op);
+    }
+
+    // Check that the function is the expected operator, as in
+    // emitInlineableBuiltinCall().
+    BasicBlock* inlined_block = createBasicBlock(op->name());
+    BasicBlock* fallback_block = createBasicBlock("fallback");
+    CreateCondBr(emitIsExpectedBuiltin(resolved_function, op),
+		 inlined_block, fallback_block,
+		 CreateBranchWeightsLikelyTaken(m_context->getLLVMContext()));
+
+    SetInsertPoint(inlined_block);
+    ScalarValue inlined_value = emitScalarOperator(expression, op);
+    BasicBlock* inlined_end = GetInsertBlock();
+
+    SetInsertPoint(fallback_block);
+    Value* fallback_result
+	= Runtime::emitCallFunction(resolved_function,
+				    emitConstantPointer(expression->tail()),
+				    emitConstantPointer(expression),
+				    m_context->getEnvironment(), this);
+    ScalarValue fallback_value = emitUnbox(fallback_result);
+    BasicBlock* fallback_end = GetInsertBlock();
+
+    return mergeScalarValues({ { inlined_value, inlined_end },
+			       { fallback_value, fallback_end } });
+}
+
+Compiler::ScalarValue Compiler::emitScalarOperator(
+    const Expression* expression,
+    const BuiltInFunction* op)
+{
+    ScalarOp scalar_op = getScalarOp(op);
+    bool is_comparison = scalar_op >= ScalarOp::LT;
+    bool has_integer_result = scalar_op == ScalarOp::ADD
+	|| scalar_op == ScalarOp::SUBTRACT
+	|| scalar_op == ScalarOp::MULTIPLY;
+
+    ScalarValue lhs = emitUnboxedEval(expression->tail()->car());
+    ScalarValue rhs = emitUnboxedEval(expression->tail()->tail()->car());
+
+    Value* not_scalar = getInt32(Runtime::NOT_SCALAR);
+    Value* real_scalar = getInt32(Runtime::REAL_SCALAR);
+    Value* both_scalar = CreateAnd(CreateICmpNE(lhs.kind, not_scalar),
+				   CreateICmpNE(rhs.kind, not_scalar));
+
+    BasicBlock* real_block = createBasicBlock("scalar_real");
+    BasicBlock* generic_block = createBasicBlock("generic");
+    std::vector<std::pair<ScalarValue, BasicBlock*>> results;
+
+    if (has_integer_result) {
+	// Logical and integer operands give an integer result, which is
+	// computed with overflow checking.
+	Value* either_real = CreateOr(CreateICmpEQ(lhs.kind, real_scalar),
+				      CreateICmpEQ(rhs.kind, real_scalar));
+	BasicBlock* check_integer = createBasicBlock("check_integer");
+	BasicBlock* integer_block = createBasicBlock("scalar_integer");
+	BasicBlock* integer_result = createBasicBlock("scalar_integer_result");
+	CreateCondBr(CreateAnd(both_scalar, either_real),
+		     real_block, check_integer);
+	SetInsertPoint(check_integer);
+	CreateCondBr(both_scalar, integer_block, generic_block);
+
+	SetInsertPoint(integer_block);
+	llvm::Type* int_type = getType<int32_t>();
+	llvm::Intrinsic::ID intrinsic
+	    = scalar_op == ScalarOp::ADD ? llvm::Intrinsic::sadd_with_overflow
+	    : scalar_op == ScalarOp::SUBTRACT
+	    ? llvm::Intrinsic::ssub_with_overflow
+	    : llvm::Intrinsic::smul_with_overflow;
+	llvm::Function* checked_op = llvm::Intrinsic::getDeclaration(
+	    m_context->getModule(), intrinsic, int_type);
+	Value* checked_result = CreateCall(
+	    checked_op, { CreateFPToSI(lhs.value, int_type),
+			  CreateFPToSI(rhs.value, int_type) });
+	Value* result = CreateExtractValue(checked_result, 0);
+	Value* overflow = CreateExtractValue(checked_result, 1);
+	// The interpreter gives NA with a warning in these cases.
+	Value* is_valid = CreateAnd(
+	    CreateNot(overflow),
+	    CreateICmpNE(result, getInt32(NA_INTEGER)));
+	CreateCondBr(is_valid, integer_result, generic_block,
+		     CreateBranchWeightsLikelyTaken(
+			 m_context->getLLVMContext()));
+
+	SetInsertPoint(integer_result);
+	results.push_back({ { getInt32(Runtime::INTEGER_SCALAR),
+			      CreateSIToFP(result, getDoubleTy()),
+			      emitNullValue() },
+			    integer_result });
+    } else {
+	Value* use_fast_path = both_scalar;
+	if (is_comparison) {
+	    // Comparisons involving NaN give NA.
+	    use_fast_path = CreateAnd(
+		both_scalar, CreateFCmpORD(lhs.value, rhs.value));
+	}
+	CreateCondBr(use_fast_path, real_block, generic_block,
+		     CreateBranchWeightsLikelyTaken(
+			 m_context->getLLVMContext()));
+    }
+
+    // Arithmetic on doubles, or a comparison.
+    SetInsertPoint(real_block);
+    Value* real_result;
+    switch (scalar_op) {
+    case ScalarOp::ADD:
+	real_result = CreateFAdd(lhs.value, rhs.value);
+	break;
+    case ScalarOp::SUBTRACT:
+	real_result = CreateFSub(lhs.value, rhs.value);
+	break;
+    case ScalarOp::MULTIPLY:
+	real_result = CreateFMul(lhs.value, rhs.value);
+	break;
+    case ScalarOp::DIVIDE:
+	real_result = CreateFDiv(lhs.value, rhs.value);
+	break;
+    case ScalarOp::LT:
+	real_result = CreateFCmpOLT(lhs.value, rhs.value);
+	break;
+    case ScalarOp::GT:
+	real_result = CreateFCmpOGT(lhs.value, rhs.value);
+	break;
+    case ScalarOp::LE:
+	real_result = CreateFCmpOLE(lhs.value, rhs.value);
+	break;
+    case ScalarOp::GE:
+	real_result = CreateFCmpOGE(lhs.value, rhs.value);
+	break;
+    case ScalarOp::EQ:
+	real_result = CreateFCmpOEQ(lhs.value, rhs.value);
+	break;
+    case ScalarOp::NE:
+	real_result = CreateFCmpONE(lhs.value, rhs.value);
+	break;
+    }
+    if (is_comparison) {
+	results.push_back({ { getInt32(Runtime::LOGICAL_SCALAR),
+			      CreateUIToFP(real_result, getDoubleTy()),
+			      emitNullValue() },
+			    real_block });
+    } else {
+	results.push_back({ { real_scalar, real_result, emitNullValue() },
+			    real_block });
+    }
+
+    // Otherwise box the operands and call the interpreter's implementation.
+    SetInsertPoint(generic_block);
+    Value* generic_result = Runtime::emitApplyBinaryOperator(
+	expression, op, emitBox(lhs), emitBox(rhs),
+	m_context->getEnvironment(), this);
+    results.push_back({ emitUnbox(generic_result), GetInsertBlock() });
+
+    return mergeScalarValues(results);
+}
+
+Compiler::ScalarValue Compiler::emitUnbox(Value* boxed)
+{
+    Value* unboxed = createEntryBlockAlloca(getDoubleTy(), "unboxed");
+    Value* kind = Runtime::emitUnboxScalar(boxed, unboxed, this);
+    return { kind, CreateLoad(unboxed), boxed };
+}
+
+Value* Compiler::emitBox(const ScalarValue& value)
+{
+    return Runtime::emitBoxScalar(value.boxed, value.kind, value.value, this);
+}
+
+// Branches from each of the blocks to a new merge block, and merges the
+// values there.  The blocks must not already be terminated.
+Compiler::ScalarValue Compiler::mergeScalarValues(
+    llvm::ArrayRef<std::pair<ScalarValue, BasicBlock*>> values)
+{
+    BasicBlock* merge_block = createBasicBlock("continue");
+    SetInsertPoint(merge_block);
+    PHINode* kind = CreatePHI(getInt32Ty(), values.size());
+    PHINode* value = CreatePHI(getDoubleTy(), values.size());
+    PHINode* boxed = CreatePHI(getType<RObject*>(), values.size());
+    for (const auto& incoming : values) {
+	BasicBlock* block = incoming.second;
+	SetInsertPoint(block);
+	Value* boxed_value = CreatePointerCast(incoming.first.boxed,
+					       getType<RObject*>());
+	CreateBr(merge_block);
+	kind->addIncoming(incoming.first.kind, block);
+	value->addIncoming(incoming.first.value, block);
+	boxed->addIncoming(boxed_value, block);
+    }
+    SetInsertPoint(merge_block);
+    return { kind, value, boxed };
+}
+
+// Evaluates the condition of an 'if' or 'while' statement, and coerces it
+// to an i1.  Comparisons are done without boxing the result.
+Value* Compiler::emitCondition(const RObject* condition,
+			       const Expression* call)
+{
+    const Expression* expression = dynamic_cast<const Expression*>(condition);
+    if (!expression || !dynamic_cast<Symbol*>(expression->car())
+	|| !isScalarOperatorCall(expression)) {
+	return Runtime::emitCoerceToTrueOrFalse(emitEval(condition), call,
+						this);
+    }
+    emitSetVisibility(true);
+    ScalarValue value = emitUnboxedEval(condition);
+
+    // Unboxed logicals and integers are never NA.
+    Value* is_unboxed = CreateAnd(
+	CreateIsNull(value.boxed),
+	CreateICmpNE(value.kind, getInt32(Runtime::REAL_SCALAR)));
+    BasicBlock* unboxed_block = createBasicBlock("unboxed_condition");
+    BasicBlock* boxed_block = createBasicBlock("boxed_condition");
+    BasicBlock* merge_block = createBasicBlock("continue");
+    CreateCondBr(is_unboxed, unboxed_block, boxed_block);
+
+    SetInsertPoint(boxed_block);
+    Value* boxed_result = Runtime::emitCoerceToTrueOrFalse(
+	emitBox(value), call, this);
+    BasicBlock* boxed_end = GetInsertBlock();
+    CreateBr(merge_block);
+
+    SetInsertPoint(unboxed_block);
+    Value* unboxed_result = CreateZExtOrTrunc(
+	CreateFCmpUNE(value.value, llvm::ConstantFP::get(getDoubleTy(), 0.0)),
+	boxed_result->getType());
+    CreateBr(merge_block);
+
+    SetInsertPoint(merge_block);
+    PHINode* result = CreatePHI(boxed_result->getType(), 2);
+    result->addIncoming(unboxed_result, unboxed_block);
+    result->addIncoming(boxed_result, boxed_end);
+    return result;
+}
+
 BasicBlock* Compiler::emitLandingPad(PHINode* dispatch) {
     InsertPointGuard preserve_insert_point(*this);
 
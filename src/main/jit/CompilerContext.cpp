@@ -21,6 +21,7 @@
  *  http://www.r-project.org/Licenses/
  */
 
+#include <algorithm>
 #include <typeinfo>
 
 #include "rho/jit/llvm.hpp"
@@ -30,11 +31,12 @@
 
 #include "rho/jit/Compiler.hpp"
 #include "rho/jit/FrameDescriptor.hpp"
-#include "rho/jit/OptimizationOptions.hpp"
 #include "rho/BuiltInFunction.hpp"
 #include "rho/Closure.hpp"
 #include "rho/Frame.hpp"
 #include "rho/LoopException.hpp"
+#include "rho/StringVector.hpp"
+#include "Rinternals.h"
 
 using llvm::BasicBlock;
 using llvm::Function;
@@ -46,6 +48,39 @@ using llvm::Value;
 namespace rho {
 namespace JIT {
 
+// Reads the optimization options from R's options().
+static OptimizationOptions getOptionsFromR()
+{
+    OptimizationOptions options;
+    RObject* level = Rf_GetOption1(Rf_install("rho.jit.optimize"));
+    if (level != R_NilValue) {
+	int value = Rf_asInteger(level);
+	if (value != NA_INTEGER)
+	    options.OptimizationLevel = std::min(std::max(value, 0), 3);
+    }
+
+    RObject* passes = Rf_GetOption1(Rf_install("rho.jit.passes"));
+    if (passes == R_NilValue && options.OptimizationLevel >= 3) {
+	options.RemoveRedundantVisibilityCalls = true;
+	options.CacheSymbolLookups = true;
+	options.RemoveRedundantInterruptChecks = true;
+    }
+    if (StringVector* names = dynamic_cast<StringVector*>(passes)) {
+	for (const String* name : *names) {
+	    if (!name)
+		continue;
+	    std::string pass = name->stdstring();
+	    if (pass == "visibility")
+		options.RemoveRedundantVisibilityCalls = true;
+	    else if (pass == "lookups")
+		options.CacheSymbolLookups = true;
+	    else if (pass == "interrupts")
+		options.RemoveRedundantInterruptChecks = true;
+	}
+    }
+    return options;
+}
+
 CompilerContext::CompilerContext(const Closure* closure,
 				 llvm::Value* environment,
 				 llvm::Function* function,
@@ -55,7 +90,12 @@ CompilerContext::CompilerContext(const Closure* closure,
     m_environment = environment;
     m_function = function;
     m_memory_manager = memory_manager;
+    m_optimization_options = getOptionsFromR();
     m_frame_descriptor = new FrameDescriptor(closure);
+    m_back_edge_counter = nullptr;
+    m_guard_failure_counter = nullptr;
+    m_lookup_caches = nullptr;
+    m_resumed_loop = nullptr;
 }
 
 CompilerContext::~CompilerContext() {
@@ -93,7 +133,11 @@ FunctionBase* CompilerContext::staticallyResolveFunction(const Symbol* symbol)
     if (!isSaneControlFlowOp && !isSaneAssignmentOp) {
 	return nullptr;
     }
+    return resolvePrimitive(symbol);
+}
 
+FunctionBase* CompilerContext::resolvePrimitive(const Symbol* symbol)
+{
     if (m_frame_descriptor->getLocation(symbol) != -1) {
 	// The symbol is shadowed in the local frame.
 	return nullptr;
@@ -101,6 +145,9 @@ FunctionBase* CompilerContext::staticallyResolveFunction(const Symbol* symbol)
 
     const Frame::Binding* binding
 	= getEnclosingEnvironment()->findBinding(symbol);
+    if (!binding) {
+	return nullptr;
+    }
     if (binding->frame() != Environment::base()->frame()
 	&& binding->frame() != Environment::baseNamespace()->frame()) {
 	// Lookup returned a binding that isn't in base, so the symbol is
@@ -108,6 +155,10 @@ FunctionBase* CompilerContext::staticallyResolveFunction(const Symbol* symbol)
 	return nullptr;
     }
 
+    if (!dynamic_cast<const BuiltInFunction*>(binding->rawValue())) {
+	// Not a primitive, so obtainPrimitive() would warn.
+	return nullptr;
+    }
     FunctionBase* builtin_definition = BuiltInFunction::obtainPrimitive(
 	symbol->name()->stdstring());
     if (binding->rawValue() != builtin_definition) {
@@ -118,13 +169,6 @@ FunctionBase* CompilerContext::staticallyResolveFunction(const Symbol* symbol)
     return builtin_definition;
 }
 
-const OptimizationOptions& CompilerContext::getOptimizationOptions()
-{
-    // TODO(kmillar): make this settable.
-    static OptimizationOptions options;
-    return options;
-}
-
 bool CompilerContext::canInlineControlFlow()
 {
     // Control flow can be inlined if all the control flow operators can be
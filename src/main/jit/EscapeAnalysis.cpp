@@ -0,0 +1,202 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#define R_NO_REMAP
+#include "rho/jit/EscapeAnalysis.hpp"
+
+#include "rho/jit/CompilerContext.hpp"
+#include "rho/jit/FrameDescriptor.hpp"
+#include "rho/ArgMatcher.hpp"
+#include "rho/Closure.hpp"
+#include "rho/ConsCell.hpp"
+#include "rho/Expression.hpp"
+#include "rho/FunctionBase.hpp"
+#include "rho/PairList.hpp"
+#include "rho/Symbol.hpp"
+#include <set>
+
+namespace rho {
+namespace JIT {
+
+namespace {
+
+// Primitives that can create closures, inspect or modify the call stack,
+// distinguish promises from values, or run arbitrary code.
+bool isUnsafePrimitive(const Symbol* symbol)
+{
+    static std::set<const Symbol*> unsafe = {
+	Symbol::obtain("function"),
+	Symbol::obtain("~"),
+	Symbol::obtain("substitute"),
+	Symbol::obtain("missing"),
+	Symbol::obtain("on.exit"),
+	Symbol::obtain("UseMethod"),
+	Symbol::obtain("standardGeneric"),
+	Symbol::obtain("browser"),
+	Symbol::obtain("forceAndCall"),
+	Symbol::obtain("as.environment"),
+	Symbol::obtain("pos.to.env"),
+	Symbol::obtain("environment<-"),
+	Symbol::obtain("lazyLoadDBfetch"),
+	Symbol::obtain(".Internal"),
+	Symbol::obtain(".Primitive"),
+	Symbol::obtain(".External"),
+	Symbol::obtain(".External2"),
+	Symbol::obtain(".External.graphics"),
+	Symbol::obtain(".Call"),
+	Symbol::obtain(".Call.graphics"),
+	Symbol::obtain(".C"),
+	Symbol::obtain(".Fortran")
+    };
+    return unsafe.count(symbol);
+}
+
+// Specials that evaluate their first argument before doing anything else.
+bool evaluatesFirstArgumentFirst(const Symbol* symbol)
+{
+    static std::set<const Symbol*> symbols = {
+	Symbol::obtain("if"),
+	Symbol::obtain("while"),
+	Symbol::obtain("&&"),
+	Symbol::obtain("||"),
+	Symbol::obtain("return"),
+	Symbol::obtain("switch"),
+	Symbol::obtain("["),
+	Symbol::obtain("[["),
+	Symbol::obtain("$")
+    };
+    return symbols.count(symbol);
+}
+
+}  // anonymous namespace
+
+EscapeAnalysis::EscapeAnalysis(const Closure* closure,
+			       CompilerContext* context)
+    : m_context(context), m_closure(closure), m_may_escape(false)
+{
+    const PairList* formals = closure->matcher()->formalArgs();
+    if (formals) {
+	for (const ConsCell& formal : *formals) {
+	    if (formal.tag() == DotsSymbol)
+		break;
+	    m_strict_arguments.push_back(false);
+	}
+	// Default arguments are evaluated in the local environment too.
+	for (const ConsCell& formal : *formals) {
+	    if (mayCapture(formal.car()))
+		m_may_escape = true;
+	}
+    }
+    if (mayCapture(closure->body()))
+	m_may_escape = true;
+    if (!m_may_escape)
+	markStrictArguments(closure->body());
+}
+
+bool EscapeAnalysis::mayCapture(const RObject* expression)
+{
+    const Expression* call = dynamic_cast<const Expression*>(expression);
+    if (!call)
+	return false;
+    const Symbol* function = dynamic_cast<const Symbol*>(call->car());
+    if (!function || isUnsafePrimitive(function)
+	|| !m_context->resolvePrimitive(function))
+	return true;
+    for (const ConsCell& item : *call) {
+	if (mayCapture(item.car()))
+	    return true;
+    }
+    return false;
+}
+
+bool EscapeAnalysis::markStrictArguments(const RObject* expression)
+{
+    const Symbol* symbol = dynamic_cast<const Symbol*>(expression);
+    if (symbol)
+	return markStrictArgument(symbol);
+    const Expression* call = dynamic_cast<const Expression*>(expression);
+    if (!call)
+	return true;
+
+    const Symbol* function_name = dynamic_cast<const Symbol*>(call->car());
+    FunctionBase* function
+	= function_name ? m_context->resolvePrimitive(function_name) : nullptr;
+    if (!function)
+	return false;
+    const PairList* arguments = call->tail();
+    if (function_name == Symbol::obtain("{")) {
+	for (; arguments; arguments = arguments->tail()) {
+	    if (!markStrictArguments(arguments->car()))
+		return false;
+	}
+	return true;
+    }
+    if (function_name == Symbol::obtain("(")) {
+	return arguments && markStrictArguments(arguments->car());
+    }
+    if (function_name == Symbol::obtain("<-")
+	|| function_name == Symbol::obtain("=")) {
+	// The value is evaluated before anything is assigned.
+	if (arguments && arguments->tail())
+	    markStrictArguments(arguments->tail()->car());
+	return false;
+    }
+    if (evaluatesFirstArgumentFirst(function_name)) {
+	if (arguments)
+	    markStrictArguments(arguments->car());
+	return false;
+    }
+    if (function->sexptype() == BUILTINSXP) {
+	// Builtins evaluate all their arguments in order before running.
+	for (; arguments; arguments = arguments->tail()) {
+	    if (!markStrictArguments(arguments->car()))
+		return false;
+	}
+    }
+    // Anything else might have side effects.
+    return false;
+}
+
+bool EscapeAnalysis::markStrictArgument(const Symbol* symbol)
+{
+    if (symbol == DotsSymbol || symbol->isDotDotSymbol())
+	return false;
+    int location = m_context->m_frame_descriptor->getLocation(symbol);
+    if (!m_context->m_frame_descriptor->isFormalParameter(location)) {
+	// Looking up other variables has no side effects.
+	return true;
+    }
+    if (location < int(m_strict_arguments.size()))
+	m_strict_arguments[location] = true;
+
+    // If the argument was omitted, evaluating the default might have side
+    // effects.
+    for (const ConsCell& formal : *m_closure->matcher()->formalArgs()) {
+	if (formal.tag() == symbol)
+	    return !dynamic_cast<const Expression*>(formal.car());
+    }
+    return true;
+}
+
+} // namespace JIT
+} // namespace rho
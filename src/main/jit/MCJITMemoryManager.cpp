@@ -43,11 +43,63 @@ static const std::string symbol_prefix = "rho.symbol.";
 static const std::string primitive_prefix = "rho.primitive.";
 static const std::string internal_prefix = "rho.internal.";
 
+std::atomic<std::size_t> MCJITMemoryManager::s_code_bytes(0);
+std::atomic<std::size_t> MCJITMemoryManager::s_data_bytes(0);
+
 MCJITMemoryManager::MCJITMemoryManager(Module* module)
-    : m_module(module) { }
+    : m_module(module), m_global_count(0), m_code_bytes(0), m_data_bytes(0)
+{ }
+
+MCJITMemoryManager::~MCJITMemoryManager()
+{
+    // SectionMemoryManager releases the memory itself.
+    s_code_bytes -= m_code_bytes;
+    s_data_bytes -= m_data_bytes;
+}
+
+uint8_t* MCJITMemoryManager::allocateCodeSection(uintptr_t size,
+						 unsigned alignment,
+						 unsigned section_id,
+						 StringRef section_name)
+{
+    m_code_bytes += size;
+    s_code_bytes += size;
+    return SectionMemoryManager::allocateCodeSection(size, alignment,
+						     section_id, section_name);
+}
+
+uint8_t* MCJITMemoryManager::allocateDataSection(uintptr_t size,
+						 unsigned alignment,
+						 unsigned section_id,
+						 StringRef section_name,
+						 bool is_read_only)
+{
+    m_data_bytes += size;
+    s_data_bytes += size;
+    return SectionMemoryManager::allocateDataSection(
+	size, alignment, section_id, section_name, is_read_only);
+}
+
+void MCJITMemoryManager::addMappings(const MCJITMemoryManager& other)
+{
+    for (const auto& mapping : other.m_mappings) {
+	// Names are unique to the object they refer to.
+	assert(!m_mappings.count(mapping.first)
+	       || m_mappings[mapping.first].first == mapping.second.first);
+	m_mappings.insert(mapping);
+    }
+}
 
 uint64_t MCJITMemoryManager::getSymbolAddress(const std::string& name)
 {
+    // Objects referred to by the module are recorded when the IR is
+    // generated, so that code generation (which may happen on a background
+    // thread) doesn't need to touch R's heap.
+    auto mapping = m_mappings.find(name);
+    if (mapping != m_mappings.end()) {
+	return reinterpret_cast<uint64_t>(mapping->second.first);
+    }
+
     if (startsWith(name, symbol_prefix)) {
 	std::string symbol_name = name.substr(symbol_prefix.length());
 	return reinterpret_cast<uint64_t>(Symbol::obtain(symbol_name));
@@ -66,11 +118,6 @@ uint64_t MCJITMemoryManager::getSymbolAddress(const std::string& name)
 	    BuiltInFunction::obtainInternal(builtin_name));
     }
 
-    auto mapping = m_mappings.find(name);
-    if (mapping != m_mappings.end()) {
-	return reinterpret_cast<uint64_t>(mapping->second.first);
-    }
-
     return RTDyldMemoryManager::getSymbolAddress(name);
 }
 
@@ -83,9 +130,11 @@ GlobalVariable* MCJITMemoryManager::getSymbol(const Symbol* symbol)
     if (result) {
 	return result;
     }
-    return new GlobalVariable(*m_module, type, true,
-			      GlobalValue::ExternalLinkage, nullptr,
-			      name);
+    result = new GlobalVariable(*m_module, type, true,
+				GlobalValue::ExternalLinkage, nullptr,
+				name);
+    m_mappings[name] = std::make_pair(const_cast<Symbol*>(symbol), result);
+    return result;
 }
 
 GlobalVariable* MCJITMemoryManager::getBuiltIn(const BuiltInFunction* function)
@@ -100,15 +149,47 @@ GlobalVariable* MCJITMemoryManager::getBuiltIn(const BuiltInFunction* function)
     if (result) {
 	return result;
     }
-    return new GlobalVariable(*m_module, type, true,
-     			      GlobalValue::ExternalLinkage, nullptr,
-			      name);
+    result = new GlobalVariable(*m_module, type, true,
+				GlobalValue::ExternalLinkage, nullptr,
+				name);
+    m_mappings[name] = std::make_pair(
+	const_cast<BuiltInFunction*>(function), result);
+    return result;
+}
+
+GlobalVariable* MCJITMemoryManager::getConstant(const void* address)
+{
+    GlobalVariable*& result = m_constants[address];
+    if (!result) {
+	Type* type = Type::getInt8Ty(m_module->getContext());
+	result = addGlobal(type, const_cast<void*>(address), true,
+			   "rho.constant");
+    }
+    return result;
+}
+
+void MCJITMemoryManager::qualifyNames(const std::string& tag)
+{
+    decltype(m_mappings) mappings;
+    for (auto& mapping : m_mappings) {
+	const std::string& name = mapping.first;
+	GlobalVariable* global = mapping.second.second;
+	if (startsWith(name, symbol_prefix)
+	    || startsWith(name, primitive_prefix)
+	    || startsWith(name, internal_prefix)) {
+	    mappings.insert(mapping);
+	    continue;
+	}
+	std::string qualified_name = tag + "." + name;
+	global->setName(qualified_name);
+	mappings[qualified_name] = mapping.second;
+    }
+    m_mappings.swap(mappings);
 }
 
-static std::string addCounter(const std::string& prefix) {
-	// Create our own, unique name.
-	static int counter = 0;
-	return prefix + "." + std::to_string(++counter);
+std::string MCJITMemoryManager::addCounter(const std::string& prefix) {
+    // Create our own, unique name.
+    return prefix + "." + std::to_string(++m_global_count);
 }
 
 GlobalVariable* MCJITMemoryManager::addGlobal(Type* type, void* address,
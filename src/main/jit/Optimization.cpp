@@ -23,26 +23,173 @@
 
 #include "rho/jit/Optimization.hpp"
 
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "rho/jit/llvm.hpp"
+#include "rho/jit/Runtime.hpp"
 
 namespace rho {
 namespace JIT {
 namespace {
 const std::string kSetVisibilityFuncName("rho_runtime_setVisibility");
+const std::string kLookupSymbolFuncName("rho_runtime_lookupSymbol");
+const std::string kLookupSymbolWithCacheFuncName(
+    "rho_runtime_lookupSymbolWithCache");
+const std::string kLookupSymbolCachedFuncName(
+    "rho_runtime_lookupSymbolCached");
+const std::string kAssignSymbolInCompiledFrameFuncName(
+    "rho_runtime_assignSymbolInCompiledFrame");
+const std::string kCheckForUserInterruptsFuncName(
+    "rho_runtime_maybeCheckForUserInterrupts");
+
+// Runtime functions that can't change any binding except by running R code
+// (which rho_runtime_lookupSymbolCached detects) or by assigning to the
+// local frame (which CacheSymbolLookups handles separately).
+const std::set<std::string> kBindingPreservingFuncNames = {
+    "rho_runtime_lookupSymbol",
+    "rho_runtime_lookupSymbolCached",
+    "rho_runtime_lookupSymbolWithCache",
+    "rho_runtime_lookupSymbolInCompiledFrame",
+    "rho_runtime_assignSymbolInCompiledFrame",
+    "rho_runtime_lookupFunction",
+    "rho_runtime_do_break",
+    "rho_runtime_do_next",
+    "rho_runtime_loopExceptionIsNext",
+    "rho_runtime_forLoopElement",
+    "rho_runtime_forLoopIndex",
+    "rho_runtime_unboxScalar",
+    "rho_runtime_boxScalar",
+    "rho_runtime_applyBinaryOperator",
+    "rho_runtime_coerceToTrueOrFalse",
+    "rho_runtime_is_function",
+    "rho_runtime_setVisibility",
+    "rho_runtime_incrementNamed",
+    "rho_runtime_maybeCheckForUserInterrupts",
+    "Rf_warning",
+};
+
+// Returns the function called by a call or invoke instruction, or null if the
+// instruction is something else or an indirect call.
+llvm::Function* getCalledFunction(llvm::Instruction* instr) {
+  if (llvm::CallInst* call = llvm::dyn_cast<llvm::CallInst>(instr))
+    return call->getCalledFunction();
+  if (llvm::InvokeInst* invoke = llvm::dyn_cast<llvm::InvokeInst>(instr))
+    return invoke->getCalledFunction();
+  return nullptr;
+}
+
+bool isCall(llvm::Instruction* instr) {
+  return llvm::isa<llvm::CallInst>(instr) || llvm::isa<llvm::InvokeInst>(instr);
+}
+
+bool preservesBindings(llvm::Function* function) {
+  if (!function)
+    return false;
+  std::string name = function->getName().str();
+  return kBindingPreservingFuncNames.count(name)
+      || name.compare(0, 5, "llvm.") == 0
+      || name.compare(0, 6, "__cxa_") == 0;
+}
+
+// Replaces 'call' with a call to 'function' with arguments 'args'.  An invoke
+// is replaced by an invoke with the same destinations.
+llvm::Instruction* replaceCall(llvm::Instruction* call,
+                               llvm::Function* function,
+                               llvm::ArrayRef<llvm::Value*> args) {
+  llvm::Instruction* replacement;
+  if (llvm::InvokeInst* invoke = llvm::dyn_cast<llvm::InvokeInst>(call)) {
+    replacement = llvm::InvokeInst::Create(function, invoke->getNormalDest(),
+                                           invoke->getUnwindDest(), args, "",
+                                           call);
+  } else {
+    replacement = llvm::CallInst::Create(function, args, "", call);
+  }
+  replacement->takeName(call);
+  call->replaceAllUsesWith(replacement);
+  call->eraseFromParent();
+  return replacement;
+}
+
+// Removes a call or invoke whose result is unused.
+void eraseCall(llvm::Instruction* call) {
+  if (llvm::InvokeInst* invoke = llvm::dyn_cast<llvm::InvokeInst>(call)) {
+    llvm::BranchInst::Create(invoke->getNormalDest(), call);
+    invoke->getUnwindDest()->removePredecessor(call->getParent());
+  }
+  call->eraseFromParent();
+}
+
+// Maps the header of each natural loop in the function to the blocks in the
+// loop.
+std::map<llvm::BasicBlock*, std::set<llvm::BasicBlock*>> findLoops(
+    llvm::Function& function, llvm::DominatorTree& dominators) {
+  std::map<llvm::BasicBlock*, std::set<llvm::BasicBlock*>> loops;
+  for (llvm::BasicBlock& block : function) {
+    if (!dominators.isReachableFromEntry(&block))
+      continue;
+    for (auto succ = llvm::succ_begin(&block); succ != llvm::succ_end(&block);
+         ++succ) {
+      llvm::BasicBlock* header = *succ;
+      if (!dominators.dominates(header, &block))
+        continue;
+      // A back edge.  The loop is everything that reaches it without going
+      // through the header.
+      std::set<llvm::BasicBlock*>& body = loops[header];
+      body.insert(header);
+      std::vector<llvm::BasicBlock*> work = {&block};
+      while (!work.empty()) {
+        llvm::BasicBlock* member = work.back();
+        work.pop_back();
+        if (!body.insert(member).second)
+          continue;
+        for (auto pred = llvm::pred_begin(member);
+             pred != llvm::pred_end(member); ++pred)
+          work.push_back(*pred);
+      }
+    }
+  }
+  return loops;
+}
+
+// True if 'first' is executed before 'second' on every path to 'second'.
+bool dominates(llvm::Instruction* first, llvm::Instruction* second,
+               llvm::DominatorTree& dominators) {
+  llvm::BasicBlock* block = first->getParent();
+  if (block != second->getParent())
+    return dominators.dominates(block, second->getParent());
+  for (llvm::Instruction& instr : *block) {
+    if (&instr == first)
+      return true;
+    if (&instr == second)
+      return false;
+  }
+  return false;
+}
 }  // namespace
 
 //------------------------------------------------------------------------------
 // Implementation of BasicFunctionPass.
 
 bool BasicFunctionPass::runOnFunction(llvm::Function& function) {
-  RemoveRedundantCallsToSetVisibility optimize_set_visibility;
   bool changed = false;
-  for (auto& block : function.getBasicBlockList()) {
-    bool block_changed = optimize_set_visibility.runOnBasicBlock(block);
-    changed = changed || block_changed;
+  if (options_.RemoveRedundantVisibilityCalls) {
+    RemoveRedundantCallsToSetVisibility optimize_set_visibility;
+    for (auto& block : function.getBasicBlockList()) {
+      bool block_changed = optimize_set_visibility.runOnBasicBlock(block);
+      changed = changed || block_changed;
+    }
+  }
+  if (options_.CacheSymbolLookups) {
+    bool lookups_changed = CacheSymbolLookups().runOnFunction(function);
+    changed = changed || lookups_changed;
+  }
+  if (options_.RemoveRedundantInterruptChecks) {
+    bool checks_changed
+        = RemoveRedundantInterruptChecks().runOnFunction(function);
+    changed = changed || checks_changed;
   }
   return changed;
 }
@@ -79,5 +226,183 @@ bool RemoveRedundantCallsToSetVisibility::runOnBasicBlock(
 // LLVM uses the address of the following variable, the value is unimportant.
 char RemoveRedundantCallsToSetVisibility::pass_id = 0;
 
+//------------------------------------------------------------------------------
+// Implementation of CacheSymbolLookups.
+
+bool CacheSymbolLookups::runOnFunction(llvm::Function& function) {
+  llvm::Module* module = function.getParent();
+  llvm::Function* lookup = module->getFunction(kLookupSymbolFuncName);
+  llvm::Function* site_lookup
+      = module->getFunction(kLookupSymbolWithCacheFuncName);
+  if ((!lookup && !site_lookup) || function.arg_empty())
+    return false;
+  llvm::Value* environment = &*function.arg_begin();
+
+  // Find the lookups in the function's own environment and the calls that
+  // might change bindings.  Symbols assigned in the local frame are left
+  // alone.
+  std::vector<llvm::Instruction*> lookups;
+  std::vector<llvm::Instruction*> clobbers;
+  std::set<llvm::Value*> assigned_symbols;
+  for (llvm::BasicBlock& block : function) {
+    for (llvm::Instruction& instr : block) {
+      if (!isCall(&instr))
+        continue;
+      llvm::Function* callee = getCalledFunction(&instr);
+      if (callee && (callee == lookup || callee == site_lookup)
+          && instr.getOperand(1) == environment) {
+        lookups.push_back(&instr);
+      } else if (callee
+                 && callee->getName() == kAssignSymbolInCompiledFrameFuncName) {
+        assigned_symbols.insert(instr.getOperand(0));
+      } else if (!preservesBindings(callee)) {
+        clobbers.push_back(&instr);
+      }
+    }
+  }
+
+  std::map<llvm::Value*, int> slots;
+  std::vector<llvm::Instruction*> cacheable;
+  for (llvm::Instruction* instr : lookups) {
+    llvm::Value* symbol = instr->getOperand(0);
+    if (!llvm::isa<llvm::Constant>(symbol) || assigned_symbols.count(symbol))
+      continue;
+    slots.insert(std::make_pair(symbol, slots.size()));
+    cacheable.push_back(instr);
+  }
+  if (cacheable.empty())
+    return false;
+
+  // The cache lives in the function's stack frame and starts out empty.
+  llvm::Function* cached_lookup
+      = Runtime::getDeclaration(kLookupSymbolCachedFuncName, module);
+  llvm::FunctionType* type = cached_lookup->getFunctionType();
+  llvm::IRBuilder<> builder(&*function.getEntryBlock().getFirstInsertionPt());
+  int size = slots.size();
+  llvm::Type* value_type = cached_lookup->getReturnType();
+  llvm::Value* cache = builder.CreateAlloca(value_type,
+                                            builder.getInt32(size),
+                                            "lookup_cache");
+  llvm::Value* version = builder.CreateAlloca(builder.getInt32Ty(), nullptr,
+                                              "lookup_cache_version");
+  llvm::Value* null_value = llvm::ConstantPointerNull::get(
+      llvm::cast<llvm::PointerType>(value_type));
+  for (int i = 0; i < size; ++i)
+    builder.CreateStore(null_value, builder.CreateConstGEP1_32(cache, i));
+  llvm::Value* invalid = builder.getInt32(~0u);
+  builder.CreateStore(invalid, version);
+  cache = builder.CreatePointerCast(cache, type->getParamType(2));
+  version = builder.CreatePointerCast(version, type->getParamType(5));
+
+  llvm::Value* no_site = llvm::ConstantPointerNull::get(
+      llvm::cast<llvm::PointerType>(type->getParamType(6)));
+  for (llvm::Instruction* instr : cacheable) {
+    llvm::Value* symbol = instr->getOperand(0);
+    // Misses still go through the lookup site's own cache, if it has one.
+    llvm::Value* site = getCalledFunction(instr) == site_lookup
+        ? instr->getOperand(2) : no_site;
+    replaceCall(instr, cached_lookup,
+                { symbol, environment, cache, builder.getInt32(slots[symbol]),
+                  builder.getInt32(size), version, site });
+  }
+
+  // Reset the cache after each call that might change a binding, including
+  // when it throws.
+  std::set<llvm::BasicBlock*> reset_blocks;
+  for (llvm::Instruction* clobber : clobbers) {
+    if (llvm::InvokeInst* invoke = llvm::dyn_cast<llvm::InvokeInst>(clobber)) {
+      reset_blocks.insert(invoke->getNormalDest());
+      reset_blocks.insert(invoke->getUnwindDest());
+    } else {
+      builder.SetInsertPoint(clobber->getParent(),
+                             ++llvm::BasicBlock::iterator(clobber));
+      builder.CreateStore(invalid, version);
+    }
+  }
+  for (llvm::BasicBlock* block : reset_blocks) {
+    builder.SetInsertPoint(&*block->getFirstInsertionPt());
+    builder.CreateStore(invalid, version);
+  }
+  return true;
+}
+
+// LLVM uses the address of the following variable, the value is unimportant.
+char CacheSymbolLookups::pass_id = 0;
+
+//------------------------------------------------------------------------------
+// Implementation of RemoveRedundantInterruptChecks.
+
+bool RemoveRedundantInterruptChecks::runOnFunction(llvm::Function& function) {
+  std::vector<llvm::Instruction*> checks;
+  for (llvm::BasicBlock& block : function) {
+    for (llvm::Instruction& instr : block) {
+      llvm::Function* callee = getCalledFunction(&instr);
+      if (callee && callee->getName() == kCheckForUserInterruptsFuncName)
+        checks.push_back(&instr);
+    }
+  }
+  if (checks.size() < 2)
+    return false;
+
+  llvm::DominatorTree dominators;
+  dominators.recalculate(function);
+  std::map<llvm::BasicBlock*, std::set<llvm::BasicBlock*>> loops
+      = findLoops(function, dominators);
+
+  // A check is redundant if another check always runs first and is in every
+  // loop that the check is in.  Then every cycle through the check also
+  // passes through the other one.  The relation is transitive, so the checks
+  // that aren't redundant suffice.
+  std::vector<llvm::Instruction*> redundant;
+  for (llvm::Instruction* check : checks) {
+    llvm::BasicBlock* block = check->getParent();
+    for (llvm::Instruction* other : checks) {
+      if (other == check || !dominates(other, check, dominators))
+        continue;
+      bool in_same_loops = true;
+      for (const auto& loop : loops) {
+        if (loop.second.count(block)
+            && !loop.second.count(other->getParent())) {
+          in_same_loops = false;
+          break;
+        }
+      }
+      if (in_same_loops) {
+        redundant.push_back(check);
+        break;
+      }
+    }
+  }
+  for (llvm::Instruction* check : redundant)
+    eraseCall(check);
+  return !redundant.empty();
+}
+
+// LLVM uses the address of the following variable, the value is unimportant.
+char RemoveRedundantInterruptChecks::pass_id = 0;
+
+//------------------------------------------------------------------------------
+// Standard LLVM passes.
+
+void runStandardPasses(llvm::Module* module, unsigned level) {
+  if (level == 0)
+    return;
+  llvm::PassManagerBuilder builder;
+  builder.OptLevel = level;
+
+  llvm::legacy::FunctionPassManager function_passes(module);
+  builder.populateFunctionPassManager(function_passes);
+  function_passes.doInitialization();
+  for (llvm::Function& function : *module) {
+    if (!function.isDeclaration())
+      function_passes.run(function);
+  }
+  function_passes.doFinalization();
+
+  llvm::legacy::PassManager module_passes;
+  builder.populateModulePassManager(module_passes);
+  module_passes.run(*module);
+}
+
 }  // namespace JIT
 }  // namespace rho
@@ -49,8 +49,7 @@ namespace Runtime {
 
 static Module* getRuntimeModule(LLVMContext& context);
 
-static llvm::Function* getDeclaration(const std::string& name,
-				      llvm::Module* module)
+llvm::Function* getDeclaration(const std::string& name, llvm::Module* module)
 {
     llvm::Function* resolved_function = module->getFunction(name);
     if (!resolved_function) {
@@ -119,6 +118,14 @@ Value* emitAssignSymbolInCompiledFrame(Value* symbol, Value* environment,
 	{ symbol, environment, compiler->getInt32(position), value });
 }
 
+Value* emitAssignSymbol(Value* symbol, Value* environment, Value* value,
+			Compiler* compiler)
+{
+    Function* assign_symbol = getDeclaration(ASSIGN_SYMBOL, compiler);
+    return compiler->emitCallOrInvoke(assign_symbol,
+				      { symbol, environment, value });
+}
+
 Value* emitLookupFunction(Value* value, Value* environment,
 			  Compiler* compiler)
 {
@@ -227,6 +234,41 @@ Value* emitLoopExceptionIsNext(Value* loop_exception, Compiler* compiler)
     return compiler->CreateCall(loop_exception_is_next, loop_exception);
 }
 
+Value* emitForLoopSequence(const Expression* call, Value* environment,
+			   Value* range_start, Value* length,
+			   Compiler* compiler)
+{
+    Function* for_loop_sequence = getDeclaration(
+	"rho_runtime_forLoopSequence", compiler);
+    Value* callp = compiler->emitConstantPointer(call);
+    return compiler->emitCallOrInvoke(
+	for_loop_sequence, { callp, environment, range_start, length });
+}
+
+Value* emitResumeForLoop(Value* range_start, Value* length, Value* start,
+			 Compiler* compiler)
+{
+    Function* resume_for_loop = getDeclaration(
+	"rho_runtime_resumeForLoop", compiler);
+    // Never throws.
+    return compiler->CreateCall(resume_for_loop,
+				{ range_start, length, start });
+}
+
+Value* emitForLoopElement(Value* sequence, Value* index, Compiler* compiler)
+{
+    Function* for_loop_element = getDeclaration(
+	"rho_runtime_forLoopElement", compiler);
+    return compiler->emitCallOrInvoke(for_loop_element, { sequence, index });
+}
+
+Value* emitForLoopIndex(Value* value, Compiler* compiler)
+{
+    Function* for_loop_index = getDeclaration(
+	"rho_runtime_forLoopIndex", compiler);
+    return compiler->emitCallOrInvoke(for_loop_index, value);
+}
+
 Value* emitGetReturnExceptionValue(Value* return_exception, Compiler* compiler)
 {
     Function* get_return_exception_value = getDeclaration(
@@ -235,6 +277,35 @@ Value* emitGetReturnExceptionValue(Value* return_exception, Compiler* compiler)
      return compiler->CreateCall(get_return_exception_value, return_exception);
 }
 
+Value* emitUnboxScalar(Value* value, Value* result, Compiler* compiler)
+{
+    Function* unbox_scalar = getDeclaration("rho_runtime_unboxScalar",
+					    compiler);
+    // Never throws.
+    return compiler->CreateCall(unbox_scalar, { value, result });
+}
+
+Value* emitBoxScalar(Value* boxed, Value* kind, Value* value,
+		     Compiler* compiler)
+{
+    Function* box_scalar = getDeclaration("rho_runtime_boxScalar", compiler);
+    return compiler->emitCallOrInvoke(box_scalar, { boxed, kind, value });
+}
+
+Value* emitApplyBinaryOperator(const Expression* call,
+			       const BuiltInFunction* op,
+			       Value* lhs, Value* rhs, Value* environment,
+			       Compiler* compiler)
+{
+    Function* apply_binary_operator = getDeclaration(
+	"rho_runtime_applyBinaryOperator", compiler);
+    return compiler->emitCallOrInvoke(
+	apply_binary_operator,
+	{ compiler->emitConstantPointer(call),
+	  compiler->emitConstantPointer(op),
+	  lhs, rhs, environment });
+}
+
 Value* emitIsAFunction(llvm::Value* object, Compiler* compiler)
 {
     Function* is_a_function = getDeclaration(
@@ -336,6 +407,8 @@ std::string getName(FunctionId function)
 	return "rho_runtime_lookupSymbolInCompiledFrame";
     case ASSIGN_SYMBOL_IN_COMPILED_FRAME:
 	return "rho_runtime_assignSymbolInCompiledFrame";
+    case ASSIGN_SYMBOL:
+	return "rho_runtime_assignSymbol";
     case LOOKUP_FUNCTION:
 	return "rho_runtime_lookupFunction";
     case CALL_FUNCTION:
@@ -355,7 +428,7 @@ std::string getName(FunctionId function)
 
 static const FunctionId allFunctionIds[]
     = { EVALUATE, LOOKUP_SYMBOL, LOOKUP_SYMBOL_IN_COMPILED_FRAME,
-	ASSIGN_SYMBOL_IN_COMPILED_FRAME,
+	ASSIGN_SYMBOL_IN_COMPILED_FRAME, ASSIGN_SYMBOL,
 	LOOKUP_FUNCTION, CALL_FUNCTION, DO_BREAK, DO_NEXT,
 	COERCE_TO_TRUE_OR_FALSE, SET_VISIBILITY, INCREMENT_NAMED };
 
@@ -375,12 +448,21 @@ namespace ForceCodeEmission {
 #define FORCE_EMISSION(FUNCTION) auto FUNCTION ## _p = &FUNCTION;
     FORCE_EMISSION(rho_runtime_evaluate);
     FORCE_EMISSION(rho_runtime_lookupSymbol);
+    FORCE_EMISSION(rho_runtime_lookupSymbolCached);
+    FORCE_EMISSION(rho_runtime_lookupSymbolWithCache);
     FORCE_EMISSION(rho_runtime_lookupSymbolInCompiledFrame);
+    FORCE_EMISSION(rho_runtime_assignSymbol);
     FORCE_EMISSION(rho_runtime_lookupFunction);
     FORCE_EMISSION(rho_runtime_callFunction);
     FORCE_EMISSION(rho_runtime_do_break);
     FORCE_EMISSION(rho_runtime_do_next);
     FORCE_EMISSION(rho_runtime_loopExceptionIsNext);
+    FORCE_EMISSION(rho_runtime_forLoopSequence);
+    FORCE_EMISSION(rho_runtime_forLoopElement);
+    FORCE_EMISSION(rho_runtime_forLoopIndex);
+    FORCE_EMISSION(rho_runtime_unboxScalar);
+    FORCE_EMISSION(rho_runtime_boxScalar);
+    FORCE_EMISSION(rho_runtime_applyBinaryOperator);
     FORCE_EMISSION(rho_runtime_coerceToTrueOrFalse);
     FORCE_EMISSION(rho_runtime_is_function);
     FORCE_EMISSION(rho_runtime_setVisibility);
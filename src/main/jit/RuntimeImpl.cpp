@@ -23,18 +23,28 @@
 
 #define R_NO_REMAP
 
+#include <algorithm>
+#include <cfloat>
+#include <climits>
 #include "rho/ArgList.hpp"
+#include "rho/BuiltInFunction.hpp"
+#include "rho/Closure.hpp"
 #include "rho/Environment.hpp"
 #include "rho/Evaluator.hpp"
 #include "rho/Expression.hpp"
 #include "rho/FunctionBase.hpp"
+#include "rho/IntVector.hpp"
 #include "rho/LoopBailout.hpp"
 #include "rho/LoopException.hpp"
 #include "rho/PairList.hpp"
+#include "rho/Promise.hpp"
 #include "rho/RObject.hpp"
+#include "rho/RealVector.hpp"
 #include "rho/StackChecker.hpp"
 #include "rho/Symbol.hpp"
+#include "rho/jit/CompiledExpression.hpp"
 #include "rho/jit/CompiledFrame.hpp"
+#include "rho/jit/SymbolLookupCache.hpp"
 #include "Defn.h"
 
 /*
@@ -51,6 +61,124 @@
 
 using namespace rho;
 
+// If 'expression' is a call with 'num_args' untagged arguments, none of them
+// '...', of the primitive 'primitive' (as found from 'environment'), returns
+// the call.  Otherwise returns null.
+static const Expression* asForLoopRangeCall(const RObject* expression,
+					    Environment* environment,
+					    const BuiltInFunction* primitive,
+					    int num_args)
+{
+    const Expression* call = dynamic_cast<const Expression*>(expression);
+    if (!call || call->car() != Symbol::obtain(primitive->name()))
+	return nullptr;
+    int n = 0;
+    for (const ConsCell& arg : *call->tail()) {
+	if (arg.tag() || arg.car() == DotsSymbol)
+	    return nullptr;
+	++n;
+    }
+    if (n != num_args)
+	return nullptr;
+    const Symbol* name = static_cast<const Symbol*>(call->car());
+    if (findFunction(name, environment) != primitive)
+	return nullptr;
+    return call;
+}
+
+// If value is a numeric scalar without attributes, sets *result to it.
+static bool getForLoopRangeBound(RObject* value, double* result)
+{
+    if (!value || value->hasAttributes() || XLENGTH(value) != 1)
+	return false;
+    switch (value->sexptype()) {
+    case INTSXP:
+	if (INTEGER(value)[0] == NA_INTEGER)
+	    return false;
+	*result = INTEGER(value)[0];
+	return true;
+    case REALSXP:
+	if (ISNAN(REAL(value)[0]))
+	    return false;
+	*result = REAL(value)[0];
+	return true;
+    default:
+	return false;
+    }
+}
+
+// Works out the sequence of a for loop whose sequence expression is a call of
+// ':', 'seq_len' or 'seq_along'.  If the sequence is an ascending range of
+// integers, sets *range_start and *length and returns null.  Otherwise
+// returns the sequence.  Returns 'unboundValue' if the expression isn't one
+// of these calls.
+static RObject* evaluateForLoopRange(const RObject* expression,
+				     Environment* environment,
+				     int* range_start, int* length)
+{
+    static const BuiltInFunction* colon = BuiltInFunction::obtainPrimitive(":");
+    static const BuiltInFunction* seq_len
+	= BuiltInFunction::obtainPrimitive("seq_len");
+    static const BuiltInFunction* seq_along
+	= BuiltInFunction::obtainPrimitive("seq_along");
+
+    const BuiltInFunction* primitive;
+    const Expression* call;
+    if ((call = asForLoopRangeCall(expression, environment, colon, 2))) {
+	primitive = colon;
+    } else if ((call = asForLoopRangeCall(expression, environment,
+					   seq_len, 1))) {
+	primitive = seq_len;
+    } else if ((call = asForLoopRangeCall(expression, environment,
+					   seq_along, 1))) {
+	primitive = seq_along;
+    } else {
+	return Symbol::unboundValue();
+    }
+
+    const PairList* args = call->tail();
+    GCStackRoot<> first(Evaluator::evaluate(args->car(), environment));
+    GCStackRoot<> second;
+    if (primitive == colon)
+	second = Evaluator::evaluate(args->tail()->car(), environment);
+
+    // These mirror seq_colon(), do_seq_len() and do_seq_along().
+    double from, to;
+    if (primitive == colon) {
+	if (getForLoopRangeBound(first, &from)
+	    && getForLoopRangeBound(second, &to)
+	    && from == int(from) && from > INT_MIN && from <= to) {
+	    double n = double(R_xlen_t(to - from + 1 + FLT_EPSILON));
+	    if (n <= INT_MAX && from + n - 1 <= INT_MAX) {
+		*range_start = int(from);
+		*length = int(n);
+		return nullptr;
+	    }
+	}
+    } else if (primitive == seq_len) {
+	if (getForLoopRangeBound(first, &to) && to >= 0 && to <= INT_MAX) {
+	    *range_start = 1;
+	    *length = int(to);
+	    return nullptr;
+	}
+    } else if (!first || (Rf_isVector(first) && !OBJECT(first))) {
+	R_xlen_t n = first ? XLENGTH(first.get()) : 0;
+	if (n <= INT_MAX) {
+	    *range_start = 1;
+	    *length = int(n);
+	    return nullptr;
+	}
+    }
+
+    // Some other case, so let the primitive deal with it.
+    if (primitive == colon) {
+	ArgList arglist({ first, second }, ArgList::EVALUATED);
+	return call->applyBuiltIn(primitive, environment, &arglist);
+    }
+    ArgList arglist({ first }, ArgList::EVALUATED);
+    return call->applyBuiltIn(primitive, environment, &arglist);
+}
+
 extern "C" {
 
 RObject* rho_runtime_evaluate(RObject* value, Environment* environment)
@@ -64,6 +192,65 @@ RObject* rho_runtime_lookupSymbol(const Symbol* value,
     return const_cast<Symbol*>(value)->evaluate(environment);
 }
 
+/*
+ * Lookup a symbol that isn't in the local frame's descriptor, using the
+ * lookup site's cache to avoid searching the enclosing environments.
+ */
+RObject* rho_runtime_lookupSymbolWithCache(const Symbol* symbol,
+					   Environment* environment,
+					   JIT::SymbolLookupCache* cache)
+{
+    Frame::Binding* binding = cache->find(symbol, environment);
+    if (binding) {
+	RObject* value = binding->unforcedValue();
+	if (!value)
+	    return nullptr;
+	if (value != Symbol::missingArgument()
+	    && value != Symbol::unboundValue()) {
+	    if (value->sexptype() == PROMSXP) {
+		value = Rf_eval(value, environment);
+		SET_NAMED(value, 2);
+	    } else if (NAMED(value) < 1) {
+		SET_NAMED(value, 1);
+	    }
+	    return value;
+	}
+    }
+    // Fallback to the interpreter, which reports any error.
+    return rho_runtime_lookupSymbol(symbol, environment);
+}
+
+/*
+ * Lookup a symbol, reusing the value found by an earlier call if no R code
+ * has run since.  'cache' holds 'size' values, one per symbol, which are
+ * valid while *version matches the count of promises forced and closures
+ * run.  Compiled code resets *version after any call that might change a
+ * binding without running R code (see CacheSymbolLookups).  If 'site' is
+ * non-null, misses are looked up through it.
+ */
+RObject* rho_runtime_lookupSymbolCached(const Symbol* symbol,
+					 Environment* environment,
+					 RObject** cache, int index, int size,
+					 unsigned int* version,
+					 JIT::SymbolLookupCache* site)
+{
+    unsigned int current = Promise::forcedCount() + Closure::executionCount();
+    if (*version != current) {
+	std::fill(cache, cache + size, nullptr);
+	*version = current;
+    }
+    if (cache[index])
+	return cache[index];
+    RObject* value
+	= site ? rho_runtime_lookupSymbolWithCache(symbol, environment, site)
+	: rho_runtime_lookupSymbol(symbol, environment);
+    // Forcing a promise or calling an active binding might have changed
+    // other bindings, so the next lookup clears the cache.
+    if (Promise::forcedCount() + Closure::executionCount() == current)
+	cache[index] = value;
+    return value;
+}
+
 /*
  * Lookup a symbol in a CompiledFrame.
  * Note that this function doesn't handle the cases where the symbol is
@@ -130,6 +317,17 @@ void rho_runtime_assignSymbolInCompiledFrame(const Symbol* symbol,
     binding->assign(value);
 }
 
+/*
+ * Assign to a symbol in a frame of any kind.
+ */
+void rho_runtime_assignSymbol(const Symbol* symbol,
+			      Environment* environment,
+			      RObject* value)
+{
+    assert(value != R_MissingArg);
+    Rf_defineVar(const_cast<Symbol*>(symbol), value, environment);
+}
+
 FunctionBase* rho_runtime_lookupFunction(const Symbol* symbol,
 					  Environment* environment)
 {
@@ -158,6 +356,177 @@ void rho_runtime_do_next(Environment* environment) {
     (new LoopBailout(environment, true))->throwException();
 }
 
+/*
+ * Evaluate the sequence of the for loop 'call'.
+ * Calls of ':', 'seq_len' and 'seq_along' that yield an ascending range of
+ * integers aren't materialized: instead *range_start and *length are set and
+ * null is returned.  Otherwise the return value is the vector to iterate over
+ * and *length is its length.
+ */
+RObject* rho_runtime_forLoopSequence(const Expression* call,
+				      Environment* environment,
+				      int* range_start, int* length)
+{
+    const RObject* expression = call->tail()->tail()->car();
+    GCStackRoot<> sequence(evaluateForLoopRange(expression, environment,
+						range_start, length));
+    if (!sequence)
+	return nullptr;
+    if (sequence == Symbol::unboundValue())
+	sequence = Evaluator::evaluate(const_cast<RObject*>(expression),
+				       environment);
+
+    // As in do_for_impl().
+    if (Rf_inherits(sequence, "factor"))
+	sequence = Rf_asCharacterFactor(sequence);
+    if (Rf_isList(sequence) || Rf_isNull(sequence))
+	sequence = Rf_coerceVector(sequence, VECSXP);
+    switch (sequence->sexptype()) {
+    case LGLSXP: case INTSXP: case REALSXP: case CPLXSXP: case STRSXP:
+    case RAWSXP: case VECSXP: case EXPRSXP:
+	break;
+    default:
+	Rf_errorcall(const_cast<Expression*>(call),
+		     _("invalid for() loop sequence"));
+    }
+    R_xlen_t n = XLENGTH(sequence.get());
+    if (n > INT_MAX)
+	Rf_errorcall(const_cast<Expression*>(call),
+		     _("invalid for() loop sequence"));
+    *length = int(n);
+
+    // Bump up NAMED to avoid modification by the loop body.
+    if (NAMED(sequence) < 2)
+	SET_NAMED(sequence, NAMED(sequence) + 1);
+    return sequence;
+}
+
+/*
+ * The sequence of a for loop that the interpreter has handed over part way
+ * through (see CompiledExpression::resumeForLoop()), in the same form as
+ * from rho_runtime_forLoopSequence().  Sets *start to the index of the next
+ * iteration.
+ */
+RObject* rho_runtime_resumeForLoop(int* range_start, int* length, int* start)
+{
+    RObject* sequence = JIT::CompiledExpression::takeResumedForLoop(start);
+    *length = int(XLENGTH(sequence));
+    if (sequence->sexptype() == INTSXP) {
+	IntVector* integers = static_cast<IntVector*>(sequence);
+	if (integers->isCompact() && integers->sequenceStep() == 1) {
+	    // Iterate over the range without looking at the sequence.
+	    *range_start = integers->sequenceStart();
+	    return nullptr;
+	}
+    }
+    return sequence;
+}
+
+/*
+ * The value of the loop variable in iteration 'index' of a for loop over
+ * 'sequence', which came from rho_runtime_forLoopSequence().
+ */
+RObject* rho_runtime_forLoopElement(RObject* sequence, int index)
+{
+    switch (sequence->sexptype()) {
+    case LGLSXP:
+	return Rf_ScalarLogical(LOGICAL(sequence)[index]);
+    case INTSXP:
+	// element() doesn't expand compact sequences.
+	return Rf_ScalarInteger(
+	    static_cast<IntVector*>(sequence)->element(index));
+    case REALSXP:
+	return Rf_ScalarReal(
+	    static_cast<RealVector*>(sequence)->element(index));
+    case CPLXSXP:
+	return Rf_ScalarComplex(COMPLEX(sequence)[index]);
+    case STRSXP:
+	return Rf_ScalarString(STRING_ELT(sequence, index));
+    case RAWSXP:
+	return Rf_ScalarRaw(RAW(sequence)[index]);
+    default: {
+	// VECSXP or EXPRSXP.  Make sure the loop variable isn't modified via
+	// other variables.
+	RObject* element = (sequence->sexptype() == VECSXP
+			    ? VECTOR_ELT(sequence, index)
+			    : XVECTOR_ELT(sequence, index));
+	if (element)
+	    SET_NAMED(element, 2);
+	return element;
+    }
+    }
+}
+
+/*
+ * The value of the loop variable in a for loop over a range of integers.
+ */
+RObject* rho_runtime_forLoopIndex(int value)
+{
+    return Rf_ScalarInteger(value);
+}
+
+/*
+ * If 'value' is a logical, integer or real scalar without attributes, which
+ * isn't an integer or logical NA, stores its value in *result and returns
+ * the corresponding Runtime::ScalarKind (1, 2 or 3 respectively).
+ * Otherwise returns Runtime::NOT_SCALAR (0).
+ */
+int rho_runtime_unboxScalar(RObject* value, double* result)
+{
+    if (!value || value->hasAttributes())
+	return 0;
+    switch (value->sexptype()) {
+    case LGLSXP:
+	if (XLENGTH(value) != 1 || LOGICAL(value)[0] == NA_LOGICAL)
+	    return 0;
+	*result = LOGICAL(value)[0];
+	return 1;
+    case INTSXP:
+	if (XLENGTH(value) != 1 || INTEGER(value)[0] == NA_INTEGER)
+	    return 0;
+	*result = INTEGER(value)[0];
+	return 2;
+    case REALSXP:
+	if (XLENGTH(value) != 1)
+	    return 0;
+	*result = REAL(value)[0];
+	return 3;
+    default:
+	return 0;
+    }
+}
+
+/*
+ * Returns 'boxed' if it is non-null.  Otherwise creates a scalar of the given
+ * kind holding 'value'.
+ */
+RObject* rho_runtime_boxScalar(RObject* boxed, int kind, double value)
+{
+    if (boxed)
+	return boxed;
+    switch (kind) {
+    case 1:
+	return Rf_ScalarLogical(int(value));
+    case 2:
+	return Rf_ScalarInteger(int(value));
+    default:
+	return Rf_ScalarReal(value);
+    }
+}
+
+/*
+ * Apply the binary arithmetic or relational operator 'op' to arguments that
+ * have already been evaluated.
+ */
+RObject* rho_runtime_applyBinaryOperator(const Expression* call,
+					 const BuiltInFunction* op,
+					 RObject* lhs, RObject* rhs,
+					 Environment* environment)
+{
+    ArgList arglist({ lhs, rhs }, ArgList::EVALUATED);
+    return call->applyBuiltIn(op, environment, &arglist);
+}
+
 bool rho_runtime_loopExceptionIsNext(void* exception) {
     LoopException* loop_exception = static_cast<LoopException*>(exception);
     return loop_exception->next();
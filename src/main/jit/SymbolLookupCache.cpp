@@ -0,0 +1,66 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+
+#include "rho/jit/SymbolLookupCache.hpp"
+
+#include "rho/Environment.hpp"
+#include "rho/Symbol.hpp"
+
+namespace rho {
+namespace JIT {
+
+Frame::Binding* SymbolLookupCache::find(const Symbol* symbol,
+					Environment* env)
+{
+    Environment* start = env;
+    if (env != Environment::global()) {
+	// As in CachingExpression::getFunction(), the local Frame is
+	// searched directly, and the cached lookup starts from the
+	// enclosing Environment.
+	Frame::Binding* binding = env->frame()->binding(symbol);
+	start = env->enclosingEnvironment();
+	if (binding || !start)
+	    return binding;
+    }
+    if (m_binding && m_environment == start
+	&& m_version == Frame::bindingSetVersion())
+	return m_binding;
+
+    // Frames beyond the global environment are on the search path,
+    // and so are tracked anyway.
+    for (Environment* e = start; e && e != Environment::global();
+	 e = e->enclosingEnvironment())
+	e->frame()->noteVariableLookup();
+    std::size_t version = Frame::bindingSetVersion();
+    Frame::Binding* binding = start->findBinding(symbol);
+    if (binding) {
+	m_environment = start;
+	m_binding = binding;
+	m_version = version;
+    }
+    return binding;
+}
+
+} // namespace JIT
+} // namespace rho
@@ -42,6 +42,7 @@
 #include "rho/ExpressionVector.hpp"
 #include "rho/FunctionContext.hpp"
 #include "rho/GCManager.hpp"
+#include "rho/GCNodeAllocator.hpp"
 #include "rho/IntVector.hpp"
 #include "rho/ListFrame.hpp"
 #include "rho/LogicalVector.hpp"
@@ -259,7 +260,36 @@ void InitMemory()
     GCManager::setReporting(R_Verbose ? &std::cerr : nullptr);
     GCManager::setGCThreshold(R_VSize);
 
+    // This has to be decided before any nodes are created.
+    const char* refcount_overflow = getenv("R_GC_REFCOUNT_OVERFLOW");
+    if (refcount_overflow && StringTrue(refcount_overflow))
+	GCNode::enableRefCountOverflow();
+
     ::initializeMemorySubsystem();
+
+    // Generational collection is experimental, so it is off by default.
+    const char* generational = getenv("R_GC_GENERATIONAL");
+    if (generational && StringTrue(generational))
+	GCNode::setGenerational(true);
+
+    const char* gc_threads = getenv("R_GC_NUM_THREADS");
+    if (gc_threads) {
+	int num_threads = atoi(gc_threads);
+	if (num_threads > 0)
+	    GCNode::setNumGCThreads(num_threads);
+    }
+
+    const char* lazy_sweep = getenv("R_GC_LAZY_SWEEP");
+    if (lazy_sweep && StringTrue(lazy_sweep))
+	GCNode::setLazySweep(true);
+
+    const char* huge_pages = getenv("R_GC_HUGE_PAGES");
+    if (huge_pages && StringTrue(huge_pages))
+	GCNodeAllocator::setHugePages(true);
+
+    const char* release_memory = getenv("R_GC_RELEASE_MEMORY");
+    if (release_memory && StringTrue(release_memory))
+	GCNodeAllocator::setReleaseFreeMemory(true);
 }
 
 
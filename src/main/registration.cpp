@@ -76,6 +76,13 @@ static R_CallMethodDef callMethods [] = {
     CALLDEF(R_getTaskCallbackNames, 0),
     CALLDEF(R_removeTaskCallback, 1),
     CALLDEF(allocstats, 0),
+    CALLDEF(heapsnapshot, 1),
+    CALLDEF(heapsampling, 2),
+    CALLDEF(jitmemstats, 0),
+    CALLDEF(jitstats, 0),
+    CALLDEF(mapvector, 5),
+    CALLDEF(argmatchcachestats, 1),
+    CALLDEF(searchpathcachestats, 1),
 
     {nullptr, nullptr, 0}
 };
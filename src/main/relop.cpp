@@ -44,6 +44,7 @@
 #include "rho/LogicalVector.hpp"
 #include "rho/RawVector.hpp"
 #include "rho/RealVector.hpp"
+#include "rho/VectorKernels.hpp"
 
 using namespace rho;
 using namespace VectorOps;
@@ -115,6 +116,59 @@ namespace {
 	return nullptr;  // -Wall
     }
 
+    VectorKernels::Comparison comparison_kernel(RELOP_TYPE code)
+    {
+	switch (code) {
+	case EQOP:
+	    return VectorKernels::Comparison::EQUAL;
+	case NEOP:
+	    return VectorKernels::Comparison::NOT_EQUAL;
+	case LTOP:
+	    return VectorKernels::Comparison::LESS;
+	case GTOP:
+	    return VectorKernels::Comparison::GREATER;
+	case LEOP:
+	    return VectorKernels::Comparison::LESS_EQUAL;
+	case GEOP:
+	    break;
+	}
+	return VectorKernels::Comparison::GREATER_EQUAL;
+    }
+
+    template <class V, typename T>
+    LogicalVector* relop_kernel(const V* vl, const V* vr, RELOP_TYPE code,
+				void (*kernel)(VectorKernels::Comparison,
+					       const T*, size_t,
+					       const T*, size_t,
+					       int*, size_t))
+    {
+	static_assert(sizeof(Logical) == sizeof(int),
+		      "The kernels write Logicals as ints");
+	if (!VectorKernels::worthwhile(std::max(vl->size(), vr->size())))
+	    return relop<V>(vl, vr, code);
+	VectorKernels::Comparison op = comparison_kernel(code);
+	return applyBinaryKernel<LogicalVector>(
+	    [=](const T* lhs, size_t lhs_stride, const T* rhs,
+		size_t rhs_stride, Logical* out, size_t n) {
+		kernel(op, lhs, lhs_stride, rhs, rhs_stride,
+		       reinterpret_cast<int*>(out), n);
+	    },
+	    GeneralBinaryAttributeCopier(),
+	    vl, vr);
+    }
+
+    LogicalVector* relop(const RealVector* vl, const RealVector* vr,
+			 RELOP_TYPE code)
+    {
+	return relop_kernel(vl, vr, code, VectorKernels::realComparison);
+    }
+
+    LogicalVector* relop(const IntVector* vl, const IntVector* vr,
+			 RELOP_TYPE code)
+    {
+	return relop_kernel(vl, vr, code, VectorKernels::intComparison);
+    }
+
     template <class V>
     LogicalVector* relop_no_order(const V* vl, const V* vr, RELOP_TYPE code)
     {
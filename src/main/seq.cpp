@@ -42,6 +42,8 @@
 #include "rho/ArgMatcher.hpp"
 #include "rho/ExpressionVector.hpp"
 #include "rho/GCStackRoot.hpp"
+#include "rho/IntVector.hpp"
+#include "rho/RealVector.hpp"
 
 using namespace rho;
 
@@ -106,6 +108,11 @@ static SEXP cross_colon(SEXP call, SEXP s, SEXP t)
 /* interval at which to check interrupts */
 #define NINTERRUPT 1000000U
 
+/* Integer and real sequences and constant vectors at least this long
+   are created in compact form, so that e.g. for(i in 1:n) or sum(1:n)
+   doesn't store all n elements. */
+#define MIN_COMPACT_LENGTH 128
+
 static SEXP seq_colon(double n1, double n2, SEXP call)
 {
     double r = fabs(n2 - n1);
@@ -126,6 +133,12 @@ static SEXP seq_colon(double n1, double n2, SEXP call)
 	    if(r <= INT_MIN || r > INT_MAX) useInt = FALSE;
 	}
     }
+    if (n >= MIN_COMPACT_LENGTH)
+	return useInt
+	    ? static_cast<SEXP>(IntVector::createSequence(
+				    int(n1), n1 <= n2 ? 1 : -1, n))
+	    : static_cast<SEXP>(RealVector::createSequence(
+				    n1, n1 <= n2 ? 1.0 : -1.0, n));
     if (useInt) {
 	int in1 = (int)(n1);
 	ans = allocVector(INTSXP, n);
@@ -284,6 +297,13 @@ static SEXP rep3(SEXP s, R_xlen_t ns, R_xlen_t na)
     R_xlen_t i, j;
     SEXP a;
 
+    if (ns == 1 && na >= MIN_COMPACT_LENGTH) {
+	if (TYPEOF(s) == INTSXP)
+	    return IntVector::createSequence(INTEGER(s)[0], 0, na);
+	if (TYPEOF(s) == REALSXP)
+	    return RealVector::createSequence(REAL(s)[0], 0, na);
+    }
+
     PROTECT(a = allocVector(TYPEOF(s), na));
 
     switch (TYPEOF(s)) {
@@ -939,6 +959,11 @@ SEXP attribute_hidden do_seq_along(/*const*/ Expression* call, const BuiltInFunc
     R_xlen_t len = length->sexptype() == INTSXP ?
 	INTEGER(length)[0] : REAL(length)[0];
 
+    if (len >= MIN_COMPACT_LENGTH) {
+	if (len > INT_MAX)
+	    return RealVector::createSequence(1, 1, len);
+	return IntVector::createSequence(1, 1, len);
+    }
 #ifdef LONG_VECTOR_SUPPORT
     if (len > INT_MAX) {
 	ans = allocVector(REALSXP, len);
@@ -980,6 +1005,11 @@ SEXP attribute_hidden do_seq_len(/*const*/ Expression* call, const BuiltInFuncti
 	errorcall(call, _("argument must be coercible to non-negative integer"));
 #endif
 
+    if (len >= MIN_COMPACT_LENGTH) {
+	if (len > INT_MAX)
+	    return RealVector::createSequence(1, 1, len);
+	return IntVector::createSequence(1, 1, len);
+    }
  #ifdef LONG_VECTOR_SUPPORT
     if (len > INT_MAX) {
 	ans = allocVector(REALSXP, len);
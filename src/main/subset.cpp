@@ -458,11 +458,13 @@ SEXP attribute_hidden do_subset_dflt(SEXP call, SEXP op, SEXP args, SEXP rho)
 	    switch (TYPEOF(x)) {
 	    case REALSXP:
 		if (i >= 1 && i <= XLENGTH(x))
-		    return ScalarReal( REAL(x)[i-1] );
+		    return ScalarReal(
+			static_cast<RealVector*>(x)->element(i-1) );
 		break;
 	    case INTSXP:
 		if (i >= 1 && i <= XLENGTH(x))
-		    return ScalarInteger( INTEGER(x)[i-1] );
+		    return ScalarInteger(
+			static_cast<IntVector*>(x)->element(i-1) );
 		break;
 	    case LGLSXP:
 		if (i >= 1 && i <= XLENGTH(x))
@@ -503,11 +505,13 @@ SEXP attribute_hidden do_subset_dflt(SEXP call, SEXP op, SEXP args, SEXP rho)
 		    switch (TYPEOF(x)) {
 		    case REALSXP:
 			if (k < LENGTH(x))
-			    return ScalarReal( REAL(x)[k] );
+			    return ScalarReal(
+				static_cast<RealVector*>(x)->element(k) );
 			break;
 		    case INTSXP:
 			if (k < LENGTH(x))
-			    return ScalarInteger( INTEGER(x)[k] );
+			    return ScalarInteger(
+				static_cast<IntVector*>(x)->element(k) );
 			break;
 		    case LGLSXP:
 			if (k < LENGTH(x))
@@ -803,9 +807,10 @@ SEXP attribute_hidden do_subset2_dflt(SEXP call, SEXP op,
 	case LGLSXP:
 	    return Rf_ScalarLogical(LOGICAL(x)[offset]);
 	case INTSXP:
-	    return Rf_ScalarInteger(INTEGER(x)[offset]);
+	    return Rf_ScalarInteger(
+		static_cast<IntVector*>(x)->element(offset));
 	case REALSXP:
-	    return Rf_ScalarReal(REAL(x)[offset]);
+	    return Rf_ScalarReal(static_cast<RealVector*>(x)->element(offset));
 	case CPLXSXP:
 	    return Rf_ScalarComplex(COMPLEX(x)[offset]);
 	case STRSXP:
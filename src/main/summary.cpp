@@ -34,6 +34,8 @@
 
 #include "rho/Closure.hpp"
 #include "rho/GCStackRoot.hpp"
+#include "rho/IntVector.hpp"
+#include "rho/RealVector.hpp"
 #include <R_ext/Itermacros.h>
 
 using namespace rho;
@@ -140,6 +142,62 @@ static Rboolean rsum(double *x, R_xlen_t n, double *value, Rboolean narm)
     return updated;
 }
 
+/* Sums of compact vectors (see FixedVector::createSequence) are worked
+   out without expanding them.  The results are the same as isum() and
+   rsum() would give on the expanded vectors. */
+static Rboolean compact_isum(const IntVector* x, int *value, Rboolean narm,
+			     SEXP call)
+{
+    R_xlen_t n = x->size();
+    int first = x->sequenceStart(), step = x->sequenceStep();
+    if (n == 0)
+	return FALSE;
+    // Only a constant vector can contain NAs.
+    if (first == NA_INTEGER) {
+	if (narm)
+	    return FALSE;
+	*value = NA_INTEGER;
+	return TRUE;
+    }
+    LDOUBLE s = (LDOUBLE) first * n + (LDOUBLE) step * n * (n - 1) / 2;
+    if(s > INT_MAX || s < R_INT_MIN){
+	warningcall(call, _("integer overflow - use sum(as.numeric(.))"));
+	*value = NA_INTEGER;
+    }
+    else *value = int( s);
+    return TRUE;
+}
+
+static Rboolean compact_rsum(const RealVector* x, double *value,
+			     Rboolean narm)
+{
+    R_xlen_t n = x->size();
+    double first = x->sequenceStart(), step = x->sequenceStep();
+    // The closed form is exact if every element and partial sum is an
+    // integer small enough to be represented exactly.
+    double bound = fabs(first) + fabs(step) * double(n);
+    if (n > 0 && R_FINITE(bound) && first == floor(first)
+	&& step == floor(step) && bound * double(n) < 4503599627370496.0) {
+	*value = first * double(n) + step * (double(n) * double(n - 1) / 2);
+	return TRUE;
+    }
+    LDOUBLE s = 0.0;
+    Rboolean updated = FALSE;
+
+    for (R_xlen_t i = 0; i < n; i++) {
+	double xi = x->element(i);
+	if (!narm || !ISNAN(xi)) {
+	    if(!updated) updated = TRUE;
+	    s += xi;
+	}
+    }
+    if(s > DBL_MAX) *value = R_PosInf;
+    else if (s < -DBL_MAX) *value = R_NegInf;
+    else *value = (double) s;
+
+    return updated;
+}
+
 static Rboolean csum(Rcomplex *x, R_xlen_t n, Rcomplex *value, Rboolean narm)
 {
     LDOUBLE sr = 0.0, si = 0.0;
@@ -623,9 +681,14 @@ SEXP attribute_hidden do_summary(SEXP call, SEXP op, SEXP args, SEXP env)
 		switch(TYPEOF(a)) {
 		case LGLSXP:
 		case INTSXP:
-		    updated = isum(TYPEOF(a) == LGLSXP ?
-				   LOGICAL(a) :INTEGER(a), XLENGTH(a),
-				   &itmp, narm, call);
+		    if (TYPEOF(a) == INTSXP
+			&& static_cast<IntVector*>(a)->isCompact())
+			updated = compact_isum(static_cast<IntVector*>(a),
+					       &itmp, narm, call);
+		    else
+			updated = isum(TYPEOF(a) == LGLSXP ?
+				       LOGICAL(a) :INTEGER(a), XLENGTH(a),
+				       &itmp, narm, call);
 		    if(updated) {
 			if(itmp == NA_INTEGER) goto na_answer;
 			if(ans_type == INTSXP) {
@@ -644,7 +707,11 @@ SEXP attribute_hidden do_summary(SEXP call, SEXP op, SEXP args, SEXP env)
 			ans_type = REALSXP;
 			if(!empty) zcum.r = Int2Real(icum);
 		    }
-		    updated = rsum(REAL(a), XLENGTH(a), &tmp, narm);
+		    if (static_cast<RealVector*>(a)->isCompact())
+			updated = compact_rsum(static_cast<RealVector*>(a),
+					       &tmp, narm);
+		    else
+			updated = rsum(REAL(a), XLENGTH(a), &tmp, narm);
 		    if(updated) {
 			zcum.r += tmp;
 		    }
@@ -0,0 +1,67 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+#include "EvaluationTests.hpp"
+#include "rho/Expression.hpp"
+#include "rho/GCStackRoot.hpp"
+
+using namespace rho;
+
+namespace {
+    double evalToReal(const char* expression) {
+	GCStackRoot<> result(
+	    Executor::InterpreterExecutor()->parseAndEval(expression));
+	return Rf_asReal(result);
+    }
+}
+
+TEST(ArgMatchCacheTest, RepeatedCallsHitTheCache) {
+    CachingExpression::resetCacheStatistics();
+    EXPECT_EQ(55, evalToReal(
+	"{ f <- function(x, y) x + y; s <- 0;"
+	"  for (i in 1:10) s <- s + f(y = i, 0); s }"));
+    CachingExpression::CacheStatistics stats
+	= CachingExpression::cacheStatistics();
+    EXPECT_LE(9u, stats.hits);
+    EXPECT_EQ(0u, stats.megamorphic);
+}
+
+TEST(ArgMatchCacheTest, PolymorphicCallSites) {
+    CachingExpression::resetCacheStatistics();
+    EXPECT_EQ(6 * (1 + 2 + 3), evalToReal(
+	"{ fs <- list(function(a) a, function(b) 2 * b, function(c) 3 * c);"
+	"  s <- 0; for (i in 1:3) for (f in fs) s <- s + f(i); s }"));
+    CachingExpression::CacheStatistics stats
+	= CachingExpression::cacheStatistics();
+    EXPECT_EQ(0u, stats.megamorphic);
+    EXPECT_LE(6u, stats.hits);
+}
+
+TEST(ArgMatchCacheTest, MegamorphicCallSitesStillMatchCorrectly) {
+    CachingExpression::resetCacheStatistics();
+    EXPECT_EQ(10 * 2, evalToReal(
+	"{ s <- 0; for (i in 1:10) { f <- function(x, y = 1) x + y;"
+	"  s <- s + f(1) }; s }"));
+    EXPECT_LT(0u, CachingExpression::cacheStatistics().megamorphic);
+}
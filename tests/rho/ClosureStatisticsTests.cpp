@@ -0,0 +1,79 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#define R_NO_REMAP
+#include "rho/jit/ClosureStatistics.hpp"
+#include "rho/jit/CompiledExpression.hpp"
+
+#include <algorithm>
+#include "rho/Closure.hpp"
+#include "rho/GCStackRoot.hpp"
+#include "EvaluationTests.hpp"
+
+using namespace rho;
+using namespace rho::JIT;
+
+namespace {
+    RObject* eval(const char* expression, Environment* env)
+    {
+	return Executor::parseAndEvalWithInterpreter(expression, env);
+    }
+
+    bool isListed(const ClosureStatistics* statistics)
+    {
+	std::vector<const ClosureStatistics*> all = ClosureStatistics::all();
+	return std::find(all.begin(), all.end(), statistics) != all.end();
+    }
+}
+
+TEST(ClosureStatisticsTest, CountsCompilationsAndCalls) {
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    GCStackRoot<Closure> f(SEXP_downcast<Closure*>(
+	eval("f <- function(x) x + 1", env)));
+    f->compile();
+    eval("{ f(1); f(2); f(3) }", env);
+
+    std::shared_ptr<ClosureStatistics> statistics = f->jitStatistics();
+    EXPECT_EQ(f.get(), statistics->closure());
+    EXPECT_EQ(1u, statistics->compilations);
+    EXPECT_EQ(0u, statistics->optimized_compilations);
+    EXPECT_EQ(0u, statistics->failed_compilations);
+    EXPECT_LT(0, statistics->compile_seconds);
+    EXPECT_EQ(3u, statistics->compiled_calls);
+    EXPECT_EQ(0u, statistics->frame_layout_mismatches);
+    EXPECT_EQ(0u, statistics->guard_failures);
+    EXPECT_TRUE(isListed(statistics.get()));
+}
+
+TEST(ClosureStatisticsTest, OnlyCompiledClosuresAreListed) {
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    GCStackRoot<Closure> f(SEXP_downcast<Closure*>(
+	eval("f <- function(x) x", env)));
+    std::size_t listed = ClosureStatistics::all().size();
+    eval("f(1)", env);
+    EXPECT_EQ(listed, ClosureStatistics::all().size());
+    f->compile();
+    EXPECT_EQ(listed + 1, ClosureStatistics::all().size());
+}
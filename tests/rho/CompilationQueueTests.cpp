@@ -0,0 +1,207 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+#define R_NO_REMAP
+#include "rho/jit/CodeCache.hpp"
+#include "rho/jit/CompilationQueue.hpp"
+#include "rho/jit/CompiledExpression.hpp"
+
+#include "rho/Closure.hpp"
+#include "rho/GCManager.hpp"
+#include "rho/GCStackRoot.hpp"
+#include "EvaluationTests.hpp"
+
+using namespace rho;
+using namespace rho::JIT;
+
+namespace {
+    Closure* makeClosure(const char* definition)
+    {
+	RObject* value
+	    = Executor::parseAndEvalWithInterpreter(definition);
+	return SEXP_downcast<Closure*>(value);
+    }
+
+    void compileF(Environment* env)
+    {
+	GCStackRoot<Closure> f(SEXP_downcast<Closure*>(
+	    Executor::parseAndEvalWithInterpreter("f", env)));
+	f->compile();
+    }
+
+    double evalToReal(const char* expression, Environment* env)
+    {
+	return Rf_asReal(Executor::parseAndEvalWithInterpreter(expression,
+							       env));
+    }
+
+    // Caches code in a directory for the duration of a test, and then
+    // deletes the directory.
+    struct CodeCacheScope {
+	explicit CodeCacheScope(const std::string& directory)
+	    : m_directory(directory)
+	{
+	    CompilationQueue::waitUntilIdle();
+	    CodeCache::setDirectory(directory);
+	}
+
+	~CodeCacheScope() {
+	    CompilationQueue::waitUntilIdle();
+	    CodeCache::setDirectory("");
+	    if (DIR* dir = opendir(m_directory.c_str())) {
+		while (dirent* entry = readdir(dir)) {
+		    std::string name = entry->d_name;
+		    if (name != "." && name != "..")
+			std::remove((m_directory + "/" + name).c_str());
+		}
+		closedir(dir);
+	    }
+	    rmdir(m_directory.c_str());
+	}
+
+	std::string m_directory;
+    };
+}
+
+TEST(CompilationQueueTest, CompilesInBackground) {
+    GCStackRoot<Closure> closure(makeClosure(
+	"function(n) { x <- 0; for (i in 1:n) x <- x + i; x }"));
+
+    GCStackRoot<const CompiledExpression> code(
+	CompiledExpression::compileFunctionBodyInBackground(closure, false));
+    ASSERT_TRUE(code.get() != nullptr);
+    CompilationQueue::waitUntilIdle();
+
+    EXPECT_EQ(0u, CompilationQueue::pendingJobs());
+    EXPECT_TRUE(code->isReady());
+    EXPECT_FALSE(code->isOptimized());
+}
+
+TEST(CompilationQueueTest, OptimizedCode) {
+    GCStackRoot<Closure> closure(makeClosure("function(x) x * 2 + 1"));
+
+    GCStackRoot<const CompiledExpression> code(
+	CompiledExpression::compileFunctionBodyInBackground(closure, true));
+    ASSERT_TRUE(code.get() != nullptr);
+    CompilationQueue::waitUntilIdle();
+
+    EXPECT_TRUE(code->isReady());
+    EXPECT_TRUE(code->isOptimized());
+}
+
+TEST(CompilationQueueTest, CompilesWaitingJobsTogether) {
+    GCStackRoot<Closure> f(makeClosure("function(x) x + 1"));
+    GCStackRoot<Closure> g(makeClosure("function(x) x - 1"));
+    std::size_t engines = CompilationQueue::memoryStatistics().engines;
+
+    GCStackRoot<const CompiledExpression> f_code, g_code;
+    {
+	// Holding the LLVM lock keeps the worker waiting until both jobs are
+	// queued.
+	std::lock_guard<std::recursive_mutex> lock(
+	    CompilationQueue::llvmMutex());
+	f_code = CompiledExpression::compileFunctionBodyInBackground(f, false);
+	g_code = CompiledExpression::compileFunctionBodyInBackground(g, false);
+    }
+    ASSERT_TRUE(f_code.get() != nullptr);
+    ASSERT_TRUE(g_code.get() != nullptr);
+    CompilationQueue::waitUntilIdle();
+
+    EXPECT_TRUE(f_code->isReady());
+    EXPECT_TRUE(g_code->isReady());
+    EXPECT_EQ(engines + 1, CompilationQueue::memoryStatistics().engines);
+}
+
+TEST(CompilationQueueTest, FreesCodeWhenCollected) {
+    GCStackRoot<Closure> closure(makeClosure("function(x) x * 3"));
+    JITMemoryStatistics before = CompilationQueue::memoryStatistics();
+    {
+	GCStackRoot<const CompiledExpression> code(
+	    CompiledExpression::compileFunctionBody(closure));
+	JITMemoryStatistics during = CompilationQueue::memoryStatistics();
+	EXPECT_EQ(before.functions + 1, during.functions);
+	EXPECT_LT(before.code_bytes, during.code_bytes);
+    }
+    GCManager::gc();
+    // The code is freed by the background thread.
+    CompilationQueue::waitUntilIdle();
+
+    JITMemoryStatistics after = CompilationQueue::memoryStatistics();
+    EXPECT_EQ(before.functions, after.functions);
+    EXPECT_EQ(before.code_bytes, after.code_bytes);
+}
+
+TEST(CompilationQueueTest, CompilesIdenticalFunctions) {
+    // Identical code is given identical names when the code cache is
+    // enabled, so it mustn't end up sharing an engine.
+    char directory[] = "/tmp/rho-code-cache-XXXXXX";
+    ASSERT_TRUE(mkdtemp(directory) != nullptr);
+    CodeCacheScope scope(directory);
+    GCStackRoot<Closure> f(makeClosure("function(x) x + 2"));
+    GCStackRoot<Closure> g(makeClosure("function(x) x + 2"));
+
+    GCStackRoot<const CompiledExpression> f_code, g_code;
+    {
+	std::lock_guard<std::recursive_mutex> lock(
+	    CompilationQueue::llvmMutex());
+	f_code = CompiledExpression::compileFunctionBodyInBackground(f, false);
+	g_code = CompiledExpression::compileFunctionBodyInBackground(g, false);
+    }
+    ASSERT_TRUE(f_code.get() != nullptr);
+    ASSERT_TRUE(g_code.get() != nullptr);
+    CompilationQueue::waitUntilIdle();
+
+    EXPECT_TRUE(f_code->isReady());
+    EXPECT_TRUE(g_code->isReady());
+}
+
+TEST(CompilationQueueTest, CodeCacheRoundTrip) {
+    char directory[] = "/tmp/rho-code-cache-XXXXXX";
+    ASSERT_TRUE(mkdtemp(directory) != nullptr);
+    CodeCacheScope scope(directory);
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    const char* definition = "f <- function(x) x * 7 + 1";
+
+    Executor::parseAndEvalWithInterpreter(definition, env);
+    compileF(env);
+    EXPECT_EQ(1u, CodeCache::get()->stores());
+    EXPECT_EQ(0u, CodeCache::get()->hits());
+    EXPECT_EQ(15, evalToReal("f(2)", env));
+
+    // Drop the code, then compile an identical function.
+    Executor::parseAndEvalWithInterpreter("rm(f)", env);
+    GCManager::gc();
+    Executor::parseAndEvalWithInterpreter(definition, env);
+    compileF(env);
+    EXPECT_EQ(1u, CodeCache::get()->stores());
+    EXPECT_EQ(1u, CodeCache::get()->hits());
+    EXPECT_EQ(22, evalToReal("f(3)", env));
+}
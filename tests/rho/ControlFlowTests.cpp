@@ -168,6 +168,34 @@ TEST_P(ControlFlowTest, While)
 	});
 }
 
+TEST_P(ControlFlowTest, For)
+{
+    runEvaluatorTests({
+	    { "for(i in NULL) 1", "NULL" },
+	    { "{ i <- 5; for(i in integer()) 1; i }", "NULL" },
+	    { "{ x <- 0; for(i in 1:4) x <- x + i; x }", "10" },
+	    { "{ for(i in 1:4) 1; i }", "4L" },
+	    { "{ for(i in 2.5:4) 1; i }", "3.5" },
+	    { "{ x <- 0; for(i in 3:1) x <- x * 10 + i; x }", "321" },
+	    { "{ x <- 0; for(i in seq_len(3)) x <- x + i; x }", "6" },
+	    { "{ x <- 0; for(i in seq_along(c('a', 'b'))) x <- x + i; x }",
+		    "3" },
+	    { "{ x <- ''; for(s in c('a', 'b')) x <- paste0(x, s); x }",
+		    "'ab'" },
+	    { "{ x <- 0; for(e in list(1, 2L, 3)) x <- x + e; x }", "6" },
+	    { "{ x <- 0; for(i in 1:10) { if (i > 3) break; x <- x + i }; x }",
+		    "6" },
+	    { "{ x <- 0; for(i in 1:4) { if (i %% 2 == 0) next; x <- x + i };"
+	      " x }", "4" },
+	    { "{ `:` <- function(a, b) c(b, a); x <- 0;"
+	      " for(i in 1:2) x <- x * 10 + i; x }", "21" },
+
+	    // Error cases.
+	    { "for(i in quote(a)) 1",
+		    Error("invalid for() loop sequence") },
+	});
+}
+
 TEST_P(ControlFlowTest, Repeat)
 {
     runEvaluatorTests({
@@ -180,6 +208,37 @@ TEST_P(ControlFlowTest, Repeat)
 	});
 }
 
+// Loops that run long enough for the interpreter to switch to compiled code
+// part way through.
+TEST_P(ControlFlowTest, LongRunningLoops)
+{
+    runEvaluatorTests({
+	    { "{ x <- 0; for(i in 1:20000) x <- x + i; c(x, i) }",
+		    "c(200010000, 20000)" },
+	    { "{ x <- ''; for(s in rep(c('a', 'b'), 10000)) x <- s; x }",
+		    "'b'" },
+	    { "{ i <- 0; while(i < 20000) i <- i + 1; i }", "20000" },
+	    { "{ i <- 0; repeat { i <- i + 1; if (i == 20000) break }; i }",
+		    "20000" },
+	    { "local({ y <- 2; i <- 0; while(i < 20000) i <- i + y;"
+	      " c(i, y, exists('i', inherits = FALSE)) })",
+		    "c(20000, 2, 1)" },
+	    { "(function(n) { for(i in seq_len(n)) if (i == 15000) return(i);"
+	      " 0 })(20000)", "15000L" },
+	    { "(function() { i <- 0; while(TRUE) { i <- i + 1;"
+	      " if (i > 12000) stop('foo') } })()", Error("foo") },
+	    // Later runs of a loop reuse its code.
+	    { "{ x <- 0; for(j in 1:3) for(i in 1:20000) x <- x + 1; c(x, i) }",
+		    "c(60000, 20000)" },
+	    { "{ f <- function(n) { x <- 0; for(i in seq_len(n)) x <- x + i;"
+	      " x }; c(f(20000), f(20000), f(3)) }",
+		    "c(200010000, 200010000, 6)" },
+	    { "{ f <- function(v) { n <- 0; for(s in v) if (s == 'b')"
+	      " n <- n + 1; n }; v <- rep(c('a', 'b'), 15000); c(f(v), f(v)) }",
+		    "c(15000, 15000)" },
+	});
+}
+
 TEST_P(ControlFlowTest, StopInsideLoop)
 {
     runEvaluatorTests({
@@ -192,7 +251,7 @@ TEST_P(ControlFlowTest, StopInsideLoop)
       });
 }
 
-// TODO(kmillar): Test break, next, for
+// TODO(kmillar): Test break, next
 
 INSTANTIATE_TEST_CASE_P(InterpreterControlFlowTest,
                         ControlFlowTest,
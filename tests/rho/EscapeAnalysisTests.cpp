@@ -0,0 +1,132 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#define R_NO_REMAP
+#include "rho/jit/CompilerContext.hpp"
+#include "rho/jit/EscapeAnalysis.hpp"
+
+#include "rho/Closure.hpp"
+#include "rho/GCStackRoot.hpp"
+#include "EvaluationTests.hpp"
+
+using namespace rho;
+using namespace rho::JIT;
+
+namespace {
+    Closure* makeClosure(const char* definition, Environment* env)
+    {
+	RObject* value
+	    = Executor::parseAndEvalWithInterpreter(definition, env);
+	return SEXP_downcast<Closure*>(value);
+    }
+
+    struct Analysis {
+	explicit Analysis(const char* definition)
+	    : closure(makeClosure(definition, Executor::newTestEnv())),
+	      context(closure, nullptr, nullptr, nullptr),
+	      analysis(closure, &context) { }
+
+	GCStackRoot<Closure> closure;
+	JIT::CompilerContext context;
+	EscapeAnalysis analysis;
+    };
+
+    double evalToReal(const char* expression, Environment* env)
+    {
+	RObject* value = Executor::parseAndEvalWithInterpreter(expression,
+							       env);
+	return Rf_asReal(value);
+    }
+}
+
+TEST(EscapeAnalysisTest, PrimitivesOnly) {
+    Analysis a("function(x, y) { z <- x * 2; if (z > 1) y else 0 }");
+    EXPECT_FALSE(a.analysis.environmentMayEscape());
+    EXPECT_EQ(std::vector<bool>({ true, false }),
+	      a.analysis.strictArguments());
+}
+
+TEST(EscapeAnalysisTest, StrictArgumentsStopAtDots) {
+    Analysis a("function(x, ..., y) x + y");
+    EXPECT_FALSE(a.analysis.environmentMayEscape());
+    EXPECT_EQ(std::vector<bool>({ true }), a.analysis.strictArguments());
+}
+
+TEST(EscapeAnalysisTest, CapturingCalls) {
+    EXPECT_TRUE(Analysis("function(x) function() x")
+		.analysis.environmentMayEscape());
+    EXPECT_TRUE(Analysis("function(x) environment()")
+		.analysis.environmentMayEscape());
+    EXPECT_TRUE(Analysis("function(x) substitute(x)")
+		.analysis.environmentMayEscape());
+    EXPECT_TRUE(Analysis("function(x, y = sys.function()) x")
+		.analysis.environmentMayEscape());
+    EXPECT_TRUE(Analysis("function(x) { c <- list; c(x) }")
+		.analysis.environmentMayEscape());
+}
+
+TEST(EscapeAnalysisTest, ReusesEnvironment) {
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    GCStackRoot<Closure> f(makeClosure(
+	"f <- function(x, y) { z <- x * y; z + 1 }", env));
+    f->compile();
+
+    EXPECT_EQ(7, evalToReal("f(2, 3)", env));
+    EXPECT_EQ(13, evalToReal("{ a <- 3; b <- 4; f(a, b) }", env));
+    EXPECT_EQ(10, evalToReal("f(f(1, 2), 3)", env));
+}
+
+TEST(EscapeAnalysisTest, KeepsEnvironmentCapturedByMethod) {
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    GCStackRoot<Closure> f(makeClosure(
+	"f <- function(x) { z <- 5; x + 1 }", env));
+    f->compile();
+    // The method captures f's environment.
+    Executor::parseAndEvalWithInterpreter(
+	"{ captured <- NULL;"
+	"  Ops.escapes <- function(e1, e2) {"
+	"    captured <<- parent.frame(); 0 } }",
+	env);
+
+    Executor::parseAndEvalWithInterpreter(
+	"f(structure(1, class = 'escapes'))", env);
+    EXPECT_EQ(1, evalToReal("f(1) - 1", env));
+    EXPECT_EQ(5, evalToReal("get('z', captured)", env));
+}
+
+TEST(EscapeAnalysisTest, ForcesArgumentsInOrder) {
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    GCStackRoot<Closure> f(makeClosure("f <- function(x, y) x + y", env));
+    f->compile();
+
+    // Forcing the first argument changes the variable passed as the second.
+    Executor::parseAndEvalWithInterpreter(
+	"{ v <- 1;"
+	"  makeActiveBinding('w', function() { v <<- 10; 2 }, environment());"
+	"  g <- function(p) f(p, v) }",
+	env);
+    EXPECT_EQ(12, evalToReal("f(w, v)", env));
+    EXPECT_EQ(12, evalToReal("{ v <- 1; g({ v <- 10; 2 }) }", env));
+}
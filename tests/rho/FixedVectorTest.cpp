@@ -25,7 +25,12 @@
 #include "rho/FixedVector.hpp"
 #include "rho/IntVector.hpp"
 #include "rho/ListVector.hpp"
+#include "rho/MemoryBank.hpp"
 #include "rho/RealVector.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <vector>
 
 using namespace rho;
 
@@ -64,6 +69,7 @@ TEST(IntegerVectorTest, ScalarConstructor) {
     IntVector* scalar = IntVector::createScalar(17);
     ASSERT_EQ(1, scalar->size());
     EXPECT_EQ(17, (*scalar)[0]);
+    EXPECT_TRUE(scalar->hasInlineData());
 }
 
 TEST(IntegerVectorTest, InitializerListConstructor) {
@@ -83,3 +89,85 @@ TEST(IntegerVectorTest, ShortInitializerListConstructor) {
     object = IntVector::create({ });
     EXPECT_EQ(0, object->size());
 }
+
+TEST(IntegerVectorTest, CompactSequence) {
+    IntVector* object = IntVector::createSequence(5, -2, 1000);
+    ASSERT_EQ(1000, object->size());
+    EXPECT_TRUE(object->isCompact());
+    EXPECT_EQ(5, object->element(0));
+    EXPECT_EQ(-1993, object->element(999));
+    EXPECT_TRUE(object->isCompact());
+
+    // Taking the address of the data expands the vector.
+    int* data = &(*object)[0];
+    EXPECT_FALSE(object->isCompact());
+    EXPECT_FALSE(object->hasInlineData());
+    EXPECT_EQ(5, data[0]);
+    EXPECT_EQ(3, data[1]);
+    EXPECT_EQ(-1993, data[999]);
+    EXPECT_EQ(-1993, object->element(999));
+
+    // Pointers into the expanded data refer to the vector, so finding
+    // them on the stack keeps it alive.
+    EXPECT_EQ(object, GCNode::asGCNode(data));
+    EXPECT_EQ(object, GCNode::asGCNode(data + 500));
+    EXPECT_EQ(object, GCNode::asGCNode(data + 1000));
+
+    data[1] = 42;
+    EXPECT_EQ(42, object->element(1));
+}
+
+TEST(IntegerVectorTest, CompactCloneStaysCompact) {
+    IntVector* object = IntVector::createSequence(1, 1, 500);
+    IntVector* copy = object->clone();
+    EXPECT_TRUE(copy->isCompact());
+    EXPECT_EQ(500, copy->size());
+    EXPECT_EQ(500, copy->element(499));
+
+    (*copy)[0] = 0;
+    EXPECT_TRUE(object->isCompact());
+    EXPECT_EQ(1, object->element(0));
+}
+
+TEST(RealVectorTest, ConstantVector) {
+    RealVector* object = RealVector::createSequence(-0.0, 0, 200);
+    EXPECT_TRUE(object->isCompact());
+    EXPECT_TRUE(std::signbit(object->element(150)));
+    EXPECT_TRUE(std::signbit((*object)[199]));
+    EXPECT_FALSE(object->isCompact());
+}
+
+TEST(RealVectorTest, MappedVector) {
+    std::vector<double> values(1000);
+    for (std::size_t i = 0; i < values.size(); ++i)
+	values[i] = i * 0.5;
+    char path_template[] = "/tmp/FixedVectorTestXXXXXX";
+    int fd = mkstemp(path_template);
+    ASSERT_NE(-1, fd);
+    std::string path = path_template;
+    std::size_t file_bytes = values.size() * sizeof(double);
+    ASSERT_EQ(ssize_t(file_bytes), write(fd, values.data(), file_bytes));
+    close(fd);
+
+    std::size_t mapped = MemoryBank::bytesMapped();
+    RealVector* object = RealVector::createMapped(path.c_str(),
+						  10 * sizeof(double),
+						  900);
+    ASSERT_EQ(900, object->size());
+    EXPECT_LE(mapped + 900 * sizeof(double), MemoryBank::bytesMapped());
+    EXPECT_FALSE(object->isCompact());
+    EXPECT_FALSE(object->hasInlineData());
+    EXPECT_EQ(5.0, (*object)[0]);
+    EXPECT_EQ(454.5, object->element(899));
+    EXPECT_EQ(object, GCNode::asGCNode(&(*object)[450]));
+
+    // Writes go to a private copy of the page.
+    (*object)[0] = -1;
+    EXPECT_EQ(-1, (*object)[0]);
+    RealVector* again = RealVector::createMapped(path.c_str(),
+						 10 * sizeof(double),
+						 900);
+    EXPECT_EQ(5.0, (*again)[0]);
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,71 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+#include "EvaluationTests.hpp"
+#include "rho/GCStackRoot.hpp"
+
+using namespace rho;
+
+namespace {
+    double evalToReal(const char* expression) {
+	GCStackRoot<> result(
+	    Executor::InterpreterExecutor()->parseAndEval(expression));
+	return Rf_asReal(result);
+    }
+}
+
+TEST(FunctionLookupCacheTest, SeesRedefinedFunctions) {
+    EXPECT_EQ(3, evalToReal(
+	"{ f <- function() 1; g <- function() f(); a <- g();"
+	"  f <- function() 2; a + g() }"));
+    EXPECT_EQ(3, evalToReal(
+	"{ k <- function() { f <- function() 1; g <- function() f();"
+	"                    a <- g(); f <- function() 2; a + g() };"
+	"  k() }"));
+}
+
+TEST(FunctionLookupCacheTest, SeesRemovedFunctions) {
+    EXPECT_EQ(11, evalToReal(
+	"{ e <- new.env(); assign('length', function(x) 10, envir = e);"
+	"  g <- function() length(1); environment(g) <- e;"
+	"  a <- g(); rm('length', envir = e); a + g() }"));
+}
+
+TEST(FunctionLookupCacheTest, LocalBindingsTakePrecedence) {
+    EXPECT_EQ(45, evalToReal(
+	"{ h <- function(length) length(1:3);"
+	"  h(function(x) 42) + h(base::length) }"));
+    EXPECT_EQ(4, evalToReal(
+	"{ h <- function(f) { s <- 0; for (i in 1:2) s <- s + f(); s };"
+	"  h(function() 1) + h(function() 1) }"));
+}
+
+TEST(FunctionLookupCacheTest, SeesChangedEnclosingEnvironments) {
+    EXPECT_EQ(3, evalToReal(
+	"{ e1 <- new.env(); e2 <- new.env();"
+	"  assign('f', function() 1, envir = e1);"
+	"  assign('f', function() 2, envir = e2);"
+	"  g <- function() f(); environment(g) <- new.env(parent = e1);"
+	"  a <- g(); parent.env(environment(g)) <- e2; a + g() }"));
+}
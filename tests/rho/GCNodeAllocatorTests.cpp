@@ -21,6 +21,10 @@
  *  http://www.r-project.org/Licenses/
  */
 
+#include <set>
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "rho/GCNodeAllocator.hpp"
 #include "rho/AddressSanitizer.hpp"
@@ -236,3 +240,130 @@ TEST(GCNodeAllocatorTest, AllocManySmall) {
     }
 }
 
+
+TEST(GCNodeAllocatorTest, TracksYoungAllocations) {
+    // Test that allocations of each size are visited as young until the
+    // nursery is cleared.
+    GCNodeAllocator::enableNursery(true);
+    void* small = GCNodeAllocator::allocate(64);
+    void* medium = GCNodeAllocator::allocate(1 << 12);
+    void* large = GCNodeAllocator::allocate(1 << 20);
+    void* freed = GCNodeAllocator::allocate(64);
+    GCNodeAllocator::free(freed);
+
+    std::set<void*> young;
+    GCNodeAllocator::applyToYoungAllocations([&](void* pointer) {
+        young.insert(pointer);
+    });
+    EXPECT_EQ(1, young.count(small));
+    EXPECT_EQ(1, young.count(medium));
+    EXPECT_EQ(1, young.count(large));
+    EXPECT_EQ(0, young.count(freed));
+
+    GCNodeAllocator::clearNursery();
+    young.clear();
+    GCNodeAllocator::applyToYoungAllocations([&](void* pointer) {
+        young.insert(pointer);
+    });
+    EXPECT_TRUE(young.empty());
+
+    GCNodeAllocator::enableNursery(false);
+    GCNodeAllocator::free(small);
+    GCNodeAllocator::free(medium);
+    GCNodeAllocator::free(large);
+}
+
+TEST(GCNodeAllocatorTest, MultiThreadedAllocation) {
+    // Test that several threads can allocate and free at once, and that
+    // each thread gets distinct blocks.
+    static constexpr int num_threads = 4;
+    static constexpr int num_allocs = 2000;
+    std::vector<void*> allocations[num_threads];
+    GCNodeAllocator::setMultiThreaded(true);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([t, &allocations]() {
+            for (int round = 0; round < 3; ++round) {
+                for (void* alloc : allocations[t]) {
+                    GCNodeAllocator::free(alloc);
+                }
+                allocations[t].clear();
+                for (int i = 0; i < num_allocs; ++i) {
+                    int size = 32 + 8 * (i % 29);
+                    if (i % 97 == 0) {
+                        size = 1 << 12;
+                    }
+                    allocations[t].push_back(GCNodeAllocator::allocate(size));
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    GCNodeAllocator::setMultiThreaded(false);
+
+    std::set<void*> distinct;
+    for (int t = 0; t < num_threads; ++t) {
+        for (void* alloc : allocations[t]) {
+            EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(alloc));
+            distinct.insert(alloc);
+        }
+    }
+    EXPECT_EQ(size_t(num_threads * num_allocs), distinct.size());
+    for (int t = 0; t < num_threads; ++t) {
+        for (void* alloc : allocations[t]) {
+            GCNodeAllocator::free(alloc);
+        }
+    }
+}
+
+TEST(GCNodeAllocatorTest, DisablingMultiThreadingFlushesCaches) {
+    // Test that blocks freed into thread caches are no longer seen as
+    // allocations once multithreading is disabled.
+    auto count_allocations = []() {
+        size_t count = 0;
+        GCNodeAllocator::applyToAllAllocations([&](void*) { ++count; });
+        return count;
+    };
+    auto allocate_and_free = []() {
+        std::vector<void*> allocations;
+        for (int i = 0; i < 100; ++i) {
+            allocations.push_back(GCNodeAllocator::allocate(64));
+        }
+        for (void* alloc : allocations) {
+            GCNodeAllocator::free(alloc);
+        }
+    };
+    size_t before = count_allocations();
+    GCNodeAllocator::setMultiThreaded(true);
+    allocate_and_free();
+    std::thread thread(allocate_and_free);
+    thread.join();
+    GCNodeAllocator::setMultiThreaded(false);
+    EXPECT_EQ(before, count_allocations());
+}
+
+#ifndef HAVE_ADDRESS_SANITIZER
+TEST(GCNodeAllocatorTest, ReleasesEmptySuperblocks) {
+    // Test that superblocks emptied by freeing are released, and that
+    // allocation still works afterwards.
+    std::vector<void*> allocations;
+    for (int i = 0; i < 4 * (1 << 18) / 248; ++i) {
+        allocations.push_back(GCNodeAllocator::allocate(248));
+    }
+    for (void* alloc : allocations) {
+        GCNodeAllocator::free(alloc);
+    }
+    EXPECT_LE(2 * (1 << 18), GCNodeAllocator::releaseFreeMemory());
+    EXPECT_EQ(0, GCNodeAllocator::releaseFreeMemory());
+
+    for (void* alloc : allocations) {
+        EXPECT_EQ(nullptr, GCNodeAllocator::lookupPointer(alloc));
+    }
+    for (int i = 0; i < 4 * (1 << 18) / 64; ++i) {
+        void* alloc = GCNodeAllocator::allocate(64);
+        EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(alloc));
+    }
+}
+#endif // HAVE_ADDRESS_SANITIZER
@@ -0,0 +1,97 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#include "TestHelpers.hpp"
+#include "rho/GCNode.hpp"
+#include "rho/GCRoot.hpp"
+#include "rho/ListVector.hpp"
+#include "rho/RealVector.hpp"
+
+using namespace rho;
+
+class GenerationalGCTest : public ::testing::TestWithParam<int> {
+protected:
+    void SetUp() override {
+	GCNode::setGenerational(true);
+    }
+
+    void TearDown() override {
+	GCNode::setGenerational(false);
+    }
+
+    // Stores a new list containing a scalar into element 0 of outer,
+    // without leaving pointers to the new objects on the stack.
+    static void __attribute__((noinline)) storeYoungList(ListVector* outer) {
+	ListVector* inner = ListVector::create(1);
+	(*outer)[0] = inner;
+	(*inner)[0] = RealVector::createScalar(42);
+    }
+
+    // Overwrites dead stack space, so that the conservative stack scan
+    // doesn't find stale pointers to the objects created above.
+    static void __attribute__((noinline)) clearStack() {
+	volatile char buffer[1 << 14];
+	for (size_t i = 0; i < sizeof(buffer); ++i) {
+	    buffer[i] = 0;
+	}
+    }
+};
+
+TEST_F(GenerationalGCTest, NodesArePromotedBySurvivingGC) {
+    GCRoot<RealVector> object(RealVector::createScalar(1));
+    EXPECT_TRUE(isYoung(object));
+
+    GCNode::minorGC();
+    EXPECT_FALSE(isYoung(object));
+    EXPECT_EQ(1, (*object)[0]);
+}
+
+TEST_F(GenerationalGCTest, DisablingPromotesAllNodes) {
+    GCRoot<RealVector> object(RealVector::createScalar(1));
+    GCNode::setGenerational(false);
+    EXPECT_FALSE(isYoung(object));
+}
+
+TEST_P(GenerationalGCTest, OldToYoungReferencesAreRoots) {
+    // The parameter selects the size of the old list, so that edges both
+    // inside and outside the small object arena are tested.
+    GCRoot<ListVector> outer(ListVector::create(GetParam()));
+    GCNode::minorGC();
+    ASSERT_FALSE(isYoung(outer));
+
+    storeYoungList(outer);
+    clearStack();
+    GCNode::minorGC();
+
+    ListVector* inner = SEXP_downcast<ListVector*>((*outer)[0].get());
+    ASSERT_NE(nullptr, inner);
+    EXPECT_FALSE(isYoung(inner));
+    RealVector* scalar = SEXP_downcast<RealVector*>((*inner)[0].get());
+    ASSERT_NE(nullptr, scalar);
+    EXPECT_EQ(42, (*scalar)[0]);
+}
+
+INSTANTIATE_TEST_CASE_P(ListSizes, GenerationalGCTest,
+			::testing::Values(1, 100000));
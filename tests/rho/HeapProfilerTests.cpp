@@ -0,0 +1,84 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+
+#include "gtest/gtest.h"
+
+#include "rho/GCStackRoot.hpp"
+#include "rho/HeapProfiler.hpp"
+#include "rho/IntVector.hpp"
+#include "rho/ListVector.hpp"
+
+using namespace rho;
+
+TEST(HeapProfilerTest, SnapshotCountsLiveNodesByType) {
+    HeapProfiler::Snapshot before = HeapProfiler::takeSnapshot();
+    GCStackRoot<ListVector> list(ListVector::create(100));
+    for (int i = 0; i < 100; ++i) {
+	(*list)[i] = IntVector::create(10);
+    }
+    HeapProfiler::Snapshot after = HeapProfiler::takeSnapshot();
+
+    EXPECT_LE(before.by_type[INTSXP].count + 100,
+	      after.by_type[INTSXP].count);
+    EXPECT_LE(before.by_type[INTSXP].bytes + 100 * 10 * sizeof(int),
+	      after.by_type[INTSXP].bytes);
+    EXPECT_LE(before.by_type[VECSXP].count + 1, after.by_type[VECSXP].count);
+}
+
+TEST(HeapProfilerTest, SnapshotReportsSuperblockCapacity) {
+    HeapProfiler::Snapshot snapshot = HeapProfiler::takeSnapshot();
+    size_t count = 0;
+    for (const auto& entry : snapshot.by_size) {
+	const HeapProfiler::SizeUsage& usage = entry.second;
+	EXPECT_EQ(entry.first * usage.count, usage.bytes);
+	if (usage.superblocks > 0) {
+	    EXPECT_LE(usage.count, usage.capacity);
+	}
+	count += usage.count;
+    }
+    size_t type_count = 0;
+    for (const auto& entry : snapshot.by_type) {
+	type_count += entry.second.count;
+    }
+    EXPECT_EQ(type_count, count);
+}
+
+TEST(HeapProfilerTest, SamplesAllocations) {
+    HeapProfiler::clearSamples();
+    HeapProfiler::startSampling(1024);
+    for (int i = 0; i < 100; ++i) {
+	IntVector::create(256);
+    }
+    HeapProfiler::stopSampling();
+
+    std::vector<HeapProfiler::Site> sites = HeapProfiler::sampledSites();
+    size_t bytes = 0;
+    for (const HeapProfiler::Site& site : sites) {
+	bytes += site.bytes;
+    }
+    EXPECT_LE(100 * 256 * sizeof(int), bytes + 1024);
+
+    HeapProfiler::clearSamples();
+    EXPECT_TRUE(HeapProfiler::sampledSites().empty());
+}
@@ -0,0 +1,100 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "EvaluationTests.hpp"
+#include "rho/BuiltInFunction.hpp"
+#include "rho/RealVector.hpp"
+
+using namespace rho;
+
+extern "C" SEXP R_binary(SEXP call, SEXP op, SEXP xarg, SEXP yarg);
+
+// Arithmetic and math functions may write their results into unshared
+// operands.  These check that values that are still referenced are never
+// overwritten.
+class InPlaceArithmeticTest : public EvaluatorTest { };
+
+TEST_P(InPlaceArithmeticTest, Temporaries)
+{
+    runEvaluatorTests({
+	    { "{ x <- as.numeric(1:100); y <- (x + 1) * 2; c(x[100], y[100]) }",
+		    "c(100, 202)" },
+	    { "{ x <- 1:100; y <- (x + 1L) * 2L; c(x[100], y[100]) }",
+		    "c(100L, 202L)" },
+	    { "{ x <- 1:100; y <- x / 2L + x; c(x[100], y[100]) }",
+		    "c(100, 150)" },
+	    { "{ x <- as.numeric(1:100); y <- sqrt(x * x); identical(x, y) }",
+		    "TRUE" },
+	    { "{ x <- c(a = 1, b = 2); names((x + 1) * 2) }", "c('a', 'b')" },
+	    { "sum(seq_len(100) * 2L)", "10100L" },
+	});
+}
+
+TEST_P(InPlaceArithmeticTest, SharedOperands)
+{
+    runEvaluatorTests({
+	    { "{ x <- as.numeric(1:100); y <- x; y <- y + 1; x[1] }", "1" },
+	    { "{ x <- as.numeric(1:100); f <- function(v) v * 2; "
+	      "y <- f(x + 1); c(x[1], y[1]) }", "c(1, 4)" },
+	    { "{ l <- list(a = as.numeric(1:100)); y <- l$a + 1; l$a[1] }",
+		    "1" },
+	    { "{ v <- as.numeric(1:100); e <- quote(v + 1); "
+	      "r <- eval(e) * 2; c(v[1], r[1]) }", "c(1, 4)" },
+	    { "{ x <- as.numeric(1:100); y <- exp(x - x); c(x[2], y[2]) }",
+		    "c(2, 1)" },
+	    // Constants in the function body must survive repeated calls.
+	    { "{ f <- function() 1 + 1; f(); f(); f() }", "2" },
+	});
+}
+
+TEST(InPlaceArithmeticReuseTest, ReusesUnsharedOperand)
+{
+    BuiltInFunction* plus = BuiltInFunction::obtainPrimitive("+");
+    GCStackRoot<RealVector> lhs(RealVector::create(100));
+    GCStackRoot<RealVector> rhs(RealVector::create(100));
+    std::fill(lhs->begin(), lhs->end(), 1.0);
+    std::fill(rhs->begin(), rhs->end(), 2.0);
+    ASSERT_EQ(0, NAMED(rhs));
+
+    RObject* result = R_binary(nullptr, plus, lhs, rhs);
+    EXPECT_EQ(rhs.get(), result);
+    EXPECT_EQ(3.0, (*rhs)[99]);
+    EXPECT_EQ(1.0, (*lhs)[99]);
+
+    // Once both operands are shared, a new vector is allocated.
+    SET_NAMED(lhs, 2);
+    SET_NAMED(rhs, 2);
+    result = R_binary(nullptr, plus, lhs, rhs);
+    EXPECT_NE(lhs.get(), result);
+    EXPECT_NE(rhs.get(), result);
+    EXPECT_EQ(4.0, (*static_cast<RealVector*>(result))[99]);
+    EXPECT_EQ(3.0, (*rhs)[99]);
+}
+
+INSTANTIATE_TEST_CASE_P(InterpreterInPlaceArithmeticTest,
+                        InPlaceArithmeticTest,
+			testing::Values(Executor::InterpreterExecutor()));
+
+INSTANTIATE_TEST_CASE_P(JITInPlaceArithmeticTest,
+                        InPlaceArithmeticTest,
+			testing::Values(Executor::JITExecutor()));
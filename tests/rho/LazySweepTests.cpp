@@ -0,0 +1,101 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+
+#include "gtest/gtest.h"
+
+#include "rho/GCNode.hpp"
+#include "rho/GCRoot.hpp"
+#include "rho/GCStackRoot.hpp"
+#include "rho/ListVector.hpp"
+#include "rho/RealVector.hpp"
+
+using namespace rho;
+
+class LazySweepTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+	GCNode::setLazySweep(true);
+    }
+
+    void TearDown() override {
+	GCNode::gc(false);
+	GCNode::setLazySweep(false);
+    }
+
+    // Creates a cycle of lists, each also holding a scalar.  The cycle
+    // can only be freed by mark-sweep.
+    static void __attribute__((noinline)) createGarbageCycle(int length) {
+	GCStackRoot<ListVector> head(ListVector::create(2));
+	ListVector* tail = head;
+	for (int i = 1; i < length; ++i) {
+	    (*tail)[0] = RealVector::createScalar(i);
+	    ListVector* next = ListVector::create(2);
+	    (*tail)[1] = next;
+	    tail = next;
+	}
+	(*tail)[1] = head;
+    }
+
+    // Overwrites dead stack space, so that the conservative stack scan
+    // doesn't find stale pointers to the objects created above.
+    static void __attribute__((noinline)) clearStack() {
+	volatile char buffer[1 << 14];
+	for (size_t i = 0; i < sizeof(buffer); ++i) {
+	    buffer[i] = 0;
+	}
+    }
+};
+
+TEST_F(LazySweepTest, SweepIsCompletedByNextCollection) {
+    GCNode::gc(true);
+    GCNode::gc(false);
+    size_t nodes_before = GCNode::numNodes();
+    createGarbageCycle(1000);
+    clearStack();
+
+    GCNode::gc(true);
+    EXPECT_LT(0u, GCNode::sweepBacklog());
+
+    GCNode::gc(false);
+    EXPECT_EQ(0u, GCNode::sweepBacklog());
+    EXPECT_GT(nodes_before + 2000, GCNode::numNodes());
+}
+
+TEST_F(LazySweepTest, ReachableNodesSurvive) {
+    GCRoot<ListVector> list(ListVector::create(1));
+    (*list)[0] = RealVector::createScalar(42);
+    createGarbageCycle(1000);
+    clearStack();
+
+    GCNode::gc(true);
+    // Allocating reclaims garbage from the unswept superblocks.
+    for (int i = 0; i < 10000; ++i) {
+	RealVector::createScalar(i);
+    }
+    GCNode::gc(false);
+
+    RealVector* value = SEXP_downcast<RealVector*>((*list)[0].get());
+    ASSERT_NE(nullptr, value);
+    EXPECT_EQ(42, (*value)[0]);
+}
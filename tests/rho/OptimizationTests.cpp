@@ -0,0 +1,129 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#define R_NO_REMAP
+#include "rho/jit/CompilationQueue.hpp"
+#include "rho/jit/CompiledExpression.hpp"
+
+#include "rho/Closure.hpp"
+#include "rho/GCStackRoot.hpp"
+#include "EvaluationTests.hpp"
+
+using namespace rho;
+using namespace rho::JIT;
+
+namespace {
+    RObject* eval(const char* expression, Environment* env)
+    {
+	return Executor::parseAndEvalWithInterpreter(expression, env);
+    }
+
+    double evalToReal(const char* expression, Environment* env)
+    {
+	return Rf_asReal(eval(expression, env));
+    }
+
+    // Compiles f in env and returns the value of calling it.
+    double compileAndCall(const char* call, Environment* env)
+    {
+	GCStackRoot<Closure> f(SEXP_downcast<Closure*>(eval("f", env)));
+	f->compile();
+	return evalToReal(call, env);
+    }
+
+    // Resets the options that the tests change.
+    struct OptionsScope {
+	~OptionsScope() {
+	    Executor::parseAndEvalWithInterpreter(
+		"options(rho.jit.optimize = NULL, rho.jit.passes = NULL)");
+	}
+    };
+}
+
+TEST(OptimizationTest, CachedLookupsSeeAssignments) {
+    OptionsScope scope;
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    eval("{ options(rho.jit.passes = 'lookups');"
+	 "  g <- 1;"
+	 "  bump <- function() g <<- g + 1;"
+	 "  f <- function(n) {"
+	 "    x <- 0;"
+	 "    for (i in 1:n) { x <- x + g; bump(); x <- x + g };"
+	 "    x } }", env);
+    // g takes the values 1, 2, 2, 3, 3, 4.
+    EXPECT_EQ(15, compileAndCall("f(3)", env));
+}
+
+TEST(OptimizationTest, CachedLookupsSeePromises) {
+    OptionsScope scope;
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    eval("{ options(rho.jit.passes = 'lookups');"
+	 "  g <- 1;"
+	 "  delayedAssign('h', { g <<- 10; 0 }, eval.env = new.env());"
+	 "  f <- function() { x <- g; x <- x + h; x + g } }", env);
+    EXPECT_EQ(11, compileAndCall("f()", env));
+}
+
+TEST(OptimizationTest, CachedLookupsSeeActiveBindings) {
+    OptionsScope scope;
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    eval("{ options(rho.jit.passes = 'lookups');"
+	 "  count <- 0;"
+	 "  makeActiveBinding('a', function() count <<- count + 1,"
+	 "                    environment());"
+	 "  f <- function(n) { x <- 0; for (i in 1:n) x <- x + a; x } }",
+	 env);
+    EXPECT_EQ(10, compileAndCall("f(4)", env));
+}
+
+TEST(OptimizationTest, OptimizationLevels) {
+    OptionsScope scope;
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    for (int level = 0; level <= 3; level++) {
+	GCStackRoot<Closure> closure(SEXP_downcast<Closure*>(eval(
+	    "{ k <- 3; function(n) { x <- 0; for (i in 1:n) x <- x + i * k;"
+	    "  x } }", env)));
+	std::string options
+	    = "options(rho.jit.optimize = " + std::to_string(level) + ")";
+	eval(options.c_str(), env);
+
+	GCStackRoot<const CompiledExpression> code(
+	    CompiledExpression::compileFunctionBodyInBackground(closure,
+								 true));
+	ASSERT_TRUE(code.get() != nullptr);
+	CompilationQueue::waitUntilIdle();
+	EXPECT_TRUE(code->isReady());
+    }
+}
+
+TEST(OptimizationTest, PassesCanBeDisabled) {
+    OptionsScope scope;
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    eval("{ options(rho.jit.passes = character());"
+	 "  k <- 2;"
+	 "  f <- function(n) { x <- 0; for (i in 1:n) x <- x + k; x } }",
+	 env);
+    EXPECT_EQ(20, compileAndCall("f(10)", env));
+}
@@ -0,0 +1,104 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "TestHelpers.hpp"
+#include "rho/GCNode.hpp"
+#include "rho/GCRoot.hpp"
+#include "rho/RealVector.hpp"
+
+using namespace rho;
+
+// The overflow table can only be enabled before any nodes are created, so
+// these tests check whichever mode the process was started in.  The check
+// target runs them again with R_GC_REFCOUNT_OVERFLOW set.
+
+// Raises the reference count of a new node past the inline maximum and
+// back again, then drops the last reference.
+static void __attribute__((noinline)) overflowAndRelease() {
+    size_t overflowed_before = GCNode::numOverflowedRefCounts();
+    std::unique_ptr<GCRoot<RealVector>> object(
+	new GCRoot<RealVector>(RealVector::createScalar(1)));
+    std::vector<std::unique_ptr<GCRoot<RealVector>>> roots;
+    for (int i = 0; i < 40; ++i) {
+	roots.emplace_back(new GCRoot<RealVector>(*object));
+    }
+    EXPECT_EQ(31, getRefCount(*object));
+    EXPECT_EQ(overflowed_before + 1, GCNode::numOverflowedRefCounts());
+
+    roots.resize(35);
+    EXPECT_EQ(31, getRefCount(*object));
+    roots.resize(30);
+    EXPECT_EQ(31, getRefCount(*object));
+    EXPECT_EQ(overflowed_before, GCNode::numOverflowedRefCounts());
+    roots.resize(10);
+    EXPECT_EQ(11, getRefCount(*object));
+
+    roots.clear();
+    EXPECT_EQ(1, getRefCount(*object));
+    object.reset();
+}
+
+// Overwrites dead stack space, so that the conservative stack scan doesn't
+// find stale pointers to the node created above.
+static void __attribute__((noinline)) clearStack() {
+    volatile char buffer[1 << 14];
+    for (size_t i = 0; i < sizeof(buffer); ++i) {
+	buffer[i] = 0;
+    }
+}
+
+TEST(RefCountSaturationTest, OverflowedCountsRoundTrip) {
+    if (!isRefCountOverflowEnabled()) {
+	return;
+    }
+    GCNode::gc(false);
+    size_t nodes_before = GCNode::numNodes();
+    overflowAndRelease();
+    clearStack();
+
+    // No mark-sweep is needed to free the node.
+    GCNode::gc(false);
+    EXPECT_EQ(nodes_before, GCNode::numNodes());
+    EXPECT_EQ(0u, GCNode::numSaturatedNodes());
+}
+
+TEST(RefCountSaturationTest, SaturatedNodesAreCounted) {
+    if (isRefCountOverflowEnabled()) {
+	return;
+    }
+    GCRoot<RealVector> object(RealVector::createScalar(1));
+    std::vector<std::unique_ptr<GCRoot<RealVector>>> roots;
+    for (int i = 0; i < 40; ++i) {
+	roots.emplace_back(new GCRoot<RealVector>(object));
+    }
+    ASSERT_EQ(31, getRefCount(object));
+
+    GCNode::gc(true);
+    EXPECT_LE(1u, GCNode::numSaturatedNodes());
+}
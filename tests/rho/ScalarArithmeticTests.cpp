@@ -0,0 +1,88 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "EvaluationTests.hpp"
+
+class ScalarArithmeticTest : public EvaluatorTest { };
+
+TEST_P(ScalarArithmeticTest, Arithmetic)
+{
+    runEvaluatorTests({
+	    { "1 + 2", "3" },
+	    { "5 - 7.5", "-2.5" },
+	    { "1L + 2L", "3L" },
+	    { "3L * 4L", "12L" },
+	    { "TRUE + TRUE", "2L" },
+	    { "2L * 1.5", "3" },
+	    { "1L / 2L", "0.5" },
+	    { "1 / 0", "Inf" },
+	    { "NA_real_ + 1", "NA_real_" },
+	    { "NA_integer_ + 1L", "NA_integer_" },
+	    { ".Machine$integer.max + 1L", "NA_integer_",
+		    Warning("NAs produced by integer overflow") },
+	    { "{ x <- 2; y <- 3; x * y + 1 }", "7" },
+	    { "{ x <- 2L; (x + 1L) * (x - 1L) }", "3L" },
+
+	    // Cases that aren't unboxed scalars.
+	    { "c(a = 1) + 1", "c(a = 2)" },
+	    { "1:3 + 1", "c(2, 3, 4)" },
+	    { "1 + 'a'", Error("non-numeric argument to binary operator") },
+	    { "{ `+` <- function(a, b) a - b; 5 + 3 }", "2" },
+	});
+}
+
+TEST_P(ScalarArithmeticTest, Comparison)
+{
+    runEvaluatorTests({
+	    { "1 < 2", "TRUE" },
+	    { "2 <= 1", "FALSE" },
+	    { "1L == 1", "TRUE" },
+	    { "TRUE != 1L", "FALSE" },
+	    { "NA < 1", "NA" },
+	    { "NaN == NaN", "NA" },
+	    { "'a' < 'b'", "TRUE" },
+	    { "{ x <- 2; y <- 3; x * y + 1 > 6 }", "TRUE" },
+	});
+}
+
+TEST_P(ScalarArithmeticTest, Conditions)
+{
+    runEvaluatorTests({
+	    { "if (1 < 2) 'yes' else 'no'", "'yes'" },
+	    { "if (1 + 1) 'yes' else 'no'", "'yes'" },
+	    { "if (1L - 1L) 'yes' else 'no'", "'no'" },
+	    { "{ i <- 0; while (i < 5) i <- i + 1; i }", "5" },
+	    { "if (NA < 1) 1",
+		    Error("missing value where TRUE/FALSE needed") },
+	    { "if (NaN + 1) 1",
+		    Error("argument is not interpretable as logical") },
+	});
+}
+
+INSTANTIATE_TEST_CASE_P(InterpreterScalarArithmeticTest,
+                        ScalarArithmeticTest,
+			testing::Values(Executor::InterpreterExecutor()));
+
+INSTANTIATE_TEST_CASE_P(JITScalarArithmeticTest,
+                        ScalarArithmeticTest,
+			testing::Values(Executor::JITExecutor()));
@@ -0,0 +1,78 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+#include "rho/Environment.hpp"
+#include "rho/GCStackRoot.hpp"
+#include "rho/ListFrame.hpp"
+#include "rho/RealVector.hpp"
+#include "rho/StringVector.hpp"
+
+using namespace rho;
+
+TEST(SearchPathCacheTest, CachesUnboundSymbols) {
+    Environment* global = Environment::global();
+    const Symbol* symbol = Symbol::obtain("search_path_cache_test_1");
+    Environment::resetSearchPathCacheStatistics();
+
+    EXPECT_EQ(nullptr, global->findBinding(symbol));
+    EXPECT_EQ(nullptr, global->findBinding(symbol));
+    EXPECT_EQ(1u, Environment::searchPathCacheStatistics().misses);
+    EXPECT_EQ(1u, Environment::searchPathCacheStatistics().negative_hits);
+
+    // Binding the symbol anywhere on the search path replaces the
+    // negative entry.
+    GCStackRoot<> value(RealVector::createScalar(1.0));
+    Frame::Binding* bdg = Environment::base()->frame()->bind(symbol, value);
+    EXPECT_EQ(bdg, global->findBinding(symbol));
+    EXPECT_EQ(bdg, global->findBinding(symbol));
+    EXPECT_EQ(1u, Environment::searchPathCacheStatistics().hits);
+
+    Environment::base()->frame()->erase(symbol);
+    EXPECT_EQ(nullptr, global->findBinding(symbol));
+}
+
+TEST(SearchPathCacheTest, AttachAndDetachInvalidateIncrementally) {
+    Environment* global = Environment::global();
+    const Symbol* attached = Symbol::obtain("search_path_cache_test_2");
+    const Symbol* other = Symbol::obtain("search_path_cache_test_3");
+    EXPECT_EQ(nullptr, global->findBinding(attached));
+    EXPECT_EQ(nullptr, global->findBinding(other));
+    Environment::resetSearchPathCacheStatistics();
+
+    GCStackRoot<Environment> env(new Environment(nullptr, new ListFrame));
+    GCStackRoot<> value(RealVector::createScalar(1.0));
+    env->frame()->bind(attached, value);
+    GCStackRoot<StringVector> name(StringVector::createScalar(
+	String::obtain("search_path_cache_test")));
+    GCStackRoot<Environment> on_path(env->attachToSearchPath(2, name));
+
+    EXPECT_NE(nullptr, global->findBinding(attached));
+    EXPECT_EQ(nullptr, global->findBinding(other));
+    EXPECT_EQ(1u, Environment::searchPathCacheStatistics().negative_hits);
+    EXPECT_EQ(0u, Environment::searchPathCacheStatistics().generations);
+
+    Environment::detachFromSearchPath(2);
+    EXPECT_EQ(nullptr, global->findBinding(attached));
+    EXPECT_EQ(0u, Environment::searchPathCacheStatistics().generations);
+}
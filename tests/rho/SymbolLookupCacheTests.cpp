@@ -0,0 +1,95 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#define R_NO_REMAP
+#include "rho/jit/CompiledExpression.hpp"
+
+#include "rho/Closure.hpp"
+#include "rho/GCStackRoot.hpp"
+#include "EvaluationTests.hpp"
+
+using namespace rho;
+using namespace rho::JIT;
+
+namespace {
+    RObject* eval(const char* expression, Environment* env)
+    {
+	return Executor::parseAndEvalWithInterpreter(expression, env);
+    }
+
+    double evalToReal(const char* expression, Environment* env)
+    {
+	return Rf_asReal(eval(expression, env));
+    }
+
+    // Defines f in a child of env, reading the free variable g, and
+    // compiles it.
+    void defineAndCompile(Environment* env)
+    {
+	eval("{ e <- new.env(parent = environment());"
+	     "  f <- local(function() g, e) }", env);
+	GCStackRoot<Closure> f(SEXP_downcast<Closure*>(eval("f", env)));
+	f->compile();
+    }
+}
+
+TEST(SymbolLookupCacheTest, SeesNewValues) {
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    eval("g <- 1", env);
+    defineAndCompile(env);
+    EXPECT_EQ(1, evalToReal("f()", env));
+    eval("g <- 2", env);
+    EXPECT_EQ(2, evalToReal("f()", env));
+    EXPECT_EQ(3, evalToReal("{ g <- 3; f() }", env));
+}
+
+TEST(SymbolLookupCacheTest, SeesShadowingBindings) {
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    eval("g <- 1", env);
+    defineAndCompile(env);
+    EXPECT_EQ(1, evalToReal("f()", env));
+    eval("assign('g', 10, e)", env);
+    EXPECT_EQ(10, evalToReal("f()", env));
+    eval("rm('g', envir = e)", env);
+    EXPECT_EQ(1, evalToReal("f()", env));
+}
+
+TEST(SymbolLookupCacheTest, SeesNewEnclosures) {
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    eval("g <- 1", env);
+    defineAndCompile(env);
+    EXPECT_EQ(1, evalToReal("f()", env));
+    eval("parent.env(e) <- list2env(list(g = 20), parent = environment())",
+	 env);
+    EXPECT_EQ(20, evalToReal("f()", env));
+}
+
+TEST(SymbolLookupCacheTest, SeesPromises) {
+    GCStackRoot<Environment> env(Executor::newTestEnv());
+    eval("delayedAssign('g', 30)", env);
+    defineAndCompile(env);
+    EXPECT_EQ(30, evalToReal("f()", env));
+    EXPECT_EQ(30, evalToReal("f()", env));
+}
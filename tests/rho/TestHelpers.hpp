@@ -49,6 +49,14 @@ public:
     static bool isOnStackBitSet(const GCNode* node) {
 	return node->isOnStackBitSet();
     }
+
+    static bool isYoung(const GCNode* node) {
+	return node->m_young;
+    }
+
+    static bool isRefCountOverflowEnabled() {
+	return GCNode::s_refcount_overflow != nullptr;
+    }
 };
 
 inline unsigned char getRefCount(const GCNode* node) {
@@ -59,6 +67,14 @@ inline bool isOnStackBitSet(const GCNode* node) {
     return GCTestHelper::isOnStackBitSet(node);
 }
 
+inline bool isYoung(const GCNode* node) {
+    return GCTestHelper::isYoung(node);
+}
+
+inline bool isRefCountOverflowEnabled() {
+    return GCTestHelper::isRefCountOverflowEnabled();
+}
+
 }  // namespace rho
 
 #endif  // RHO_TESTS_RHO_TEST_HELPERS_HPP
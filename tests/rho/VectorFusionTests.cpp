@@ -0,0 +1,74 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "EvaluationTests.hpp"
+
+// The vectors are long enough for the calls to be fused, and sums are used
+// to keep the expected values short.
+class VectorFusionTest : public EvaluatorTest { };
+
+TEST_P(VectorFusionTest, Arithmetic)
+{
+    runEvaluatorTests({
+	    { "{ x <- as.numeric(1:100); sum(x * 2 + 1) }", "10200" },
+	    { "{ x <- as.numeric(1:100); sum(1 - x / 2) }", "-2425" },
+	    { "{ x <- as.numeric(1:2000); sum(exp(x / 2000) * 0 + x) }",
+		    "2001000" },
+	    { "{ x <- 1:100; sum(x / 2L + x) }", "7575" },
+	    { "{ x <- rep(c(TRUE, FALSE), 50); sum(x * 1.5 + x) }", "125" },
+	    { "{ x <- as.numeric(1:100); x[3] <- NA; sum(is.na(x * 2 + 1)) }",
+		    "1L" },
+	    { "{ x <- seq(-99, 100); sum(is.nan(sqrt(x - 0.5) + 1)) }", "100L",
+		    Warning("NaNs produced") },
+	});
+}
+
+TEST_P(VectorFusionTest, Comparison)
+{
+    runEvaluatorTests({
+	    { "{ x <- 1:100; sum(x * 2.5 > 100) }", "60L" },
+	    { "{ x <- as.numeric(1:100); sum(sqrt(x * x) == x) }", "100L" },
+	    { "{ x <- as.numeric(1:100); x[1] <- NaN; is.na((x + 1 > 50)[1]) }",
+		    "TRUE" },
+	});
+}
+
+TEST_P(VectorFusionTest, Unfused)
+{
+    runEvaluatorTests({
+	    { "{ x <- 1:100; typeof(x + x * 2L) }", "'integer'" },
+	    { "{ x <- as.numeric(1:100); names(x) <- x; names((x + 1) * 2)[5] }",
+		    "'5'" },
+	    { "{ x <- as.numeric(1:100); y <- 1:2; sum(x * 2 + y) }", "10250" },
+	    { "{ `+` <- function(a, b) a - b; x <- as.numeric(1:100); "
+	      "sum(x * 2 + 1) }", "10000" },
+	});
+}
+
+INSTANTIATE_TEST_CASE_P(InterpreterVectorFusionTest,
+                        VectorFusionTest,
+			testing::Values(Executor::InterpreterExecutor()));
+
+INSTANTIATE_TEST_CASE_P(JITVectorFusionTest,
+                        VectorFusionTest,
+			testing::Values(Executor::JITExecutor()));
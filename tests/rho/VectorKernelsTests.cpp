@@ -0,0 +1,291 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#include "rho/VectorKernels.hpp"
+
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace rho;
+using namespace rho::VectorKernels;
+
+namespace {
+    const int NA = INT_MIN;
+
+    // Restores the default instruction set at the end of a test.
+    class InstructionSetTest : public ::testing::TestWithParam<const char*>
+    {
+    protected:
+	void SetUp() override {
+	    m_default = instructionSet();
+	    m_supported = setInstructionSet(GetParam());
+	}
+
+	void TearDown() override {
+	    setInstructionSet(m_default.c_str());
+	}
+
+	bool m_supported;
+    private:
+	std::string m_default;
+    };
+
+    // Values that exercise NA handling, overflow and signed zeros,
+    // arranged so that each lane sees a mixture.
+    std::vector<int> intValues(size_t n, int seed)
+    {
+	static const int special[] = {
+	    NA, INT_MAX, -INT_MAX, 0, 1, -1, 46341, -46341, INT_MAX / 2 + 1
+	};
+	const size_t num_special = sizeof(special) / sizeof(special[0]);
+	std::vector<int> values(n);
+	for (size_t i = 0; i < n; ++i) {
+	    size_t k = (i * 7 + seed) % (num_special + 4);
+	    values[i] = k < num_special ? special[k] : int(i) * seed - 20;
+	}
+	return values;
+    }
+
+    std::vector<double> realValues(size_t n, int seed)
+    {
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	const double inf = std::numeric_limits<double>::infinity();
+	const double special[] = { nan, inf, -inf, 0.0, -0.0, 1.5, -2.25 };
+	const size_t num_special = sizeof(special) / sizeof(special[0]);
+	std::vector<double> values(n);
+	for (size_t i = 0; i < n; ++i) {
+	    size_t k = (i * 5 + seed) % (num_special + 3);
+	    values[i] = k < num_special ? special[k] : double(i) * seed / 3;
+	}
+	return values;
+    }
+
+    bool sameReal(double x, double y)
+    {
+	if (std::isnan(x) || std::isnan(y))
+	    return std::isnan(x) && std::isnan(y);
+	return std::memcmp(&x, &y, sizeof(double)) == 0;
+    }
+
+    int expectedInt(Arithmetic op, int lhs, int rhs, bool* overflow)
+    {
+	if (lhs == NA || rhs == NA)
+	    return NA;
+	double result = op == Arithmetic::PLUS ? double(lhs) + rhs
+	    : op == Arithmetic::MINUS ? double(lhs) - rhs
+	    : double(lhs) * rhs;
+	if (std::abs(result) > INT_MAX) {
+	    *overflow = true;
+	    return NA;
+	}
+	return int(result);
+    }
+
+    double expectedReal(Arithmetic op, double lhs, double rhs)
+    {
+	switch (op) {
+	case Arithmetic::PLUS:
+	    return lhs + rhs;
+	case Arithmetic::MINUS:
+	    return lhs - rhs;
+	case Arithmetic::TIMES:
+	    return lhs * rhs;
+	case Arithmetic::DIVIDE:
+	    return lhs / rhs;
+	}
+	return 0;
+    }
+
+    template <class T>
+    int expectedComparison(Comparison op, T lhs, T rhs)
+    {
+	switch (op) {
+	case Comparison::EQUAL:
+	    return lhs == rhs;
+	case Comparison::NOT_EQUAL:
+	    return lhs != rhs;
+	case Comparison::LESS:
+	    return lhs < rhs;
+	case Comparison::GREATER:
+	    return lhs > rhs;
+	case Comparison::LESS_EQUAL:
+	    return lhs <= rhs;
+	case Comparison::GREATER_EQUAL:
+	    return lhs >= rhs;
+	}
+	return 0;
+    }
+
+    const Arithmetic all_arithmetic[] = {
+	Arithmetic::PLUS, Arithmetic::MINUS, Arithmetic::TIMES,
+	Arithmetic::DIVIDE
+    };
+
+    const Comparison all_comparisons[] = {
+	Comparison::EQUAL, Comparison::NOT_EQUAL, Comparison::LESS,
+	Comparison::GREATER, Comparison::LESS_EQUAL, Comparison::GREATER_EQUAL
+    };
+
+    // Lengths covering empty input, partial groups of lanes and several
+    // complete groups with a tail.
+    const size_t lengths[] = { 0, 1, 3, 8, 15, 16, 17, 40, 67 };
+
+    // Stride combinations: both vectors, scalar lhs and scalar rhs.
+    const size_t strides[][2] = { { 1, 1 }, { 0, 1 }, { 1, 0 } };
+}
+
+TEST_P(InstructionSetTest, IntArithmetic) {
+    if (!m_supported)
+	return;
+    for (size_t n : lengths) {
+	std::vector<int> lhs = intValues(n + 1, 3), rhs = intValues(n + 1, 11);
+	for (const auto& stride : strides) {
+	    for (Arithmetic op : all_arithmetic) {
+		if (op == Arithmetic::DIVIDE)
+		    continue;
+		std::vector<int> out(n);
+		bool overflow = intArithmetic(op, lhs.data(), stride[0],
+					      rhs.data(), stride[1],
+					      out.data(), n);
+		bool expected_overflow = false;
+		for (size_t i = 0; i < n; ++i) {
+		    EXPECT_EQ(expectedInt(op, lhs[i * stride[0]],
+					  rhs[i * stride[1]],
+					  &expected_overflow), out[i])
+			<< "op " << int(op) << " element " << i;
+		}
+		EXPECT_EQ(expected_overflow, overflow);
+	    }
+	}
+    }
+}
+
+TEST_P(InstructionSetTest, IntOverflowInVectorLanes) {
+    if (!m_supported)
+	return;
+    std::vector<int> lhs(64, INT_MAX), rhs(64, 0), out(64);
+    EXPECT_FALSE(intArithmetic(Arithmetic::PLUS, lhs.data(), 1,
+			       rhs.data(), 1, out.data(), 64));
+    rhs[5] = 1;
+    EXPECT_TRUE(intArithmetic(Arithmetic::PLUS, lhs.data(), 1,
+			      rhs.data(), 1, out.data(), 64));
+    EXPECT_EQ(NA, out[5]);
+    EXPECT_EQ(INT_MAX, out[6]);
+    // Overflow in an NA lane isn't reported.
+    lhs[5] = NA;
+    EXPECT_FALSE(intArithmetic(Arithmetic::PLUS, lhs.data(), 1,
+			       rhs.data(), 1, out.data(), 64));
+}
+
+TEST_P(InstructionSetTest, RealArithmetic) {
+    if (!m_supported)
+	return;
+    for (size_t n : lengths) {
+	std::vector<double> lhs = realValues(n + 1, 2),
+	    rhs = realValues(n + 1, 7);
+	for (const auto& stride : strides) {
+	    for (Arithmetic op : all_arithmetic) {
+		std::vector<double> out(n);
+		realArithmetic(op, lhs.data(), stride[0], rhs.data(), stride[1],
+			       out.data(), n);
+		for (size_t i = 0; i < n; ++i) {
+		    EXPECT_PRED2(sameReal,
+				 expectedReal(op, lhs[i * stride[0]],
+					      rhs[i * stride[1]]),
+				 out[i])
+			<< "op " << int(op) << " element " << i;
+		}
+	    }
+	}
+    }
+}
+
+TEST_P(InstructionSetTest, Comparisons) {
+    if (!m_supported)
+	return;
+    for (size_t n : lengths) {
+	std::vector<int> lhs = intValues(n + 1, 5), rhs = intValues(n + 1, 2);
+	std::vector<double> rlhs = realValues(n + 1, 1),
+	    rrhs = realValues(n + 1, 4);
+	for (const auto& stride : strides) {
+	    for (Comparison op : all_comparisons) {
+		std::vector<int> out(n), rout(n);
+		intComparison(op, lhs.data(), stride[0], rhs.data(), stride[1],
+			      out.data(), n);
+		realComparison(op, rlhs.data(), stride[0],
+			       rrhs.data(), stride[1], rout.data(), n);
+		for (size_t i = 0; i < n; ++i) {
+		    int l = lhs[i * stride[0]], r = rhs[i * stride[1]];
+		    EXPECT_EQ(l == NA || r == NA ? NA
+			      : expectedComparison(op, l, r), out[i])
+			<< "op " << int(op) << " element " << i;
+		    double rl = rlhs[i * stride[0]], rr = rrhs[i * stride[1]];
+		    EXPECT_EQ(std::isnan(rl) || std::isnan(rr) ? NA
+			      : expectedComparison(op, rl, rr), rout[i])
+			<< "op " << int(op) << " element " << i;
+		}
+	    }
+	}
+    }
+}
+
+TEST_P(InstructionSetTest, OutputMayBeAnOperand) {
+    if (!m_supported)
+	return;
+    for (size_t n : lengths) {
+	std::vector<double> lhs = realValues(n, 3), rhs = realValues(n, 8);
+	std::vector<double> expected(n), out = lhs;
+	realArithmetic(Arithmetic::TIMES, lhs.data(), 1, rhs.data(), 1,
+		       expected.data(), n);
+	realArithmetic(Arithmetic::TIMES, out.data(), 1, rhs.data(), 1,
+		       out.data(), n);
+	for (size_t i = 0; i < n; ++i)
+	    EXPECT_PRED2(sameReal, expected[i], out[i]) << "element " << i;
+
+	std::vector<int> ilhs = intValues(n, 4), irhs = intValues(n, 9);
+	std::vector<int> iexpected(n), iout = irhs;
+	bool overflow = intArithmetic(Arithmetic::MINUS, ilhs.data(), 1,
+				      irhs.data(), 1, iexpected.data(), n);
+	EXPECT_EQ(overflow,
+		  intArithmetic(Arithmetic::MINUS, ilhs.data(), 1,
+				iout.data(), 1, iout.data(), n));
+	EXPECT_EQ(iexpected, iout);
+    }
+}
+
+TEST(VectorKernelsTest, UnknownInstructionSet) {
+    std::string current = instructionSet();
+    EXPECT_TRUE(setInstructionSet("generic"));
+    EXPECT_FALSE(setInstructionSet("mmx"));
+    EXPECT_STREQ("generic", instructionSet());
+    setInstructionSet(current.c_str());
+}
+
+INSTANTIATE_TEST_CASE_P(AllInstructionSets, InstructionSetTest,
+			::testing::Values("generic", "avx2", "avx512f"));